@@ -44,21 +44,69 @@ enum {
 extern "C" {
 #endif
 
+// From <sys/uio.h>, which users of clGather and clRing include themselves.
+struct iovec;
+
 typedef struct clFixedArray clFixedArray;
 typedef struct clFlexibleArray clFlexibleArray;
 typedef struct clObject clObject;
 typedef struct clUnion clUnion;
 typedef struct clColumn clColumn;
 typedef struct clString clString;
+typedef struct clNumber clNumber;
+typedef struct clLookup clLookup;
+typedef struct clPath clPath;
+typedef struct clDispatch clDispatch;
+typedef struct clBatch clBatch;
+typedef union clScalar clScalar;
+typedef struct clBuffer clBuffer;
+typedef struct clView clView;
+typedef struct clLogWriter clLogWriter;
+typedef struct clLogReader clLogReader;
+typedef struct clLogRecord clLogRecord;
+typedef struct clLogCursor clLogCursor;
+typedef struct clPlan clPlan;
+typedef struct clPlanOp clPlanOp;
+typedef struct clValidator clValidator;
+typedef struct clCheck clCheck;
+typedef struct clGather clGather;
+typedef struct clProjection clProjection;
+typedef struct clProjectionOp clProjectionOp;
+typedef struct clStats clStats;
+typedef struct clStatsOp clStatsOp;
+typedef struct clRing clRing;
+typedef struct clProgram clProgram;
+typedef struct clProgramOp clProgramOp;
+
+// A collision-free hash of the field names of an object or union.
+struct clLookup {
+  uint32_t seed;
+  int32_t num;          // power of two
+  const int16_t *slots; // column index, -1 for an empty slot
+};
 
 struct clObject {
   int32_t num;
   const clColumn *columns;
+  const clLookup *lookup;
 };
 
 struct clUnion {
   int32_t num;
   const clColumn *columns;
+  const clLookup *lookup;
+
+  // A tagged union carries only the member its sibling field TAG selects: a
+  // tag value V selects columns[cases[V]], and none when V is not below
+  // NUM_CASES or cases[V] is -1. NUM_CASES is 0 for an untagged union, which
+  // is carried as its bytes.
+  int32_t num_cases;
+  const int16_t *cases;
+  struct {
+    int8_t tp;
+    int32_t size;
+    ptrdiff_t offset;
+  } tag;
 };
 
 struct clFixedArray {
@@ -71,6 +119,13 @@ struct clFlexibleArray {
   int32_t tp;
   int32_t capacity;
   const clColumn *columns;
+
+  // the sibling field holding the number of live elements
+  struct {
+    int8_t tp;
+    int32_t size;
+    ptrdiff_t offset;
+  } len;
 };
 
 struct clString {
@@ -78,6 +133,14 @@ struct clString {
   int32_t capacity;
 };
 
+// The values an integer field may hold, [MIN, MAX] when RANGED. Set for enum
+// fields with DEFINE_FIELD_ENUM and checked by clValidate().
+struct clNumber {
+  bool ranged;
+  int64_t min;
+  int64_t max;
+};
+
 struct clColumn {
   int8_t tp;
 
@@ -96,9 +159,615 @@ struct clColumn {
     clFixedArray via_fixed_array;
     clFlexibleArray via_flexible_array;
     clString via_string;
+    clNumber via_number;
   };
 };
 
+enum {
+  cl_ERR_BUFFER = -1,   // output too small or input truncated
+  cl_ERR_CAPACITY = -2, // element count exceeds the declared capacity
+  cl_ERR_TYPE = -3,     // column kind not supported
+  cl_ERR_VALUE = -4,    // malformed or out-of-range value
+  cl_ERR_MEMORY = -5,   // allocation failed
+};
+
+enum {
+  cl_WIRE_RAW,     // numbers in host layout, strings up to the terminator
+  cl_WIRE_COMPACT, // varint integers, length-prefixed strings
+  cl_WIRE_SWAPPED, // cl_WIRE_RAW with the bytes of every number reversed
+};
+
+// cl_WIRE_RAW with numbers in little-endian order on every host, to talk to
+// hosts of the other byte order: a plain cl_WIRE_RAW on little-endian hosts.
+// The bytes of untagged unions are carried as they are.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define cl_WIRE_PORTABLE cl_WIRE_SWAPPED
+#else
+#define cl_WIRE_PORTABLE cl_WIRE_RAW
+#endif
+
+// Returns the number of bytes clEncode() writes for SRC, or a cl_ERR_* code.
+ptrdiff_t clEncodeSize(const clColumn *column, const void *src);
+
+// Encodes the live part of SRC: flexible arrays up to their length field,
+// strings up to their terminator and tagged unions as their selected member.
+// Returns the number of bytes written to BUF,
+// or a cl_ERR_* code.
+ptrdiff_t clEncode(const clColumn *column, const void *src, void *buf,
+                   size_t size);
+
+// Returns the number of bytes consumed from BUF, or a cl_ERR_* code. Bytes
+// past the live part of DST are left untouched.
+ptrdiff_t clDecode(const clColumn *column, void *dst, const void *buf,
+                   size_t size);
+
+// Same as the above with an explicit cl_WIRE_* format; the plain variants
+// use cl_WIRE_RAW.
+//
+// All of them run objects through programs cached by the address of COLUMN
+// (see clProgramFind()): call clProgramCacheClear() before releasing a
+// descriptor built at run time other than by clSchemaRead(), or before
+// changing one in place.
+ptrdiff_t clEncodeSizeEx(const clColumn *column, int wire, const void *src);
+ptrdiff_t clEncodeEx(const clColumn *column, int wire, const void *src,
+                     void *buf, size_t size);
+ptrdiff_t clDecodeEx(const clColumn *column, int wire, void *dst,
+                     const void *buf, size_t size);
+
+// Encodes messages into iovecs for writev() or sendmsg(). Runs of the
+// encoding that are the message bytes as laid out in memory, such as the
+// live part of an array of numbers or of plain structs, are referenced in
+// place once they reach THRESHOLD bytes; the rest is copied into ARENA.
+// Referenced messages must stay unchanged until the iovecs are written.
+struct clGather {
+  struct iovec *iov;
+  int num;
+  int capacity;
+  uint8_t *arena;
+  size_t used;
+  size_t size;
+  size_t threshold; // 64 after clGatherInit()
+  size_t bytes;     // total length of the iovecs
+};
+
+void clGatherInit(clGather *gather, struct iovec *iov, int capacity,
+                  void *arena, size_t size);
+
+// Empties GATHER once its iovecs are written, for the next messages.
+void clGatherReset(clGather *gather);
+
+// Appends a copy of DATA, such as a frame header. Returns 0 or
+// cl_ERR_BUFFER.
+int clGatherBytes(clGather *gather, const void *data, size_t size);
+
+// Appends the encoding of SRC in a cl_WIRE_* format. Returns the number of
+// bytes appended, or a cl_ERR_* code with GATHER unchanged; cl_ERR_BUFFER
+// when the iovecs or the arena are full.
+ptrdiff_t clGatherEncode(clGather *gather, const clColumn *column, int wire,
+                         const void *src);
+
+// Appends the messages MSGS[i] of COLUMNS[i], i < N, while they fit.
+// Returns the number of messages appended, or the error of the first one
+// when none was.
+ptrdiff_t clGatherEncodeAll(clGather *gather, const clColumn *const *columns,
+                            int wire, const void *const *msgs, size_t n);
+
+// Writes a patch that turns BASE into CUR: a bitmap of changed fields per
+// object and array, followed by the changed leaves. Returns the number of
+// bytes written, or a cl_ERR_* code.
+ptrdiff_t clDiffSize(const clColumn *column, const void *base,
+                     const void *cur);
+ptrdiff_t clDiff(const clColumn *column, const void *base, const void *cur,
+                 void *buf, size_t size);
+
+// Applies a clDiff() patch to DST, which holds the live part of BASE. Returns
+// the number of bytes consumed from BUF, or a cl_ERR_* code.
+ptrdiff_t clPatch(const clColumn *column, void *dst, const void *buf,
+                  size_t size);
+
+// Returns the field NAME of an object or union column, or NULL.
+const clColumn *clFindColumn(const clColumn *column, const char *name,
+                             size_t len);
+
+struct clPath {
+  const clColumn *column;
+  ptrdiff_t offset; // from the start of the root object
+};
+
+// Resolves a dotted path such as "fuzz[3].v.u32" below ROOT. An array
+// segment without an index refers to the first element. Results are cached
+// per thread by the address of ROOT, until clProgramCacheClear() or
+// clSchemaRead() is called. Returns 0, or cl_ERR_VALUE when the path does
+// not resolve.
+int clResolvePath(const clColumn *root, const char *path, size_t len,
+                  clPath *out);
+
+// Called with the decoded message; returns 0 or a negative error code.
+typedef int (*clHandler)(const clColumn *column, void *msg, void *ctx);
+
+// Message descriptors and handlers indexed by cmd - FIRST, generated with
+// --dispatch from the "cmd = N" comments of the input headers.
+struct clDispatch {
+  int32_t first;
+  int32_t num;
+  const clColumn *const *columns;
+  clHandler *handlers;
+};
+
+// Returns 0, or cl_ERR_VALUE when CMD is not part of DISPATCH.
+int clRegisterHandler(clDispatch *dispatch, int32_t cmd, clHandler handler);
+
+// Returns the descriptor of CMD, or NULL.
+const clColumn *clCommandColumn(const clDispatch *dispatch, int32_t cmd);
+
+// Decodes BUF into MSG, which must hold the largest message of DISPATCH, and
+// passes it to the handler of CMD. Returns the number of bytes consumed, the
+// error of the handler, or cl_ERR_VALUE for an unknown or unhandled CMD.
+ptrdiff_t clDispatchMessage(const clDispatch *dispatch, int32_t cmd, void *msg,
+                            const void *buf, size_t size, void *ctx);
+
+// Rows of an object stored column-wise: one contiguous, cache line aligned
+// buffer per leaf field. Nested objects are flattened, every other column
+// (numbers, strings, unions and arrays) is a leaf of COLUMN->size bytes.
+struct clBatch {
+  const clColumn *column;
+  int32_t num;
+  const clColumn **leaves;
+  ptrdiff_t *offsets; // of each leaf within a row
+  uint8_t **data;
+  size_t size;
+  size_t capacity;
+};
+
+// Holds i64 for cl_INT* leaves, u64 for cl_UINT* and cl_BOOL leaves and f64
+// for cl_FLOAT* leaves.
+union clScalar {
+  int64_t i64;
+  uint64_t u64;
+  double f64;
+};
+
+enum {
+  cl_CMP_EQ,
+  cl_CMP_NE,
+  cl_CMP_LT,
+  cl_CMP_LE,
+  cl_CMP_GT,
+  cl_CMP_GE,
+};
+
+// Returns 0, cl_ERR_TYPE when COLUMN is not an object, or cl_ERR_MEMORY.
+int clBatchInit(clBatch *batch, const clColumn *column);
+void clBatchFree(clBatch *batch);
+int clBatchReserve(clBatch *batch, size_t capacity);
+
+// Returns the leaf at PATH (see clResolvePath()), or cl_ERR_VALUE.
+int32_t clBatchLeaf(const clBatch *batch, const char *path, size_t len);
+
+// Appends N rows of STRIDE bytes each. Returns 0 or cl_ERR_MEMORY.
+int clBatchAppend(clBatch *batch, const void *rows, size_t n, size_t stride);
+
+// Copy the rows [FIRST, FIRST + N) out to (in from) an array of structs.
+// Return 0, or cl_ERR_VALUE when the range is past the end of BATCH.
+int clBatchGather(const clBatch *batch, size_t first, size_t n, void *rows,
+                  size_t stride);
+int clBatchScatter(clBatch *batch, size_t first, size_t n, const void *rows,
+                   size_t stride);
+
+// Kernels over a number leaf. Return 0, cl_ERR_TYPE for other leaves and
+// cl_ERR_VALUE for an empty batch (clBatchMinMax() only). Integer sums wrap.
+int clBatchSum(const clBatch *batch, int32_t leaf, clScalar *sum);
+int clBatchMinMax(const clBatch *batch, int32_t leaf, clScalar *min,
+                  clScalar *max);
+
+// Sets bit i of MASK, (SIZE + 63) / 64 words, when row i satisfies
+// "leaf OP VALUE" with a cl_CMP_* OP. Returns the number of matching rows or
+// a cl_ERR_* code.
+ptrdiff_t clBatchFilter(const clBatch *batch, int32_t leaf, int op,
+                        clScalar value, uint64_t *mask);
+
+enum {
+  cl_CODEC_PLAIN, // the leaf buffer as is
+  cl_CODEC_FOR,   // frame of reference: minimum plus bit-packed offsets
+  cl_CODEC_DELTA, // first value plus frame of reference differences
+  cl_CODEC_RLE,   // runs of equal cells
+  cl_CODEC_DICT,  // distinct values plus bit-packed indices
+};
+
+// Returns the cl_CODEC_* clBatchCompress() picks for LEAF from its type and
+// the current rows, or a cl_ERR_* code.
+int clBatchCodec(const clBatch *batch, int32_t leaf);
+
+// Compresses all rows, every leaf with its smallest codec. Returns the number
+// of bytes written, or a cl_ERR_* code.
+ptrdiff_t clBatchCompressSize(const clBatch *batch);
+ptrdiff_t clBatchCompress(const clBatch *batch, void *buf, size_t size);
+
+// Appends the rows of a clBatchCompress() buffer made from the same
+// descriptor. The rows are reserved before they are read, so a buffer of
+// more than MAX_ROWS is refused with cl_ERR_CAPACITY: a few bytes of runs
+// may stand for any number of them. Returns the number of bytes consumed,
+// or a cl_ERR_* code.
+ptrdiff_t clBatchDecompress(clBatch *batch, const void *buf, size_t size,
+                            size_t max_rows);
+
+// A growable output buffer. DATA is NULL or comes from malloc(); it is grown
+// with realloc() and owned by the caller.
+struct clBuffer {
+  char *data;
+  size_t size;
+  size_t capacity;
+};
+
+// Appends SRC to OUT as JSON keyed by the column names. A tagged union is an
+// object of its selected member, or null. Returns the number of bytes
+// appended, or a cl_ERR_* code with OUT->size left unchanged.
+ptrdiff_t clJsonEncode(const clColumn *column, const void *src, clBuffer *out);
+
+// Parses a JSON value into DST. Unknown keys are skipped, missing ones leave
+// DST untouched, and flexible arrays and tagged unions set their length and
+// tag fields. Numbers use '.' whatever the locale; one longer than 511
+// characters gives cl_ERR_CAPACITY. Returns the number of bytes consumed, or a
+// cl_ERR_* code.
+ptrdiff_t clJsonDecode(const clColumn *column, void *dst, const char *json,
+                       size_t len);
+
+// A read-only window on one column of a cl_WIRE_RAW encoding, used in place.
+struct clView {
+  const clColumn *column;
+  const uint8_t *data;
+  size_t size;
+  int64_t count; // elements of an array, characters of a string, the index
+                 // of the selected member of a tagged union or -1
+  bool image;    // DATA is the memory layout, below a union
+};
+
+// Checks once that BUF holds a complete encoding of the object COLUMN, so
+// that the accessors below need no further bounds checks. Returns the
+// encoded size, or a cl_ERR_* code.
+ptrdiff_t clViewInit(clView *view, const clColumn *column, const void *buf,
+                     size_t size);
+
+// Narrow VIEW of an object or union to its field NAME (element I of an
+// array of objects). Return 0 or a cl_ERR_* code; cl_ERR_VALUE for a member
+// of a tagged union that is not selected.
+int clViewField(const clView *view, const char *name, size_t len,
+                clView *field);
+int clViewElement(const clView *view, int64_t i, clView *element);
+
+// Read a number (element I of an array of numbers), see clScalar. Return 0
+// or a cl_ERR_* code.
+int clViewNumber(const clView *view, clScalar *out);
+int clViewNumberAt(const clView *view, int64_t i, clScalar *out);
+
+// Returns the characters of a string view without the terminator, or NULL.
+const void *clViewString(const clView *view, size_t *len);
+
+// Serialize a descriptor tree. Return the number of bytes written, or a
+// cl_ERR_* code.
+ptrdiff_t clSchemaSize(const clColumn *column);
+ptrdiff_t clSchemaWrite(const clColumn *column, void *buf, size_t size);
+
+// Rebuilds a clSchemaWrite() tree in one allocation, released with free().
+// Returns the number of bytes consumed, or a cl_ERR_* code.
+ptrdiff_t clSchemaRead(const clColumn **out, const void *buf, size_t size);
+
+enum {
+  cl_LOG_DIRECT = 1, // write with O_DIRECT where the file system allows it
+};
+
+// An append-only file of cl_WIRE_RAW messages. Its header holds the
+// descriptors of DISPATCH, so the records stay readable with views after the
+// structs change. Records are buffered into blocks of BLOCK_SIZE bytes (0
+// for 64 KiB, otherwise a multiple of 4096), each written with one write().
+struct clLogWriter {
+  int fd;
+  int flags;
+  const clDispatch *dispatch;
+  uint8_t *block;
+  size_t used;
+  size_t capacity;
+};
+
+// Creates PATH or reopens it for appending. Returns 0, cl_ERR_VALUE when an
+// existing file was written with other descriptors, cl_ERR_BUFFER on an I/O
+// error or cl_ERR_MEMORY.
+int clLogOpen(clLogWriter *log, const char *path, const clDispatch *dispatch,
+              size_t block_size, int flags);
+
+// Encodes MSG, a message of CMD, into the current block. Returns 0,
+// cl_ERR_VALUE for an unknown CMD, cl_ERR_CAPACITY for a message larger than
+// a block, or an error of clEncode() or clLogFlush().
+int clLogAppend(clLogWriter *log, int32_t cmd, uint64_t timestamp,
+                const void *msg);
+
+// Write out the current block (and close the file). Return 0 or
+// cl_ERR_BUFFER.
+int clLogFlush(clLogWriter *log);
+int clLogClose(clLogWriter *log);
+
+// A log mapped read-only, with the descriptors of its header.
+struct clLogReader {
+  const uint8_t *data;
+  size_t size;
+  int32_t num;
+  int32_t *cmds;
+  const clColumn **columns;
+  size_t first; // offset of the first block
+};
+
+// Returns 0 or a cl_ERR_* code; the log is unmapped on failure.
+int clLogMap(clLogReader *log, const char *path);
+void clLogUnmap(clLogReader *log);
+
+// Returns the descriptor CMD was written with, or NULL.
+const clColumn *clLogSchema(const clLogReader *log, int32_t cmd);
+
+// DATA points into the mapping, see clViewInit() and clDecode().
+struct clLogRecord {
+  int32_t cmd;
+  uint64_t timestamp;
+  const void *data;
+  size_t size;
+};
+
+struct clLogCursor {
+  const clLogReader *log;
+  int32_t cmd;
+  uint64_t from;
+  uint64_t to;
+  size_t block;
+  size_t pos;
+  size_t end;
+};
+
+// Iterates the records of CMD (any when negative) with a timestamp in
+// [FROM, TO]. Blocks are skipped by the timestamp range and cmd bitmap of
+// their header. clLogNext() returns 1 for a record, 0 at the end or
+// cl_ERR_VALUE on a damaged block.
+void clLogBegin(clLogCursor *cursor, const clLogReader *log, int32_t cmd,
+                uint64_t from, uint64_t to);
+int clLogNext(clLogCursor *cursor, clLogRecord *record);
+
+// A 64-bit hash of the clSchemaWrite() bytes of COLUMN, equal for equal
+// layouts on every build. Returns 0 when COLUMN cannot be serialized.
+uint64_t clSchemaFingerprint(const clColumn *column);
+
+// Decodes the cl_WIRE_RAW encoding of a writer object into the struct of a
+// reader object. Fields are matched by name; integers and floats are
+// converted to the reader size, reader fields the writer does not have are
+// zeroed and writer fields the reader does not have are skipped. Arrays and
+// strings keep the reader capacity: fixed arrays and strings are truncated,
+// a longer flexible array fails with cl_ERR_CAPACITY.
+struct clPlan {
+  uint64_t writer; // fingerprints
+  uint64_t reader;
+  int32_t num;
+  int32_t registers;
+  clPlanOp *ops;
+};
+
+// Returns 0, cl_ERR_TYPE when a field changed its kind or is a tagged union,
+// cl_ERR_VALUE or cl_ERR_MEMORY.
+int clPlanInit(clPlan *plan, const clColumn *writer, const clColumn *reader);
+void clPlanFree(clPlan *plan);
+
+// Returns the number of bytes consumed from BUF, or a cl_ERR_* code;
+// cl_ERR_VALUE when an integer does not fit its reader field.
+ptrdiff_t clPlanDecode(const clPlan *plan, void *dst, const void *buf,
+                       size_t size);
+
+// Looks up the plan from WRITER to READER in a per-thread cache keyed by
+// their fingerprints, compiling it on first use. The fingerprints are only
+// computed the first time a pair of addresses is seen, or again after
+// clProgramCacheClear() or clSchemaRead(). The plan stays valid until
+// clPlanCacheClear() is called on the same thread. Returns 0 or an error of
+// clPlanInit().
+int clPlanFind(const clPlan **out, const clColumn *writer,
+               const clColumn *reader);
+void clPlanCacheClear(void);
+
+// Checks that messages from untrusted input are safe to use: lengths of
+// flexible arrays within their capacity, strings terminated within theirs,
+// bools 0 or 1 and enum fields within their range. The checks of an object
+// are compiled once into a flat list; fields below an untagged union are
+// not checked, any bytes of it decode the same.
+struct clValidator {
+  const clColumn *column;
+  int32_t num;
+  clCheck *checks;
+};
+
+// Returns 0, cl_ERR_TYPE when COLUMN is not an object, cl_ERR_VALUE or
+// cl_ERR_MEMORY.
+int clValidatorInit(clValidator *validator, const clColumn *column);
+void clValidatorFree(clValidator *validator);
+
+// Validates N messages of STRIDE bytes at MSGS, running each check across
+// 64 messages at a time. Sets bit i of MASK, (N + 63) / 64 words or NULL,
+// when message i fails a check. Returns the number of failing messages.
+ptrdiff_t clValidate(const clValidator *validator, const void *msgs, size_t n,
+                     size_t stride, uint64_t *mask);
+
+// Decodes only the fields at a few paths of a message, such as "epoch" and
+// "fuzz[*].tag", and skips the others by their encoded length. A path
+// selects a field with everything below it: "[*]" goes on below every
+// element of an array, and a path into an untagged union selects all of it.
+// The length fields of selected flexible arrays and the tags of selected
+// tagged unions are decoded along. The paths are compiled once, for one
+// cl_WIRE_* format.
+struct clProjection {
+  const clColumn *column;
+  int wire;
+  int32_t num;
+  int32_t registers;
+  clProjectionOp *ops;
+};
+
+// Returns 0, cl_ERR_TYPE when COLUMN is not an object, cl_ERR_VALUE for an
+// unknown WIRE or a path that does not resolve, or cl_ERR_MEMORY.
+int clProjectionInit(clProjection *projection, const clColumn *column,
+                     int wire, const char *const *paths, size_t n);
+void clProjectionFree(clProjection *projection);
+
+// Decodes the selected fields of BUF into DST; the other bytes of DST are
+// left untouched. Decoding stops after the last selected field: returns the
+// number of bytes read up to there, not the size of the message, or a
+// cl_ERR_* code.
+ptrdiff_t clProjectionDecode(const clProjection *projection, void *dst,
+                             const void *buf, size_t size);
+
+// Same as the above into a new row of BATCH, whose other leaves are zeroed.
+// Returns cl_ERR_TYPE when BATCH holds rows of another column, or
+// cl_ERR_MEMORY.
+ptrdiff_t clProjectionAppend(const clProjection *projection, clBatch *batch,
+                             const void *buf, size_t size);
+
+// Per descriptor counters of the library calls below, collected when it is
+// built with CL_STATS defined (meson -Denable-stats=true) and compiled out
+// otherwise. Every thread counts into a shard of its own without atomic
+// read-modify-writes; clStatsSnapshot() sums the shards. Messages of a cmd
+// are counted under clCommandColumn().
+enum {
+  cl_STATS_ENCODE, // clEncode(), clEncodeEx() and clGatherEncode()
+  cl_STATS_DECODE, // clDecode(), clDecodeEx() and clDispatchMessage()
+  cl_STATS_DIFF,   // clDiff()
+  cl_STATS_OPS,
+};
+
+#define cl_STATS_BUCKETS 32
+
+// LATENCY[i] counts the calls that took [2^i, 2^(i+1)) ns, the last bucket
+// the slower ones too. Failed calls count in CALLS, ERRORS and LATENCY.
+struct clStatsOp {
+  uint64_t calls;
+  uint64_t errors;
+  uint64_t bytes_in; // struct bytes, wire bytes for cl_STATS_DECODE
+  uint64_t bytes_out;
+  uint64_t latency[cl_STATS_BUCKETS];
+};
+
+struct clStats {
+  const clColumn *column;
+  uint64_t invalid; // messages failing clValidate()
+  clStatsOp ops[cl_STATS_OPS];
+};
+
+// Sums the counters of every thread into OUT, one entry per descriptor.
+// Returns the number of entries written, at most N.
+size_t clStatsSnapshot(clStats *out, size_t n);
+
+// Adds the counters of SRC to DST, such as the snapshots of two processes.
+void clStatsMerge(clStats *dst, const clStats *src);
+
+// Zeroes the counters of every thread. Calls running meanwhile may be lost.
+void clStatsReset(void);
+
+// Returns the upper bound in ns of the bucket holding the Q quantile of
+// the latencies of OP, 0 <= Q <= 1, or 0 when OP has no calls.
+uint64_t clStatsQuantile(const clStatsOp *op, double q);
+
+// A bounded ring of encoded messages from any number of producer threads to
+// one consumer thread. A producer reserves a slot, writes the message in
+// place and commits it; the consumer hands the committed messages to
+// writev() in order and releases them. Reserving retries only when another
+// producer reserved first, committing is a single store.
+struct clRing {
+  uint8_t *data;
+  size_t size;               // power of two
+  alignas(64) uint64_t head; // reserved by the producers
+  alignas(64) uint64_t tail; // released by the consumer
+};
+
+// Allocates a ring of at least SIZE bytes. Returns 0, cl_ERR_VALUE or
+// cl_ERR_MEMORY.
+int clRingInit(clRing *ring, size_t size);
+void clRingFree(clRing *ring);
+
+// Reserves SIZE bytes for a message and points SLOT at them. Returns 0,
+// cl_ERR_BUFFER while the ring is full, or cl_ERR_CAPACITY when SIZE
+// exceeds half the ring. Every reserved slot must be committed.
+int clRingReserve(clRing *ring, size_t size, void **slot);
+
+// Reserves SIZES[i] bytes for N messages at once and points SLOTS[i] at
+// them, with the same results as clRingReserve().
+int clRingReserveAll(clRing *ring, const size_t *sizes, size_t n,
+                     void **slots);
+
+// Publishes the first USED bytes of SLOT, at most its reserved size, as a
+// message. A USED of 0 drops the slot.
+void clRingCommit(clRing *ring, void *slot, size_t used);
+
+// Encodes SRC in a cl_WIRE_* format straight into a slot. Returns the
+// number of bytes committed, or a cl_ERR_* code.
+ptrdiff_t clRingEncode(clRing *ring, const clColumn *column, int wire,
+                       const void *src);
+
+// Encodes the messages MSGS[i] of COLUMNS[i], i < N, reserving their slots
+// together while they fit. Stops at the first message that cannot be
+// encoded, dropping the slots reserved after it. Returns the number of
+// messages committed, or the error of the first one when none was.
+ptrdiff_t clRingEncodeAll(clRing *ring, const clColumn *const *columns,
+                          int wire, const void *const *msgs, size_t n);
+
+// Points up to N iovecs at the oldest committed messages, in order, for the
+// consumer. Returns the number of iovecs filled.
+int clRingPeek(const clRing *ring, struct iovec *iov, int n);
+
+// Frees the oldest N messages returned by clRingPeek() for the producers,
+// stopping early at the first message not committed yet.
+void clRingRelease(clRing *ring, int n);
+
+// An object descriptor compiled for one cl_WIRE_* format into a flat list of
+// ops over absolute offsets, with adjacent fields that travel as their bytes
+// merged into one copy. clEncodeEx(), clEncodeSizeEx(), clDecodeEx() and
+// clGatherEncode() run objects through a per-thread cache of programs.
+struct clProgram {
+  const clColumn *column;
+  int wire;
+  int32_t num;
+  clProgramOp *ops;
+  int32_t *cases; // member ops of tagged unions, indexed by tag
+};
+
+// Returns 0, cl_ERR_TYPE when COLUMN is not an object or holds a kind the
+// codec does not support, cl_ERR_VALUE or cl_ERR_MEMORY.
+int clProgramInit(clProgram *program, const clColumn *column, int wire);
+void clProgramFree(clProgram *program);
+
+// Same as clEncodeEx() and clDecodeEx() with the descriptor and format of
+// PROGRAM.
+ptrdiff_t clProgramEncode(const clProgram *program, const void *src,
+                          void *buf, size_t size);
+ptrdiff_t clProgramDecode(const clProgram *program, void *dst,
+                          const void *buf, size_t size);
+
+// Looks up the program of COLUMN in WIRE in a per-thread cache keyed by the
+// address of COLUMN, compiling it on first use. It stays valid until
+// clProgramCacheClear() or clSchemaRead() is called. clProgramCacheClear()
+// drops the programs of every thread, and must be called before releasing
+// a descriptor built at run time other than by clSchemaRead(). A program is
+// also compiled again when the size or the fields of COLUMN no longer match
+// it, but changes within nested objects go unnoticed. Returns 0 or an error
+// of clProgramInit().
+int clProgramFind(const clProgram **out, const clColumn *column, int wire);
+void clProgramCacheClear(void);
+
+// Hashing and equality of messages over the bytes cl_WIRE_RAW carries, for
+// response caches and dedup sets: the padding between fields, the elements
+// past the count of a flexible array, the bytes past the terminator of a
+// string and the members a tagged union does not select are left out.
+// Numbers, floats included, compare by their bits. Both run off the cached
+// cl_WIRE_RAW program of COLUMN, see clProgramFind().
+
+// Hashes the message SRC of the object COLUMN into OUT. Returns 0,
+// cl_ERR_CAPACITY for a count out of range, or an error of clProgramFind().
+int clHash(uint64_t *out, const clColumn *column, const void *src);
+
+// Returns 1 when the messages A and B of COLUMN are equal, 0 when they are
+// not, or the errors of clHash() over A.
+int clEqual(const clColumn *column, const void *a, const void *b);
+
 #ifdef __cplusplus
 }
 #endif
@@ -150,6 +819,18 @@ template <class T> struct clColumnTraits {
 
 #endif
 
+#ifndef COLUMN_LOOKUP
+#define COLUMN_LOOKUP(FIELDS) NULL
+#endif
+
+#ifdef __cplusplus
+#define COLUMN_ASSERT_SIZE(TYPE, SIZE)                                         \
+  static_assert(sizeof(TYPE) == (SIZE), #TYPE)
+#else
+#define COLUMN_ASSERT_SIZE(TYPE, SIZE)                                         \
+  _Static_assert(sizeof(TYPE) == (SIZE), #TYPE)
+#endif
+
 #define DEFINE_FIELD_NUMBER(PARENT, FIELD)                                     \
   {                                                                            \
     .tp = COLUMN_TYPE(PARENT, FIELD),                                          \
@@ -163,6 +844,28 @@ template <class T> struct clColumnTraits {
     .offset = offsetof(PARENT, FIELD),                                         \
   }
 
+// An integer field, usually an enum, holding a value in [MIN, MAX].
+#define DEFINE_FIELD_ENUM(PARENT, FIELD, MIN, MAX)                             \
+  {                                                                            \
+    .tp = COLUMN_TYPE(PARENT, FIELD),                                          \
+    .name =                                                                    \
+        {                                                                      \
+            .len = sizeof(#FIELD) - 1,                                         \
+            .string = #FIELD,                                                  \
+        },                                                                     \
+    .size = sizeof(((PARENT *)NULL)->FIELD),                                   \
+    .align = alignof(__typeof(((PARENT *)NULL)->FIELD)),                       \
+    .offset = offsetof(PARENT, FIELD),                                         \
+    {                                                                          \
+        .via_number =                                                          \
+            {                                                                  \
+                .ranged = true,                                                \
+                .min = (MIN),                                                  \
+                .max = (MAX),                                                  \
+            },                                                                 \
+    },                                                                         \
+  }
+
 #define DEFINE_FIELD_OBJECT(PARENT, FIELD, FIELDS)                             \
   {                                                                            \
     .tp = cl_OBJECT,                                                           \
@@ -179,6 +882,7 @@ template <class T> struct clColumnTraits {
             {                                                                  \
                 .num = sizeof(FIELDS) / sizeof(FIELDS[0]),                     \
                 .columns = FIELDS,                                             \
+                .lookup = COLUMN_LOOKUP(FIELDS),                               \
             },                                                                 \
     },                                                                         \
   }
@@ -199,6 +903,38 @@ template <class T> struct clColumnTraits {
             {                                                                  \
                 .num = sizeof(FIELDS) / sizeof(FIELDS[0]),                     \
                 .columns = FIELDS,                                             \
+                .lookup = COLUMN_LOOKUP(FIELDS),                               \
+            },                                                                 \
+    },                                                                         \
+  }
+
+// CASES maps the values of the sibling field TAG, which precedes FIELD, to
+// member indices, see clUnion.
+#define DEFINE_FIELD_TAGGED_UNION(PARENT, FIELD, FIELDS, TAG, CASES)           \
+  {                                                                            \
+    .tp = cl_UNION,                                                            \
+    .name =                                                                    \
+        {                                                                      \
+            .len = sizeof(#FIELD) - 1,                                         \
+            .string = #FIELD,                                                  \
+        },                                                                     \
+    .size = sizeof(((PARENT *)NULL)->FIELD),                                   \
+    .align = alignof(__typeof(((PARENT *)NULL)->FIELD)),                       \
+    .offset = offsetof(PARENT, FIELD),                                         \
+    {                                                                          \
+        .via_union =                                                           \
+            {                                                                  \
+                .num = sizeof(FIELDS) / sizeof(FIELDS[0]),                     \
+                .columns = FIELDS,                                             \
+                .lookup = COLUMN_LOOKUP(FIELDS),                               \
+                .num_cases = sizeof(CASES) / sizeof(CASES[0]),                 \
+                .cases = CASES,                                                \
+                .tag =                                                         \
+                    {                                                          \
+                        .tp = COLUMN_TYPE(PARENT, TAG),                        \
+                        .size = sizeof(((PARENT *)NULL)->TAG),                 \
+                        .offset = offsetof(PARENT, TAG),                       \
+                    },                                                         \
             },                                                                 \
     },                                                                         \
   }
@@ -247,7 +983,7 @@ template <class T> struct clColumnTraits {
     },                                                                         \
   }
 
-#define DEFINE_FIELD_FLEXIBLE_ARRAY(PARENT, FIELD)                             \
+#define DEFINE_FIELD_FLEXIBLE_ARRAY(PARENT, FIELD, LEN)                        \
   {                                                                            \
     .tp = cl_FLEXIBLE_ARRAY,                                                   \
     .name =                                                                    \
@@ -265,11 +1001,17 @@ template <class T> struct clColumnTraits {
                 .capacity = sizeof(((PARENT *)NULL)->FIELD) /                  \
                             sizeof(((PARENT *)NULL)->FIELD[0]),                \
                 .columns = NULL,                                               \
+                .len =                                                         \
+                    {                                                          \
+                        .tp = COLUMN_TYPE(PARENT, LEN),                        \
+                        .size = sizeof(((PARENT *)NULL)->LEN),                 \
+                        .offset = offsetof(PARENT, LEN),                       \
+                    },                                                         \
             },                                                                 \
     },                                                                         \
   }
 
-#define DEFINE_FIELD_OBJECT_FLEXIBLE_ARRAY(PARENT, FIELD, ELEMENT)             \
+#define DEFINE_FIELD_OBJECT_FLEXIBLE_ARRAY(PARENT, FIELD, LEN, ELEMENT)        \
   {                                                                            \
     .tp = cl_FLEXIBLE_ARRAY,                                                   \
     .name =                                                                    \
@@ -287,6 +1029,12 @@ template <class T> struct clColumnTraits {
                 .capacity = sizeof(((PARENT *)NULL)->FIELD) /                  \
                             sizeof(((PARENT *)NULL)->FIELD[0]),                \
                 .columns = ELEMENT,                                            \
+                .len =                                                         \
+                    {                                                          \
+                        .tp = COLUMN_TYPE(PARENT, LEN),                        \
+                        .size = sizeof(((PARENT *)NULL)->LEN),                 \
+                        .offset = offsetof(PARENT, LEN),                       \
+                    },                                                         \
             },                                                                 \
     },                                                                         \
   }
@@ -326,6 +1074,7 @@ template <class T> struct clColumnTraits {
             {                                                                  \
                 .num = sizeof(FIELDS) / sizeof(FIELDS[0]),                     \
                 .columns = FIELDS,                                             \
+                .lookup = COLUMN_LOOKUP(FIELDS),                               \
             },                                                                 \
     },                                                                         \
   }
@@ -0,0 +1,394 @@
+#pragma once
+
+// Compile-time descriptors for C++17. The --hpp option of columns.sh
+// generates a cl::Descriptor specialization per struct, next to the C
+// tables, and the functions below walk it with templates instead of
+// clColumn pointers. The encoding is the cl_WIRE_RAW format of clEncode().
+
+#include <columns.h>
+
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+
+namespace cl {
+
+// Specialized for every struct, with NAMES and a Fields<> list of FIELDS in
+// declaration order.
+template <class T> struct Descriptor;
+
+template <class... F> struct Fields {};
+
+template <auto M> struct Member;
+
+template <class C, class T, T C::*M> struct Member<M> {
+  using Class = C;
+  using Type = T;
+};
+
+template <auto M> struct Number;
+template <auto M> struct String;
+template <auto M> struct FixedArray;
+template <auto M, auto Len> struct FlexibleArray;
+template <auto M> struct Object;
+template <auto M> struct Union;
+template <auto V, class F> struct Case;
+template <auto M, auto Tag, class... C> struct TaggedUnion;
+
+namespace detail {
+
+struct Writer {
+  uint8_t *buf; // nullptr when only measuring
+  size_t pos;
+  size_t size;
+
+  int put(const void *src, size_t n) {
+    if (buf) {
+      if (size - pos < n) {
+        return cl_ERR_BUFFER;
+      }
+      std::memcpy(buf + pos, src, n);
+    }
+    pos += n;
+    return 0;
+  }
+};
+
+struct Reader {
+  const uint8_t *buf;
+  size_t pos;
+  size_t size;
+
+  int get(void *dst, size_t n) {
+    if (size - pos < n) {
+      return cl_ERR_BUFFER;
+    }
+    std::memcpy(dst, buf + pos, n);
+    pos += n;
+    return 0;
+  }
+};
+
+// The elements of a string to transfer: the characters and the terminator,
+// or CAPACITY when there is none.
+template <class E>
+size_t stringLength(const uint8_t *p, size_t capacity, bool *terminated) {
+  static const uint8_t zero[sizeof(E)] = {};
+  for (size_t i = 0; i < capacity; ++i) {
+    if (std::memcmp(p + i * sizeof(E), zero, sizeof(E)) == 0) {
+      *terminated = true;
+      return i + 1;
+    }
+  }
+  *terminated = false;
+  return capacity;
+}
+
+template <class T> using FieldsOf = typename Descriptor<T>::fields;
+
+template <class T, class... F>
+int encodeFields(const T &src, Writer &w, Fields<F...>) {
+  int err = 0;
+  (void)(... && !(err = F::encode(src, w)));
+  return err;
+}
+
+template <class T, class... F>
+int decodeFields(T &dst, Reader &r, Fields<F...>) {
+  int err = 0;
+  (void)(... && !(err = F::decode(dst, r)));
+  return err;
+}
+
+template <class T> int encodeObject(const T &src, Writer &w) {
+  return encodeFields(src, w, FieldsOf<T>());
+}
+
+template <class T> int decodeObject(T &dst, Reader &r) {
+  return decodeFields(dst, r, FieldsOf<T>());
+}
+
+template <class T> constexpr size_t maxSize();
+
+template <class... F> constexpr size_t maxFieldsSize(Fields<F...>) {
+  return (size_t(0) + ... + F::maxSize());
+}
+
+template <class T> constexpr size_t maxSize() {
+  return maxFieldsSize(FieldsOf<T>());
+}
+
+template <class E> int encodeElements(const E *src, size_t n, Writer &w) {
+  if constexpr (std::is_class_v<E>) {
+    for (size_t i = 0; i < n; ++i) {
+      int err = encodeObject(src[i], w);
+      if (err) {
+        return err;
+      }
+    }
+    return 0;
+  } else {
+    return w.put(src, n * sizeof(E));
+  }
+}
+
+template <class E> int decodeElements(E *dst, size_t n, Reader &r) {
+  if constexpr (std::is_class_v<E>) {
+    for (size_t i = 0; i < n; ++i) {
+      int err = decodeObject(dst[i], r);
+      if (err) {
+        return err;
+      }
+    }
+    return 0;
+  } else {
+    return r.get(dst, n * sizeof(E));
+  }
+}
+
+template <class E> constexpr size_t maxElementSize() {
+  if constexpr (std::is_class_v<E>) {
+    return maxSize<E>();
+  } else {
+    return sizeof(E);
+  }
+}
+
+} // namespace detail
+
+template <auto M> struct Number {
+  using Class = typename Member<M>::Class;
+  using Type = typename Member<M>::Type;
+  static_assert(std::is_arithmetic_v<Type> || std::is_enum_v<Type>);
+  static constexpr auto member = M;
+
+  static int encode(const Class &src, detail::Writer &w) {
+    return w.put(&(src.*M), sizeof(Type));
+  }
+
+  static int decode(Class &dst, detail::Reader &r) {
+    return r.get(&(dst.*M), sizeof(Type));
+  }
+
+  static constexpr size_t maxSize() { return sizeof(Type); }
+};
+
+template <auto M> struct String {
+  using Class = typename Member<M>::Class;
+  using Type = typename Member<M>::Type;
+  using Element = std::remove_extent_t<Type>;
+  static constexpr size_t capacity = std::extent_v<Type>;
+  static constexpr auto member = M;
+
+  static int encode(const Class &src, detail::Writer &w) {
+    bool terminated;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(src.*M);
+    size_t len = detail::stringLength<Element>(p, capacity, &terminated);
+    return w.put(p, len * sizeof(Element));
+  }
+
+  static int decode(Class &dst, detail::Reader &r) {
+    size_t avail = (r.size - r.pos) / sizeof(Element);
+    size_t n = avail < capacity ? avail : capacity;
+
+    bool terminated;
+    size_t len = detail::stringLength<Element>(r.buf + r.pos, n, &terminated);
+    if (n < capacity && !terminated) {
+      return cl_ERR_BUFFER;
+    }
+    return r.get(dst.*M, len * sizeof(Element));
+  }
+
+  static constexpr size_t maxSize() { return sizeof(Type); }
+};
+
+template <auto M> struct FixedArray {
+  using Class = typename Member<M>::Class;
+  using Type = typename Member<M>::Type;
+  using Element = std::remove_extent_t<Type>;
+  static constexpr size_t capacity = std::extent_v<Type>;
+  static constexpr auto member = M;
+
+  static int encode(const Class &src, detail::Writer &w) {
+    return detail::encodeElements(src.*M, capacity, w);
+  }
+
+  static int decode(Class &dst, detail::Reader &r) {
+    return detail::decodeElements(dst.*M, capacity, r);
+  }
+
+  static constexpr size_t maxSize() {
+    return capacity * detail::maxElementSize<Element>();
+  }
+};
+
+// LEN is the sibling holding the number of live elements; it precedes the
+// array, so it has already been decoded when the array is.
+template <auto M, auto Len> struct FlexibleArray {
+  using Class = typename Member<M>::Class;
+  using Type = typename Member<M>::Type;
+  using Element = std::remove_extent_t<Type>;
+  static constexpr size_t capacity = std::extent_v<Type>;
+  static constexpr auto member = M;
+  static_assert(std::is_same_v<Class, typename Member<Len>::Class>);
+
+  static int count(const Class &obj, size_t *n) {
+    auto len = obj.*Len;
+    if constexpr (std::is_signed_v<decltype(len)>) {
+      if (len < 0) {
+        return cl_ERR_CAPACITY;
+      }
+    }
+    if (static_cast<uint64_t>(len) > capacity) {
+      return cl_ERR_CAPACITY;
+    }
+    *n = static_cast<size_t>(len);
+    return 0;
+  }
+
+  static int encode(const Class &src, detail::Writer &w) {
+    size_t n;
+    int err = count(src, &n);
+    return err ? err : detail::encodeElements(src.*M, n, w);
+  }
+
+  static int decode(Class &dst, detail::Reader &r) {
+    size_t n;
+    int err = count(dst, &n);
+    return err ? err : detail::decodeElements(dst.*M, n, r);
+  }
+
+  static constexpr size_t maxSize() {
+    return capacity * detail::maxElementSize<Element>();
+  }
+};
+
+template <auto M> struct Object {
+  using Class = typename Member<M>::Class;
+  using Type = typename Member<M>::Type;
+  static constexpr auto member = M;
+
+  static int encode(const Class &src, detail::Writer &w) {
+    return detail::encodeObject(src.*M, w);
+  }
+
+  static int decode(Class &dst, detail::Reader &r) {
+    return detail::decodeObject(dst.*M, r);
+  }
+
+  static constexpr size_t maxSize() { return detail::maxSize<Type>(); }
+};
+
+// The bytes of the union as they are, see cl_UNION.
+template <auto M> struct Union {
+  using Class = typename Member<M>::Class;
+  using Type = typename Member<M>::Type;
+  static constexpr auto member = M;
+
+  static int encode(const Class &src, detail::Writer &w) {
+    return w.put(&(src.*M), sizeof(Type));
+  }
+
+  static int decode(Class &dst, detail::Reader &r) {
+    return r.get(&(dst.*M), sizeof(Type));
+  }
+
+  static constexpr size_t maxSize() { return sizeof(Type); }
+};
+
+// F, a field of the union, is the member the tag value V selects.
+template <auto V, class F> struct Case {
+  static constexpr auto value = V;
+  using Field = F;
+};
+
+// Only the member the sibling TAG selects, none when no case matches; see
+// clUnion. TAG precedes the union, so it has already been decoded when the
+// union is.
+template <auto M, auto Tag, class... C> struct TaggedUnion {
+  using Class = typename Member<M>::Class;
+  using Type = typename Member<M>::Type;
+  static constexpr auto member = M;
+  static_assert(std::is_same_v<Class, typename Member<Tag>::Class>);
+
+  static int encode(const Class &src, detail::Writer &w) {
+    auto tag = src.*Tag;
+    int err = 0;
+    (void)(... || (tag == static_cast<decltype(tag)>(C::value) &&
+                   (err = C::Field::encode(src.*M, w), true)));
+    return err;
+  }
+
+  static int decode(Class &dst, detail::Reader &r) {
+    auto tag = dst.*Tag;
+    int err = 0;
+    (void)(... || (tag == static_cast<decltype(tag)>(C::value) &&
+                   (err = C::Field::decode(dst.*M, r), true)));
+    return err;
+  }
+
+  static constexpr size_t maxSize() {
+    size_t size = 0;
+    ((size = C::Field::maxSize() > size ? C::Field::maxSize() : size), ...);
+    return size;
+  }
+};
+
+// Same as clEncodeSize(), clEncode() and clDecode() with the descriptor of
+// T, instantiated per struct.
+template <class T> ptrdiff_t encodeSize(const T &src) {
+  detail::Writer w = {nullptr, 0, 0};
+  int err = detail::encodeObject(src, w);
+  return err ? err : static_cast<ptrdiff_t>(w.pos);
+}
+
+template <class T> ptrdiff_t encode(const T &src, void *buf, size_t size) {
+  detail::Writer w = {static_cast<uint8_t *>(buf), 0, size};
+  int err = detail::encodeObject(src, w);
+  return err ? err : static_cast<ptrdiff_t>(w.pos);
+}
+
+template <class T> ptrdiff_t decode(T &dst, const void *buf, size_t size) {
+  detail::Reader r = {static_cast<const uint8_t *>(buf), 0, size};
+  int err = detail::decodeObject(dst, r);
+  return err ? err : static_cast<ptrdiff_t>(r.pos);
+}
+
+// The largest encoding of a T, for buffers sized at compile time.
+template <class T> constexpr size_t maxEncodedSize() {
+  return detail::maxSize<T>();
+}
+
+template <class T> constexpr size_t fieldCount() {
+  return std::size(Descriptor<T>::names);
+}
+
+// Returns the index of the field NAME of T, or -1.
+template <class T> constexpr ptrdiff_t fieldIndex(std::string_view name) {
+  for (size_t i = 0; i < fieldCount<T>(); ++i) {
+    if (Descriptor<T>::names[i] == name) {
+      return static_cast<ptrdiff_t>(i);
+    }
+  }
+  return -1;
+}
+
+namespace detail {
+
+template <class T, class V, class... F>
+void visitFields(T &obj, V &&visitor, Fields<F...>) {
+  size_t i = 0;
+  (visitor(Descriptor<std::remove_const_t<T>>::names[i++], obj.*F::member),
+   ...);
+}
+
+} // namespace detail
+
+// Calls VISITOR(name, field) with a reference to every field of OBJ.
+template <class T, class V> void visit(T &obj, V &&visitor) {
+  detail::visitFields(obj, visitor,
+                      detail::FieldsOf<std::remove_const_t<T>>());
+}
+
+} // namespace cl
@@ -0,0 +1,345 @@
+#include "internal.h"
+
+#include <stdlib.h>
+
+#define ALIGN 64 // one cache line
+
+// X(tp, C type, clScalar member) for every leaf type the kernels handle
+#define CL_BATCH_TYPES(X)                                                      \
+  X(cl_INT8, int8_t, i64)                                                      \
+  X(cl_INT16, int16_t, i64)                                                    \
+  X(cl_INT32, int32_t, i64)                                                    \
+  X(cl_INT64, int64_t, i64)                                                    \
+  X(cl_UINT8, uint8_t, u64)                                                    \
+  X(cl_UINT16, uint16_t, u64)                                                  \
+  X(cl_UINT32, uint32_t, u64)                                                  \
+  X(cl_UINT64, uint64_t, u64)                                                  \
+  X(cl_BOOL, uint8_t, u64)                                                     \
+  X(cl_FLOAT32, float, f64)                                                    \
+  X(cl_FLOAT64, double, f64)
+
+static int32_t countLeaves(const clColumn *column) {
+  if (column->tp != cl_OBJECT) {
+    return 1;
+  }
+
+  int32_t num = 0;
+  for (int32_t i = 0; i < column->via_object.num; ++i) {
+    num += countLeaves(&column->via_object.columns[i]);
+  }
+  return num;
+}
+
+static void collectLeaves(clBatch *batch, const clColumn *column,
+                          ptrdiff_t offset, int32_t *num) {
+  offset += column->offset;
+  if (column->tp != cl_OBJECT) {
+    batch->leaves[*num] = column;
+    batch->offsets[*num] = offset;
+    ++*num;
+    return;
+  }
+
+  for (int32_t i = 0; i < column->via_object.num; ++i) {
+    collectLeaves(batch, &column->via_object.columns[i], offset, num);
+  }
+}
+
+int clBatchInit(clBatch *batch, const clColumn *column) {
+  memset(batch, 0, sizeof(*batch));
+  if (column->tp != cl_OBJECT) {
+    return cl_ERR_TYPE;
+  }
+
+  int32_t num = countLeaves(column);
+  batch->column = column;
+  batch->leaves = (const clColumn **)calloc(num, sizeof(*batch->leaves));
+  batch->offsets = (ptrdiff_t *)calloc(num, sizeof(*batch->offsets));
+  batch->data = (uint8_t **)calloc(num, sizeof(*batch->data));
+  if (!batch->leaves || !batch->offsets || !batch->data) {
+    clBatchFree(batch);
+    return cl_ERR_MEMORY;
+  }
+
+  // the root sits at offset 0 of a row whatever its own offset says
+  collectLeaves(batch, column, -column->offset, &batch->num);
+  return 0;
+}
+
+void clBatchFree(clBatch *batch) {
+  if (batch->data) {
+    for (int32_t i = 0; i < batch->num; ++i) {
+      free(batch->data[i]);
+    }
+  }
+
+  free(batch->leaves);
+  free(batch->offsets);
+  free(batch->data);
+  memset(batch, 0, sizeof(*batch));
+}
+
+int clBatchReserve(clBatch *batch, size_t capacity) {
+  if (capacity <= batch->capacity) {
+    return 0;
+  }
+
+  uint8_t **data = (uint8_t **)calloc(batch->num, sizeof(*data));
+  if (!data) {
+    return cl_ERR_MEMORY;
+  }
+
+  for (int32_t i = 0; i < batch->num; ++i) {
+    if (capacity > (SIZE_MAX - ALIGN) / (size_t)batch->leaves[i]->size) {
+      free(data);
+      return cl_ERR_MEMORY;
+    }
+  }
+
+  for (int32_t i = 0; i < batch->num; ++i) {
+    size_t size = (size_t)batch->leaves[i]->size * capacity;
+    size = (size + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+    data[i] = (uint8_t *)aligned_alloc(ALIGN, size);
+    if (!data[i]) {
+      for (int32_t j = 0; j < i; ++j) {
+        free(data[j]);
+      }
+      free(data);
+      return cl_ERR_MEMORY;
+    }
+  }
+
+  // swap only once every buffer is in place, BATCH stays intact on failure
+  for (int32_t i = 0; i < batch->num; ++i) {
+    if (batch->size) {
+      memcpy(data[i], batch->data[i],
+             (size_t)batch->leaves[i]->size * batch->size);
+    }
+    free(batch->data[i]);
+  }
+  free(batch->data);
+
+  batch->data = data;
+  batch->capacity = capacity;
+  return 0;
+}
+
+int32_t clBatchLeaf(const clBatch *batch, const char *path, size_t len) {
+  clPath out;
+  if (clResolvePath(batch->column, path, len, &out)) {
+    return cl_ERR_VALUE;
+  }
+
+  for (int32_t i = 0; i < batch->num; ++i) {
+    if (batch->leaves[i] == out.column && batch->offsets[i] == out.offset) {
+      return i;
+    }
+  }
+  return cl_ERR_VALUE;
+}
+
+static void scatter(clBatch *batch, size_t first, size_t n, const void *rows,
+                    size_t stride) {
+  // leaf by leaf, so that every store stream is sequential
+  for (int32_t i = 0; i < batch->num; ++i) {
+    size_t size = (size_t)batch->leaves[i]->size;
+    const uint8_t *src = (const uint8_t *)rows + batch->offsets[i];
+    uint8_t *dst = batch->data[i] + size * first;
+    for (size_t j = 0; j < n; ++j) {
+      memcpy(dst + size * j, src + stride * j, size);
+    }
+  }
+}
+
+int clBatchAppend(clBatch *batch, const void *rows, size_t n, size_t stride) {
+  if (batch->capacity - batch->size < n) {
+    size_t capacity = batch->capacity ? batch->capacity * 2 : 64;
+    if (capacity < batch->size + n) {
+      capacity = batch->size + n;
+    }
+
+    int err = clBatchReserve(batch, capacity);
+    if (err) {
+      return err;
+    }
+  }
+
+  scatter(batch, batch->size, n, rows, stride);
+  batch->size += n;
+  return 0;
+}
+
+int clBatchGather(const clBatch *batch, size_t first, size_t n, void *rows,
+                  size_t stride) {
+  if (first > batch->size || batch->size - first < n) {
+    return cl_ERR_VALUE;
+  }
+
+  for (int32_t i = 0; i < batch->num; ++i) {
+    size_t size = (size_t)batch->leaves[i]->size;
+    const uint8_t *src = batch->data[i] + size * first;
+    uint8_t *dst = (uint8_t *)rows + batch->offsets[i];
+    for (size_t j = 0; j < n; ++j) {
+      memcpy(dst + stride * j, src + size * j, size);
+    }
+  }
+  return 0;
+}
+
+int clBatchScatter(clBatch *batch, size_t first, size_t n, const void *rows,
+                   size_t stride) {
+  if (first > batch->size || batch->size - first < n) {
+    return cl_ERR_VALUE;
+  }
+
+  scatter(batch, first, n, rows, stride);
+  return 0;
+}
+
+// The kernels below run over one contiguous array per call, in loops simple
+// enough for the compiler to vectorize.
+
+static bool isKernelType(const clColumn *column) {
+  switch (column->tp) {
+#define X(TP, T, M)                                                            \
+  case TP:                                                                     \
+    return column->size == sizeof(T);
+    CL_BATCH_TYPES(X)
+#undef X
+  default:
+    return false;
+  }
+}
+
+static const clColumn *kernelLeaf(const clBatch *batch, int32_t leaf) {
+  if (leaf < 0 || leaf >= batch->num || !isKernelType(batch->leaves[leaf])) {
+    return NULL;
+  }
+  return batch->leaves[leaf];
+}
+
+// integers accumulate as uint64_t so that overflow wraps instead of being UB
+#define ACC_i64 uint64_t
+#define ACC_u64 uint64_t
+#define ACC_f64 double
+
+#define SCALAR_i64 int64_t
+#define SCALAR_u64 uint64_t
+#define SCALAR_f64 double
+
+int clBatchSum(const clBatch *batch, int32_t leaf, clScalar *sum) {
+  const clColumn *column = kernelLeaf(batch, leaf);
+  if (!column) {
+    return cl_ERR_TYPE;
+  }
+
+  const void *data = batch->data[leaf];
+  size_t n = batch->size;
+
+  switch (column->tp) {
+#define X(TP, T, M)                                                            \
+  case TP: {                                                                   \
+    const T *p = (const T *)data;                                              \
+    ACC_##M s = 0;                                                             \
+    for (size_t i = 0; i < n; ++i) {                                           \
+      s += (ACC_##M)p[i];                                                      \
+    }                                                                          \
+    sum->M = s;                                                                \
+    break;                                                                     \
+  }
+    CL_BATCH_TYPES(X)
+#undef X
+  }
+  return 0;
+}
+
+int clBatchMinMax(const clBatch *batch, int32_t leaf, clScalar *min,
+                  clScalar *max) {
+  const clColumn *column = kernelLeaf(batch, leaf);
+  if (!column) {
+    return cl_ERR_TYPE;
+  }
+  if (!batch->size) {
+    return cl_ERR_VALUE;
+  }
+
+  const void *data = batch->data[leaf];
+  size_t n = batch->size;
+
+  switch (column->tp) {
+#define X(TP, T, M)                                                            \
+  case TP: {                                                                   \
+    const T *p = (const T *)data;                                              \
+    T lo = p[0], hi = p[0];                                                    \
+    for (size_t i = 1; i < n; ++i) {                                           \
+      lo = p[i] < lo ? p[i] : lo;                                              \
+      hi = p[i] > hi ? p[i] : hi;                                              \
+    }                                                                          \
+    min->M = lo;                                                               \
+    max->M = hi;                                                               \
+    break;                                                                     \
+  }
+    CL_BATCH_TYPES(X)
+#undef X
+  }
+  return 0;
+}
+
+// Builds MASK one 64-row word at a time; V is converted to the clScalar
+// member type so that values outside the range of T compare correctly.
+#define FILTER(T, M, OP)                                                       \
+  for (size_t i = 0; i < n; i += 64) {                                         \
+    size_t end = n - i < 64 ? n - i : 64;                                      \
+    uint64_t bits = 0;                                                         \
+    for (size_t j = 0; j < end; ++j) {                                         \
+      bits |= (uint64_t)((SCALAR_##M)p[i + j] OP value.M) << j;                \
+    }                                                                          \
+    mask[i / 64] = bits;                                                       \
+    count += __builtin_popcountll(bits);                                       \
+  }
+
+ptrdiff_t clBatchFilter(const clBatch *batch, int32_t leaf, int op,
+                        clScalar value, uint64_t *mask) {
+  const clColumn *column = kernelLeaf(batch, leaf);
+  if (!column) {
+    return cl_ERR_TYPE;
+  }
+  if (op < cl_CMP_EQ || op > cl_CMP_GE) {
+    return cl_ERR_VALUE;
+  }
+
+  const void *data = batch->data[leaf];
+  size_t n = batch->size;
+  ptrdiff_t count = 0;
+
+  switch (column->tp) {
+#define X(TP, T, M)                                                            \
+  case TP: {                                                                   \
+    const T *p = (const T *)data;                                              \
+    switch (op) {                                                              \
+    case cl_CMP_EQ:                                                            \
+      FILTER(T, M, ==)                                                         \
+      break;                                                                   \
+    case cl_CMP_NE:                                                            \
+      FILTER(T, M, !=)                                                         \
+      break;                                                                   \
+    case cl_CMP_LT:                                                            \
+      FILTER(T, M, <)                                                          \
+      break;                                                                   \
+    case cl_CMP_LE:                                                            \
+      FILTER(T, M, <=)                                                         \
+      break;                                                                   \
+    case cl_CMP_GT:                                                            \
+      FILTER(T, M, >)                                                          \
+      break;                                                                   \
+    case cl_CMP_GE:                                                            \
+      FILTER(T, M, >=)                                                         \
+      break;                                                                   \
+    }                                                                          \
+    break;                                                                     \
+  }
+    CL_BATCH_TYPES(X)
+#undef X
+  }
+  return count;
+}
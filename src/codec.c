@@ -0,0 +1,354 @@
+#include "internal.h"
+
+// The width of the numbers an object is made of when it is nothing else,
+// without padding, so that an array of it swaps as an array of numbers; 0
+// otherwise.
+static int32_t swapWidth(const clColumn *column) {
+  int32_t width = 0;
+  int32_t size = 0;
+  for (int32_t i = 0; i < column->via_object.num; ++i) {
+    const clColumn *field = &column->via_object.columns[i];
+    int32_t w = field->size;
+    if (field->tp == cl_FIXED_ARRAY && !field->via_fixed_array.columns) {
+      w = clElementSize(field, field->via_fixed_array.capacity);
+    } else if (!clIsNumber(field->tp)) {
+      return 0;
+    }
+    if ((width && w != width) || field->offset != size) {
+      return 0;
+    }
+    width = w;
+    size += field->size;
+  }
+  return size == column->size ? width : 0;
+}
+
+static int encodeNumber(int tp, int32_t size, const uint8_t *src,
+                        clWriter *w) {
+  if (w->wire == cl_WIRE_SWAPPED) {
+    return clWriteSwapped(w, src, 1, size);
+  }
+  if (!clIsVarint(w->wire, tp, size)) {
+    return clWriteBytes(w, src, size);
+  }
+
+  int64_t v = clLoadInteger(src, tp, size);
+  return clWriteVarint(w, clIsSigned(tp) ? clZigzag(v) : (uint64_t)v);
+}
+
+static int decodeNumber(int tp, int32_t size, uint8_t *dst, clReader *r) {
+  if (r->wire == cl_WIRE_SWAPPED) {
+    return clReadSwapped(r, dst, 1, size);
+  }
+  if (!clIsVarint(r->wire, tp, size)) {
+    return clReadBytes(r, dst, size);
+  }
+
+  uint64_t u;
+  int err = clReadVarint(r, &u);
+  if (err) {
+    return err;
+  }
+
+  int64_t v = clIsSigned(tp) ? clUnzigzag(u) : (int64_t)u;
+  if (!clFitsInteger(v, tp, size)) {
+    return cl_ERR_VALUE;
+  }
+  clStoreInteger(dst, size, v);
+  return 0;
+}
+
+static int encodeColumns(const clColumn *columns, int32_t num,
+                         const uint8_t *base, clWriter *w) {
+  for (int32_t i = 0; i < num; ++i) {
+    int err = clEncodeColumn(&columns[i], base, w);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+static int decodeColumns(const clColumn *columns, int32_t num, uint8_t *base,
+                         clReader *r) {
+  for (int32_t i = 0; i < num; ++i) {
+    int err = clDecodeColumn(&columns[i], base, r);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+static int encodeArray(const clColumn *element, int tp, int32_t stride,
+                       int64_t count, const uint8_t *src, clWriter *w) {
+  if (w->wire == cl_WIRE_SWAPPED) {
+    // one pass of the swap kernel over runs of numbers of the same width
+    int32_t width = element ? swapWidth(element) : stride;
+    if (width) {
+      return clWriteSwapped(w, src, (size_t)(stride / width) * count, width);
+    }
+  }
+  if (!element && !clIsVarint(w->wire, tp, stride)) {
+    return clWriteBytes(w, src, (size_t)stride * count);
+  }
+
+  if (!element) {
+    for (int64_t i = 0; i < count; ++i) {
+      int err = encodeNumber(tp, stride, src + i * stride, w);
+      if (err) {
+        return err;
+      }
+    }
+    return 0;
+  }
+
+  for (int64_t i = 0; i < count; ++i) {
+    int err = clEncodeColumn(element, src + i * stride, w);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+static int decodeArray(const clColumn *element, int tp, int32_t stride,
+                       int64_t count, uint8_t *dst, clReader *r) {
+  if (r->wire == cl_WIRE_SWAPPED) {
+    int32_t width = element ? swapWidth(element) : stride;
+    if (width) {
+      return clReadSwapped(r, dst, (size_t)(stride / width) * count, width);
+    }
+  }
+  if (!element && !clIsVarint(r->wire, tp, stride)) {
+    return clReadBytes(r, dst, (size_t)stride * count);
+  }
+
+  if (!element) {
+    for (int64_t i = 0; i < count; ++i) {
+      int err = decodeNumber(tp, stride, dst + i * stride, r);
+      if (err) {
+        return err;
+      }
+    }
+    return 0;
+  }
+
+  for (int64_t i = 0; i < count; ++i) {
+    int err = clDecodeColumn(element, dst + i * stride, r);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+int clEncodeColumn(const clColumn *column, const uint8_t *base, clWriter *w) {
+  const uint8_t *src = base + column->offset;
+
+  switch (column->tp) {
+  case cl_OBJECT:
+    return encodeColumns(column->via_object.columns, column->via_object.num,
+                         src, w);
+
+  case cl_UNION: {
+    if (!clIsTagged(column)) {
+      return clWriteBytes(w, src, column->size);
+    }
+    const clColumn *member = clUnionMember(column, base);
+    return member ? clEncodeColumn(member, src, w) : 0;
+  }
+
+  case cl_FIXED_ARRAY: {
+    const clFixedArray *array = &column->via_fixed_array;
+    return encodeArray(array->columns, array->tp,
+                       clElementSize(column, array->capacity),
+                       array->capacity, src, w);
+  }
+
+  case cl_FLEXIBLE_ARRAY: {
+    const clFlexibleArray *array = &column->via_flexible_array;
+    int64_t count = clLoadCount(array, base);
+    if (count < 0) {
+      return (int)count;
+    }
+    return encodeArray(array->columns, array->tp,
+                       clElementSize(column, array->capacity), count, src,
+                       w);
+  }
+
+  case cl_STRING: {
+    const clString *string = &column->via_string;
+    return clEncodeString(src, clElementSize(column, string->capacity),
+                          string->capacity, w);
+  }
+
+  default:
+    if (!clIsNumber(column->tp)) {
+      return cl_ERR_TYPE;
+    }
+    return encodeNumber(column->tp, column->size, src, w);
+  }
+}
+
+int clEncodeString(const uint8_t *src, int32_t element, int32_t capacity,
+                   clWriter *w) {
+  int32_t len = clStringLength(src, element, capacity);
+  if (w->wire == cl_WIRE_COMPACT) {
+    if (clIsTerminated(src, element, len)) {
+      --len;
+    }
+    int err = clWriteVarint(w, (uint64_t)len);
+    if (err) {
+      return err;
+    }
+  }
+  if (w->wire == cl_WIRE_SWAPPED) {
+    return clWriteSwapped(w, src, (size_t)len, element);
+  }
+  return clWriteBytes(w, src, (size_t)element * len);
+}
+
+int clDecodeString(uint8_t *dst, int32_t element, int32_t capacity,
+                   clReader *r) {
+  if (r->wire == cl_WIRE_COMPACT) {
+    uint64_t len;
+    int err = clReadVarint(r, &len);
+    if (err) {
+      return err;
+    }
+    if (len > (uint64_t)capacity) {
+      return cl_ERR_VALUE;
+    }
+
+    err = clReadBytes(r, dst, (size_t)element * len);
+    if (err) {
+      return err;
+    }
+    if (len < (uint64_t)capacity) {
+      memset(dst + (size_t)element * len, 0, (size_t)element);
+    }
+    return 0;
+  }
+
+  size_t avail = (r->size - r->pos) / element;
+  int32_t n = capacity;
+  if (avail < (size_t)n) {
+    n = (int32_t)avail;
+  }
+
+  int32_t len = clStringLength(r->buf + r->pos, element, n);
+  if (n < capacity && !clIsTerminated(r->buf + r->pos, element, len)) {
+    return cl_ERR_BUFFER;
+  }
+  if (r->wire == cl_WIRE_SWAPPED) {
+    return clReadSwapped(r, dst, (size_t)len, element);
+  }
+  return clReadBytes(r, dst, (size_t)element * len);
+}
+
+int clDecodeColumn(const clColumn *column, uint8_t *base, clReader *r) {
+  uint8_t *dst = base + column->offset;
+
+  switch (column->tp) {
+  case cl_OBJECT:
+    return decodeColumns(column->via_object.columns, column->via_object.num,
+                         dst, r);
+
+  case cl_UNION: {
+    if (!clIsTagged(column)) {
+      return clReadBytes(r, dst, column->size);
+    }
+    // the tag precedes the union and has already been decoded
+    const clColumn *member = clUnionMember(column, base);
+    return member ? clDecodeColumn(member, dst, r) : 0;
+  }
+
+  case cl_FIXED_ARRAY: {
+    const clFixedArray *array = &column->via_fixed_array;
+    return decodeArray(array->columns, array->tp,
+                       clElementSize(column, array->capacity),
+                       array->capacity, dst, r);
+  }
+
+  case cl_FLEXIBLE_ARRAY: {
+    // the length field precedes the array and has already been decoded
+    const clFlexibleArray *array = &column->via_flexible_array;
+    int64_t count = clLoadCount(array, base);
+    if (count < 0) {
+      return (int)count;
+    }
+    return decodeArray(array->columns, array->tp,
+                       clElementSize(column, array->capacity), count, dst,
+                       r);
+  }
+
+  case cl_STRING: {
+    const clString *string = &column->via_string;
+    return clDecodeString(dst, clElementSize(column, string->capacity),
+                          string->capacity, r);
+  }
+
+  default:
+    if (!clIsNumber(column->tp)) {
+      return cl_ERR_TYPE;
+    }
+    return decodeNumber(column->tp, column->size, dst, r);
+  }
+}
+
+int clEncodeMessage(const clColumn *column, const void *src, clWriter *w) {
+  const clProgram *program;
+  if (column->tp == cl_OBJECT && !clProgramFind(&program, column, w->wire)) {
+    return clProgramWrite(program, (const uint8_t *)src, w);
+  }
+  return clEncodeColumn(column, (const uint8_t *)src - column->offset, w);
+}
+
+static int decodeMessage(const clColumn *column, void *dst, clReader *r) {
+  const clProgram *program;
+  if (column->tp == cl_OBJECT && !clProgramFind(&program, column, r->wire)) {
+    return clProgramRead(program, (uint8_t *)dst, r);
+  }
+  return clDecodeColumn(column, (uint8_t *)dst - column->offset, r);
+}
+
+ptrdiff_t clEncodeSizeEx(const clColumn *column, int wire, const void *src) {
+  clWriter w = {NULL, 0, 0, wire, NULL, NULL, 0};
+  int err = clEncodeMessage(column, src, &w);
+  return err ? err : (ptrdiff_t)w.pos;
+}
+
+ptrdiff_t clEncodeEx(const clColumn *column, int wire, const void *src,
+                     void *buf, size_t size) {
+  uint64_t start = clStatsNow();
+  clWriter w = {(uint8_t *)buf, 0, size, wire, NULL, NULL, 0};
+  int err = clEncodeMessage(column, src, &w);
+  ptrdiff_t n = err ? err : (ptrdiff_t)w.pos;
+  clStatsRecord(column, cl_STATS_ENCODE, start, n);
+  return n;
+}
+
+ptrdiff_t clDecodeEx(const clColumn *column, int wire, void *dst,
+                     const void *buf, size_t size) {
+  uint64_t start = clStatsNow();
+  clReader r = {(const uint8_t *)buf, 0, size, wire};
+  int err = decodeMessage(column, dst, &r);
+  ptrdiff_t n = err ? err : (ptrdiff_t)r.pos;
+  clStatsRecord(column, cl_STATS_DECODE, start, n);
+  return n;
+}
+
+ptrdiff_t clEncodeSize(const clColumn *column, const void *src) {
+  return clEncodeSizeEx(column, cl_WIRE_RAW, src);
+}
+
+ptrdiff_t clEncode(const clColumn *column, const void *src, void *buf,
+                   size_t size) {
+  return clEncodeEx(column, cl_WIRE_RAW, src, buf, size);
+}
+
+ptrdiff_t clDecode(const clColumn *column, void *dst, const void *buf,
+                   size_t size) {
+  return clDecodeEx(column, cl_WIRE_RAW, dst, buf, size);
+}
@@ -0,0 +1,614 @@
+#include "internal.h"
+
+#include <stdlib.h>
+
+// A compressed batch is the row count followed by every leaf in order: one
+// cl_CODEC_* byte and the payload of that codec. Integer leaves are coded as
+// order preserving unsigned keys (signed values have their sign bit
+// flipped), every other leaf as opaque cells of the field size.
+//
+//   cl_CODEC_PLAIN  the leaf buffer as is
+//   cl_CODEC_FOR    varint min, bit width, keys - min bit-packed
+//   cl_CODEC_DELTA  varint first key, then the differences as cl_CODEC_FOR
+//   cl_CODEC_RLE    varint runs, each a varint length and one cell
+//   cl_CODEC_DICT   varint count, ascending keys as varint gaps, bit width,
+//                   dictionary indices bit-packed
+
+#define DICT_MAX 4096
+
+static bool isIntegerLeaf(const clColumn *column) {
+  return clIsNumber(column->tp) && !clIsFloat(column->tp) &&
+         (column->size == 1 || column->size == 2 || column->size == 4 ||
+          column->size == 8);
+}
+
+static uint64_t signBit(const clColumn *column) {
+  return clIsSigned(column->tp) ? (uint64_t)1 << 63 : 0;
+}
+
+static int bitWidth(uint64_t range) {
+  return range ? 64 - __builtin_clzll(range) : 0;
+}
+
+static size_t packedSize(size_t n, int bits) {
+  return (n * (size_t)bits + 7) / 8;
+}
+
+static uint64_t load64(const uint8_t *p) {
+#if CL_VARINT_WORDS
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+#else
+  uint64_t v = 0;
+  for (int i = 0; i < 8; ++i) {
+    v |= (uint64_t)p[i] << (i * 8);
+  }
+  return v;
+#endif
+}
+
+// Writes N values of V - BASE, BITS each, as a little-endian bit stream.
+static int pack(clWriter *w, const uint64_t *v, size_t n, int bits,
+                uint64_t base) {
+  if (!w->buf) {
+    w->pos += packedSize(n, bits);
+    return 0;
+  }
+  if (w->size - w->pos < packedSize(n, bits)) {
+    return cl_ERR_BUFFER;
+  }
+
+  uint8_t *p = w->buf + w->pos;
+  uint64_t acc = 0;
+  int fill = 0;
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t x = v[i] - base;
+    int left = bits;
+    while (left) {
+      int take = 64 - fill < left ? 64 - fill : left;
+      uint64_t part = take == 64 ? x : x & (((uint64_t)1 << take) - 1);
+      acc |= part << fill;
+      x = take == 64 ? 0 : x >> take;
+      left -= take;
+      fill += take;
+      if (fill == 64) {
+        for (int k = 0; k < 8; ++k) {
+          *p++ = (uint8_t)(acc >> (k * 8));
+        }
+        acc = 0;
+        fill = 0;
+      }
+    }
+  }
+  for (int k = 0; k < fill; k += 8) {
+    *p++ = (uint8_t)(acc >> k);
+  }
+
+  w->pos += packedSize(n, bits);
+  return 0;
+}
+
+// Reads N values of BITS each and adds BASE. Every value of up to 56 bits
+// lies within one unaligned 8-byte load, so the main loop is a branch-free
+// load, shift and mask per value; only the tail within 8 bytes of the end
+// and wider values go byte by byte.
+static int unpack(clReader *r, size_t n, int bits, uint64_t base,
+                  uint64_t *out) {
+  size_t len = packedSize(n, bits);
+  if (r->size - r->pos < len) {
+    return cl_ERR_BUFFER;
+  }
+
+  const uint8_t *p = r->buf + r->pos;
+  r->pos += len;
+
+  if (!bits) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = base;
+    }
+    return 0;
+  }
+
+  uint64_t mask = bits == 64 ? ~(uint64_t)0 : ((uint64_t)1 << bits) - 1;
+  size_t i = 0;
+  if (bits <= 56 && len >= 8) {
+    size_t fast = (len - 8) * 8 / (size_t)bits + 1;
+    fast = fast < n ? fast : n;
+    for (; i < fast; ++i) {
+      size_t bit = i * (size_t)bits;
+      out[i] = base + ((load64(p + bit / 8) >> (bit % 8)) & mask);
+    }
+  }
+
+  for (; i < n; ++i) {
+    uint64_t x = 0;
+    for (int k = 0; k < bits;) {
+      size_t bit = i * (size_t)bits + (size_t)k;
+      int shift = (int)(bit % 8);
+      int take = 8 - shift < bits - k ? 8 - shift : bits - k;
+      x |= (uint64_t)((p[bit / 8] >> shift) & ((1u << take) - 1)) << k;
+      k += take;
+    }
+    out[i] = base + x;
+  }
+  return 0;
+}
+
+static size_t countRuns(const uint8_t *data, size_t cell, size_t n,
+                        size_t *size) {
+  size_t runs = 0;
+  *size = 0;
+  for (size_t i = 0; i < n;) {
+    size_t j = i + 1;
+    while (j < n && memcmp(data + cell * i, data + cell * j, cell) == 0) {
+      ++j;
+    }
+    ++runs;
+    *size += clVarintSize(j - i) + cell;
+    i = j;
+  }
+  *size += clVarintSize(runs);
+  return runs;
+}
+
+static int compareKeys(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+// Sorts KEYS into SORTED and returns the number of distinct keys, which are
+// moved to the front.
+static size_t uniqueKeys(const uint64_t *keys, size_t n, uint64_t *sorted) {
+  if (!n) {
+    return 0;
+  }
+
+  memcpy(sorted, keys, n * sizeof(*sorted));
+  qsort(sorted, n, sizeof(*sorted), compareKeys);
+
+  size_t num = 1;
+  for (size_t i = 1; i < n; ++i) {
+    if (sorted[i] != sorted[num - 1]) {
+      sorted[num++] = sorted[i];
+    }
+  }
+  return num;
+}
+
+static void minMax(const uint64_t *v, size_t n, uint64_t *min, uint64_t *max) {
+  uint64_t lo = ~(uint64_t)0, hi = 0;
+  for (size_t i = 0; i < n; ++i) {
+    lo = v[i] < lo ? v[i] : lo;
+    hi = v[i] > hi ? v[i] : hi;
+  }
+  *min = lo;
+  *max = hi;
+}
+
+// Order preserving keys of the differences, in place from the back.
+static void deltaKeys(uint64_t *keys, size_t n) {
+  for (size_t i = n; i-- > 1;) {
+    keys[i] = (keys[i] - keys[i - 1]) ^ ((uint64_t)1 << 63);
+  }
+}
+
+typedef struct {
+  const clBatch *batch;
+  uint64_t *keys;   // row count entries
+  uint64_t *sorted; // row count entries
+} clScratch;
+
+static void loadKeys(const clBatch *batch, int32_t leaf, uint64_t *keys) {
+  const clColumn *column = batch->leaves[leaf];
+  const uint8_t *data = batch->data[leaf];
+  uint64_t sign = signBit(column);
+  for (size_t i = 0; i < batch->size; ++i) {
+    keys[i] = (uint64_t)clLoadInteger(data + (size_t)column->size * i,
+                                      column->tp, column->size) ^
+              sign;
+  }
+}
+
+// Picks the smallest encoding of LEAF; ties go to the cheaper decoder.
+// Leaves KEYS loaded and SORTED holding the distinct keys.
+static int chooseCodec(const clBatch *batch, int32_t leaf, clScratch *s,
+                       size_t *num_unique) {
+  const clColumn *column = batch->leaves[leaf];
+  size_t n = batch->size;
+  size_t cell = (size_t)column->size;
+
+  int codec = cl_CODEC_PLAIN;
+  size_t best = cell * n;
+  size_t size;
+
+  countRuns(batch->data[leaf], cell, n, &size);
+  size_t rle = size;
+
+  *num_unique = 0;
+  if (isIntegerLeaf(column) && n) {
+    uint64_t min, max;
+    loadKeys(batch, leaf, s->keys);
+
+    minMax(s->keys, n, &min, &max);
+    size = clVarintSize(min) + 1 + packedSize(n, bitWidth(max - min));
+    if (size < best) {
+      codec = cl_CODEC_FOR;
+      best = size;
+    }
+
+    *num_unique = uniqueKeys(s->keys, n, s->sorted);
+    if (*num_unique <= DICT_MAX) {
+      size = clVarintSize(*num_unique) + 1 +
+             packedSize(n, bitWidth(*num_unique - 1));
+      for (size_t i = 0; i < *num_unique; ++i) {
+        size += clVarintSize(i ? s->sorted[i] - s->sorted[i - 1]
+                               : s->sorted[0]);
+      }
+      if (size < best) {
+        codec = cl_CODEC_DICT;
+        best = size;
+      }
+    }
+
+    // last, it rewrites KEYS
+    uint64_t first = s->keys[0];
+    deltaKeys(s->keys, n);
+    minMax(s->keys + 1, n - 1, &min, &max);
+    size = clVarintSize(first) + clVarintSize(n > 1 ? min : 0) + 1 +
+           packedSize(n - 1, n > 1 ? bitWidth(max - min) : 0);
+    if (size < best) {
+      codec = cl_CODEC_DELTA;
+      best = size;
+    }
+  }
+
+  if (rle < best) {
+    codec = cl_CODEC_RLE;
+  }
+  return codec;
+}
+
+static int encodeFor(clWriter *w, const uint64_t *keys, size_t n) {
+  uint64_t min = 0, max = 0;
+  if (n) {
+    minMax(keys, n, &min, &max);
+  }
+
+  int bits = bitWidth(max - min);
+  uint8_t width = (uint8_t)bits;
+  int err = clWriteVarint(w, min);
+  if (!err) {
+    err = clWriteBytes(w, &width, 1);
+  }
+  return err ? err : pack(w, keys, n, bits, min);
+}
+
+static int encodeRle(clWriter *w, const uint8_t *data, size_t cell, size_t n) {
+  size_t size;
+  int err = clWriteVarint(w, countRuns(data, cell, n, &size));
+  for (size_t i = 0; !err && i < n;) {
+    size_t j = i + 1;
+    while (j < n && memcmp(data + cell * i, data + cell * j, cell) == 0) {
+      ++j;
+    }
+    err = clWriteVarint(w, j - i);
+    if (!err) {
+      err = clWriteBytes(w, data + cell * i, cell);
+    }
+    i = j;
+  }
+  return err;
+}
+
+static int encodeDict(clWriter *w, uint64_t *keys, size_t n,
+                      const uint64_t *dict, size_t num, uint64_t *indices) {
+  int err = clWriteVarint(w, num);
+  for (size_t i = 0; !err && i < num; ++i) {
+    err = clWriteVarint(w, i ? dict[i] - dict[i - 1] : dict[0]);
+  }
+  if (err) {
+    return err;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    size_t lo = 0, hi = num;
+    while (hi - lo > 1) {
+      size_t mid = (lo + hi) / 2;
+      if (dict[mid] <= keys[i]) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    indices[i] = lo;
+  }
+
+  int bits = bitWidth(num - 1);
+  uint8_t width = (uint8_t)bits;
+  err = clWriteBytes(w, &width, 1);
+  return err ? err : pack(w, indices, n, bits, 0);
+}
+
+static int encodeLeaf(clWriter *w, const clBatch *batch, int32_t leaf,
+                      clScratch *s) {
+  const clColumn *column = batch->leaves[leaf];
+  const uint8_t *data = batch->data[leaf];
+  size_t n = batch->size;
+  size_t cell = (size_t)column->size;
+
+  size_t num_unique;
+  uint8_t codec = (uint8_t)chooseCodec(batch, leaf, s, &num_unique);
+  int err = clWriteBytes(w, &codec, 1);
+  if (err) {
+    return err;
+  }
+
+  switch (codec) {
+  case cl_CODEC_FOR:
+    loadKeys(batch, leaf, s->keys);
+    return encodeFor(w, s->keys, n);
+
+  case cl_CODEC_DELTA:
+    loadKeys(batch, leaf, s->keys);
+    deltaKeys(s->keys, n);
+    err = clWriteVarint(w, s->keys[0]);
+    return err ? err : encodeFor(w, s->keys + 1, n - 1);
+
+  case cl_CODEC_RLE:
+    return encodeRle(w, data, cell, n);
+
+  case cl_CODEC_DICT:
+    // SORTED still holds the distinct keys, the indices replace KEYS
+    loadKeys(batch, leaf, s->keys);
+    return encodeDict(w, s->keys, n, s->sorted, num_unique, s->keys);
+
+  default:
+    return clWriteBytes(w, data, cell * n);
+  }
+}
+
+static int allocScratch(clScratch *s, const clBatch *batch, size_t n) {
+  s->batch = batch;
+  s->keys = (uint64_t *)malloc((n ? n : 1) * sizeof(*s->keys));
+  s->sorted = (uint64_t *)malloc((n ? n : 1) * sizeof(*s->sorted));
+  if (!s->keys || !s->sorted) {
+    free(s->keys);
+    free(s->sorted);
+    return cl_ERR_MEMORY;
+  }
+  return 0;
+}
+
+static void freeScratch(clScratch *s) {
+  free(s->keys);
+  free(s->sorted);
+}
+
+int clBatchCodec(const clBatch *batch, int32_t leaf) {
+  if (leaf < 0 || leaf >= batch->num) {
+    return cl_ERR_VALUE;
+  }
+
+  clScratch s;
+  int err = allocScratch(&s, batch, batch->size);
+  if (err) {
+    return err;
+  }
+
+  size_t num_unique;
+  int codec = chooseCodec(batch, leaf, &s, &num_unique);
+  freeScratch(&s);
+  return codec;
+}
+
+static ptrdiff_t compress(const clBatch *batch, clWriter *w) {
+  clScratch s;
+  int err = allocScratch(&s, batch, batch->size);
+  if (err) {
+    return err;
+  }
+
+  err = clWriteVarint(w, batch->size);
+  for (int32_t i = 0; !err && i < batch->num; ++i) {
+    err = encodeLeaf(w, batch, i, &s);
+  }
+
+  freeScratch(&s);
+  return err ? err : (ptrdiff_t)w->pos;
+}
+
+ptrdiff_t clBatchCompressSize(const clBatch *batch) {
+  clWriter w = {NULL, 0, 0, cl_WIRE_RAW, NULL, NULL, 0};
+  return compress(batch, &w);
+}
+
+ptrdiff_t clBatchCompress(const clBatch *batch, void *buf, size_t size) {
+  clWriter w = {(uint8_t *)buf, 0, size, cl_WIRE_RAW, NULL, NULL, 0};
+  return compress(batch, &w);
+}
+
+static int decodeFor(clReader *r, size_t n, uint64_t *keys) {
+  uint64_t min;
+  uint8_t bits;
+  int err = clReadVarint(r, &min);
+  if (!err) {
+    err = clReadBytes(r, &bits, 1);
+  }
+  if (err) {
+    return err;
+  }
+  if (bits > 64) {
+    return cl_ERR_VALUE;
+  }
+  return unpack(r, n, bits, min, keys);
+}
+
+static int decodeRle(clReader *r, uint8_t *dst, size_t cell, size_t n) {
+  uint64_t runs;
+  int err = clReadVarint(r, &runs);
+  if (err) {
+    return err;
+  }
+
+  size_t row = 0;
+  for (uint64_t i = 0; i < runs; ++i) {
+    uint64_t len;
+    err = clReadVarint(r, &len);
+    if (err) {
+      return err;
+    }
+    if (len == 0 || len > n - row) {
+      return cl_ERR_VALUE;
+    }
+
+    err = clReadBytes(r, dst + cell * row, cell);
+    if (err) {
+      return err;
+    }
+    for (uint64_t j = 1; j < len; ++j) {
+      memcpy(dst + cell * (row + j), dst + cell * row, cell);
+    }
+    row += len;
+  }
+  return row == n ? 0 : cl_ERR_VALUE;
+}
+
+static int decodeDict(clReader *r, size_t n, uint64_t *keys,
+                      uint64_t *dict) {
+  uint64_t num;
+  int err = clReadVarint(r, &num);
+  if (err) {
+    return err;
+  }
+  if (num == 0 || num > DICT_MAX || num > n) {
+    return cl_ERR_VALUE;
+  }
+
+  for (uint64_t i = 0; i < num; ++i) {
+    uint64_t gap;
+    err = clReadVarint(r, &gap);
+    if (err) {
+      return err;
+    }
+    dict[i] = i ? dict[i - 1] + gap : gap;
+  }
+
+  uint8_t bits;
+  err = clReadBytes(r, &bits, 1);
+  if (err) {
+    return err;
+  }
+  if (bits > 64) {
+    return cl_ERR_VALUE;
+  }
+
+  err = unpack(r, n, bits, 0, keys);
+  if (err) {
+    return err;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (keys[i] >= num) {
+      return cl_ERR_VALUE;
+    }
+    keys[i] = dict[keys[i]];
+  }
+  return 0;
+}
+
+static int decodeLeaf(clReader *r, clBatch *batch, int32_t leaf, size_t n,
+                      clScratch *s) {
+  const clColumn *column = batch->leaves[leaf];
+  size_t cell = (size_t)column->size;
+  uint8_t *dst = batch->data[leaf] + cell * batch->size;
+
+  uint8_t codec;
+  int err = clReadBytes(r, &codec, 1);
+  if (err) {
+    return err;
+  }
+
+  if (codec == cl_CODEC_PLAIN) {
+    return clReadBytes(r, dst, cell * n);
+  }
+  if (codec == cl_CODEC_RLE) {
+    return decodeRle(r, dst, cell, n);
+  }
+  if (!isIntegerLeaf(column) || !n) {
+    return cl_ERR_VALUE;
+  }
+
+  switch (codec) {
+  case cl_CODEC_FOR:
+    err = decodeFor(r, n, s->keys);
+    break;
+
+  case cl_CODEC_DELTA:
+    err = clReadVarint(r, &s->keys[0]);
+    if (!err) {
+      err = decodeFor(r, n - 1, s->keys + 1);
+    }
+    for (size_t i = 1; !err && i < n; ++i) {
+      s->keys[i] = s->keys[i - 1] + (s->keys[i] ^ ((uint64_t)1 << 63));
+    }
+    break;
+
+  case cl_CODEC_DICT:
+    err = decodeDict(r, n, s->keys, s->sorted);
+    break;
+
+  default:
+    return cl_ERR_VALUE;
+  }
+  if (err) {
+    return err;
+  }
+
+  uint64_t sign = signBit(column);
+  for (size_t i = 0; i < n; ++i) {
+    clStoreInteger(dst + cell * i, column->size, (int64_t)(s->keys[i] ^ sign));
+  }
+  return 0;
+}
+
+ptrdiff_t clBatchDecompress(clBatch *batch, const void *buf, size_t size,
+                            size_t max_rows) {
+  clReader r = {(const uint8_t *)buf, 0, size, cl_WIRE_RAW};
+  uint64_t n;
+  int err = clReadVarint(&r, &n);
+  if (err) {
+    return err;
+  }
+  if (n > max_rows) {
+    return cl_ERR_CAPACITY;
+  }
+  if (n > SIZE_MAX / 16 - batch->size) {
+    return cl_ERR_VALUE;
+  }
+  // a codec byte per leaf
+  if (size - r.pos < (size_t)batch->num) {
+    return cl_ERR_BUFFER;
+  }
+
+  err = clBatchReserve(batch, batch->size + n);
+  if (err) {
+    return err;
+  }
+
+  clScratch s;
+  err = allocScratch(&s, batch, n);
+  if (err) {
+    return err;
+  }
+
+  for (int32_t i = 0; !err && i < batch->num; ++i) {
+    err = decodeLeaf(&r, batch, i, n, &s);
+  }
+  freeScratch(&s);
+
+  if (err) {
+    return err;
+  }
+  batch->size += n;
+  return (ptrdiff_t)r.pos;
+}
@@ -0,0 +1,272 @@
+#include "internal.h"
+
+// A patch mirrors the descriptor tree: every object and array starts with a
+// bitmap of its changed fields (elements), followed by the patches of those
+// fields in order. Leaves are sent in the cl_WIRE_RAW format.
+//
+// BASE is NULL when the receiver holds nothing meaningful at that position,
+// e.g. flexible array elements past the baseline count; everything below it
+// is then sent in full.
+
+#define BLOCK 8 // elements covered by one bitmap byte
+
+static void setBit(clWriter *w, size_t bitmap, int64_t i) {
+  if (w->buf) {
+    w->buf[bitmap + i / 8] |= (uint8_t)(1u << (i % 8));
+  }
+}
+
+static bool getBit(const uint8_t *bitmap, int64_t i) {
+  return (bitmap[i / 8] >> (i % 8)) & 1;
+}
+
+static bool isChanged(const clColumn *column, const uint8_t *base,
+                      const uint8_t *cur) {
+  const uint8_t *b = base + column->offset;
+  const uint8_t *c = cur + column->offset;
+
+  switch (column->tp) {
+  case cl_FLEXIBLE_ARRAY: {
+    const clFlexibleArray *array = &column->via_flexible_array;
+    int64_t count = clLoadCount(array, cur);
+    if (count != clLoadCount(array, base)) {
+      return true;
+    }
+    if (count < 0) {
+      return false;
+    }
+    return memcmp(b, c,
+                  (size_t)clElementSize(column, array->capacity) * count) != 0;
+  }
+
+  case cl_STRING: {
+    const clString *string = &column->via_string;
+    int32_t element = clElementSize(column, string->capacity);
+    int32_t len = clStringLength(c, element, string->capacity);
+    return len != clStringLength(b, element, string->capacity) ||
+           memcmp(b, c, (size_t)element * len) != 0;
+  }
+
+  case cl_UNION: {
+    if (!clIsTagged(column)) {
+      return memcmp(b, c, column->size) != 0;
+    }
+    // only the bytes of the selected member
+    const clColumn *member = clUnionMember(column, cur);
+    if (member != clUnionMember(column, base)) {
+      return true;
+    }
+    return member && memcmp(b + member->offset, c + member->offset,
+                            member->size) != 0;
+  }
+
+  default:
+    return memcmp(b, c, column->size) != 0;
+  }
+}
+
+static int diffColumn(const clColumn *column, const uint8_t *base,
+                      const uint8_t *cur, clWriter *w);
+
+static int diffColumns(const clColumn *columns, int32_t num,
+                       const uint8_t *base, const uint8_t *cur, clWriter *w) {
+  size_t bitmap = w->pos;
+  int err = clWriteZeros(w, ((size_t)num + 7) / 8);
+  if (err) {
+    return err;
+  }
+
+  for (int32_t i = 0; i < num; ++i) {
+    if (base && !isChanged(&columns[i], base, cur)) {
+      continue;
+    }
+
+    setBit(w, bitmap, i);
+    err = diffColumn(&columns[i], base, cur, w);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+// Elements below BASE_COUNT exist on the receiver and are diffed, the others
+// are sent in full.
+static int diffArray(const clColumn *element, int32_t stride, int64_t count,
+                     int64_t base_count, const uint8_t *base,
+                     const uint8_t *cur, clWriter *w) {
+  size_t bitmap = w->pos;
+  int err = clWriteZeros(w, ((size_t)count + 7) / 8);
+  if (err) {
+    return err;
+  }
+
+  for (int64_t i = 0; i < count; i += BLOCK) {
+    int64_t n = count - i < BLOCK ? count - i : BLOCK;
+
+    // one wide compare skips a whole unchanged bitmap byte
+    if (i + n <= base_count &&
+        memcmp(base + i * stride, cur + i * stride, (size_t)stride * n) == 0) {
+      continue;
+    }
+
+    for (int64_t j = i; j < i + n; ++j) {
+      const uint8_t *b = j < base_count ? base + j * stride : NULL;
+      const uint8_t *c = cur + j * stride;
+      if (b && memcmp(b, c, stride) == 0) {
+        continue;
+      }
+
+      setBit(w, bitmap, j);
+      err = element ? diffColumn(element, b, c, w)
+                    : clWriteBytes(w, c, stride);
+      if (err) {
+        return err;
+      }
+    }
+  }
+  return 0;
+}
+
+static int diffColumn(const clColumn *column, const uint8_t *base,
+                      const uint8_t *cur, clWriter *w) {
+  const uint8_t *b = base ? base + column->offset : NULL;
+  const uint8_t *c = cur + column->offset;
+
+  switch (column->tp) {
+  case cl_OBJECT:
+    return diffColumns(column->via_object.columns, column->via_object.num, b,
+                       c, w);
+
+  case cl_FIXED_ARRAY: {
+    const clFixedArray *array = &column->via_fixed_array;
+    return diffArray(array->columns, clElementSize(column, array->capacity),
+                     array->capacity, b ? array->capacity : 0, b, c, w);
+  }
+
+  case cl_FLEXIBLE_ARRAY: {
+    const clFlexibleArray *array = &column->via_flexible_array;
+    int64_t count = clLoadCount(array, cur);
+    if (count < 0) {
+      return (int)count;
+    }
+
+    int64_t base_count = base ? clLoadCount(array, base) : 0;
+    if (base_count < 0) {
+      base_count = 0;
+    }
+    return diffArray(array->columns, clElementSize(column, array->capacity),
+                     count, base_count, b, c, w);
+  }
+
+  default:
+    // numbers, strings and unions change as a whole, a tagged union as its
+    // selected member
+    return clEncodeColumn(column, cur, w);
+  }
+}
+
+static int patchColumn(const clColumn *column, uint8_t *base, clReader *r);
+
+static int patchColumns(const clColumn *columns, int32_t num, uint8_t *base,
+                        clReader *r) {
+  size_t len = ((size_t)num + 7) / 8;
+  if (r->size - r->pos < len) {
+    return cl_ERR_BUFFER;
+  }
+
+  const uint8_t *bitmap = r->buf + r->pos;
+  r->pos += len;
+
+  for (int32_t i = 0; i < num; ++i) {
+    if (!getBit(bitmap, i)) {
+      continue;
+    }
+
+    int err = patchColumn(&columns[i], base, r);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+static int patchArray(const clColumn *element, int32_t stride, int64_t count,
+                      uint8_t *dst, clReader *r) {
+  size_t len = ((size_t)count + 7) / 8;
+  if (r->size - r->pos < len) {
+    return cl_ERR_BUFFER;
+  }
+
+  const uint8_t *bitmap = r->buf + r->pos;
+  r->pos += len;
+
+  for (int64_t i = 0; i < count; ++i) {
+    if (!getBit(bitmap, i)) {
+      continue;
+    }
+
+    int err = element ? patchColumn(element, dst + i * stride, r)
+                      : clReadBytes(r, dst + i * stride, stride);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+static int patchColumn(const clColumn *column, uint8_t *base, clReader *r) {
+  uint8_t *dst = base + column->offset;
+
+  switch (column->tp) {
+  case cl_OBJECT:
+    return patchColumns(column->via_object.columns, column->via_object.num,
+                        dst, r);
+
+  case cl_FIXED_ARRAY: {
+    const clFixedArray *array = &column->via_fixed_array;
+    return patchArray(array->columns, clElementSize(column, array->capacity),
+                      array->capacity, dst, r);
+  }
+
+  case cl_FLEXIBLE_ARRAY: {
+    // the length field precedes the array and has already been patched
+    const clFlexibleArray *array = &column->via_flexible_array;
+    int64_t count = clLoadCount(array, base);
+    if (count < 0) {
+      return (int)count;
+    }
+    return patchArray(array->columns, clElementSize(column, array->capacity),
+                      count, dst, r);
+  }
+
+  default:
+    return clDecodeColumn(column, base, r);
+  }
+}
+
+ptrdiff_t clDiffSize(const clColumn *column, const void *base,
+                     const void *cur) {
+  clWriter w = {NULL, 0, 0, cl_WIRE_RAW, NULL, NULL, 0};
+  int err = diffColumn(column, (const uint8_t *)base - column->offset,
+                       (const uint8_t *)cur - column->offset, &w);
+  return err ? err : (ptrdiff_t)w.pos;
+}
+
+ptrdiff_t clDiff(const clColumn *column, const void *base, const void *cur,
+                 void *buf, size_t size) {
+  uint64_t start = clStatsNow();
+  clWriter w = {(uint8_t *)buf, 0, size, cl_WIRE_RAW, NULL, NULL, 0};
+  int err = diffColumn(column, (const uint8_t *)base - column->offset,
+                       (const uint8_t *)cur - column->offset, &w);
+  ptrdiff_t n = err ? err : (ptrdiff_t)w.pos;
+  clStatsRecord(column, cl_STATS_DIFF, start, n);
+  return n;
+}
+
+ptrdiff_t clPatch(const clColumn *column, void *dst, const void *buf,
+                  size_t size) {
+  clReader r = {(const uint8_t *)buf, 0, size, cl_WIRE_RAW};
+  int err = patchColumn(column, (uint8_t *)dst - column->offset, &r);
+  return err ? err : (ptrdiff_t)r.pos;
+}
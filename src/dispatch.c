@@ -0,0 +1,40 @@
+#include "internal.h"
+
+static bool findCommand(const clDispatch *dispatch, int32_t cmd,
+                        uint32_t *idx) {
+  // one unsigned compare rejects ids on both sides of the range
+  *idx = (uint32_t)cmd - (uint32_t)dispatch->first;
+  return *idx < (uint32_t)dispatch->num;
+}
+
+int clRegisterHandler(clDispatch *dispatch, int32_t cmd, clHandler handler) {
+  uint32_t idx;
+  if (!findCommand(dispatch, cmd, &idx)) {
+    return cl_ERR_VALUE;
+  }
+
+  dispatch->handlers[idx] = handler;
+  return 0;
+}
+
+const clColumn *clCommandColumn(const clDispatch *dispatch, int32_t cmd) {
+  uint32_t idx;
+  return findCommand(dispatch, cmd, &idx) ? dispatch->columns[idx] : NULL;
+}
+
+ptrdiff_t clDispatchMessage(const clDispatch *dispatch, int32_t cmd, void *msg,
+                            const void *buf, size_t size, void *ctx) {
+  uint32_t idx;
+  if (!findCommand(dispatch, cmd, &idx) || !dispatch->handlers[idx]) {
+    return cl_ERR_VALUE;
+  }
+
+  const clColumn *column = dispatch->columns[idx];
+  ptrdiff_t n = clDecode(column, msg, buf, size);
+  if (n < 0) {
+    return n;
+  }
+
+  int err = dispatch->handlers[idx](column, msg, ctx);
+  return err ? err : n;
+}
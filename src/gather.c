@@ -0,0 +1,156 @@
+#include "internal.h"
+
+#include <sys/uio.h>
+
+// A message is encoded into the arena, except for its byte runs: in a
+// gather writer clWriteBytes() only records where the bytes are, and joins
+// the runs that continue each other in memory. A run that ends becomes an
+// iovec of its own once it reaches the threshold and is copied into the
+// arena otherwise. The arena bytes in between make up the other iovecs, and
+// an iovec that continues the previous one in memory is merged into it.
+
+#define GATHER_THRESHOLD 64
+
+static int push(clGather *gather, const uint8_t *p, size_t n) {
+  if (!n) {
+    return 0;
+  }
+
+  if (gather->num > 0) {
+    struct iovec *last = &gather->iov[gather->num - 1];
+    if ((const uint8_t *)last->iov_base + last->iov_len == p) {
+      last->iov_len += n;
+      gather->bytes += n;
+      return 0;
+    }
+  }
+  if (gather->num == gather->capacity) {
+    return cl_ERR_BUFFER;
+  }
+
+  gather->iov[gather->num].iov_base = (void *)p;
+  gather->iov[gather->num].iov_len = n;
+  ++gather->num;
+  gather->bytes += n;
+  return 0;
+}
+
+int clGatherRun(clWriter *w, const void *src, size_t n) {
+  const uint8_t *p = (const uint8_t *)src;
+  if (w->run && w->run + w->run_len == p) {
+    w->run_len += n;
+    return 0;
+  }
+
+  int err = clGatherSettle(w);
+  if (!err) {
+    w->run = p;
+    w->run_len = n;
+  }
+  return err;
+}
+
+int clGatherSettle(clWriter *w) {
+  clGather *gather = w->gather;
+  const uint8_t *run = w->run;
+  size_t n = w->run_len;
+  w->run = NULL;
+  w->run_len = 0;
+
+  if (n < gather->threshold) {
+    if (w->size - w->pos < n) {
+      return cl_ERR_BUFFER;
+    }
+    if (n) {
+      memcpy(w->buf + w->pos, run, n);
+    }
+    w->pos += n;
+    return 0;
+  }
+
+  // the arena bytes in front of the run go first
+  int err = push(gather, w->buf + gather->used, w->pos - gather->used);
+  if (!err) {
+    gather->used = w->pos;
+    err = push(gather, run, n);
+  }
+  return err;
+}
+
+void clGatherInit(clGather *gather, struct iovec *iov, int capacity,
+                  void *arena, size_t size) {
+  memset(gather, 0, sizeof(*gather));
+  gather->iov = iov;
+  gather->capacity = capacity;
+  gather->arena = (uint8_t *)arena;
+  gather->size = size;
+  gather->threshold = GATHER_THRESHOLD;
+}
+
+void clGatherReset(clGather *gather) {
+  gather->num = 0;
+  gather->used = 0;
+  gather->bytes = 0;
+}
+
+int clGatherBytes(clGather *gather, const void *data, size_t size) {
+  if (gather->size - gather->used < size) {
+    return cl_ERR_BUFFER;
+  }
+
+  uint8_t *p = gather->arena + gather->used;
+  if (size) {
+    memcpy(p, data, size);
+  }
+  int err = push(gather, p, size);
+  if (!err) {
+    gather->used += size;
+  }
+  return err;
+}
+
+ptrdiff_t clGatherEncode(clGather *gather, const clColumn *column, int wire,
+                         const void *src) {
+  uint64_t start = clStatsNow();
+
+  // what to roll back to, the last iovec may grow by merging
+  int num = gather->num;
+  size_t last = num ? gather->iov[num - 1].iov_len : 0;
+  size_t used = gather->used;
+  size_t bytes = gather->bytes;
+
+  clWriter w = {gather->arena, used, gather->size, wire, gather, NULL, 0};
+  int err = clEncodeMessage(column, src, &w);
+  if (!err) {
+    err = clGatherSettle(&w);
+  }
+  if (!err) {
+    err = push(gather, gather->arena + gather->used, w.pos - gather->used);
+  }
+
+  if (err) {
+    gather->num = num;
+    if (num) {
+      gather->iov[num - 1].iov_len = last;
+    }
+    gather->used = used;
+    gather->bytes = bytes;
+    clStatsRecord(column, cl_STATS_ENCODE, start, err);
+    return err;
+  }
+  gather->used = w.pos;
+  clStatsRecord(column, cl_STATS_ENCODE, start,
+                (ptrdiff_t)(gather->bytes - bytes));
+  return (ptrdiff_t)(gather->bytes - bytes);
+}
+
+ptrdiff_t clGatherEncodeAll(clGather *gather, const clColumn *const *columns,
+                            int wire, const void *const *msgs, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    ptrdiff_t err = clGatherEncode(gather, columns[i], wire, msgs[i]);
+    if (err < 0) {
+      return i ? (ptrdiff_t)i : err;
+    }
+  }
+  return (ptrdiff_t)n;
+}
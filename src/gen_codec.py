@@ -0,0 +1,206 @@
+"""
+gen_codec.py
+"""
+
+from io import StringIO
+
+import layout
+
+
+class CodeWriter:
+    def __init__(self):
+        self.sio = StringIO()
+        self.depth = 1
+
+    def line(self, code: str):
+        self.sio.write("  " * self.depth + code + "\n")
+
+    def open(self, code: str):
+        self.line(f"{code} {{" if code else "{")
+        self.depth += 1
+
+    def close(self):
+        self.depth -= 1
+        self.line("}")
+
+    def fail_if(self, cond: str, err: str):
+        self.open(f"if ({cond})")
+        self.line(f"return {err};")
+        self.close()
+
+
+def at(ptr: str, offset: int) -> str:
+    return f"{ptr} + {offset}" if offset else ptr
+
+
+def split_runs(items: list):
+    """groups consecutive Bytes so that each group needs one bounds check"""
+
+    run = []
+    for item in items:
+        if isinstance(item, layout.Bytes):
+            run.append(item)
+            continue
+
+        if run:
+            yield run
+            run = []
+        yield item
+
+    if run:
+        yield run
+
+
+def render_string(w: CodeWriter, item: layout.String, obj: str, ptr: str, encode: bool):
+    element_size = item.size // item.capacity
+
+    w.open("")
+    if encode:
+        if element_size == 1:
+            w.line(
+                f"const uint8_t *z = (const uint8_t *)memchr({at(ptr, item.offset)}, 0, {item.capacity});"
+            )
+            w.line(
+                f"size_t n = z ? (size_t)(z - ({at(ptr, item.offset)})) + 1 : {item.capacity};"
+            )
+        else:
+            w.line("size_t n = 0;")
+            w.open(f"while (n < {item.capacity} && {obj}{item.path}[n])")
+            w.line("++n;")
+            w.close()
+            w.line(f"n = (n < {item.capacity} ? n + 1 : n) * {element_size};")
+
+        w.fail_if("(size_t)(end - p) < n", "cl_ERR_BUFFER")
+        w.line(f"memcpy(p, {at(ptr, item.offset)}, n);")
+    else:
+        if element_size == 1:
+            w.line("size_t avail = (size_t)(end - p);")
+        else:
+            w.line(f"size_t avail = (size_t)(end - p) / {element_size};")
+        w.line(f"size_t limit = avail < {item.capacity} ? avail : {item.capacity};")
+        if element_size == 1:
+            w.line("const uint8_t *z = (const uint8_t *)memchr(p, 0, limit);")
+            w.line("size_t n = z ? (size_t)(z - p) + 1 : limit;")
+            w.fail_if(f"!z && limit < {item.capacity}", "cl_ERR_BUFFER")
+        else:
+            w.line("size_t n = 0;")
+            w.open("for (; n < limit; ++n)")
+            w.line(f"uint8_t c[{element_size}] = {{0}};")
+            w.open(f"if (memcmp(p + n * {element_size}, c, {element_size}) == 0)")
+            w.line("break;")
+            w.close()
+            w.close()
+            w.fail_if(f"n == limit && limit < {item.capacity}", "cl_ERR_BUFFER")
+            w.line(f"n = (n < limit ? n + 1 : n) * {element_size};")
+        w.line(f"memcpy({at(ptr, item.offset)}, p, n);")
+    w.line("p += n;")
+    w.close()
+
+
+def render_tagged_union(
+    w: CodeWriter, item: layout.TaggedUnion, obj: str, ptr: str, encode: bool, level: int
+):
+    # only the member the tag selects, the switch becomes a jump table
+    w.open(f"switch ({obj}{item.tag_path})")
+    for value, member in item.cases:
+        w.depth -= 1
+        w.line(f"case {value}:")
+        w.depth += 1
+        render_items(w, member, obj, ptr, encode, level)
+        w.line("break;")
+    w.depth -= 1
+    w.line("default:")
+    w.depth += 1
+    w.line("break;")
+    w.close()
+
+
+def render_items(w: CodeWriter, items: list, obj: str, ptr: str, encode: bool, level: int = 0):
+    const = "const " if encode else ""
+
+    for group in split_runs(items):
+        if isinstance(group, list):
+            total = sum(item.size for item in group)
+            w.fail_if(f"end - p < {total}", "cl_ERR_BUFFER")
+
+            pos = 0
+            for item in group:
+                src = at(ptr, item.offset)
+                dst = f"p + {pos}" if pos else "p"
+                if not encode:
+                    src, dst = dst, src
+                w.line(f"memcpy({dst}, {src}, {item.size});")
+                pos += item.size
+            w.line(f"p += {total};")
+            continue
+
+        if isinstance(group, layout.String):
+            render_string(w, group, obj, ptr, encode)
+            continue
+
+        if isinstance(group, layout.TaggedUnion):
+            render_tagged_union(w, group, obj, ptr, encode, level)
+            continue
+
+        count = f"{obj}{group.len_path}"
+        w.fail_if(f"(uint64_t){count} > {group.capacity}", "cl_ERR_CAPACITY")
+
+        if group.element is None or layout.is_plain(group.element, group.element_size):
+            w.open("")
+            w.line(f"size_t n = (size_t){count} * {group.element_size};")
+            w.fail_if("(size_t)(end - p) < n", "cl_ERR_BUFFER")
+            if encode:
+                w.line(f"memcpy(p, {at(ptr, group.offset)}, n);")
+            else:
+                w.line(f"memcpy({at(ptr, group.offset)}, p, n);")
+            w.line("p += n;")
+            w.close()
+            continue
+
+        index = f"i{level}"
+        element = f"e{level}"
+        w.open(f"for (size_t {index} = 0; {index} < (size_t){count}; ++{index})")
+        w.line(f"{const}{group.element_type} *{element} = &{obj}{group.path}[{index}];")
+        render_items(
+            w,
+            group.element,
+            f"{element}->",
+            f"({const}uint8_t *){element}",
+            encode,
+            level + 1,
+        )
+        w.close()
+
+
+def render_declarations(name: str, tp_str: str) -> str:
+    return (
+        f"ptrdiff_t {name}_encode(const {tp_str} *src, void *buf, size_t size);\n"
+        f"ptrdiff_t {name}_decode({tp_str} *dst, const void *buf, size_t size);\n"
+    )
+
+
+def render_definitions(name: str, tp_str: str, size: int, items: list) -> str:
+    items = layout.merge_bytes(items)
+    sio = StringIO()
+
+    sio.write(f"COLUMN_ASSERT_SIZE({tp_str}, {size});\n")
+
+    w = CodeWriter()
+    w.line("uint8_t *p = (uint8_t *)buf;")
+    w.line("uint8_t *end = p + size;")
+    render_items(w, items, "src->", "(const uint8_t *)src", True)
+    w.line("return p - (uint8_t *)buf;")
+    sio.write(f"ptrdiff_t {name}_encode(const {tp_str} *src, void *buf, size_t size) {{\n")
+    sio.write(w.sio.getvalue())
+    sio.write("}\n")
+
+    w = CodeWriter()
+    w.line("const uint8_t *p = (const uint8_t *)buf;")
+    w.line("const uint8_t *end = p + size;")
+    render_items(w, items, "dst->", "(uint8_t *)dst", False)
+    w.line("return p - (const uint8_t *)buf;")
+    sio.write(f"ptrdiff_t {name}_decode({tp_str} *dst, const void *buf, size_t size) {{\n")
+    sio.write(w.sio.getvalue())
+    sio.write("}\n")
+
+    return sio.getvalue()
@@ -0,0 +1,77 @@
+"""
+gen_dispatch.py
+"""
+
+import dataclasses
+import re
+
+CMD_RE = re.compile(r"\bcmd\s*=\s*(\d+)")
+
+
+@dataclasses.dataclass
+class Command:
+    cmd: int
+    name: str
+    object_name: str
+    tp_str: str
+    location: str
+
+
+def parse_cmd(comment: str) -> int | None:
+    if not comment:
+        return None
+
+    match = CMD_RE.search(comment)
+    if not match:
+        return None
+    return int(match.group(1))
+
+
+def add_command(commands: dict[int, Command], command: Command):
+    other = commands.get(command.cmd)
+    if other:
+        raise Exception(
+            f"{command.location}: cmd {command.cmd} of {command.name}"
+            f" is already used by {other.name} at {other.location}"
+        )
+    commands[command.cmd] = command
+
+
+def check_dense(commands: dict[int, Command]) -> list[Command]:
+    ids = sorted(commands)
+    for prev, cmd in zip(ids, ids[1:]):
+        if cmd != prev + 1:
+            raise Exception(
+                f"cmd ids are not dense: nothing between {prev}"
+                f" ({commands[prev].name}) and {cmd} ({commands[cmd].name})"
+            )
+    return [commands[cmd] for cmd in ids]
+
+
+def render_declarations(name: str, commands: list[Command]) -> str:
+    lines = ["enum {"]
+    lines += [f"    {c.name}Cmd = {c.cmd}," for c in commands]
+    lines.append("};")
+    lines.append("")
+
+    # storage for any message of the table, see clDispatchMessage()
+    lines.append("typedef union {")
+    lines += [f"    {c.tp_str} {c.name};" for c in commands]
+    lines.append(f"}} {name}Message;")
+    lines.append("")
+
+    lines.append(f"extern clDispatch {name}Dispatch;")
+    return "\n".join(lines) + "\n"
+
+
+def render_definitions(name: str, commands: list[Command]) -> str:
+    lines = [f"static const clColumn *const {name}Columns[] = {{"]
+    lines += [f"    {c.object_name}," for c in commands]
+    lines.append("};")
+    lines.append(f"static clHandler {name}Handlers[{len(commands)}];")
+    lines.append(f"clDispatch {name}Dispatch = {{")
+    lines.append(
+        f"    {commands[0].cmd}, {len(commands)}, {name}Columns, {name}Handlers,"
+    )
+    lines.append("};")
+    return "\n".join(lines) + "\n"
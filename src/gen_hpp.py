@@ -0,0 +1,66 @@
+"""
+gen_hpp.py
+"""
+
+import re
+
+import layout
+
+
+def cpp_name(tp_str: str) -> str:
+    """the type without its struct/union keyword, to name members with"""
+    return re.sub(r"^(struct|union|enum)\s+", "", tp_str)
+
+
+def member_type(parent_cpp_str: str, field: str) -> str:
+    return f"decltype({cpp_name(parent_cpp_str)}::{field})"
+
+
+def render_field(kind: str, parent_cpp_str: str, field: str, len_field: str) -> str:
+    member = f"&{cpp_name(parent_cpp_str)}::{field}"
+
+    templates = {
+        layout.NUMBER: "Number",
+        layout.STRING: "String",
+        layout.FIXED_ARRAY: "FixedArray",
+        layout.OBJECT: "Object",
+        layout.UNION: "Union",
+    }
+
+    if kind == layout.FLEXIBLE_ARRAY:
+        return f"FlexibleArray<{member}, &{cpp_name(parent_cpp_str)}::{len_field}>"
+    return f"{templates[kind]}<{member}>"
+
+
+def render_tagged_union(
+    parent_cpp_str: str,
+    field: str,
+    tag: str,
+    cases: list[int],
+    members: list[tuple[str, str]],
+) -> str:
+    parent = cpp_name(parent_cpp_str)
+    head = f"TaggedUnion<&{parent}::{field}, &{parent}::{tag}"
+    return head + "".join(
+        f",\n          Case<{value}, {members[i][1]}>"
+        for value, i in enumerate(cases)
+        if i >= 0
+    ) + ">"
+
+
+def render_descriptor(
+    cpp_str: str, size: int, location: str, fields: list[tuple[str, str]]
+) -> str:
+    if not fields:
+        return ""
+
+    lines = [f"// {location}"]
+    lines.append(f"template <> struct Descriptor<{cpp_str}> {{")
+    lines.append("  static constexpr std::string_view names[] = {")
+    lines += [f'      "{name}",' for name, _ in fields]
+    lines.append("  };")
+    lines.append("  using fields = Fields<")
+    lines.append(",\n".join(f"      {field}" for _, field in fields) + ">;")
+    lines.append("};")
+    lines.append(f"static_assert(sizeof({cpp_str}) == {size}, \"{cpp_str}\");")
+    return "\n".join(lines) + "\n"
@@ -0,0 +1,51 @@
+"""
+gen_lookup.py
+"""
+
+MAX_SEED = 1 << 16
+
+
+def hash_name(name: bytes, seed: int) -> int:
+    # must match clHashName() in src/lookup.c
+    h = (2166136261 ^ seed) & 0xFFFFFFFF
+    for b in name:
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    h ^= h >> 15
+    h = (h * 0x2C1B3C6D) & 0xFFFFFFFF
+    h ^= h >> 12
+    return h
+
+
+def find_perfect_hash(names: list[str]) -> tuple[int, list[int]]:
+    encoded = [name.encode("UTF-8") for name in names]
+
+    num = 1
+    while num < len(names):
+        num *= 2
+
+    while True:
+        for seed in range(MAX_SEED):
+            slots = [-1] * num
+            for i, name in enumerate(encoded):
+                slot = hash_name(name, seed) & (num - 1)
+                if slots[slot] >= 0:
+                    break
+                slots[slot] = i
+            else:
+                return seed, slots
+        num *= 2
+
+
+def render_lookup(unique_name: str, names: list[str]) -> str:
+    seed, slots = find_perfect_hash(names)
+    slots_str = ", ".join(map(str, slots))
+
+    return (
+        f"static const int16_t {unique_name}Slots[] = {{{slots_str}}};\n"
+        f"static const clLookup {unique_name}Lookup = {{\n"
+        f"    .seed = {seed}u,\n"
+        f"    .num = {len(slots)},\n"
+        f"    .slots = {unique_name}Slots,\n"
+        f"}};\n"
+    )
@@ -0,0 +1,267 @@
+"""
+gen_packed.py
+"""
+
+import dataclasses
+from io import StringIO
+from clang.cindex import Cursor, CursorKind, TypeKind
+
+
+CACHE_LINE = 64
+
+SIGNED_TYPE = [
+    TypeKind.SCHAR,
+    TypeKind.SHORT,
+    TypeKind.INT,
+    TypeKind.LONG,
+    TypeKind.LONGLONG,
+]
+
+UNSIGNED_TYPE = [
+    TypeKind.UCHAR,
+    TypeKind.CHAR16,
+    TypeKind.CHAR32,
+    TypeKind.USHORT,
+    TypeKind.UINT,
+    TypeKind.ULONG,
+    TypeKind.ULONGLONG,
+]
+
+# how a field moves between a struct and its twin
+COPY = "COPY"
+OBJECT = "OBJECT"
+OBJECTS = "OBJECTS"
+
+
+@dataclasses.dataclass
+class Twin:
+    name: str  # of the struct, see twin_name()
+    size: int
+
+
+@dataclasses.dataclass
+class Field:
+    name: str
+    offset: int
+    size: int
+    align: int
+    # the declaration of the field in the twin, and its size there
+    decl: str
+    packed_size: int
+    move: str
+    # a number, not an array
+    scalar: bool = False
+    # the struct of the twin and count of OBJECT and OBJECTS fields
+    twin: str = ""
+    count: int = 1
+    # padding within the field, in nested structs and array elements
+    inner_padding: int = 0
+
+
+def twin_name(name: str) -> str:
+    return f"{name}_packed"
+
+
+def number_type(tp) -> str | None:
+    """a spelling of the number type TP that needs no header of the input"""
+
+    tp = tp.get_canonical()
+    if tp.kind == TypeKind.ENUM:
+        tp = tp.get_declaration().enum_type.get_canonical()
+
+    size = tp.get_size()
+    if tp.kind == TypeKind.BOOL:
+        return "bool"
+    if tp.kind in (TypeKind.CHAR_S, TypeKind.CHAR_U):
+        return "char"
+    if tp.kind == TypeKind.FLOAT:
+        return "float"
+    if tp.kind == TypeKind.DOUBLE:
+        return "double"
+    if size not in (1, 2, 4, 8):
+        return None
+    if tp.kind in SIGNED_TYPE:
+        return f"int{size * 8}_t"
+    if tp.kind in UNSIGNED_TYPE:
+        return f"uint{size * 8}_t"
+    return None
+
+
+def layout_key(declaration: Cursor) -> str:
+    return declaration.get_usr()
+
+
+def padding(declaration: Cursor) -> int:
+    """the padding bytes of a struct, those of the structs in it included"""
+
+    fields = collect_fields(declaration, {})
+    if fields is None:
+        return 0
+    own = declaration.type.get_size() - sum(f.size for f in fields)
+    return own + sum(f.inner_padding for f in fields)
+
+
+def collect_field(child: Cursor, twins: dict[str, Twin]) -> Field:
+    name = child.spelling
+    tp = child.type.get_canonical()
+    size = tp.get_size()
+    field = Field(
+        name=name,
+        offset=child.get_field_offsetof() // 8,
+        size=size,
+        align=tp.get_align(),
+        decl=f"uint8_t {name}[{size}]",
+        packed_size=size,
+        move=COPY,
+    )
+
+    element = tp
+    count = 1
+    if tp.kind == TypeKind.CONSTANTARRAY:
+        element = tp.get_array_element_type().get_canonical()
+        count = tp.get_array_size()
+    declaration = element.get_declaration()
+
+    if declaration.kind == CursorKind.STRUCT_DECL:
+        field.inner_padding = padding(declaration) * count
+        twin = twins.get(layout_key(declaration))
+        if twin:
+            field.twin = twin.name
+            field.count = count
+            field.packed_size = twin.size * count
+            # the alignment the twin keeps, if it is placed aligned
+            field.align = min(field.align, twin.size & -twin.size)
+            if tp.kind == TypeKind.CONSTANTARRAY:
+                field.move = OBJECTS
+                field.decl = f"struct {twin_name(twin.name)} {name}[{count}]"
+            else:
+                field.move = OBJECT
+                field.decl = f"struct {twin_name(twin.name)} {name}"
+        return field
+
+    # unions and anything else travel as their bytes
+    number = number_type(element) if element.kind != TypeKind.RECORD else None
+    if number and tp.kind == TypeKind.CONSTANTARRAY:
+        field.decl = f"{number} {name}[{count}]"
+    elif number:
+        field.decl = f"{number} {name}"
+        field.scalar = True
+    return field
+
+
+def collect_fields(declaration: Cursor, twins: dict[str, Twin]) -> list[Field] | None:
+    """the fields of a struct in memory order, or None when some have no name"""
+
+    fields = []
+    for child in declaration.get_children():
+        if child.kind != CursorKind.FIELD_DECL:
+            continue
+        if not child.spelling or child.is_bitfield():
+            return None
+        fields.append(collect_field(child, twins))
+    return fields
+
+
+def packed_order(fields: list[Field]) -> list[Field]:
+    """the fields by decreasing alignment, in memory order otherwise"""
+
+    return sorted(fields, key=lambda f: -f.align)
+
+
+def get_holes(fields: list[Field], size: int) -> list[tuple[int, int, str]]:
+    """the padding of a struct of SIZE bytes: offset, bytes and where"""
+
+    holes = []
+    end = 0
+    for f in fields:
+        if f.offset > end:
+            holes.append((end, f.offset - end, f"before {f.name}"))
+        end = max(end, f.offset + f.size)
+    if size > end:
+        holes.append((end, size - end, "at the end"))
+    return holes
+
+
+def count(n: int, what: str) -> str:
+    return f"{n} {what}" if n == 1 else f"{n} {what}s"
+
+
+def render_report(
+    location: str, tp_str: str, size: int, align: int, fields: list[Field] | None
+) -> str:
+    if fields is None:
+        return f"{location} {tp_str}: {size} bytes, unnamed members, not packed\n"
+
+    holes = get_holes(fields, size)
+    own = sum(n for _, n, _ in holes)
+    inner = sum(f.inner_padding for f in fields)
+    lines = (size + CACHE_LINE - 1) // CACHE_LINE
+    worst = (size + CACHE_LINE - min(align, CACHE_LINE) + CACHE_LINE - 1) // CACHE_LINE
+    packed = sum(f.packed_size for f in fields)
+
+    sio = StringIO()
+    sio.write(
+        f"{location} {tp_str}: {size} bytes, {own + inner} of padding"
+        f" ({own} here, {inner} in nested structs), "
+        f"{count(lines, 'cache line')} ({worst} at worst), {packed} packed\n"
+    )
+    for offset, n, where in holes:
+        sio.write(f"  {offset}: {count(n, 'byte')} {where}\n")
+    for f in fields:
+        first = f.offset // CACHE_LINE
+        last = (f.offset + f.size - 1) // CACHE_LINE
+        if f.scalar and first != last:
+            sio.write(f"  {f.offset}: {f.name} straddles a cache line\n")
+    return sio.getvalue()
+
+
+def render_declarations(name: str, tp_str: str, fields: list[Field]) -> str:
+    twin = twin_name(name)
+    sio = StringIO()
+
+    # no padding in between, and none after for dense arrays; the widest
+    # fields first keep the others aligned where the twin is
+    sio.write("#pragma pack(push, 1)\n")
+    sio.write(f"struct {twin} {{\n")
+    for f in packed_order(fields):
+        sio.write(f"  {f.decl};\n")
+    sio.write("};\n")
+    sio.write("#pragma pack(pop)\n")
+    sio.write(f"void {name}_pack(struct {twin} *dst, const {tp_str} *src);\n")
+    sio.write(f"void {name}_unpack({tp_str} *dst, const struct {twin} *src);\n")
+    return sio.getvalue()
+
+
+def render_move(f: Field, dst: str, src: str, fn: str) -> str:
+    if f.move == OBJECT:
+        return f"  {f.twin}_{fn}(&{dst}->{f.name}, &{src}->{f.name});\n"
+    if f.move == OBJECTS:
+        return (
+            f"  for (size_t i = 0; i < {f.count}; ++i) {{\n"
+            f"    {f.twin}_{fn}(&{dst}->{f.name}[i], &{src}->{f.name}[i]);\n"
+            "  }\n"
+        )
+    # the members of the twin may be unaligned
+    return f"  memcpy(&{dst}->{f.name}, &{src}->{f.name}, {f.size});\n"
+
+
+def render_definitions(name: str, tp_str: str, size: int, fields: list[Field]) -> str:
+    twin = twin_name(name)
+    sio = StringIO()
+    sio.write(
+        f"COLUMN_ASSERT_SIZE(struct {twin}, {sum(f.packed_size for f in fields)});\n"
+    )
+
+    sio.write(f"void {name}_pack(struct {twin} *dst, const {tp_str} *src) {{\n")
+    for f in packed_order(fields):
+        sio.write(render_move(f, "dst", "src", "pack"))
+    sio.write("}\n")
+
+    # the padding of DST is zeroed, for memcmp() and hashing
+    sio.write(f"void {name}_unpack({tp_str} *dst, const struct {twin} *src) {{\n")
+    for offset, n, _ in get_holes(fields, size):
+        sio.write(f"  memset((uint8_t *)dst + {offset}, 0, {n});\n")
+    for f in fields:
+        sio.write(render_move(f, "dst", "src", "unpack"))
+    sio.write("}\n")
+    return sio.getvalue()
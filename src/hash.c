@@ -0,0 +1,216 @@
+#include "program.h"
+
+// Hashing and equality walk the cl_WIRE_RAW program of a message, the mask
+// of its meaningful bytes: its OP_COPY runs are the fields that continue
+// each other in memory, without the padding between them, its strings end
+// at their terminator, its flexible arrays at their count and its tagged
+// unions hold the selected member only. Every span is hashed on its own,
+// 32 bytes at a time in four independent lanes, and folded into the hash of
+// the message.
+
+#define K0 0x9e3779b97f4a7c15u
+#define K1 0xbf58476d1ce4e5b9u
+#define K2 0x94d049bb133111ebu
+
+static inline uint64_t load64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t load32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t rotl(uint64_t v, int r) {
+  return v << r | v >> (64 - r);
+}
+
+// The finalizer of splitmix64.
+static inline uint64_t fmix(uint64_t h) {
+  h ^= h >> 30;
+  h *= K1;
+  h ^= h >> 27;
+  h *= K2;
+  return h ^ h >> 31;
+}
+
+static inline uint64_t round64(uint64_t h, uint64_t v) {
+  return rotl(h + v * K1, 31) * K0;
+}
+
+static uint64_t hashSpan(const uint8_t *p, size_t n) {
+  uint64_t h = K2 ^ (uint64_t)n;
+  if (n >= 32) {
+    uint64_t a = K0, b = K1, c = K2, d = K0 ^ K2;
+    const uint8_t *end = p + (n & ~(size_t)31);
+    for (; p < end; p += 32) {
+      a = round64(a, load64(p));
+      b = round64(b, load64(p + 8));
+      c = round64(c, load64(p + 16));
+      d = round64(d, load64(p + 24));
+    }
+    h ^= rotl(a, 1) + rotl(b, 7) + rotl(c, 12) + rotl(d, 18);
+    n &= 31;
+  }
+
+  for (; n >= 8; p += 8, n -= 8) {
+    h = round64(h, load64(p));
+  }
+  // the last 1 to 7 bytes in at most two loads, overlapping as needed
+  if (n >= 4) {
+    h = round64(h, load32(p) | (uint64_t)load32(p + n - 4) << 32);
+  } else if (n) {
+    h = round64(h, (uint64_t)p[0] | (uint64_t)p[n / 2] << 8 |
+                       (uint64_t)p[n - 1] << 16);
+  }
+  return fmix(h);
+}
+
+static int hashOps(const clProgram *program, int32_t begin, int32_t end,
+                   const uint8_t *base, uint64_t *h) {
+  const clProgramOp *ops = program->ops;
+  for (int32_t i = begin; i < end; ++i) {
+    const clProgramOp *op = &ops[i];
+    const uint8_t *src = base + op->offset;
+
+    switch (op->op) {
+    case OP_COPY:
+      *h = (*h ^ hashSpan(src, (size_t)op->n)) * K0;
+      break;
+
+    case OP_STRING: {
+      int32_t len = clStringLength(src, op->width, op->n);
+      *h = (*h ^ hashSpan(src, (size_t)len * op->width)) * K0;
+      break;
+    }
+
+    case OP_ARRAY: {
+      int64_t n = clProgramCount(op, base);
+      if (n < 0) {
+        return (int)n;
+      }
+      if (op->bulk) {
+        *h = (*h ^ hashSpan(src, (size_t)n * op->width)) * K0;
+      } else {
+        for (int64_t k = 0; k < n; ++k) {
+          int err = hashOps(program, i + 1, i + 1 + op->sub,
+                            src + k * op->width, h);
+          if (err) {
+            return err;
+          }
+        }
+      }
+      i += op->sub;
+      break;
+    }
+
+    case OP_UNION: {
+      int32_t m = clProgramMember(program, op, base);
+      if (m >= 0) {
+        int err = hashOps(program, m + 1, m + 1 + ops[m].sub, base, h);
+        if (err) {
+          return err;
+        }
+      }
+      i += op->sub;
+      break;
+    }
+    }
+  }
+  return 0;
+}
+
+// Returns 1 when A and B are equal over the ops [BEGIN, END), 0 when not,
+// or cl_ERR_CAPACITY.
+static int equalOps(const clProgram *program, int32_t begin, int32_t end,
+                    const uint8_t *a, const uint8_t *b) {
+  const clProgramOp *ops = program->ops;
+  for (int32_t i = begin; i < end; ++i) {
+    const clProgramOp *op = &ops[i];
+    const uint8_t *x = a + op->offset;
+    const uint8_t *y = b + op->offset;
+
+    switch (op->op) {
+    case OP_COPY:
+      if (memcmp(x, y, (size_t)op->n)) {
+        return 0;
+      }
+      break;
+
+    case OP_STRING: {
+      int32_t len = clStringLength(x, op->width, op->n);
+      if (len != clStringLength(y, op->width, op->n) ||
+          memcmp(x, y, (size_t)len * op->width)) {
+        return 0;
+      }
+      break;
+    }
+
+    case OP_ARRAY: {
+      // the counts precede the array and have already been compared
+      int64_t n = clProgramCount(op, a);
+      if (n < 0) {
+        return (int)n;
+      }
+      if (op->bulk) {
+        if (memcmp(x, y, (size_t)n * op->width)) {
+          return 0;
+        }
+      } else {
+        for (int64_t k = 0; k < n; ++k) {
+          int eq = equalOps(program, i + 1, i + 1 + op->sub,
+                            x + k * op->width, y + k * op->width);
+          if (eq <= 0) {
+            return eq;
+          }
+        }
+      }
+      i += op->sub;
+      break;
+    }
+
+    case OP_UNION: {
+      // and so do the tags
+      int32_t m = clProgramMember(program, op, a);
+      if (m >= 0) {
+        int eq = equalOps(program, m + 1, m + 1 + ops[m].sub, a, b);
+        if (eq <= 0) {
+          return eq;
+        }
+      }
+      i += op->sub;
+      break;
+    }
+    }
+  }
+  return 1;
+}
+
+int clHash(uint64_t *out, const clColumn *column, const void *src) {
+  const clProgram *program;
+  int err = clProgramFind(&program, column, cl_WIRE_RAW);
+  if (err) {
+    return err;
+  }
+
+  uint64_t h = K0;
+  err = hashOps(program, 0, program->num, (const uint8_t *)src, &h);
+  if (err) {
+    return err;
+  }
+  *out = fmix(h);
+  return 0;
+}
+
+int clEqual(const clColumn *column, const void *a, const void *b) {
+  const clProgram *program;
+  int err = clProgramFind(&program, column, cl_WIRE_RAW);
+  if (err) {
+    return err;
+  }
+  return equalOps(program, 0, program->num, (const uint8_t *)a,
+                  (const uint8_t *)b);
+}
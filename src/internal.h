@@ -0,0 +1,329 @@
+#pragma once
+
+#include <columns.h>
+#include <string.h>
+
+#include "swap.h"
+#include "varint.h"
+
+static inline bool clIsNumber(int tp) { return tp >= cl_INT8 && tp <= cl_BOOL; }
+
+static inline bool clIsSigned(int tp) {
+  return tp >= cl_INT8 && tp <= cl_INT256;
+}
+
+static inline bool clIsFloat(int tp) {
+  return tp >= cl_FLOAT8 && tp <= cl_FLOAT256;
+}
+
+// Whether integers of TP and SIZE travel as (zigzag) varints in WIRE.
+static inline bool clIsVarint(int wire, int tp, int32_t size) {
+  return wire == cl_WIRE_COMPACT && size >= 2 && size <= 8 &&
+         (clIsSigned(tp) || (tp >= cl_UINT8 && tp <= cl_UINT256));
+}
+
+static inline int64_t clLoadInteger(const uint8_t *p, int tp, int32_t size) {
+  switch (size) {
+  case 1: {
+    uint8_t v;
+    memcpy(&v, p, sizeof(v));
+    return clIsSigned(tp) ? (int64_t)(int8_t)v : (int64_t)v;
+  }
+  case 2: {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return clIsSigned(tp) ? (int64_t)(int16_t)v : (int64_t)v;
+  }
+  case 4: {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return clIsSigned(tp) ? (int64_t)(int32_t)v : (int64_t)v;
+  }
+  case 8: {
+    int64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  default:
+    return 0;
+  }
+}
+
+static inline void clStoreInteger(uint8_t *p, int32_t size, int64_t v) {
+  switch (size) {
+  case 1: {
+    uint8_t x = (uint8_t)v;
+    memcpy(p, &x, sizeof(x));
+    break;
+  }
+  case 2: {
+    uint16_t x = (uint16_t)v;
+    memcpy(p, &x, sizeof(x));
+    break;
+  }
+  case 4: {
+    uint32_t x = (uint32_t)v;
+    memcpy(p, &x, sizeof(x));
+    break;
+  }
+  case 8:
+    memcpy(p, &v, sizeof(v));
+    break;
+  }
+}
+
+// Whether V, as read by clLoadInteger(), fits a field of SIZE bytes.
+static inline bool clFitsInteger(int64_t v, int tp, int32_t size) {
+  if (size >= 8) {
+    return true;
+  }
+
+  int bits = size * 8;
+  if (clIsSigned(tp)) {
+    return v >= -((int64_t)1 << (bits - 1)) && v < ((int64_t)1 << (bits - 1));
+  }
+  return (uint64_t)v < ((uint64_t)1 << bits);
+}
+
+// Reads the length field of ARRAY out of the enclosing object at BASE.
+static inline int64_t clLoadCount(const clFlexibleArray *array,
+                                  const uint8_t *base) {
+  int64_t count =
+      clLoadInteger(base + array->len.offset, array->len.tp, array->len.size);
+  if (count < 0 || count > array->capacity) {
+    return cl_ERR_CAPACITY;
+  }
+  return count;
+}
+
+// Returns the member of the tagged union COLUMN that its tag field in the
+// enclosing object at BASE selects, or NULL for none.
+static inline const clColumn *clUnionMember(const clColumn *column,
+                                            const uint8_t *base) {
+  const clUnion *u = &column->via_union;
+  int64_t tag = clLoadInteger(base + u->tag.offset, u->tag.tp, u->tag.size);
+
+  // one compare and one load, whatever the number of members
+  if ((uint64_t)tag >= (uint64_t)u->num_cases) {
+    return NULL;
+  }
+  int16_t i = u->cases[tag];
+  return i < 0 ? NULL : &u->columns[i];
+}
+
+static inline bool clIsTagged(const clColumn *column) {
+  return column->tp == cl_UNION && column->via_union.num_cases > 0;
+}
+
+static inline int32_t clElementSize(const clColumn *column, int32_t capacity) {
+  return capacity > 0 ? column->size / capacity : 0;
+}
+
+// Returns the number of elements to transfer for a string: the characters
+// plus the terminator, or CAPACITY when the string fills the whole array.
+static inline int32_t clStringLength(const uint8_t *p, int32_t element,
+                                     int32_t capacity) {
+  if (element == 1) {
+    const uint8_t *nul = (const uint8_t *)memchr(p, 0, (size_t)capacity);
+    return nul ? (int32_t)(nul - p) + 1 : capacity;
+  }
+
+  static const uint8_t zero[16];
+  for (int32_t i = 0; i < capacity; ++i) {
+    if (memcmp(p + (size_t)i * element, zero, (size_t)element) == 0) {
+      return i + 1;
+    }
+  }
+  return capacity;
+}
+
+// Whether the LEN elements returned by clStringLength() end with a terminator.
+static inline bool clIsTerminated(const uint8_t *p, int32_t element,
+                                  int32_t len) {
+  static const uint8_t zero[16];
+  return len > 0 &&
+         memcmp(p + (size_t)(len - 1) * element, zero, (size_t)element) == 0;
+}
+
+typedef struct {
+  uint8_t *buf; // NULL when only measuring
+  size_t pos;
+  size_t size;
+  int wire;
+
+  // Set by clGatherEncode(): BUF is the arena, and byte runs are held in RUN
+  // until they end, to be referenced in place or copied, see gather.c.
+  clGather *gather;
+  const uint8_t *run;
+  size_t run_len;
+} clWriter;
+
+int clGatherRun(clWriter *w, const void *src, size_t n);
+int clGatherSettle(clWriter *w);
+
+typedef struct {
+  const uint8_t *buf;
+  size_t pos;
+  size_t size;
+  int wire;
+} clReader;
+
+static inline int clWriteBytes(clWriter *w, const void *src, size_t n) {
+  if (w->gather) {
+    return clGatherRun(w, src, n);
+  }
+  if (w->buf) {
+    if (w->size - w->pos < n) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(w->buf + w->pos, src, n);
+  }
+  w->pos += n;
+  return 0;
+}
+
+static inline int clWriteZeros(clWriter *w, size_t n) {
+  if (w->gather) {
+    int err = clGatherSettle(w);
+    if (err) {
+      return err;
+    }
+  }
+  if (w->buf) {
+    if (w->size - w->pos < n) {
+      return cl_ERR_BUFFER;
+    }
+    memset(w->buf + w->pos, 0, n);
+  }
+  w->pos += n;
+  return 0;
+}
+
+static inline int clReadBytes(clReader *r, void *dst, size_t n) {
+  if (r->size - r->pos < n) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(dst, r->buf + r->pos, n);
+  r->pos += n;
+  return 0;
+}
+
+// Write (read) N elements of WIDTH bytes with the bytes of each reversed,
+// for cl_WIRE_SWAPPED. The swapped copy is never referenced by a gather.
+static inline int clWriteSwapped(clWriter *w, const void *src, size_t n,
+                                 int32_t width) {
+  if (width == 1) {
+    return clWriteBytes(w, src, n);
+  }
+  if (w->gather) {
+    int err = clGatherSettle(w);
+    if (err) {
+      return err;
+    }
+  }
+
+  size_t size = n * (size_t)width;
+  if (w->buf) {
+    if (w->size - w->pos < size) {
+      return cl_ERR_BUFFER;
+    }
+    clSwapBytes(w->buf + w->pos, (const uint8_t *)src, n, width);
+  }
+  w->pos += size;
+  return 0;
+}
+
+static inline int clReadSwapped(clReader *r, void *dst, size_t n,
+                                int32_t width) {
+  int err = clReadBytes(r, dst, n * (size_t)width);
+  if (!err && width > 1) {
+    clSwapBytes((uint8_t *)dst, (const uint8_t *)dst, n, width);
+  }
+  return err;
+}
+
+static inline int clWriteVarint(clWriter *w, uint64_t v) {
+  if (w->gather) {
+    int err = clGatherSettle(w);
+    if (err) {
+      return err;
+    }
+  }
+  if (!w->buf) {
+    w->pos += clVarintSize(v);
+    return 0;
+  }
+
+  size_t n = clPutVarint(w->buf + w->pos, w->size - w->pos, v);
+  if (!n) {
+    return cl_ERR_BUFFER;
+  }
+  w->pos += n;
+  return 0;
+}
+
+static inline int clReadVarint(clReader *r, uint64_t *v) {
+  size_t n = clGetVarint(r->buf + r->pos, r->size - r->pos, v);
+  if (!n) {
+    return r->size - r->pos < CL_VARINT_MAX ? cl_ERR_BUFFER : cl_ERR_VALUE;
+  }
+  r->pos += n;
+  return 0;
+}
+
+#ifdef CL_STATS
+
+// Returns the start of a call, in ns.
+uint64_t clStatsNow(void);
+
+// Counts a call of the cl_STATS_* OP on COLUMN started at START that
+// returned RESULT: its encoded size or a cl_ERR_* code.
+void clStatsRecord(const clColumn *column, int op, uint64_t start,
+                   ptrdiff_t result);
+
+// Counts N messages of COLUMN that failed clValidate().
+void clStatsInvalid(const clColumn *column, ptrdiff_t n);
+
+#else
+
+static inline uint64_t clStatsNow(void) { return 0; }
+
+static inline void clStatsRecord(const clColumn *column, int op,
+                                 uint64_t start, ptrdiff_t result) {
+  (void)column;
+  (void)op;
+  (void)start;
+  (void)result;
+}
+
+static inline void clStatsInvalid(const clColumn *column, ptrdiff_t n) {
+  (void)column;
+  (void)n;
+}
+
+#endif
+
+// Walks COLUMN of the object at BASE in the cl_WIRE_* format of W (R).
+int clEncodeColumn(const clColumn *column, const uint8_t *base, clWriter *w);
+int clDecodeColumn(const clColumn *column, uint8_t *base, clReader *r);
+
+// Write (read) a string of CAPACITY elements of ELEMENT bytes at SRC (DST).
+int clEncodeString(const uint8_t *src, int32_t element, int32_t capacity,
+                   clWriter *w);
+int clDecodeString(uint8_t *dst, int32_t element, int32_t capacity,
+                   clReader *r);
+
+// Run PROGRAM over the object at SRC (DST) in its cl_WIRE_* format, which W
+// (R) must have.
+int clProgramWrite(const clProgram *program, const uint8_t *src, clWriter *w);
+int clProgramRead(const clProgram *program, uint8_t *dst, clReader *r);
+
+// Drops the cached programs of every thread, on its next clProgramFind().
+void clProgramInvalidate(void);
+// Returns the count of clProgramInvalidate() calls, for other caches keyed
+// by the address of a descriptor.
+uint64_t clProgramEpoch(void);
+
+// Encodes the message SRC of COLUMN with W, through its cached program when
+// COLUMN is an object.
+int clEncodeMessage(const clColumn *column, const void *src, clWriter *w);
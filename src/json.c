@@ -0,0 +1,1350 @@
+#define _POSIX_C_SOURCE 200809L // newlocale, uselocale
+
+#include "internal.h"
+
+#include <locale.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+// Objects map to JSON objects keyed by clColumn.name, arrays to JSON arrays
+// (flexible arrays up to their length field), strings to JSON strings,
+// tagged unions to an object of their selected member (null for none) and
+// untagged unions, which have no meaningful member to print, to a hex string
+// of their bytes. Non-finite floats are written as null.
+
+#define MAX_DEPTH 64
+#define MAX_NUMBER 512 // characters of a number, any double written out fits
+#define ONES 0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+// Returns a mask with the high bit set in every byte of V that is a '"',
+// a '\\' or a control character. Bits above the lowest hit may be false
+// positives, the lowest one is exact.
+static inline uint64_t specialBytes(uint64_t v) {
+  uint64_t quote = v ^ (ONES * '"');
+  uint64_t slash = v ^ (ONES * '\\');
+  return ((quote - ONES) & ~quote & HIGHS) | ((slash - ONES) & ~slash & HIGHS) |
+         ((v - ONES * 0x20) & ~v & HIGHS);
+}
+
+// Returns the length of the leading run of P that needs no escaping.
+static size_t plainPrefix(const uint8_t *p, size_t len) {
+  size_t i = 0;
+#if CL_VARINT_WORDS
+  for (; i + 8 <= len; i += 8) {
+    uint64_t v;
+    memcpy(&v, p + i, sizeof(v));
+    uint64_t hits = specialBytes(v);
+    if (hits) {
+      return i + (size_t)__builtin_ctzll(hits) / 8;
+    }
+  }
+#endif
+  for (; i < len; ++i) {
+    if (p[i] == '"' || p[i] == '\\' || p[i] < 0x20) {
+      break;
+    }
+  }
+  return i;
+}
+
+static int grow(clBuffer *out, size_t n) {
+  if (out->capacity - out->size >= n) {
+    return 0;
+  }
+
+  size_t capacity = out->capacity ? out->capacity : 256;
+  while (capacity - out->size < n) {
+    if (capacity > SIZE_MAX / 2) {
+      return cl_ERR_MEMORY;
+    }
+    capacity *= 2;
+  }
+
+  char *data = (char *)realloc(out->data, capacity);
+  if (!data) {
+    return cl_ERR_MEMORY;
+  }
+  out->data = data;
+  out->capacity = capacity;
+  return 0;
+}
+
+static int put(clBuffer *out, const void *src, size_t n) {
+  int err = grow(out, n);
+  if (err) {
+    return err;
+  }
+  memcpy(out->data + out->size, src, n);
+  out->size += n;
+  return 0;
+}
+
+static int putChar(clBuffer *out, char c) { return put(out, &c, 1); }
+
+static const char digits[] = "00010203040506070809"
+                             "10111213141516171819"
+                             "20212223242526272829"
+                             "30313233343536373839"
+                             "40414243444546474849"
+                             "50515253545556575859"
+                             "60616263646566676869"
+                             "70717273747576777879"
+                             "80818283848586878889"
+                             "90919293949596979899";
+
+// Writes V backwards ending at END, two digits at a time.
+static char *formatUnsigned(char *end, uint64_t v) {
+  while (v >= 100) {
+    end -= 2;
+    memcpy(end, digits + (v % 100) * 2, 2);
+    v /= 100;
+  }
+  if (v >= 10) {
+    end -= 2;
+    memcpy(end, digits + v * 2, 2);
+  } else {
+    *--end = (char)('0' + v);
+  }
+  return end;
+}
+
+// Floats are printed with the Grisu2 algorithm of Florian Loitsch, "Printing
+// Floating-Point Numbers Quickly and Accurately with Integers": V and the
+// bounds of the values that read back to it are scaled by a cached power of
+// ten into 64-bit fixed point, and digits are generated until the number
+// falls between the bounds. The digits always read back to V and are the
+// shortest that do for all but a few inputs.
+
+typedef struct {
+  uint64_t f;
+  int e; // V = F * 2^E
+} clFp;
+
+typedef struct {
+  uint64_t f;
+  int e;
+  int k; // F * 2^E approximates 10^K
+} clCachedPower;
+
+// 10^K rounded to 64 bits, for K from -300 to 324 in steps of 8.
+static const clCachedPower kPowers[] = {
+    {0xab70fe17c79ac6cau, -1060, -300},
+    {0xff77b1fcbebcdc4fu, -1034, -292},
+    {0xbe5691ef416bd60cu, -1007, -284},
+    {0x8dd01fad907ffc3cu, -980, -276},
+    {0xd3515c2831559a83u, -954, -268},
+    {0x9d71ac8fada6c9b5u, -927, -260},
+    {0xea9c227723ee8bcbu, -901, -252},
+    {0xaecc49914078536du, -874, -244},
+    {0x823c12795db6ce57u, -847, -236},
+    {0xc21094364dfb5637u, -821, -228},
+    {0x9096ea6f3848984fu, -794, -220},
+    {0xd77485cb25823ac7u, -768, -212},
+    {0xa086cfcd97bf97f4u, -741, -204},
+    {0xef340a98172aace5u, -715, -196},
+    {0xb23867fb2a35b28eu, -688, -188},
+    {0x84c8d4dfd2c63f3bu, -661, -180},
+    {0xc5dd44271ad3cdbau, -635, -172},
+    {0x936b9fcebb25c996u, -608, -164},
+    {0xdbac6c247d62a584u, -582, -156},
+    {0xa3ab66580d5fdaf6u, -555, -148},
+    {0xf3e2f893dec3f126u, -529, -140},
+    {0xb5b5ada8aaff80b8u, -502, -132},
+    {0x87625f056c7c4a8bu, -475, -124},
+    {0xc9bcff6034c13053u, -449, -116},
+    {0x964e858c91ba2655u, -422, -108},
+    {0xdff9772470297ebdu, -396, -100},
+    {0xa6dfbd9fb8e5b88fu, -369, -92},
+    {0xf8a95fcf88747d94u, -343, -84},
+    {0xb94470938fa89bcfu, -316, -76},
+    {0x8a08f0f8bf0f156bu, -289, -68},
+    {0xcdb02555653131b6u, -263, -60},
+    {0x993fe2c6d07b7facu, -236, -52},
+    {0xe45c10c42a2b3b06u, -210, -44},
+    {0xaa242499697392d3u, -183, -36},
+    {0xfd87b5f28300ca0eu, -157, -28},
+    {0xbce5086492111aebu, -130, -20},
+    {0x8cbccc096f5088ccu, -103, -12},
+    {0xd1b71758e219652cu, -77, -4},
+    {0x9c40000000000000u, -50, 4},
+    {0xe8d4a51000000000u, -24, 12},
+    {0xad78ebc5ac620000u, 3, 20},
+    {0x813f3978f8940984u, 30, 28},
+    {0xc097ce7bc90715b3u, 56, 36},
+    {0x8f7e32ce7bea5c70u, 83, 44},
+    {0xd5d238a4abe98068u, 109, 52},
+    {0x9f4f2726179a2245u, 136, 60},
+    {0xed63a231d4c4fb27u, 162, 68},
+    {0xb0de65388cc8ada8u, 189, 76},
+    {0x83c7088e1aab65dbu, 216, 84},
+    {0xc45d1df942711d9au, 242, 92},
+    {0x924d692ca61be758u, 269, 100},
+    {0xda01ee641a708deau, 295, 108},
+    {0xa26da3999aef774au, 322, 116},
+    {0xf209787bb47d6b85u, 348, 124},
+    {0xb454e4a179dd1877u, 375, 132},
+    {0x865b86925b9bc5c2u, 402, 140},
+    {0xc83553c5c8965d3du, 428, 148},
+    {0x952ab45cfa97a0b3u, 455, 156},
+    {0xde469fbd99a05fe3u, 481, 164},
+    {0xa59bc234db398c25u, 508, 172},
+    {0xf6c69a72a3989f5cu, 534, 180},
+    {0xb7dcbf5354e9beceu, 561, 188},
+    {0x88fcf317f22241e2u, 588, 196},
+    {0xcc20ce9bd35c78a5u, 614, 204},
+    {0x98165af37b2153dfu, 641, 212},
+    {0xe2a0b5dc971f303au, 667, 220},
+    {0xa8d9d1535ce3b396u, 694, 228},
+    {0xfb9b7cd9a4a7443cu, 720, 236},
+    {0xbb764c4ca7a44410u, 747, 244},
+    {0x8bab8eefb6409c1au, 774, 252},
+    {0xd01fef10a657842cu, 800, 260},
+    {0x9b10a4e5e9913129u, 827, 268},
+    {0xe7109bfba19c0c9du, 853, 276},
+    {0xac2820d9623bf429u, 880, 284},
+    {0x80444b5e7aa7cf85u, 907, 292},
+    {0xbf21e44003acdd2du, 933, 300},
+    {0x8e679c2f5e44ff8fu, 960, 308},
+    {0xd433179d9c8cb841u, 986, 316},
+    {0x9e19db92b4e31ba9u, 1013, 324},
+};
+
+static clFp fpSub(clFp x, clFp y) { return (clFp){x.f - y.f, x.e}; }
+
+// The upper 64 bits of the product, rounded.
+static clFp fpMul(clFp x, clFp y) {
+  uint64_t a = x.f >> 32, b = x.f & 0xffffffffu;
+  uint64_t c = y.f >> 32, d = y.f & 0xffffffffu;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t mid = (bd >> 32) + (ad & 0xffffffffu) + (bc & 0xffffffffu) +
+                 (1u << 31);
+  return (clFp){ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64};
+}
+
+static clFp fpNormalize(clFp x) {
+  int shift = __builtin_clzll(x.f);
+  return (clFp){x.f << shift, x.e - shift};
+}
+
+// V and the midpoints to its neighbours, LO and HI, with the exponent of
+// HI normalized. BITS holds a float of PRECISION bits of mantissa, the
+// hidden one included, and BIAS.
+static void fpBounds(uint64_t bits, int precision, int bias, clFp *v, clFp *lo,
+                     clFp *hi) {
+  uint64_t hidden = (uint64_t)1 << (precision - 1);
+  uint64_t f = bits & (hidden - 1);
+  int e = (int)(bits >> (precision - 1));
+
+  *v = e ? (clFp){f + hidden, e - bias} : (clFp){f, 1 - bias};
+  *hi = fpNormalize((clFp){2 * v->f + 1, v->e - 1});
+  // the neighbour below a power of two is closer
+  *lo = f == 0 && e > 1 ? (clFp){4 * v->f - 1, v->e - 2}
+                        : (clFp){2 * v->f - 1, v->e - 1};
+  lo->f <<= lo->e - hi->e;
+  lo->e = hi->e;
+  *v = fpNormalize(*v);
+}
+
+// Returns the cached power that brings a number of binary exponent E into
+// [-60, -32].
+static const clCachedPower *cachedPower(int e) {
+  int f = -61 - e;
+  int k = f * 78913 / (1 << 18) + (f > 0); // ceil(f * log10(2))
+  return &kPowers[(300 + k + 7) / 8];
+}
+
+// Moves the last digit of BUF toward the scaled value, at DIST below the
+// upper bound, while it stays within DELTA of that bound.
+static void grisuRound(char *buf, int len, uint64_t dist, uint64_t delta,
+                       uint64_t rest, uint64_t ten) {
+  while (rest < dist && delta - rest >= ten &&
+         (rest + ten < dist || dist - rest > rest + ten - dist)) {
+    --buf[len - 1];
+    rest += ten;
+  }
+}
+
+// Writes the digits of W, with LO < W < HI, to BUF; the number is the
+// digits times 10^*EXP. Returns their count.
+static int grisuDigits(char *buf, int *exp, clFp lo, clFp w, clFp hi) {
+  uint64_t delta = fpSub(hi, lo).f;
+  uint64_t dist = fpSub(hi, w).f;
+  int shift = -hi.e;
+  uint64_t one = (uint64_t)1 << shift;
+  uint32_t p1 = (uint32_t)(hi.f >> shift); // the integral part
+  uint64_t p2 = hi.f & (one - 1);          // and the fraction
+
+  uint32_t pow10 = 1;
+  int n = 1;
+  while (n < 10 && p1 / pow10 >= 10) {
+    pow10 *= 10;
+    ++n;
+  }
+
+  int len = 0;
+  while (n > 0) {
+    buf[len++] = (char)('0' + p1 / pow10);
+    p1 %= pow10;
+    --n;
+    uint64_t rest = ((uint64_t)p1 << shift) + p2;
+    if (rest <= delta) {
+      *exp += n;
+      grisuRound(buf, len, dist, delta, rest, (uint64_t)pow10 << shift);
+      return len;
+    }
+    pow10 /= 10;
+  }
+
+  for (;;) {
+    p2 *= 10;
+    buf[len++] = (char)('0' + (p2 >> shift));
+    p2 &= one - 1;
+    delta *= 10;
+    dist *= 10;
+    --*exp;
+    if (p2 <= delta) {
+      break;
+    }
+  }
+  grisuRound(buf, len, dist, delta, p2, one);
+  return len;
+}
+
+// Writes a positive finite V of PRECISION bits in the layout of %.Ng, where
+// N is the digit count but at least MIN.
+static int formatFloat(char *buf, uint64_t bits, int precision, int bias,
+                       int min) {
+  clFp v, lo, hi;
+  fpBounds(bits, precision, bias, &v, &lo, &hi);
+  const clCachedPower *c = cachedPower(hi.e);
+  clFp scale = {c->f, c->e};
+  clFp w = fpMul(v, scale);
+  lo = fpMul(lo, scale);
+  hi = fpMul(hi, scale);
+  // the products are off by up to one unit either way
+  ++lo.f;
+  --hi.f;
+
+  char decimals[20];
+  int exp = -c->k;
+  int len = grisuDigits(decimals, &exp, lo, w, hi);
+  int x = len + exp - 1; // the exponent of the first digit
+  char *p = buf;
+
+  if (x < -4 || x >= (len > min ? len : min)) {
+    *p++ = decimals[0];
+    if (len > 1) {
+      *p++ = '.';
+      memcpy(p, decimals + 1, (size_t)len - 1);
+      p += len - 1;
+    }
+    *p++ = 'e';
+    *p++ = x < 0 ? '-' : '+';
+    int ax = x < 0 ? -x : x;
+    if (ax >= 100) {
+      *p++ = (char)('0' + ax / 100);
+    }
+    memcpy(p, digits + ax % 100 * 2, 2);
+    return (int)(p + 2 - buf);
+  }
+
+  if (x < 0) {
+    memcpy(p, "0.0000", (size_t)(1 - x));
+    p += 1 - x;
+    memcpy(p, decimals, (size_t)len);
+    return (int)(p + len - buf);
+  }
+  if (len <= x + 1) {
+    memcpy(p, decimals, (size_t)len);
+    memset(p + len, '0', (size_t)(x + 1 - len));
+    return (int)(p + x + 1 - buf);
+  }
+  memcpy(p, decimals, (size_t)x + 1);
+  p += x + 1;
+  *p++ = '.';
+  memcpy(p, decimals + x + 1, (size_t)(len - x - 1));
+  return (int)(p + len - x - 1 - buf);
+}
+
+static int encodeNumber(int tp, int32_t size, const uint8_t *src,
+                        clBuffer *out) {
+  char buf[32];
+  char *end = buf + sizeof(buf);
+  char *begin;
+
+  if (tp == cl_BOOL) {
+    return *src ? put(out, "true", 4) : put(out, "false", 5);
+  }
+
+  if (tp == cl_FLOAT32 || tp == cl_FLOAT64) {
+    // the bits of the float, of WIDTH bits with PRECISION of mantissa
+    uint64_t bits;
+    int width, precision, bias, min;
+    if (size == 4) {
+      uint32_t u;
+      memcpy(&u, src, sizeof(u));
+      bits = u;
+      width = 32;
+      precision = 24;
+      bias = 150;
+      min = 6;
+    } else if (size == 8) {
+      memcpy(&bits, src, sizeof(bits));
+      width = 64;
+      precision = 53;
+      bias = 1075;
+      min = 15;
+    } else {
+      return cl_ERR_TYPE;
+    }
+
+    uint64_t sign = (uint64_t)1 << (width - 1);
+    uint64_t inf = (((uint64_t)1 << (width - precision)) - 1)
+                   << (precision - 1);
+    if ((bits & ~sign) >= inf) {
+      return put(out, "null", 4);
+    }
+
+    char *p = buf;
+    if (bits & sign) {
+      *p++ = '-';
+    }
+    bits &= ~sign;
+    int n = 1;
+    if (bits) {
+      n = formatFloat(p, bits, precision, bias, min);
+    } else {
+      *p = '0';
+    }
+    return put(out, buf, (size_t)(p - buf + n));
+  }
+
+  if (clIsFloat(tp) || size < 1 || size > 8 || (size & (size - 1))) {
+    return cl_ERR_TYPE;
+  }
+
+  int64_t v = clLoadInteger(src, tp, size);
+  if (clIsSigned(tp) && v < 0) {
+    begin = formatUnsigned(end, 0 - (uint64_t)v);
+    *--begin = '-';
+  } else {
+    begin = formatUnsigned(end, (uint64_t)v);
+  }
+  return put(out, begin, (size_t)(end - begin));
+}
+
+static int encodeString(const uint8_t *p, size_t len, clBuffer *out) {
+  static const char hex[] = "0123456789abcdef";
+
+  int err = putChar(out, '"');
+  while (!err && len) {
+    size_t n = plainPrefix(p, len);
+    err = put(out, p, n);
+    p += n;
+    len -= n;
+    if (err || !len) {
+      break;
+    }
+
+    char esc[6] = {'\\', 0, '0', '0', 0, 0};
+    size_t k = 2;
+    switch (*p) {
+    case '"':
+    case '\\':
+      esc[1] = (char)*p;
+      break;
+    case '\n':
+      esc[1] = 'n';
+      break;
+    case '\r':
+      esc[1] = 'r';
+      break;
+    case '\t':
+      esc[1] = 't';
+      break;
+    case '\b':
+      esc[1] = 'b';
+      break;
+    case '\f':
+      esc[1] = 'f';
+      break;
+    default:
+      esc[1] = 'u';
+      esc[4] = hex[*p >> 4];
+      esc[5] = hex[*p & 15];
+      k = 6;
+      break;
+    }
+    err = put(out, esc, k);
+    ++p;
+    --len;
+  }
+  return err ? err : putChar(out, '"');
+}
+
+static int encodeColumn(const clColumn *column, const uint8_t *base,
+                        clBuffer *out);
+
+static int encodeArray(const clColumn *element, int tp, int32_t stride,
+                       int64_t count, const uint8_t *src, clBuffer *out) {
+  int err = putChar(out, '[');
+  for (int64_t i = 0; !err && i < count; ++i) {
+    if (i) {
+      err = putChar(out, ',');
+    }
+    if (!err) {
+      err = element ? encodeColumn(element, src + i * stride, out)
+                    : encodeNumber(tp, stride, src + i * stride, out);
+    }
+  }
+  return err ? err : putChar(out, ']');
+}
+
+static int encodeColumns(const clColumn *columns, int32_t num,
+                         const uint8_t *base, clBuffer *out) {
+  int err = putChar(out, '{');
+  for (int32_t i = 0; !err && i < num; ++i) {
+    const clColumn *column = &columns[i];
+    err = grow(out, (size_t)column->name.len + 4);
+    if (err) {
+      break;
+    }
+
+    char *p = out->data + out->size;
+    if (i) {
+      *p++ = ',';
+    }
+    *p++ = '"';
+    memcpy(p, column->name.string, (size_t)column->name.len);
+    p += column->name.len;
+    *p++ = '"';
+    *p++ = ':';
+    out->size = (size_t)(p - out->data);
+
+    err = encodeColumn(column, base, out);
+  }
+  return err ? err : putChar(out, '}');
+}
+
+static int encodeColumn(const clColumn *column, const uint8_t *base,
+                        clBuffer *out) {
+  const uint8_t *src = base + column->offset;
+
+  switch (column->tp) {
+  case cl_OBJECT:
+    return encodeColumns(column->via_object.columns, column->via_object.num,
+                         src, out);
+
+  case cl_UNION: {
+    if (clIsTagged(column)) {
+      const clColumn *member = clUnionMember(column, base);
+      return member ? encodeColumns(member, 1, src, out)
+                    : put(out, "null", 4);
+    }
+
+    static const char hex[] = "0123456789abcdef";
+    int err = grow(out, (size_t)column->size * 2 + 2);
+    if (err) {
+      return err;
+    }
+    char *p = out->data + out->size;
+    *p++ = '"';
+    for (int32_t i = 0; i < column->size; ++i) {
+      *p++ = hex[src[i] >> 4];
+      *p++ = hex[src[i] & 15];
+    }
+    *p++ = '"';
+    out->size = (size_t)(p - out->data);
+    return 0;
+  }
+
+  case cl_FIXED_ARRAY: {
+    const clFixedArray *array = &column->via_fixed_array;
+    return encodeArray(array->columns, array->tp,
+                       clElementSize(column, array->capacity),
+                       array->capacity, src, out);
+  }
+
+  case cl_FLEXIBLE_ARRAY: {
+    const clFlexibleArray *array = &column->via_flexible_array;
+    int64_t count = clLoadCount(array, base);
+    if (count < 0) {
+      return (int)count;
+    }
+    return encodeArray(array->columns, array->tp,
+                       clElementSize(column, array->capacity), count, src,
+                       out);
+  }
+
+  case cl_STRING: {
+    const clString *string = &column->via_string;
+    int32_t element = clElementSize(column, string->capacity);
+    int32_t len = clStringLength(src, element, string->capacity);
+    if (clIsTerminated(src, element, len)) {
+      --len;
+    }
+    if (element == 1) {
+      return encodeString(src, (size_t)len, out);
+    }
+    // wide characters as an array of code units
+    return encodeArray(NULL, cl_UINT8 + __builtin_ctz((unsigned)element),
+                       element, len, src, out);
+  }
+
+  default:
+    if (!clIsNumber(column->tp)) {
+      return cl_ERR_TYPE;
+    }
+    return encodeNumber(column->tp, column->size, src, out);
+  }
+}
+
+ptrdiff_t clJsonEncode(const clColumn *column, const void *src,
+                       clBuffer *out) {
+  size_t size = out->size;
+  int err = encodeColumn(column, (const uint8_t *)src - column->offset, out);
+  if (err) {
+    out->size = size;
+    return err;
+  }
+  return (ptrdiff_t)(out->size - size);
+}
+
+typedef struct {
+  const uint8_t *p;
+  const uint8_t *end;
+  int depth;
+} clParser;
+
+static bool isSpace(uint8_t c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static void skipSpace(clParser *in) {
+  while (in->p < in->end && isSpace(*in->p)) {
+    ++in->p;
+  }
+}
+
+// Skips whitespace and returns the next character, or -1 at the end.
+static int peek(clParser *in) {
+  skipSpace(in);
+  return in->p < in->end ? *in->p : -1;
+}
+
+static int expect(clParser *in, char c) {
+  int next = peek(in);
+  if (next < 0) {
+    return cl_ERR_BUFFER;
+  }
+  if (next != c) {
+    return cl_ERR_VALUE;
+  }
+  ++in->p;
+  return 0;
+}
+
+static int literal(clParser *in, const char *word, size_t len) {
+  if ((size_t)(in->end - in->p) < len) {
+    return cl_ERR_BUFFER;
+  }
+  if (memcmp(in->p, word, len) != 0) {
+    return cl_ERR_VALUE;
+  }
+  in->p += len;
+  return 0;
+}
+
+static int hexDigit(uint8_t c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  c |= 0x20;
+  return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// Returns the length of the valid UTF-8 sequence at P, or 0.
+static size_t utf8Sequence(const uint8_t *p, size_t avail) {
+  uint8_t c = p[0];
+  size_t n;
+  uint32_t min;
+  uint32_t cp;
+
+  if (c < 0x80) {
+    return 1;
+  } else if ((c & 0xe0) == 0xc0) {
+    n = 2, min = 0x80, cp = c & 0x1f;
+  } else if ((c & 0xf0) == 0xe0) {
+    n = 3, min = 0x800, cp = c & 0x0f;
+  } else if ((c & 0xf8) == 0xf0) {
+    n = 4, min = 0x10000, cp = c & 0x07;
+  } else {
+    return 0;
+  }
+
+  if (avail < n) {
+    return 0;
+  }
+  for (size_t i = 1; i < n; ++i) {
+    if ((p[i] & 0xc0) != 0x80) {
+      return 0;
+    }
+    cp = (cp << 6) | (p[i] & 0x3f);
+  }
+
+  if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+    return 0;
+  }
+  return n;
+}
+
+static size_t putUtf8(uint8_t *p, uint32_t cp) {
+  if (cp < 0x80) {
+    p[0] = (uint8_t)cp;
+    return 1;
+  }
+  if (cp < 0x800) {
+    p[0] = (uint8_t)(0xc0 | (cp >> 6));
+    p[1] = (uint8_t)(0x80 | (cp & 0x3f));
+    return 2;
+  }
+  if (cp < 0x10000) {
+    p[0] = (uint8_t)(0xe0 | (cp >> 12));
+    p[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3f));
+    p[2] = (uint8_t)(0x80 | (cp & 0x3f));
+    return 3;
+  }
+  p[0] = (uint8_t)(0xf0 | (cp >> 18));
+  p[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3f));
+  p[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3f));
+  p[3] = (uint8_t)(0x80 | (cp & 0x3f));
+  return 4;
+}
+
+static int readHex4(clParser *in, uint32_t *v) {
+  if (in->end - in->p < 4) {
+    return cl_ERR_BUFFER;
+  }
+
+  *v = 0;
+  for (int i = 0; i < 4; ++i) {
+    int d = hexDigit(in->p[i]);
+    if (d < 0) {
+      return cl_ERR_VALUE;
+    }
+    *v = (*v << 4) | (uint32_t)d;
+  }
+  in->p += 4;
+  return 0;
+}
+
+static int readEscape(clParser *in, uint8_t *utf8, size_t *n) {
+  if (in->p >= in->end) {
+    return cl_ERR_BUFFER;
+  }
+
+  uint8_t c = *in->p++;
+  *n = 1;
+  switch (c) {
+  case '"':
+  case '\\':
+  case '/':
+    utf8[0] = c;
+    return 0;
+  case 'b':
+    utf8[0] = '\b';
+    return 0;
+  case 'f':
+    utf8[0] = '\f';
+    return 0;
+  case 'n':
+    utf8[0] = '\n';
+    return 0;
+  case 'r':
+    utf8[0] = '\r';
+    return 0;
+  case 't':
+    utf8[0] = '\t';
+    return 0;
+  case 'u':
+    break;
+  default:
+    return cl_ERR_VALUE;
+  }
+
+  uint32_t cp;
+  int err = readHex4(in, &cp);
+  if (err) {
+    return err;
+  }
+
+  if (cp >= 0xd800 && cp <= 0xdbff) {
+    uint32_t low;
+    err = literal(in, "\\u", 2);
+    if (!err) {
+      err = readHex4(in, &low);
+    }
+    if (err) {
+      return err;
+    }
+    if (low < 0xdc00 || low > 0xdfff) {
+      return cl_ERR_VALUE;
+    }
+    cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+  } else if (cp >= 0xdc00 && cp <= 0xdfff) {
+    return cl_ERR_VALUE;
+  }
+
+  *n = putUtf8(utf8, cp);
+  return 0;
+}
+
+// Parses a JSON string into DST, at most CAPACITY bytes; a NULL DST only
+// validates. Returns the length through LEN.
+static int readString(clParser *in, uint8_t *dst, size_t capacity,
+                      size_t *len) {
+  int err = expect(in, '"');
+  if (err) {
+    return err;
+  }
+
+  *len = 0;
+  for (;;) {
+    // plain runs are validated a word at a time, non-ASCII bytes one
+    // sequence at a time
+    size_t avail = (size_t)(in->end - in->p);
+    size_t n = plainPrefix(in->p, avail);
+    for (size_t i = 0; i < n;) {
+#if CL_VARINT_WORDS
+      if (n - i >= 8) {
+        uint64_t v;
+        memcpy(&v, in->p + i, sizeof(v));
+        if (!(v & HIGHS)) {
+          i += 8;
+          continue;
+        }
+      }
+#endif
+      size_t k = utf8Sequence(in->p + i, n - i);
+      if (!k) {
+        // a sequence cut short by the end of the input may still be valid
+        return n == avail && n - i < 4 ? cl_ERR_BUFFER : cl_ERR_VALUE;
+      }
+      i += k;
+    }
+
+    if (dst) {
+      if (capacity - *len < n) {
+        return cl_ERR_CAPACITY;
+      }
+      memcpy(dst + *len, in->p, n);
+    }
+    *len += n;
+    in->p += n;
+
+    if (in->p >= in->end) {
+      return cl_ERR_BUFFER;
+    }
+
+    uint8_t c = *in->p++;
+    if (c == '"') {
+      return 0;
+    }
+    if (c != '\\') {
+      return cl_ERR_VALUE; // raw control character
+    }
+
+    uint8_t utf8[4];
+    err = readEscape(in, utf8, &n);
+    if (err) {
+      return err;
+    }
+    if (dst) {
+      if (capacity - *len < n) {
+        return cl_ERR_CAPACITY;
+      }
+      memcpy(dst + *len, utf8, n);
+    }
+    *len += n;
+  }
+}
+
+// Copies the characters of a JSON number to BUF. Returns the length, or 0.
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static locale_t cLocale;
+
+static void makeLocale(void) {
+  cLocale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+}
+
+// Parses the number at IN into OUT, with '.' as the decimal point whatever
+// the locale of the thread. Returns 0, cl_ERR_CAPACITY when it is longer
+// than MAX_NUMBER, cl_ERR_VALUE or cl_ERR_MEMORY.
+static int readNumber(clParser *in, double *out) {
+  skipSpace(in);
+  size_t n = 0;
+  while (in->p + n < in->end) {
+    uint8_t c = in->p[n];
+    if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+          c == 'e' || c == 'E')) {
+      break;
+    }
+    ++n;
+  }
+  if (!n) {
+    return cl_ERR_VALUE;
+  }
+  if (n >= MAX_NUMBER) {
+    return cl_ERR_CAPACITY;
+  }
+
+  pthread_once(&once, makeLocale);
+  if (cLocale == (locale_t)0) {
+    return cl_ERR_MEMORY;
+  }
+
+  char buf[MAX_NUMBER];
+  memcpy(buf, in->p, n);
+  buf[n] = '\0';
+  char *end;
+  locale_t previous = uselocale(cLocale);
+  *out = strtod(buf, &end);
+  uselocale(previous);
+  if (end != buf + n) {
+    return cl_ERR_VALUE;
+  }
+  in->p += n;
+  return 0;
+}
+
+static int decodeInteger(int tp, int32_t size, uint8_t *dst, clParser *in) {
+  skipSpace(in);
+  const uint8_t *p = in->p;
+  bool negative = p < in->end && *p == '-';
+  p += negative;
+
+  if (p >= in->end) {
+    return cl_ERR_BUFFER;
+  }
+  if (*p < '0' || *p > '9' || (*p == '0' && p + 1 < in->end && p[1] >= '0' &&
+                               p[1] <= '9')) {
+    return cl_ERR_VALUE;
+  }
+
+  uint64_t v = 0;
+  for (; p < in->end && *p >= '0' && *p <= '9'; ++p) {
+    uint64_t d = (uint64_t)(*p - '0');
+    if (v > (UINT64_MAX - d) / 10) {
+      return cl_ERR_VALUE;
+    }
+    v = v * 10 + d;
+  }
+  if (p < in->end && (*p == '.' || *p == 'e' || *p == 'E')) {
+    return cl_ERR_VALUE;
+  }
+
+  int64_t value;
+  if (clIsSigned(tp)) {
+    if (v > (negative ? (uint64_t)1 << 63 : (uint64_t)INT64_MAX)) {
+      return cl_ERR_VALUE;
+    }
+    value = negative ? (int64_t)(0 - v) : (int64_t)v;
+  } else {
+    if (negative && v) {
+      return cl_ERR_VALUE;
+    }
+    value = (int64_t)v;
+  }
+
+  if (!clFitsInteger(value, tp, size)) {
+    return cl_ERR_VALUE;
+  }
+  clStoreInteger(dst, size, value);
+  in->p = p;
+  return 0;
+}
+
+static int decodeNumber(int tp, int32_t size, uint8_t *dst, clParser *in) {
+  int c = peek(in);
+  if (c < 0) {
+    return cl_ERR_BUFFER;
+  }
+
+  if (tp == cl_BOOL) {
+    int err = c == 't' ? literal(in, "true", 4) : literal(in, "false", 5);
+    if (!err) {
+      *dst = c == 't';
+    }
+    return err;
+  }
+
+  if (tp == cl_FLOAT32 || tp == cl_FLOAT64) {
+    double v = NAN;
+    if (c == 'n') {
+      int err = literal(in, "null", 4);
+      if (err) {
+        return err;
+      }
+    } else {
+      int err = readNumber(in, &v);
+      if (err) {
+        return err;
+      }
+    }
+
+    if (size == 4) {
+      float f = (float)v;
+      memcpy(dst, &f, sizeof(f));
+    } else if (size == 8) {
+      memcpy(dst, &v, sizeof(v));
+    } else {
+      return cl_ERR_TYPE;
+    }
+    return 0;
+  }
+
+  if (clIsFloat(tp) || size < 1 || size > 8 || (size & (size - 1))) {
+    return cl_ERR_TYPE;
+  }
+  return decodeInteger(tp, size, dst, in);
+}
+
+static int skipValue(clParser *in) {
+  int c = peek(in);
+  if (c < 0) {
+    return cl_ERR_BUFFER;
+  }
+
+  if (c == '"') {
+    size_t len;
+    return readString(in, NULL, 0, &len);
+  }
+
+  if (c == '{' || c == '[') {
+    if (++in->depth > MAX_DEPTH) {
+      return cl_ERR_VALUE;
+    }
+    char close = c == '{' ? '}' : ']';
+    ++in->p;
+    if (peek(in) == close) {
+      ++in->p;
+      --in->depth;
+      return 0;
+    }
+    for (;;) {
+      int err;
+      if (close == '}') {
+        size_t len;
+        err = readString(in, NULL, 0, &len);
+        if (!err) {
+          err = expect(in, ':');
+        }
+        if (err) {
+          return err;
+        }
+      }
+      err = skipValue(in);
+      if (err) {
+        return err;
+      }
+      c = peek(in);
+      if (c < 0) {
+        return cl_ERR_BUFFER;
+      }
+      ++in->p;
+      if (c == close) {
+        --in->depth;
+        return 0;
+      }
+      if (c != ',') {
+        return cl_ERR_VALUE;
+      }
+    }
+  }
+
+  if (c == 't') {
+    return literal(in, "true", 4);
+  }
+  if (c == 'f') {
+    return literal(in, "false", 5);
+  }
+  if (c == 'n') {
+    return literal(in, "null", 4);
+  }
+
+  double v;
+  return readNumber(in, &v);
+}
+
+static int decodeColumn(const clColumn *column, uint8_t *base, clParser *in);
+
+// Parses a JSON array of at most CAPACITY elements, returns the count.
+static int64_t decodeArray(const clColumn *element, int tp, int32_t stride,
+                           int32_t capacity, uint8_t *dst, clParser *in) {
+  int err = expect(in, '[');
+  if (err) {
+    return err;
+  }
+  if (peek(in) == ']') {
+    ++in->p;
+    return 0;
+  }
+
+  for (int64_t count = 0;; ++count) {
+    if (count == capacity) {
+      return cl_ERR_CAPACITY;
+    }
+
+    err = element ? decodeColumn(element, dst + count * stride, in)
+                  : decodeNumber(tp, stride, dst + count * stride, in);
+    if (err) {
+      return err;
+    }
+
+    int c = peek(in);
+    if (c < 0) {
+      return cl_ERR_BUFFER;
+    }
+    ++in->p;
+    if (c == ']') {
+      return count + 1;
+    }
+    if (c != ',') {
+      return cl_ERR_VALUE;
+    }
+  }
+}
+
+// Keys usually arrive in declaration order: FIELD, the one after the previous
+// key, is tried with a plain compare before hashing.
+static bool matchKey(const clColumn *field, clParser *in) {
+  size_t len = (size_t)field->name.len;
+  skipSpace(in);
+  if ((size_t)(in->end - in->p) < len + 2 || in->p[0] != '"' ||
+      in->p[len + 1] != '"' ||
+      memcmp(in->p + 1, field->name.string, len) != 0) {
+    return false;
+  }
+  in->p += len + 2;
+  return true;
+}
+
+static int decodeObject(const clColumn *column, uint8_t *dst, clParser *in) {
+  int err = expect(in, '{');
+  if (err) {
+    return err;
+  }
+  if (++in->depth > MAX_DEPTH) {
+    return cl_ERR_VALUE;
+  }
+  if (peek(in) == '}') {
+    ++in->p;
+    --in->depth;
+    return 0;
+  }
+
+  const clColumn *columns = column->via_object.columns;
+  int32_t next = 0;
+  for (;;) {
+    const clColumn *field = NULL;
+    if (next < column->via_object.num && matchKey(&columns[next], in)) {
+      field = &columns[next];
+    } else {
+      // keys longer than any field name cannot match and are only validated
+      uint8_t key[128];
+      size_t len;
+      const uint8_t *start = in->p;
+      err = readString(in, key, sizeof(key), &len);
+      if (err == cl_ERR_CAPACITY) {
+        in->p = start;
+        err = readString(in, NULL, 0, &len);
+        len = sizeof(key) + 1;
+      }
+      if (err) {
+        return err;
+      }
+      if (len <= sizeof(key)) {
+        field = clFindColumn(column, (const char *)key, len);
+      }
+    }
+
+    err = expect(in, ':');
+    if (err) {
+      return err;
+    }
+    if (field) {
+      next = (int32_t)(field - columns) + 1;
+    }
+    err = field ? decodeColumn(field, dst, in) : skipValue(in);
+    if (err) {
+      return err;
+    }
+
+    int c = peek(in);
+    if (c < 0) {
+      return cl_ERR_BUFFER;
+    }
+    ++in->p;
+    if (c == '}') {
+      --in->depth;
+      return 0;
+    }
+    if (c != ',') {
+      return cl_ERR_VALUE;
+    }
+  }
+}
+
+static int decodeUnion(const clColumn *column, uint8_t *dst, clParser *in) {
+  int err = expect(in, '"');
+  if (err) {
+    return err;
+  }
+  if ((size_t)(in->end - in->p) < (size_t)column->size * 2 + 1) {
+    return cl_ERR_BUFFER;
+  }
+
+  for (int32_t i = 0; i < column->size; ++i) {
+    int hi = hexDigit(in->p[i * 2]);
+    int lo = hexDigit(in->p[i * 2 + 1]);
+    if (hi < 0 || lo < 0) {
+      return cl_ERR_VALUE;
+    }
+    dst[i] = (uint8_t)(hi << 4 | lo);
+  }
+  in->p += column->size * 2;
+  if (*in->p != '"') {
+    return cl_ERR_VALUE;
+  }
+  ++in->p;
+  return 0;
+}
+
+// Parses an object with the key of one member of a tagged union and sets the
+// tag to the first value selecting it; null leaves both untouched.
+static int decodeMember(const clColumn *column, uint8_t *base, clParser *in) {
+  const clUnion *u = &column->via_union;
+  if (peek(in) == 'n') {
+    return literal(in, "null", 4);
+  }
+
+  int err = expect(in, '{');
+  if (err) {
+    return err;
+  }
+
+  uint8_t key[128];
+  size_t len;
+  err = readString(in, key, sizeof(key), &len);
+  if (err) {
+    return err == cl_ERR_CAPACITY ? cl_ERR_VALUE : err;
+  }
+  const clColumn *member = clFindColumn(column, (const char *)key, len);
+  if (!member) {
+    return cl_ERR_VALUE;
+  }
+
+  int64_t tag = 0;
+  while (tag < u->num_cases && u->cases[tag] != member - u->columns) {
+    ++tag;
+  }
+  if (tag == u->num_cases || !clFitsInteger(tag, u->tag.tp, u->tag.size)) {
+    return cl_ERR_VALUE;
+  }
+
+  err = expect(in, ':');
+  if (!err) {
+    err = decodeColumn(member, base + column->offset, in);
+  }
+  if (!err) {
+    err = expect(in, '}');
+  }
+  if (err) {
+    return err;
+  }
+  clStoreInteger(base + u->tag.offset, u->tag.size, tag);
+  return 0;
+}
+
+static int decodeColumn(const clColumn *column, uint8_t *base, clParser *in) {
+  uint8_t *dst = base + column->offset;
+
+  switch (column->tp) {
+  case cl_OBJECT:
+    return decodeObject(column, dst, in);
+
+  case cl_UNION:
+    return clIsTagged(column) ? decodeMember(column, base, in)
+                              : decodeUnion(column, dst, in);
+
+  case cl_FIXED_ARRAY: {
+    const clFixedArray *array = &column->via_fixed_array;
+    int64_t count = decodeArray(array->columns, array->tp,
+                                clElementSize(column, array->capacity),
+                                array->capacity, dst, in);
+    if (count < 0) {
+      return (int)count;
+    }
+    return count == array->capacity ? 0 : cl_ERR_VALUE;
+  }
+
+  case cl_FLEXIBLE_ARRAY: {
+    // the element count wins over the length field
+    const clFlexibleArray *array = &column->via_flexible_array;
+    int64_t count = decodeArray(array->columns, array->tp,
+                                clElementSize(column, array->capacity),
+                                array->capacity, dst, in);
+    if (count < 0) {
+      return (int)count;
+    }
+    if (!clFitsInteger(count, array->len.tp, array->len.size)) {
+      return cl_ERR_CAPACITY;
+    }
+    clStoreInteger(base + array->len.offset, array->len.size, count);
+    return 0;
+  }
+
+  case cl_STRING: {
+    const clString *string = &column->via_string;
+    int32_t element = clElementSize(column, string->capacity);
+    int64_t len;
+    if (element == 1) {
+      size_t n;
+      int err = readString(in, dst, (size_t)string->capacity, &n);
+      if (err) {
+        return err;
+      }
+      len = (int64_t)n;
+    } else {
+      len = decodeArray(NULL, cl_UINT8 + __builtin_ctz((unsigned)element),
+                        element, string->capacity, dst, in);
+      if (len < 0) {
+        return (int)len;
+      }
+    }
+    if (len < string->capacity) {
+      memset(dst + (size_t)element * len, 0, (size_t)element);
+    }
+    return 0;
+  }
+
+  default:
+    if (!clIsNumber(column->tp)) {
+      return cl_ERR_TYPE;
+    }
+    return decodeNumber(column->tp, column->size, dst, in);
+  }
+}
+
+ptrdiff_t clJsonDecode(const clColumn *column, void *dst, const char *json,
+                       size_t len) {
+  clParser in = {(const uint8_t *)json, (const uint8_t *)json + len, 0};
+  int err = decodeColumn(column, (uint8_t *)dst - column->offset, &in);
+  if (err) {
+    return err;
+  }
+  skipSpace(&in);
+  return (ptrdiff_t)(in.p - (const uint8_t *)json);
+}
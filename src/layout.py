@@ -0,0 +1,336 @@
+"""
+layout.py
+"""
+
+import dataclasses
+import os
+from clang.cindex import Cursor, CursorKind, TypeKind
+
+import plugin_stub
+
+
+CHAR_TYPE = [
+    TypeKind.CHAR_U,
+    TypeKind.CHAR_S,
+    TypeKind.UCHAR,
+    TypeKind.CHAR16,
+    TypeKind.CHAR32,
+    TypeKind.USHORT,
+    TypeKind.UINT,
+    TypeKind.CHAR_S,
+    TypeKind.SCHAR,
+    TypeKind.SHORT,
+    TypeKind.INT,
+]
+
+BASE_TYPE = [
+    TypeKind.BOOL,
+    TypeKind.CHAR_U,
+    TypeKind.CHAR_S,
+    TypeKind.UCHAR,
+    TypeKind.CHAR16,
+    TypeKind.CHAR32,
+    TypeKind.USHORT,
+    TypeKind.UINT,
+    TypeKind.ULONG,
+    TypeKind.ULONGLONG,
+    TypeKind.UINT128,
+    TypeKind.CHAR_S,
+    TypeKind.SCHAR,
+    TypeKind.SHORT,
+    TypeKind.INT,
+    TypeKind.LONG,
+    TypeKind.LONGLONG,
+    TypeKind.INT128,
+    TypeKind.FLOAT,
+    TypeKind.DOUBLE,
+    TypeKind.LONGDOUBLE,
+    TypeKind.ENUM,
+]
+
+NUMBER = "NUMBER"
+STRING = "STRING"
+FIXED_ARRAY = "FIXED_ARRAY"
+FLEXIBLE_ARRAY = "FLEXIBLE_ARRAY"
+OBJECT = "OBJECT"
+UNION = "UNION"
+
+# tag values of a union member, the bound of its table of cases
+MAX_CASES = 1024
+
+
+def get_field_kind(cursor: Cursor, prev_cursor: Cursor) -> str:
+    canonical_type = cursor.type.get_canonical()
+
+    if canonical_type.kind in BASE_TYPE:
+        return NUMBER
+
+    if canonical_type.kind in (
+        TypeKind.CONSTANTARRAY,
+        TypeKind.VARIABLEARRAY,
+    ):
+        comment = cursor.raw_comment
+        if comment:
+            if "@string" in comment:
+                return STRING
+
+        element_type = cursor.type.get_array_element_type()
+        if element_type.spelling == "char":
+            return STRING
+
+        if prev_cursor and plugin_stub.check_is_flexable_array(prev_cursor, cursor):
+            return FLEXIBLE_ARRAY
+        return FIXED_ARRAY
+
+    declaration = canonical_type.get_declaration()
+    if declaration.kind == CursorKind.STRUCT_DECL:
+        return OBJECT
+    if declaration.kind == CursorKind.UNION_DECL:
+        return UNION
+    return None
+
+
+def get_enum_range(cursor: Cursor) -> tuple[int, int] | None:
+    """the smallest and largest constant of the enum field CURSOR"""
+
+    canonical_type = cursor.type.get_canonical()
+    if canonical_type.kind != TypeKind.ENUM:
+        return None
+
+    values = [
+        child.enum_value
+        for child in canonical_type.get_declaration().get_children()
+        if child.kind == CursorKind.ENUM_CONSTANT_DECL
+    ]
+    if not values:
+        return None
+    return (min(values), max(values))
+
+
+def where(cursor: Cursor) -> str:
+    location = cursor.location
+    return f"{os.path.basename(location.file.name)}:{location.line}:{location.column}"
+
+
+def get_union_tag(cursor: Cursor) -> str | None:
+    """the tag field of the union field CURSOR, a number declared before it"""
+
+    tag = plugin_stub.get_union_tag(cursor)
+    if not tag:
+        return None
+
+    for child in cursor.semantic_parent.get_children():
+        if child == cursor:
+            break
+        if child.kind != CursorKind.FIELD_DECL or child.spelling != tag:
+            continue
+
+        tag_kind = child.type.get_canonical().kind
+        if tag_kind not in BASE_TYPE or tag_kind in (
+            TypeKind.FLOAT,
+            TypeKind.DOUBLE,
+            TypeKind.LONGDOUBLE,
+        ):
+            raise Exception(f"{where(cursor)}: tag {tag} of {cursor.spelling} is not an integer")
+        return tag
+
+    raise Exception(f"{where(cursor)}: tag {tag} of {cursor.spelling} is not a field before it")
+
+
+def get_union_members(declaration: Cursor) -> list[tuple[Cursor, str]]:
+    """the members of a union with a column, and their kinds"""
+
+    members = []
+    prev_cursor = None
+    for child in declaration.get_children():
+        if child.kind in (CursorKind.UNION_DECL, CursorKind.STRUCT_DECL):
+            prev_cursor = None
+            continue
+
+        if child.kind != CursorKind.FIELD_DECL:
+            continue
+
+        kind = get_field_kind(child, prev_cursor)
+        if kind == NUMBER:
+            prev_cursor = child
+        if kind:
+            members.append((child, kind))
+    return members
+
+
+def get_union_cases(declaration: Cursor) -> list[int]:
+    """the member index by tag value, -1 for none"""
+
+    cases = []
+    for i, (member, _) in enumerate(get_union_members(declaration)):
+        value = plugin_stub.get_union_case(member, i)
+        if value < 0 or value >= MAX_CASES:
+            raise Exception(f"{where(member)}: case {value} is not in [0, {MAX_CASES})")
+
+        cases.extend([-1] * (value + 1 - len(cases)))
+        if cases[value] >= 0:
+            raise Exception(f"{where(member)}: case {value} is already used")
+        cases[value] = i
+    return cases
+
+
+@dataclasses.dataclass
+class Bytes:
+    """bytes copied to the wire as they are laid out in memory"""
+
+    path: str
+    offset: int
+    size: int
+
+
+@dataclasses.dataclass
+class String:
+    path: str
+    offset: int
+    size: int
+    capacity: int
+
+
+@dataclasses.dataclass
+class FlexibleArray:
+    path: str
+    offset: int
+    size: int
+    capacity: int
+    len_path: str
+    # items of one element relative to the element, None for numbers
+    element: list
+    element_type: str
+    element_size: int
+
+
+@dataclasses.dataclass
+class TaggedUnion:
+    path: str
+    offset: int
+    tag_path: str
+    # (tag value, items of the member) for the values that select one
+    cases: list
+
+
+def walk_record(declaration: Cursor, path: str = "", offset: int = 0) -> list:
+    items = []
+    prev_cursor = None
+
+    for child in declaration.get_children():
+        if child.kind in (CursorKind.UNION_DECL, CursorKind.STRUCT_DECL):
+            prev_cursor = None
+            continue
+
+        if child.kind != CursorKind.FIELD_DECL:
+            continue
+
+        kind = get_field_kind(child, prev_cursor)
+        items.extend(walk_field(child, kind, prev_cursor, path, offset))
+        if kind == NUMBER:
+            prev_cursor = child
+
+    return items
+
+
+def walk_field(child: Cursor, kind: str, prev_cursor: Cursor, path: str, offset: int) -> list:
+    items = []
+
+    child_path = path + child.spelling
+    child_offset = offset + child.get_field_offsetof() // 8
+    child_size = child.type.get_size()
+
+    if kind == NUMBER:
+        items.append(Bytes(child_path, child_offset, child_size))
+    elif kind == STRING:
+        capacity = child.type.get_array_size()
+        items.append(String(child_path, child_offset, child_size, capacity))
+    elif kind in (FIXED_ARRAY, FLEXIBLE_ARRAY):
+        capacity = child.type.get_array_size()
+        element_type = child.type.get_array_element_type().get_canonical()
+        element_size = element_type.get_size()
+        element_declaration = element_type.get_declaration()
+
+        element = None
+        if element_declaration.kind == CursorKind.STRUCT_DECL:
+            element = walk_record(element_declaration)
+
+        if kind == FLEXIBLE_ARRAY:
+            items.append(
+                FlexibleArray(
+                    child_path,
+                    child_offset,
+                    child_size,
+                    capacity,
+                    path + prev_cursor.spelling,
+                    element,
+                    element_type.spelling,
+                    element_size,
+                )
+            )
+        elif element is None:
+            items.append(Bytes(child_path, child_offset, child_size))
+        else:
+            for i in range(capacity):
+                items.extend(
+                    walk_record(
+                        element_declaration,
+                        f"{child_path}[{i}].",
+                        child_offset + i * element_size,
+                    )
+                )
+    elif kind == OBJECT:
+        child_declaration = child.type.get_canonical().get_declaration()
+        prefix = f"{child_path}." if child.spelling else path
+        items.extend(walk_record(child_declaration, prefix, child_offset))
+    elif kind == UNION:
+        tag = get_union_tag(child)
+        if tag:
+            child_declaration = child.type.get_canonical().get_declaration()
+            members = get_union_members(child_declaration)
+            cases = [
+                (value, walk_field(*members[i], None, f"{child_path}.", child_offset))
+                for value, i in enumerate(get_union_cases(child_declaration))
+                if i >= 0
+            ]
+            items.append(TaggedUnion(child_path, child_offset, path + tag, cases))
+        else:
+            items.append(Bytes(child_path, child_offset, child_size))
+
+    return items
+
+
+def merge_bytes(items: list) -> list:
+    """merges runs of Bytes that are adjacent in memory into one copy"""
+
+    result = []
+    for item in items:
+        if isinstance(item, FlexibleArray) and item.element:
+            item = dataclasses.replace(item, element=merge_bytes(item.element))
+        if isinstance(item, TaggedUnion):
+            cases = [(value, merge_bytes(member)) for value, member in item.cases]
+            item = dataclasses.replace(item, cases=cases)
+
+        if (
+            result
+            and isinstance(item, Bytes)
+            and isinstance(result[-1], Bytes)
+            and result[-1].offset + result[-1].size == item.offset
+        ):
+            last = result[-1]
+            result[-1] = Bytes(last.path, last.offset, last.size + item.size)
+            continue
+
+        result.append(item)
+    return result
+
+
+def is_plain(items: list, size: int) -> bool:
+    """whether the wire image of a record is exactly its memory image"""
+
+    return (
+        len(items) == 1
+        and isinstance(items[0], Bytes)
+        and items[0].offset == 0
+        and items[0].size == size
+    )
@@ -0,0 +1,503 @@
+#define _GNU_SOURCE // O_DIRECT
+
+#include "internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// File layout, in host byte order:
+//
+//   header  "CLOG", u32 version, u32 number of cmds, u32 header size,
+//           then per cmd: i32 cmd, u32 length, clSchemaWrite() bytes
+//   blocks  a block header, then records of i32 size, i32 cmd,
+//           u64 timestamp and the cl_WIRE_RAW encoding
+//
+// The header and every block are padded to a multiple of LOG_ALIGN so the
+// file can be written with O_DIRECT.
+
+#define LOG_ALIGN 4096
+#define LOG_BLOCK (64 * 1024)
+#define LOG_VERSION 1
+
+static const char kLogMagic[4] = {'C', 'L', 'O', 'G'};
+static const char kBlockMagic[4] = {'C', 'L', 'B', 'K'};
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint32_t num;
+  uint32_t size;
+} clLogHeader;
+
+typedef struct {
+  char magic[4];
+  uint32_t count;
+  uint32_t used;   // bytes of this header and the records
+  uint32_t padded; // bytes up to the next block
+  uint64_t first;  // timestamp range
+  uint64_t last;
+  uint64_t cmds; // bit cmd % 64 of every record
+} clBlockHeader;
+
+typedef struct {
+  int32_t size;
+  int32_t cmd;
+  uint64_t timestamp;
+} clRecordHeader;
+
+static size_t alignUp(size_t n) {
+  return (n + LOG_ALIGN - 1) & ~(size_t)(LOG_ALIGN - 1);
+}
+
+// Returns whether BLOCK is sound and within the REST bytes from its start.
+static bool validBlock(const clBlockHeader *block, size_t rest) {
+  return memcmp(block->magic, kBlockMagic, sizeof(block->magic)) == 0 &&
+         block->used >= sizeof(*block) && block->used <= block->padded &&
+         block->padded % LOG_ALIGN == 0 && block->padded <= rest;
+}
+
+static int writeAll(int fd, const uint8_t *p, size_t n) {
+  while (n) {
+    ssize_t r = write(fd, p, n);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return cl_ERR_BUFFER;
+    }
+    p += r;
+    n -= (size_t)r;
+  }
+  return 0;
+}
+
+static ptrdiff_t writeHeader(const clDispatch *dispatch, clWriter *w) {
+  int32_t num = 0;
+  for (int32_t i = 0; i < dispatch->num; ++i) {
+    num += dispatch->columns[i] != NULL;
+  }
+
+  clLogHeader header;
+  memcpy(header.magic, kLogMagic, sizeof(header.magic));
+  header.version = LOG_VERSION;
+  header.num = (uint32_t)num;
+  header.size = 0;
+
+  size_t start = w->pos;
+  int err = clWriteBytes(w, &header, sizeof(header));
+  for (int32_t i = 0; !err && i < dispatch->num; ++i) {
+    const clColumn *column = dispatch->columns[i];
+    if (!column) {
+      continue;
+    }
+
+    int32_t cmd = dispatch->first + i;
+    ptrdiff_t n = clSchemaSize(column);
+    if (n < 0 || n > INT32_MAX) {
+      return n < 0 ? n : cl_ERR_CAPACITY;
+    }
+    uint32_t len = (uint32_t)n;
+    err = clWriteBytes(w, &cmd, sizeof(cmd));
+    if (!err) {
+      err = clWriteBytes(w, &len, sizeof(len));
+    }
+    if (!err && w->buf) {
+      n = clSchemaWrite(column, w->buf + w->pos, w->size - w->pos);
+      err = n < 0 ? (int)n : 0;
+    }
+    w->pos += len;
+  }
+  if (err) {
+    return err;
+  }
+
+  size_t size = alignUp(w->pos - start);
+  err = clWriteZeros(w, size - (w->pos - start));
+  if (!err && w->buf) {
+    header.size = (uint32_t)size;
+    memcpy(w->buf + start, &header, sizeof(header));
+  }
+  return err ? err : (ptrdiff_t)size;
+}
+
+static void resetBlock(clLogWriter *log) {
+  memset(log->block, 0, sizeof(clBlockHeader));
+  log->used = sizeof(clBlockHeader);
+}
+
+// Returns the end of the whole blocks of the SIZE bytes of FD from START,
+// reading them a page at a time into PAGE, or -1.
+static off_t blocksEnd(int fd, uint8_t *page, off_t start, off_t size) {
+  off_t end = start;
+  while (size - end >= (off_t)sizeof(clBlockHeader)) {
+    // a full page, for O_DIRECT
+    ssize_t n = pread(fd, page, LOG_ALIGN, end);
+    if (n < 0) {
+      return -1;
+    }
+
+    clBlockHeader block;
+    if ((size_t)n < sizeof(block)) {
+      break;
+    }
+    memcpy(&block, page, sizeof(block));
+    if (!validBlock(&block, (size_t)(size - end))) {
+      break;
+    }
+    end += block.padded;
+  }
+  return end;
+}
+
+int clLogOpen(clLogWriter *log, const char *path, const clDispatch *dispatch,
+              size_t block_size, int flags) {
+  if (!block_size) {
+    block_size = LOG_BLOCK;
+  }
+  if (block_size % LOG_ALIGN || block_size > UINT32_MAX) {
+    return cl_ERR_VALUE;
+  }
+
+  clWriter w = {NULL, 0, 0, cl_WIRE_RAW, NULL, NULL, 0};
+  ptrdiff_t n = writeHeader(dispatch, &w);
+  if (n < 0) {
+    return (int)n;
+  }
+
+  size_t capacity = (size_t)n > block_size ? (size_t)n : block_size;
+  uint8_t *block = (uint8_t *)aligned_alloc(LOG_ALIGN, capacity);
+  uint8_t *existing = (uint8_t *)aligned_alloc(LOG_ALIGN, (size_t)n);
+  if (!block || !existing) {
+    free(block);
+    free(existing);
+    return cl_ERR_MEMORY;
+  }
+
+  w.buf = block;
+  w.pos = 0;
+  w.size = capacity;
+  writeHeader(dispatch, &w);
+
+  int oflags = O_RDWR | O_CREAT;
+#ifdef O_DIRECT
+  if (flags & cl_LOG_DIRECT) {
+    oflags |= O_DIRECT;
+  }
+#endif
+
+  int err = 0;
+  int fd = open(path, oflags, 0644);
+  if (fd < 0 && errno == EINVAL && (oflags & ~(O_RDWR | O_CREAT))) {
+    // no O_DIRECT on this file system
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+  }
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    err = cl_ERR_BUFFER;
+  } else if (st.st_size == 0) {
+    err = writeAll(fd, block, (size_t)n);
+  } else if (pread(fd, existing, (size_t)n, 0) != n ||
+             memcmp(existing, block, (size_t)n) != 0) {
+    // a log of another set of descriptors
+    err = cl_ERR_VALUE;
+  } else {
+    // drop a torn or damaged block, and whatever follows it
+    off_t end = blocksEnd(fd, existing, n, st.st_size);
+    if (end < 0 || (end != st.st_size && ftruncate(fd, end) != 0)) {
+      err = cl_ERR_BUFFER;
+    } else if (lseek(fd, end, SEEK_SET) != end) {
+      err = cl_ERR_BUFFER;
+    }
+  }
+  free(existing);
+
+  if (err) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    free(block);
+    return err;
+  }
+
+  log->fd = fd;
+  log->flags = flags;
+  log->dispatch = dispatch;
+  log->block = block;
+  log->capacity = block_size;
+  resetBlock(log);
+  return 0;
+}
+
+int clLogAppend(clLogWriter *log, int32_t cmd, uint64_t timestamp,
+                const void *msg) {
+  const clColumn *column = clCommandColumn(log->dispatch, cmd);
+  if (!column) {
+    return cl_ERR_VALUE;
+  }
+
+  for (int retry = 0;; ++retry) {
+    size_t pos = log->used + sizeof(clRecordHeader);
+    ptrdiff_t n = pos <= log->capacity
+                      ? clEncode(column, msg, log->block + pos,
+                                 log->capacity - pos)
+                      : cl_ERR_BUFFER;
+    if (n >= 0) {
+      clBlockHeader block;
+      memcpy(&block, log->block, sizeof(block));
+      if (!block.count) {
+        block.first = block.last = timestamp;
+      }
+      block.count += 1;
+      block.first = timestamp < block.first ? timestamp : block.first;
+      block.last = timestamp > block.last ? timestamp : block.last;
+      block.cmds |= (uint64_t)1 << ((uint32_t)cmd % 64);
+      memcpy(log->block, &block, sizeof(block));
+
+      clRecordHeader record = {(int32_t)n, cmd, timestamp};
+      memcpy(log->block + log->used, &record, sizeof(record));
+      log->used = pos + (size_t)n;
+      return 0;
+    }
+    if (n != cl_ERR_BUFFER) {
+      return (int)n;
+    }
+    if (retry || log->used == sizeof(clBlockHeader)) {
+      // larger than a block
+      return cl_ERR_CAPACITY;
+    }
+
+    int err = clLogFlush(log);
+    if (err) {
+      return err;
+    }
+  }
+}
+
+int clLogFlush(clLogWriter *log) {
+  if (log->used == sizeof(clBlockHeader)) {
+    return 0;
+  }
+
+  size_t padded = alignUp(log->used);
+  clBlockHeader block;
+  memcpy(&block, log->block, sizeof(block));
+  memcpy(block.magic, kBlockMagic, sizeof(block.magic));
+  block.used = (uint32_t)log->used;
+  block.padded = (uint32_t)padded;
+  memcpy(log->block, &block, sizeof(block));
+  memset(log->block + log->used, 0, padded - log->used);
+
+  int err = writeAll(log->fd, log->block, padded);
+  if (!err) {
+    resetBlock(log);
+  }
+  return err;
+}
+
+int clLogClose(clLogWriter *log) {
+  int err = clLogFlush(log);
+  if (close(log->fd) != 0 && !err) {
+    err = cl_ERR_BUFFER;
+  }
+  free(log->block);
+  log->fd = -1;
+  log->block = NULL;
+  return err;
+}
+
+static void freeSchemas(clLogReader *log) {
+  for (int32_t i = 0; i < log->num; ++i) {
+    free((void *)log->columns[i]);
+  }
+  free(log->columns);
+  free(log->cmds);
+  log->columns = NULL;
+  log->cmds = NULL;
+  log->num = 0;
+}
+
+static int readHeader(clLogReader *log) {
+  clLogHeader header;
+  if (log->size < sizeof(header)) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(&header, log->data, sizeof(header));
+  if (memcmp(header.magic, kLogMagic, sizeof(header.magic)) != 0 ||
+      header.version != LOG_VERSION) {
+    return cl_ERR_VALUE;
+  }
+  // the header is padded like a block, and holds at least itself
+  if (header.size < sizeof(header) || header.size % LOG_ALIGN) {
+    return cl_ERR_VALUE;
+  }
+  if (header.size > log->size || header.num > header.size / 8) {
+    return cl_ERR_BUFFER;
+  }
+
+  log->cmds = (int32_t *)malloc((header.num + 1) * sizeof(int32_t));
+  log->columns =
+      (const clColumn **)malloc((header.num + 1) * sizeof(clColumn *));
+  if (!log->cmds || !log->columns) {
+    return cl_ERR_MEMORY;
+  }
+
+  clReader r = {log->data, sizeof(header), header.size, cl_WIRE_RAW};
+  for (uint32_t i = 0; i < header.num; ++i) {
+    int32_t cmd;
+    uint32_t len;
+    int err = clReadBytes(&r, &cmd, sizeof(cmd));
+    if (!err) {
+      err = clReadBytes(&r, &len, sizeof(len));
+    }
+    if (!err && r.size - r.pos < len) {
+      err = cl_ERR_BUFFER;
+    }
+    if (err) {
+      return err;
+    }
+
+    const clColumn *column;
+    ptrdiff_t n = clSchemaRead(&column, r.buf + r.pos, len);
+    if (n < 0) {
+      return (int)n;
+    }
+    log->cmds[log->num] = cmd;
+    log->columns[log->num] = column;
+    log->num += 1;
+    if ((size_t)n != len || column->tp != cl_OBJECT) {
+      return cl_ERR_VALUE;
+    }
+    r.pos += len;
+  }
+
+  log->first = header.size;
+  return 0;
+}
+
+int clLogMap(clLogReader *log, const char *path) {
+  memset(log, 0, sizeof(*log));
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return cl_ERR_BUFFER;
+  }
+
+  struct stat st;
+  int err = fstat(fd, &st) != 0 || st.st_size == 0 ? cl_ERR_BUFFER : 0;
+  void *data = MAP_FAILED;
+  if (!err) {
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    err = data == MAP_FAILED ? cl_ERR_MEMORY : 0;
+  }
+  close(fd);
+  if (err) {
+    return err;
+  }
+
+  log->data = (const uint8_t *)data;
+  log->size = (size_t)st.st_size;
+  err = readHeader(log);
+  if (err) {
+    clLogUnmap(log);
+  }
+  return err;
+}
+
+void clLogUnmap(clLogReader *log) {
+  freeSchemas(log);
+  if (log->data) {
+    munmap((void *)log->data, log->size);
+  }
+  log->data = NULL;
+  log->size = 0;
+}
+
+const clColumn *clLogSchema(const clLogReader *log, int32_t cmd) {
+  for (int32_t i = 0; i < log->num; ++i) {
+    if (log->cmds[i] == cmd) {
+      return log->columns[i];
+    }
+  }
+  return NULL;
+}
+
+void clLogBegin(clLogCursor *cursor, const clLogReader *log, int32_t cmd,
+                uint64_t from, uint64_t to) {
+  cursor->log = log;
+  cursor->cmd = cmd;
+  cursor->from = from;
+  cursor->to = to;
+  cursor->block = log->first;
+  cursor->pos = 0;
+  cursor->end = 0;
+}
+
+// Moves to the next block that may hold a matching record; the block
+// headers are the index, records of skipped blocks are never touched.
+static int nextBlock(clLogCursor *cursor) {
+  const clLogReader *log = cursor->log;
+  uint64_t bit = (uint64_t)1 << ((uint32_t)cursor->cmd % 64);
+
+  while (log->size - cursor->block >= sizeof(clBlockHeader)) {
+    clBlockHeader block;
+    const uint8_t *p = log->data + cursor->block;
+    memcpy(&block, p, sizeof(block));
+    if (!validBlock(&block, log->size - cursor->block)) {
+      return cl_ERR_VALUE;
+    }
+
+    size_t start = cursor->block;
+    cursor->block += block.padded;
+    if ((cursor->cmd >= 0 && !(block.cmds & bit)) ||
+        block.last < cursor->from || block.first > cursor->to) {
+      continue;
+    }
+
+    cursor->pos = start + sizeof(block);
+    cursor->end = start + block.used;
+    return 1;
+  }
+  return 0;
+}
+
+int clLogNext(clLogCursor *cursor, clLogRecord *record) {
+  const clLogReader *log = cursor->log;
+
+  for (;;) {
+    if (cursor->pos == cursor->end) {
+      int more = nextBlock(cursor);
+      if (more <= 0) {
+        return more;
+      }
+      continue;
+    }
+
+    clRecordHeader header;
+    if (cursor->end - cursor->pos < sizeof(header)) {
+      return cl_ERR_VALUE;
+    }
+    memcpy(&header, log->data + cursor->pos, sizeof(header));
+    cursor->pos += sizeof(header);
+    if (header.size < 0 ||
+        (size_t)header.size > cursor->end - cursor->pos) {
+      return cl_ERR_VALUE;
+    }
+
+    const uint8_t *data = log->data + cursor->pos;
+    cursor->pos += (size_t)header.size;
+    if ((cursor->cmd >= 0 && header.cmd != cursor->cmd) ||
+        header.timestamp < cursor->from || header.timestamp > cursor->to) {
+      continue;
+    }
+
+    record->cmd = header.cmd;
+    record->timestamp = header.timestamp;
+    record->data = data;
+    record->size = (size_t)header.size;
+    return 1;
+  }
+}
@@ -0,0 +1,201 @@
+#include "internal.h"
+
+#define CACHE_SIZE 64  // power of two
+#define CACHE_PATH 48  // longer paths are resolved every time
+
+typedef struct {
+  const clColumn *root;
+  uint32_t len;
+  char path[CACHE_PATH];
+  clPath result;
+} clCacheEntry;
+
+// Reset with the program cache, when a descriptor may have been released.
+static _Thread_local clCacheEntry cache[CACHE_SIZE];
+static _Thread_local uint64_t seen;
+
+// must match hash_name() in src/gen_lookup.py
+static uint32_t clHashName(const char *name, size_t len, uint32_t seed) {
+  uint32_t h = 2166136261u ^ seed;
+  for (size_t i = 0; i < len; ++i) {
+    h ^= (uint8_t)name[i];
+    h *= 16777619u;
+  }
+  h ^= h >> 15;
+  h *= 0x2c1b3c6du;
+  h ^= h >> 12;
+  return h;
+}
+
+static bool isNamed(const clColumn *column, const char *name, size_t len) {
+  return (size_t)column->name.len == len &&
+         memcmp(column->name.string, name, len) == 0;
+}
+
+const clColumn *clFindColumn(const clColumn *column, const char *name,
+                             size_t len) {
+  const clColumn *columns;
+  int32_t num;
+  const clLookup *lookup;
+
+  switch (column->tp) {
+  case cl_OBJECT:
+    columns = column->via_object.columns;
+    num = column->via_object.num;
+    lookup = column->via_object.lookup;
+    break;
+
+  case cl_UNION:
+    columns = column->via_union.columns;
+    num = column->via_union.num;
+    lookup = column->via_union.lookup;
+    break;
+
+  default:
+    return NULL;
+  }
+
+  if (lookup) {
+    uint32_t slot = clHashName(name, len, lookup->seed) & (lookup->num - 1);
+    int16_t idx = lookup->slots[slot];
+    if (idx < 0 || !isNamed(&columns[idx], name, len)) {
+      return NULL;
+    }
+    return &columns[idx];
+  }
+
+  for (int32_t i = 0; i < num; ++i) {
+    if (isNamed(&columns[i], name, len)) {
+      return &columns[i];
+    }
+  }
+  return NULL;
+}
+
+// Parses "[N]" at PATH, returns the number of characters consumed or 0.
+static size_t parseIndex(const char *path, size_t len, int64_t *idx) {
+  if (len < 3 || path[0] != '[') {
+    return 0;
+  }
+
+  int64_t v = 0;
+  size_t i = 1;
+  for (; i < len && path[i] >= '0' && path[i] <= '9'; ++i) {
+    v = v * 10 + (path[i] - '0');
+    if (v > INT32_MAX) {
+      return 0;
+    }
+  }
+
+  if (i == 1 || i >= len || path[i] != ']') {
+    return 0;
+  }
+  *idx = v;
+  return i + 1;
+}
+
+static int resolve(const clColumn *root, const char *path, size_t len,
+                   clPath *out) {
+  const clColumn *container = root;
+  const clColumn *column = NULL;
+  ptrdiff_t offset = 0;
+  size_t pos = 0;
+
+  while (pos < len) {
+    if (!container) {
+      return cl_ERR_VALUE;
+    }
+
+    size_t end = pos;
+    while (end < len && path[end] != '.' && path[end] != '[') {
+      ++end;
+    }
+
+    column = clFindColumn(container, path + pos, end - pos);
+    if (!column) {
+      return cl_ERR_VALUE;
+    }
+    offset += column->offset;
+    pos = end;
+
+    container = NULL;
+    switch (column->tp) {
+    case cl_OBJECT:
+    case cl_UNION:
+      container = column;
+      break;
+
+    case cl_FIXED_ARRAY:
+    case cl_FLEXIBLE_ARRAY: {
+      bool fixed = column->tp == cl_FIXED_ARRAY;
+      int32_t capacity = fixed ? column->via_fixed_array.capacity
+                               : column->via_flexible_array.capacity;
+      const clColumn *element = fixed ? column->via_fixed_array.columns
+                                      : column->via_flexible_array.columns;
+
+      int64_t idx = 0;
+      size_t n = parseIndex(path + pos, len - pos, &idx);
+      if (n && idx >= capacity) {
+        return cl_ERR_VALUE;
+      }
+      pos += n;
+      offset += (ptrdiff_t)idx * clElementSize(column, capacity);
+      container = element;
+      break;
+    }
+
+    default:
+      break;
+    }
+
+    if (pos < len) {
+      if (path[pos] != '.') {
+        return cl_ERR_VALUE;
+      }
+      ++pos;
+      if (pos == len) {
+        return cl_ERR_VALUE;
+      }
+    }
+  }
+
+  if (!column) {
+    return cl_ERR_VALUE;
+  }
+
+  out->column = column;
+  out->offset = offset;
+  return 0;
+}
+
+int clResolvePath(const clColumn *root, const char *path, size_t len,
+                  clPath *out) {
+  if (len >= CACHE_PATH) {
+    return resolve(root, path, len, out);
+  }
+
+  uint64_t e = clProgramEpoch();
+  if (e != seen) {
+    memset(cache, 0, sizeof(cache));
+    seen = e;
+  }
+
+  uint32_t h = clHashName(path, len, (uint32_t)(uintptr_t)root);
+  clCacheEntry *entry = &cache[h & (CACHE_SIZE - 1)];
+  if (entry->root == root && entry->len == len &&
+      memcmp(entry->path, path, len) == 0) {
+    *out = entry->result;
+    return 0;
+  }
+
+  int err = resolve(root, path, len, out);
+  if (err) {
+    return err;
+  }
+
+  entry->root = root;
+  entry->len = (uint32_t)len;
+  memcpy(entry->path, path, len);
+  entry->result = *out;
+  return 0;
+}
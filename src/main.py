@@ -12,6 +12,9 @@ sys.dont_write_bytecode = True
 import ctypes
 import getopt
 import dataclasses
+import hashlib
+import json
+from concurrent.futures import ProcessPoolExecutor
 from io import StringIO
 import os
 import re
@@ -27,6 +30,12 @@ from clang.cindex import (
 )
 
 import plugin_stub
+import layout
+import gen_codec
+import gen_dispatch
+import gen_hpp
+import gen_lookup
+import gen_packed
 
 
 @dataclasses.dataclass
@@ -34,23 +43,39 @@ class Context:
     tu: TranslationUnit
     header_sio: StringIO
     current_object_sio: StringIO
-    object_stack: list[tuple[str, StringIO]]
+    object_stack: list[tuple[str, str, StringIO]]
     source_sio: StringIO
     parent_tp_str: str
     prev_cursor: Cursor
     source_code: bytes
+    codec: bool
+    commands: dict[int, gen_dispatch.Command]
+    hpp_sio: StringIO | None = None
+    parent_cpp_str: str = ""
+    hpp_fields: list[tuple[str, str]] = dataclasses.field(default_factory=list)
+    hpp_unions: dict[str, list[tuple[str, str]]] = dataclasses.field(
+        default_factory=dict
+    )
+    union_cases: set[str] = dataclasses.field(default_factory=set)
+    packed: bool = False
+    twins: dict[str, gen_packed.Twin] = dataclasses.field(default_factory=dict)
+    layout_sio: StringIO | None = None
 
-    def push_new_object(self, parent_tp_str: str):
+    def push_new_object(self, parent_tp_str: str, parent_cpp_str: str = ""):
         self.prev_cursor = None
-        self.object_stack.append((self.parent_tp_str, self.current_object_sio))
+        self.object_stack.append(
+            (self.parent_tp_str, self.parent_cpp_str, self.current_object_sio)
+        )
         self.parent_tp_str = parent_tp_str
+        self.parent_cpp_str = parent_cpp_str or parent_tp_str
         self.current_object_sio = StringIO()
 
     def pop_object(self):
-        parent_tp_str, current_object_sio = self.object_stack.pop()
+        parent_tp_str, parent_cpp_str, current_object_sio = self.object_stack.pop()
         self.source_sio.write(self.current_object_sio.getvalue())
         self.current_object_sio = current_object_sio
         self.parent_tp_str = parent_tp_str
+        self.parent_cpp_str = parent_cpp_str
 
 
 def get_compile_args(include_dirs: list[str], standard: str) -> list[str]:
@@ -81,46 +106,6 @@ def in_system_header(location: SourceLocation) -> bool:
     return conf.lib.clang_Location_isInSystemHeader(location) > 0
 
 
-CHAR_TYPE = [
-    TypeKind.CHAR_U,
-    TypeKind.CHAR_S,
-    TypeKind.UCHAR,
-    TypeKind.CHAR16,
-    TypeKind.CHAR32,
-    TypeKind.USHORT,
-    TypeKind.UINT,
-    TypeKind.CHAR_S,
-    TypeKind.SCHAR,
-    TypeKind.SHORT,
-    TypeKind.INT,
-]
-
-BASE_TYPE = [
-    TypeKind.BOOL,
-    TypeKind.CHAR_U,
-    TypeKind.CHAR_S,
-    TypeKind.UCHAR,
-    TypeKind.CHAR16,
-    TypeKind.CHAR32,
-    TypeKind.USHORT,
-    TypeKind.UINT,
-    TypeKind.ULONG,
-    TypeKind.ULONGLONG,
-    TypeKind.UINT128,
-    TypeKind.CHAR_S,
-    TypeKind.SCHAR,
-    TypeKind.SHORT,
-    TypeKind.INT,
-    TypeKind.LONG,
-    TypeKind.LONGLONG,
-    TypeKind.INT128,
-    TypeKind.FLOAT,
-    TypeKind.DOUBLE,
-    TypeKind.LONGDOUBLE,
-    TypeKind.ENUM,
-]
-
-
 def get_tp_str(cursor: Cursor) -> str:
     declaration = cursor.type.get_declaration()
     if not declaration.is_anonymous():
@@ -139,7 +124,7 @@ def get_unique_name(cursor: Cursor) -> str:
 def process_string(cursor: Cursor, ctx: Context):
     element_type = cursor.type.get_array_element_type()
 
-    if element_type.kind not in CHAR_TYPE:
+    if element_type.kind not in layout.CHAR_TYPE:
         raise Exception("类型错误")
 
     element_type = element_type.get_canonical().get_declaration()
@@ -152,70 +137,114 @@ def process_string(cursor: Cursor, ctx: Context):
     )
 
 
-def process_array(cursor: Cursor, ctx: Context):
+def process_array(cursor: Cursor, ctx: Context, prefix_str: str):
     element_type = cursor.type.get_array_element_type()
     element_type_declaration = element_type.get_canonical().get_declaration()
 
-    array_or_flexable_array = {True: "FLEXIBLE_ARRAY", False: "FIXED_ARRAY"}
-
-    is_flexable_array = False
-    if ctx.prev_cursor:
-        is_flexable_array = plugin_stub.check_is_flexable_array(ctx.prev_cursor, cursor)
-    prefix_str = array_or_flexable_array.get(is_flexable_array)
+    args = [ctx.parent_tp_str, cursor.spelling]
+    if prefix_str == layout.FLEXIBLE_ARRAY:
+        args.append(ctx.prev_cursor.spelling)
 
     if element_type_declaration.kind != CursorKind.NO_DECL_FOUND:
-        element_name = plugin_stub.generate_object_name(element_type_declaration)
+        args.append(plugin_stub.generate_object_name(element_type_declaration))
         ctx.current_object_sio.write(
-            f"    DEFINE_FIELD_OBJECT_{prefix_str}({ctx.parent_tp_str}, {cursor.spelling}, {element_name}),\n"
+            f"    DEFINE_FIELD_OBJECT_{prefix_str}({', '.join(args)}),\n"
         )
     else:
         ctx.current_object_sio.write(
-            f"    DEFINE_FIELD_{prefix_str}({ctx.parent_tp_str}, {cursor.spelling}),\n"
+            f"    DEFINE_FIELD_{prefix_str}({', '.join(args)}),\n"
         )
 
 
-def process_field(cursor: Cursor, ctx: Context):
-    canonical_type = cursor.type.get_canonical()
-    element_type_declaration = canonical_type.get_declaration()
+def process_field(cursor: Cursor, ctx: Context) -> bool:
+    kind = layout.get_field_kind(cursor, ctx.prev_cursor)
+    tag = layout.get_union_tag(cursor) if kind == layout.UNION else None
+
+    if ctx.hpp_sio and tag:
+        declaration = cursor.type.get_canonical().get_declaration()
+        ctx.hpp_fields.append(
+            (
+                cursor.spelling,
+                gen_hpp.render_tagged_union(
+                    ctx.parent_cpp_str,
+                    cursor.spelling,
+                    tag,
+                    layout.get_union_cases(declaration),
+                    ctx.hpp_unions[get_unique_name(declaration)],
+                ),
+            )
+        )
+    elif ctx.hpp_sio and kind:
+        len_field = ctx.prev_cursor.spelling if ctx.prev_cursor else ""
+        ctx.hpp_fields.append(
+            (
+                cursor.spelling,
+                gen_hpp.render_field(
+                    kind, ctx.parent_cpp_str, cursor.spelling, len_field
+                ),
+            )
+        )
 
-    if canonical_type.kind in BASE_TYPE:
+    if kind == layout.NUMBER:
         ctx.prev_cursor = cursor
+        enum_range = layout.get_enum_range(cursor)
+        if enum_range:
+            ctx.current_object_sio.write(
+                f"    DEFINE_FIELD_ENUM({ctx.parent_tp_str}, {cursor.spelling}, "
+                f"{enum_range[0]}, {enum_range[1]}),\n"
+            )
+            return True
+
         ctx.current_object_sio.write(
             f"    DEFINE_FIELD_NUMBER({ctx.parent_tp_str}, {cursor.spelling}),\n"
         )
-        return
-
-    if canonical_type.kind in (
-        TypeKind.CONSTANTARRAY,
-        TypeKind.VARIABLEARRAY,
-    ):
-        comment = cursor.raw_comment
-        if comment:
-            if "@string" in comment:
-                process_string(cursor, ctx)
-                return
+        return True
 
-        element_type = cursor.type.get_array_element_type()
-        if element_type.spelling == "char":
-            process_string(cursor, ctx)
-            return
+    if kind == layout.STRING:
+        process_string(cursor, ctx)
+        return True
 
-        process_array(cursor, ctx)
-        return
+    if kind in (layout.FIXED_ARRAY, layout.FLEXIBLE_ARRAY):
+        process_array(cursor, ctx, kind)
+        return True
 
-    if element_type_declaration.kind in (CursorKind.STRUCT_DECL, CursorKind.UNION_DECL):
+    if kind in (layout.OBJECT, layout.UNION):
         struct_or_union = {
-            CursorKind.UNION_DECL: "DEFINE_FIELD_UNION",
-            CursorKind.STRUCT_DECL: "DEFINE_FIELD_OBJECT",
+            layout.UNION: "DEFINE_FIELD_UNION",
+            layout.OBJECT: "DEFINE_FIELD_OBJECT",
         }
 
-        prefix_str = struct_or_union.get(element_type_declaration.kind)
+        prefix_str = struct_or_union.get(kind)
 
+        element_type_declaration = cursor.type.get_canonical().get_declaration()
         unique_name = get_unique_name(element_type_declaration)
 
+        if tag:
+            process_cases(element_type_declaration, unique_name, ctx)
+            ctx.current_object_sio.write(
+                f"    DEFINE_FIELD_TAGGED_UNION({ctx.parent_tp_str}, {cursor.spelling}, "
+                f"{unique_name}, {tag}, {unique_name}Cases),\n"
+            )
+            return True
+
         ctx.current_object_sio.write(
             f"    {prefix_str}({ctx.parent_tp_str}, {cursor.spelling}, {unique_name}),\n"
         )
+        return True
+
+    return False
+
+
+def process_cases(declaration: Cursor, unique_name: str, ctx: Context):
+    if unique_name in ctx.union_cases:
+        return
+    ctx.union_cases.add(unique_name)
+
+    # ahead of the table being written, which refers to it
+    cases = ", ".join(str(i) for i in layout.get_union_cases(declaration))
+    ctx.source_sio.write(
+        f"static const int16_t {unique_name}Cases[] = {{{cases}}};\n"
+    )
 
 
 def process_inline_union_or_struct(cursor: Cursor, ctx: Context):
@@ -256,6 +285,9 @@ def process_union_or_struct(cursor: Cursor, ctx: Context):
     ctx.current_object_sio.write(f"// {fname}:{line}:{column}\n")
     ctx.current_object_sio.write(f"static const clColumn {unique_name}[] = {{\n")
 
+    names = []
+    hpp_fields = ctx.hpp_fields
+    ctx.hpp_fields = []
     for child in cursor.get_children():
         name = child.spelling
 
@@ -268,17 +300,33 @@ def process_union_or_struct(cursor: Cursor, ctx: Context):
 
         if child.is_anonymous():
             tp_str = get_tp_str(child)
-            ctx.push_new_object(tp_str)
+            ctx.push_new_object(
+                tp_str, gen_hpp.member_type(ctx.parent_cpp_str, name)
+            )
             process_union_or_struct(child.type.get_declaration(), ctx)
             ctx.pop_object()
 
-        process_field(child, ctx)
+        if process_field(child, ctx):
+            names.append(name)
 
     ctx.current_object_sio.write("};\n")
+    ctx.current_object_sio.write(gen_lookup.render_lookup(unique_name, names))
 
+    fields, ctx.hpp_fields = ctx.hpp_fields, hpp_fields
     if cursor.kind != CursorKind.STRUCT_DECL:
+        ctx.hpp_unions[unique_name] = fields
         return
 
+    if ctx.hpp_sio:
+        ctx.hpp_sio.write(
+            gen_hpp.render_descriptor(
+                ctx.parent_cpp_str,
+                cursor.type.get_size(),
+                f"{fname}:{line}:{column}",
+                fields,
+            )
+        )
+
     if not cursor.is_anonymous():
         ctx.current_object_sio.write(f"const clColumn {object_name}[] = {{\n")
         ctx.current_object_sio.write(
@@ -288,9 +336,89 @@ def process_union_or_struct(cursor: Cursor, ctx: Context):
         ctx.current_object_sio.write("};\n")
         ctx.header_sio.write(f"extern const struct clColumn {object_name}[];\n")
 
+        if ctx.codec:
+            process_codec(cursor, ctx)
+
+        process_packed(cursor, ctx, f"{fname}:{line}:{column}")
+
+        process_command(cursor, ctx, object_name, f"{fname}:{line}:{column}")
+
         plugin_stub.end_object(cursor, object_name)
 
 
+def declare_type(ctx: Context):
+    tp_str = ctx.parent_tp_str
+    if tp_str.startswith("struct ") and "::" not in tp_str:
+        ctx.header_sio.write(f"{tp_str};\n")
+
+
+def process_codec(cursor: Cursor, ctx: Context):
+    tp_str = ctx.parent_tp_str
+    declare_type(ctx)
+
+    ctx.header_sio.write(gen_codec.render_declarations(cursor.spelling, tp_str))
+    ctx.current_object_sio.write(
+        gen_codec.render_definitions(
+            cursor.spelling,
+            tp_str,
+            cursor.type.get_size(),
+            layout.walk_record(cursor),
+        )
+    )
+
+
+def process_packed(cursor: Cursor, ctx: Context, location: str):
+    if not ctx.packed and ctx.layout_sio is None:
+        return
+
+    fields = gen_packed.collect_fields(cursor, ctx.twins)
+    if ctx.layout_sio is not None:
+        ctx.layout_sio.write(
+            gen_packed.render_report(
+                location,
+                ctx.parent_tp_str,
+                cursor.type.get_size(),
+                cursor.type.get_align(),
+                fields,
+            )
+        )
+
+    # a struct without fields has no twin, C has no empty structs
+    if not ctx.packed or not fields:
+        return
+
+    if not ctx.codec:
+        declare_type(ctx)
+    ctx.header_sio.write(
+        gen_packed.render_declarations(cursor.spelling, ctx.parent_tp_str, fields)
+    )
+    ctx.current_object_sio.write(
+        gen_packed.render_definitions(
+            cursor.spelling, ctx.parent_tp_str, cursor.type.get_size(), fields
+        )
+    )
+    ctx.twins[gen_packed.layout_key(cursor)] = gen_packed.Twin(
+        cursor.spelling, sum(f.packed_size for f in fields)
+    )
+
+
+def process_command(cursor: Cursor, ctx: Context, object_name: str, location: str):
+    cmd = gen_dispatch.parse_cmd(cursor.raw_comment)
+    if cmd is None:
+        return
+
+    gen_dispatch.add_command(
+        ctx.commands,
+        gen_dispatch.Command(
+            cmd=cmd,
+            name=cursor.spelling,
+            object_name=object_name,
+            tp_str=ctx.parent_tp_str,
+            location=location,
+        ),
+    )
+
+
 def search_union_or_struct(cursor: Cursor, ctx: Context):
     if not cursor.spelling:
         return
@@ -332,7 +460,9 @@ SOURCE_CODE_TPL = """
 // generated by the columns. DO NOT EDIT!
 
 #define USE_COLUMN_MACROS
+#define COLUMN_LOOKUP(FIELDS) (&FIELDS##Lookup)
 #include <columns.h>
+#include <string.h>
 
 $includes
 
@@ -348,6 +478,21 @@ $extra_output
 #endif
 """
 
+HPP_CODE_TPL = """
+#pragma once
+
+// generated by the columns. DO NOT EDIT!
+#include <columns.hpp>
+
+$includes
+
+namespace cl {
+
+$code
+
+} // namespace cl
+"""
+
 HEADER_CODE_TPL = """
 #pragma once
 
@@ -385,20 +530,301 @@ def render_include(path: str) -> str:
     return f'#include "{path}"\n'
 
 
+def render_dispatch(
+    name: str, commands: dict[int, gen_dispatch.Command], header_paths: list[str]
+) -> tuple[str, str]:
+    if not commands:
+        raise Exception("no cmd ids found for --dispatch")
+
+    sorted_commands = gen_dispatch.check_dense(commands)
+    return (
+        render_tpl(
+            HEADER_CODE_TPL,
+            {
+                "includes": "".join(map(render_include, header_paths)),
+                "code": gen_dispatch.render_declarations(name, sorted_commands),
+                "extra_output": "",
+            },
+        ),
+        render_tpl(
+            SOURCE_CODE_TPL,
+            {
+                "includes": render_include(f"{name}_def.h"),
+                "code": gen_dispatch.render_definitions(name, sorted_commands),
+                "extra_output": "",
+            },
+        ),
+    )
+
+
 def guess_suffix(standard: str) -> str:
     if "+" in standard:
         return "cpp"
     return "c"
 
 
+@dataclasses.dataclass
+class Options:
+    work_dir: str
+    includes: list[str]
+    standard: str
+    plugin: str
+    codec: bool
+    hpp: bool
+    packed: bool
+    layout: bool
+
+
+@dataclasses.dataclass
+class Unit:
+    header_path: str
+    header: str
+    source: str
+    hpp: str
+    layout: str
+    commands: list[gen_dispatch.Command]
+    deps: list[str]
+
+
+def register_functions():
+    functions = [
+        ("clang_Location_isInSystemHeader", [SourceLocation], ctypes.c_int),
+    ]
+
+    for item in functions:
+        register_function(conf.lib, item, not Config.compatibility_check)
+
+
+def init_worker(options: Options):
+    os.chdir(options.work_dir)
+    register_functions()
+
+    if len(options.plugin) > 0:
+        plugin_stub.load_plugin(options.plugin)
+
+
+def generate_unit(path: str, options: Options) -> Unit:
+    plugin_stub.init()
+
+    source_code = bytes()
+
+    with open(path, "rb") as f:
+        source_code = f.read()
+
+    tu = create_unit(path, options.includes, options.standard)
+
+    path = tu.spelling
+    header_path = os.path.relpath(path, options.work_dir)
+    commands = dict()
+    ctx = Context(
+        tu=tu,
+        header_sio=StringIO(),
+        current_object_sio=StringIO(),
+        object_stack=list(),
+        source_sio=StringIO(),
+        parent_tp_str="",
+        prev_cursor=None,
+        source_code=source_code,
+        codec=options.codec,
+        commands=commands,
+        hpp_sio=StringIO() if options.hpp else None,
+        packed=options.packed,
+        layout_sio=StringIO() if options.layout else None,
+    )
+
+    search_namespace_or_union_or_struct(tu.cursor, ctx)
+
+    extra_output = plugin_stub.complete()
+    if not extra_output:
+        extra_output = ("", "")
+
+    includes_str = ""
+    if len(options.includes) > 0:
+        includes_str = "".join(map(render_include, options.includes))
+
+    # the twins are declared in the header, next to their converters
+    source_includes = render_include(header_path)
+    if options.packed:
+        stem, _ = os.path.splitext(os.path.basename(header_path))
+        source_includes += render_include(f"{stem}_def.h")
+
+    return Unit(
+        header_path=header_path,
+        header=render_tpl(
+            HEADER_CODE_TPL,
+            {
+                "includes": includes_str,
+                "code": ctx.header_sio.getvalue().strip(),
+                "extra_output": extra_output[0],
+            },
+        ),
+        source=render_tpl(
+            SOURCE_CODE_TPL,
+            {
+                "includes": source_includes,
+                "code": ctx.source_sio.getvalue().strip(),
+                "extra_output": extra_output[1],
+            },
+        ),
+        hpp=render_tpl(
+            HPP_CODE_TPL,
+            {
+                "includes": render_include(header_path),
+                "code": ctx.hpp_sio.getvalue().strip(),
+            },
+        )
+        if options.hpp
+        else "",
+        layout=ctx.layout_sio.getvalue() if ctx.layout_sio else "",
+        commands=list(commands.values()),
+        deps=[os.path.abspath(path)]
+        + [os.path.abspath(i.include.name) for i in tu.get_includes()],
+    )
+
+
+def hash_file(path: str) -> str:
+    try:
+        with open(path, "rb") as f:
+            return hashlib.sha256(f.read()).hexdigest()
+    except OSError:
+        return ""
+
+
+class Cache:
+    """
+    Units of unchanged inputs, one json file per input. An entry is valid
+    while its key (the input, the flags, the plugin and the generator
+    itself) and the contents of every header the input included are
+    unchanged.
+    """
+
+    def __init__(self, cache_dir: str, options: Options):
+        self.cache_dir = cache_dir
+
+        h = hashlib.sha256()
+        src_dir = os.path.dirname(os.path.abspath(__file__))
+        for name in sorted(os.listdir(src_dir)):
+            if name.endswith(".py"):
+                h.update(hash_file(os.path.join(src_dir, name)).encode())
+
+        flags = dataclasses.astuple(options)
+        h.update(json.dumps(flags).encode())
+        if len(options.plugin) > 0:
+            h.update(hash_file(options.plugin).encode())
+        self.salt = h.hexdigest()
+
+    def entry_path(self, path: str) -> str:
+        name = hashlib.sha256(os.path.abspath(path).encode()).hexdigest()
+        return os.path.join(self.cache_dir, f"{name}.json")
+
+    def key(self, path: str) -> str:
+        return f"{self.salt}:{hash_file(path)}"
+
+    def load(self, path: str) -> Unit | None:
+        try:
+            with open(self.entry_path(path), encoding="UTF-8") as f:
+                entry = json.load(f)
+        except (OSError, ValueError):
+            return None
+
+        if entry.get("key") != self.key(path):
+            return None
+
+        for dep, digest in entry["deps"].items():
+            if hash_file(dep) != digest:
+                return None
+
+        unit = Unit(**entry["unit"])
+        unit.commands = [gen_dispatch.Command(**c) for c in unit.commands]
+        return unit
+
+    def store(self, path: str, unit: Unit):
+        entry = {
+            "key": self.key(path),
+            "deps": {dep: hash_file(dep) for dep in unit.deps},
+            "unit": dataclasses.asdict(unit),
+        }
+
+        os.makedirs(self.cache_dir, exist_ok=True)
+        tmp_path = self.entry_path(path) + ".tmp"
+        with open(tmp_path, mode="w", encoding="UTF-8") as out:
+            json.dump(entry, out)
+        os.replace(tmp_path, self.entry_path(path))
+
+
+def generate_units(inputs: list[str], options: Options, jobs: int) -> list[Unit]:
+    if not inputs:
+        return []
+
+    if jobs <= 1 or len(inputs) <= 1:
+        init_worker(options)
+        return [generate_unit(path, options) for path in inputs]
+
+    # every worker parses its inputs with its own Index
+    with ProcessPoolExecutor(
+        max_workers=min(jobs, len(inputs)),
+        initializer=init_worker,
+        initargs=(options,),
+    ) as executor:
+        futures = [executor.submit(generate_unit, path, options) for path in inputs]
+        return [future.result() for future in futures]
+
+
+def write_if_changed(path: str, text: str):
+    # keep the timestamp of unchanged outputs, so that nothing rebuilds
+    data = text.replace("\n", os.linesep).encode("UTF-8")
+    try:
+        with open(path, "rb") as f:
+            if f.read() == data:
+                return
+    except OSError:
+        pass
+
+    with open(path, mode="wb") as out:
+        out.write(data)
+
+
+def escape_dep(path: str) -> str:
+    return path.replace("\\", "\\\\").replace(" ", "\\ ").replace("$", "$$")
+
+
+def write_depfile(path: str, outputs: list[str], deps: list[str]):
+    lines = [" ".join(map(escape_dep, outputs)) + ": \\"]
+    lines += [f"  {escape_dep(dep)} \\" for dep in deps]
+    lines.append("")
+    write_if_changed(path, "\n".join(lines) + "\n")
+
+
 def main():
     inputs = []
     includes = []
     work_dir = os.getcwd()
     standard = "c11"
     plugin = ""
-
-    opts, args = getopt.getopt(sys.argv[1:], "C:I:p:", ["std="])
+    codec = False
+    hpp = False
+    packed = False
+    layout = False
+    dispatch = ""
+    jobs = os.cpu_count() or 1
+    cache_dir = ".columns-cache"
+    depfile = ""
+
+    opts, args = getopt.getopt(
+        sys.argv[1:],
+        "C:I:p:j:",
+        [
+            "std=",
+            "codec",
+            "hpp",
+            "packed",
+            "layout",
+            "dispatch=",
+            "cache=",
+            "no-cache",
+            "depfile=",
+        ],
+    )
     for opt in opts:
         if opt[0] == "-C":
             work_dir = opt[1]
@@ -408,87 +834,102 @@ def main():
             standard = opt[1]
         elif opt[0] == "-p":
             plugin = opt[1]
+        elif opt[0] == "--codec":
+            codec = True
+        elif opt[0] == "--hpp":
+            hpp = True
+        elif opt[0] == "--packed":
+            packed = True
+        elif opt[0] == "--layout":
+            layout = True
+        elif opt[0] == "--dispatch":
+            dispatch = opt[1]
+        elif opt[0] == "-j":
+            jobs = int(opt[1])
+        elif opt[0] == "--cache":
+            cache_dir = opt[1]
+        elif opt[0] == "--no-cache":
+            cache_dir = ""
+        elif opt[0] == "--depfile":
+            depfile = opt[1]
 
     inputs.extend(args)
 
     os.chdir(work_dir)
     work_dir = os.getcwd()
 
-    outputs = dict()
-
-    if len(plugin) > 0:
-        plugin_stub.load_plugin(plugin)
+    options = Options(
+        work_dir=work_dir,
+        includes=includes,
+        standard=standard,
+        plugin=plugin,
+        codec=codec,
+        hpp=hpp,
+        packed=packed,
+        layout=layout,
+    )
 
-    for path in inputs:
-        plugin_stub.init()
+    units = dict()
+    cache = Cache(cache_dir, options) if cache_dir else None
+    if cache:
+        for path in inputs:
+            unit = cache.load(path)
+            if unit:
+                units[path] = unit
 
-        source_code = bytes()
+    missing = [path for path in inputs if path not in units]
+    for path, unit in zip(missing, generate_units(missing, options, jobs)):
+        units[path] = unit
+        if cache:
+            cache.store(path, unit)
 
-        with open(path, "rb") as f:
-            source_code = f.read()
-
-        tu = create_unit(path, includes, standard)
-
-        path = tu.spelling
-        header_path = os.path.relpath(path, work_dir)
-        ctx = Context(
-            tu=tu,
-            header_sio=StringIO(),
-            current_object_sio=StringIO(),
-            object_stack=list(),
-            source_sio=StringIO(),
-            parent_tp_str="",
-            prev_cursor=None,
-            source_code=source_code,
-        )
+    outputs = dict()
+    hpp_outputs = dict()
+    commands = dict()
+    header_paths = []
+    deps = dict()
 
-        search_namespace_or_union_or_struct(tu.cursor, ctx)
-
-        extra_output = plugin_stub.complete()
-        if not extra_output:
-            extra_output = ("", "")
-
-        stem, _ = os.path.splitext(header_path)
-
-        includes_str = ""
-        if len(includes) > 0:
-            includes_str = "".join(map(render_include, includes))
-
-        outputs[stem] = (
-            render_tpl(
-                HEADER_CODE_TPL,
-                {
-                    "includes": includes_str,
-                    "code": ctx.header_sio.getvalue().strip(),
-                    "extra_output": extra_output[0],
-                },
-            ),
-            render_tpl(
-                SOURCE_CODE_TPL,
-                {
-                    "includes": render_include(header_path),
-                    "code": ctx.source_sio.getvalue().strip(),
-                    "extra_output": extra_output[1],
-                },
-            ),
+    # merged in the order of the inputs, whichever finished first
+    for path in inputs:
+        unit = units[path]
+        for command in unit.commands:
+            gen_dispatch.add_command(commands, command)
+
+        stem, _ = os.path.splitext(unit.header_path)
+        header_paths.append(unit.header_path)
+        header_paths.append(f"{stem}_def.h")
+        deps.update(dict.fromkeys(unit.deps))
+        sys.stdout.write(unit.layout)
+
+        outputs[stem] = (unit.header, unit.source)
+        if unit.hpp:
+            hpp_outputs[stem] = unit.hpp
+
+    if dispatch:
+        if dispatch in outputs:
+            raise Exception(f"--dispatch={dispatch} collides with an input header")
+        outputs[dispatch] = render_dispatch(
+            dispatch, commands, header_paths
         )
 
     suffix = guess_suffix(standard)
+    output_paths = []
 
     for stem, (header, source) in outputs.items():
-        with open(f"{stem}_def.h", mode="w", encoding="UTF-8") as out:
-            out.write(header)
+        output_paths.append(f"{stem}_def.h")
+        output_paths.append(f"{stem}_def.{suffix}")
+        write_if_changed(f"{stem}_def.h", header)
+        write_if_changed(f"{stem}_def.{suffix}", source)
 
-        with open(f"{stem}_def.{suffix}", mode="w", encoding="UTF-8") as out:
-            out.write(source)
+    for stem, hpp_code in hpp_outputs.items():
+        output_paths.append(f"{stem}_def.hpp")
+        write_if_changed(f"{stem}_def.hpp", hpp_code)
 
+    if depfile:
+        if len(plugin) > 0:
+            deps[os.path.abspath(plugin)] = None
+        write_depfile(depfile, output_paths, list(deps))
 
-if __name__ == "__main__":
-    functions = [
-        ("clang_Location_isInSystemHeader", [SourceLocation], ctypes.c_int),
-    ]
-
-    for item in functions:
-        register_function(conf.lib, item, not Config.compatibility_check)
 
+if __name__ == "__main__":
     main()
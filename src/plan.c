@@ -0,0 +1,747 @@
+#include "internal.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+// A plan decodes the cl_WIRE_RAW encoding of a writer descriptor into the
+// struct of a reader descriptor. It is a flat list of ops in the order of
+// the writer fields: nested objects are inlined with their offsets added
+// up, fields of equal type that are adjacent in the reader struct are
+// merged into one copy, and the ops of an array element follow its
+// OP_ARRAY. The count of a flexible array is kept in a register set by its
+// length field, which the encoding always has in front of the array.
+
+#define MAX_DEPTH 64
+#define PLAN_REGISTERS 32
+#define PLAN_BUCKETS 16 // power of two
+
+enum {
+  OP_COPY,   // SRC_SIZE bytes to DST
+  OP_SKIP,   // SRC_SIZE bytes
+  OP_ZERO,   // DST_SIZE bytes at DST, a field the writer does not have
+  OP_INT,    // an integer of another size or signedness
+  OP_FLOAT,  // a float of another size
+  OP_STRING, // up to the terminator
+  OP_ARRAY,  // COUNT elements, the next SUB ops for elements of objects
+};
+
+struct clPlanOp {
+  int8_t op;
+  int8_t convert; // OP_COPY, OP_INT or OP_FLOAT for elements of numbers
+  int8_t src_tp;
+  int8_t dst_tp;
+  int32_t src_size; // of a number or element
+  int32_t dst_size;
+  int32_t count;    // elements of a fixed array, characters of a string
+  int32_t capacity; // of the reader array or string
+  int32_t reg;      // set by a length field, read by a flexible array
+  int32_t sub;
+  ptrdiff_t dst; // from the current object or element, -1 to drop
+  ptrdiff_t len; // length field of a reader flexible array, or -1
+  int8_t len_tp;
+  int32_t len_size;
+};
+
+typedef struct {
+  clPlan *plan;
+  int32_t capacity;
+  int32_t mark; // ops before MARK are not merged into
+} clCompiler;
+
+static bool isInteger(int tp) { return clIsNumber(tp) && !clIsFloat(tp); }
+
+static bool isWord(int32_t size) {
+  return size == 1 || size == 2 || size == 4 || size == 8;
+}
+
+// Returns OP_COPY, OP_INT or OP_FLOAT to turn one number into another, or
+// cl_ERR_TYPE.
+static int numberOp(int src_tp, int32_t src_size, int dst_tp,
+                    int32_t dst_size) {
+  if (src_tp == dst_tp && src_size == dst_size) {
+    return OP_COPY;
+  }
+  if (isInteger(src_tp) && isInteger(dst_tp) && isWord(src_size) &&
+      isWord(dst_size)) {
+    return OP_INT;
+  }
+  if (clIsFloat(src_tp) && clIsFloat(dst_tp) &&
+      (src_size == 4 || src_size == 8) && (dst_size == 4 || dst_size == 8)) {
+    return OP_FLOAT;
+  }
+  return cl_ERR_TYPE;
+}
+
+// The elements of a fixed or flexible array: their type, count and object.
+typedef struct {
+  int tp;
+  int32_t capacity;
+  const clColumn *columns;
+} clElements;
+
+static clElements elementsOf(const clColumn *array) {
+  if (array->tp == cl_FIXED_ARRAY) {
+    const clFixedArray *a = &array->via_fixed_array;
+    return (clElements){a->tp, a->capacity, a->columns};
+  }
+  const clFlexibleArray *a = &array->via_flexible_array;
+  return (clElements){a->tp, a->capacity, a->columns};
+}
+
+// Whether two unions have the same bytes, their own name and offset aside.
+static bool sameUnion(const clColumn *a, const clColumn *b) {
+  if (a->tp != b->tp || a->size != b->size || clIsTagged(a) ||
+      clIsTagged(b)) {
+    return false;
+  }
+
+  switch (a->tp) {
+  case cl_OBJECT:
+  case cl_UNION:
+    if (a->via_object.num != b->via_object.num) {
+      return false;
+    }
+    for (int32_t i = 0; i < a->via_object.num; ++i) {
+      const clColumn *x = &a->via_object.columns[i];
+      const clColumn *y = &b->via_object.columns[i];
+      if (x->offset != y->offset || !sameUnion(x, y)) {
+        return false;
+      }
+    }
+    return true;
+
+  case cl_FIXED_ARRAY:
+  case cl_FLEXIBLE_ARRAY: {
+    clElements x = elementsOf(a);
+    clElements y = elementsOf(b);
+    if (x.tp != y.tp || x.capacity != y.capacity || !x.columns != !y.columns) {
+      return false;
+    }
+    return !x.columns || sameUnion(x.columns, y.columns);
+  }
+
+  case cl_STRING:
+    return a->via_string.tp == b->via_string.tp &&
+           a->via_string.capacity == b->via_string.capacity;
+
+  default:
+    return true;
+  }
+}
+
+static int emit(clCompiler *c, int op, int32_t *idx) {
+  clPlan *plan = c->plan;
+  if (plan->num == c->capacity) {
+    int32_t capacity = c->capacity ? c->capacity * 2 : 16;
+    clPlanOp *ops =
+        (clPlanOp *)realloc(plan->ops, (size_t)capacity * sizeof(clPlanOp));
+    if (!ops) {
+      return cl_ERR_MEMORY;
+    }
+    plan->ops = ops;
+    c->capacity = capacity;
+  }
+
+  clPlanOp *p = &plan->ops[plan->num];
+  memset(p, 0, sizeof(*p));
+  p->op = (int8_t)op;
+  p->reg = -1;
+  p->dst = -1;
+  p->len = -1;
+  *idx = plan->num++;
+  return 0;
+}
+
+// Emits a copy (DST >= 0) or a skip of N bytes, merged with the previous op
+// where the bytes continue it.
+static int emitBytes(clCompiler *c, ptrdiff_t dst, int32_t n) {
+  clPlan *plan = c->plan;
+  if (plan->num > c->mark) {
+    clPlanOp *prev = &plan->ops[plan->num - 1];
+    if (dst < 0 && prev->op == OP_SKIP) {
+      prev->src_size += n;
+      return 0;
+    }
+    if (dst >= 0 && prev->op == OP_COPY && prev->dst + prev->src_size == dst) {
+      prev->src_size += n;
+      return 0;
+    }
+  }
+
+  int32_t idx;
+  int err = emit(c, dst < 0 ? OP_SKIP : OP_COPY, &idx);
+  if (!err) {
+    plan->ops[idx].src_size = n;
+    plan->ops[idx].dst = dst;
+  }
+  return err;
+}
+
+static int compileObject(clCompiler *c, const clColumn *w, const clColumn *r,
+                         ptrdiff_t base, int depth);
+
+static int compileArray(clCompiler *c, const clColumn *w, const clColumn *r,
+                        ptrdiff_t dst, ptrdiff_t base, int32_t reg,
+                        int depth) {
+  clElements wa = elementsOf(w);
+  clElements ra = r ? elementsOf(r) : (clElements){0, 0, NULL};
+  if (r && (r->tp != w->tp || !ra.columns != !wa.columns)) {
+    return cl_ERR_TYPE;
+  }
+
+  int32_t src_size = clElementSize(w, wa.capacity);
+  int32_t dst_size = r ? clElementSize(r, ra.capacity) : 0;
+  int convert = OP_COPY;
+  if (r && !wa.columns) {
+    convert = numberOp(wa.tp, src_size, ra.tp, dst_size);
+    if (convert < 0) {
+      return convert;
+    }
+  }
+
+  if (w->tp == cl_FIXED_ARRAY && !wa.columns &&
+      (!r || (convert == OP_COPY && ra.capacity == wa.capacity))) {
+    return emitBytes(c, dst, w->size);
+  }
+  if (w->tp == cl_FLEXIBLE_ARRAY && reg < 0) {
+    return cl_ERR_VALUE;
+  }
+
+  int32_t idx;
+  int err = emit(c, OP_ARRAY, &idx);
+  if (err) {
+    return err;
+  }
+
+  clPlanOp *op = &c->plan->ops[idx];
+  op->convert = (int8_t)convert;
+  op->src_tp = (int8_t)wa.tp;
+  op->src_size = src_size;
+  op->count = w->tp == cl_FIXED_ARRAY ? wa.capacity : 0;
+  op->reg = w->tp == cl_FLEXIBLE_ARRAY ? reg : -1;
+  op->dst = dst;
+  if (r) {
+    op->dst_tp = (int8_t)ra.tp;
+    op->dst_size = dst_size;
+    op->capacity = ra.capacity;
+  }
+  if (r && r->tp == cl_FLEXIBLE_ARRAY && base >= 0) {
+    const clFlexibleArray *flexible = &r->via_flexible_array;
+    op->len = base + flexible->len.offset;
+    op->len_tp = flexible->len.tp;
+    op->len_size = flexible->len.size;
+  }
+
+  if (!wa.columns) {
+    return 0;
+  }
+
+  c->mark = c->plan->num;
+  const clColumn *element = r ? ra.columns : NULL;
+  err = compileObject(c, wa.columns, element,
+                      element ? element->offset : -1, depth + 1);
+  if (err) {
+    return err;
+  }
+  c->plan->ops[idx].sub = c->plan->num - idx - 1;
+  c->mark = c->plan->num;
+  return 0;
+}
+
+// Compiles the writer field W into the reader field R (NULL when the reader
+// does not have it) of the object at BASE (-1 when dropped).
+static int compileColumn(clCompiler *c, const clColumn *w, const clColumn *r,
+                         ptrdiff_t base, int32_t reg, int depth) {
+  ptrdiff_t dst = r && base >= 0 ? base + r->offset : -1;
+  if (depth > MAX_DEPTH) {
+    return cl_ERR_VALUE;
+  }
+
+  switch (w->tp) {
+  case cl_OBJECT:
+    if (r && r->tp != cl_OBJECT) {
+      return cl_ERR_TYPE;
+    }
+    return compileObject(c, w, r, dst, depth + 1);
+
+  case cl_UNION:
+    // the encoded size of a tagged union depends on its tag, which ops of
+    // fixed sizes cannot follow
+    if (clIsTagged(w) || (r && !sameUnion(w, r))) {
+      return cl_ERR_TYPE;
+    }
+    return emitBytes(c, dst, w->size);
+
+  case cl_FIXED_ARRAY:
+  case cl_FLEXIBLE_ARRAY:
+    return compileArray(c, w, r, dst, base, reg, depth);
+
+  case cl_STRING: {
+    int32_t element = clElementSize(w, w->via_string.capacity);
+    if (r && (r->tp != cl_STRING ||
+              clElementSize(r, r->via_string.capacity) != element)) {
+      return cl_ERR_TYPE;
+    }
+
+    int32_t idx;
+    int err = emit(c, OP_STRING, &idx);
+    if (!err) {
+      clPlanOp *op = &c->plan->ops[idx];
+      op->src_size = op->dst_size = element;
+      op->count = w->via_string.capacity;
+      op->capacity = r ? r->via_string.capacity : 0;
+      op->dst = dst;
+    }
+    return err;
+  }
+
+  default:
+    break;
+  }
+
+  if (!clIsNumber(w->tp)) {
+    return cl_ERR_TYPE;
+  }
+
+  int convert = OP_COPY;
+  if (r) {
+    convert = clIsNumber(r->tp) ? numberOp(w->tp, w->size, r->tp, r->size)
+                                : cl_ERR_TYPE;
+    if (convert < 0) {
+      return convert;
+    }
+  }
+  if (reg < 0 && convert == OP_COPY) {
+    return emitBytes(c, dst, w->size);
+  }
+  if (reg >= 0 && (!isInteger(w->tp) || !isWord(w->size))) {
+    return cl_ERR_TYPE;
+  }
+
+  // a length field is always loaded to set its register
+  int32_t idx;
+  int err = emit(c, convert == OP_FLOAT ? OP_FLOAT : OP_INT, &idx);
+  if (!err) {
+    clPlanOp *op = &c->plan->ops[idx];
+    op->src_tp = w->tp;
+    op->src_size = w->size;
+    op->dst_tp = r ? r->tp : w->tp;
+    op->dst_size = r ? r->size : w->size;
+    op->reg = reg;
+    op->dst = dst;
+  }
+  return err;
+}
+
+// Returns the index of the sibling number of W holding the length of the
+// flexible array ARRAY, or -1.
+static int32_t lengthField(const clColumn *w, const clColumn *array) {
+  const clObject *object = &w->via_object;
+  for (int32_t i = 0; i < object->num; ++i) {
+    const clColumn *column = &object->columns[i];
+    if (column == array) {
+      break;
+    }
+    if (clIsNumber(column->tp) &&
+        column->offset == array->via_flexible_array.len.offset) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int compileObject(clCompiler *c, const clColumn *w, const clColumn *r,
+                         ptrdiff_t base, int depth) {
+  const clObject *object = &w->via_object;
+  if (depth > MAX_DEPTH) {
+    return cl_ERR_VALUE;
+  }
+
+  int32_t *regs = NULL;
+  if (object->num > 0) {
+    regs = (int32_t *)malloc((size_t)object->num * sizeof(int32_t));
+    if (!regs) {
+      return cl_ERR_MEMORY;
+    }
+  }
+  for (int32_t i = 0; i < object->num; ++i) {
+    regs[i] = -1;
+  }
+
+  int err = 0;
+  for (int32_t i = 0; !err && i < object->num; ++i) {
+    const clColumn *column = &object->columns[i];
+    if (column->tp != cl_FLEXIBLE_ARRAY) {
+      continue;
+    }
+
+    int32_t len = lengthField(w, column);
+    if (len < 0) {
+      err = cl_ERR_VALUE;
+    } else if (regs[len] < 0) {
+      if (c->plan->registers == PLAN_REGISTERS) {
+        err = cl_ERR_CAPACITY;
+      } else {
+        regs[len] = c->plan->registers++;
+      }
+    }
+    regs[i] = len < 0 ? -1 : regs[len];
+  }
+
+  for (int32_t i = 0; !err && i < object->num; ++i) {
+    const clColumn *column = &object->columns[i];
+    const clColumn *field =
+        r ? clFindColumn(r, column->name.string, (size_t)column->name.len)
+          : NULL;
+    err = compileColumn(c, column, field, base, regs[i], depth);
+  }
+  free(regs);
+  if (err || !r || base < 0) {
+    return err;
+  }
+
+  for (int32_t i = 0; !err && i < r->via_object.num; ++i) {
+    const clColumn *field = &r->via_object.columns[i];
+    if (clFindColumn(w, field->name.string, (size_t)field->name.len)) {
+      continue;
+    }
+
+    int32_t idx;
+    err = emit(c, OP_ZERO, &idx);
+    if (!err) {
+      c->plan->ops[idx].dst = base + field->offset;
+      c->plan->ops[idx].dst_size = field->size;
+    }
+  }
+  return err;
+}
+
+uint64_t clSchemaFingerprint(const clColumn *column) {
+  ptrdiff_t n = clSchemaSize(column);
+  if (n < 0) {
+    return 0;
+  }
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)n);
+  if (!buf || clSchemaWrite(column, buf, (size_t)n) != n) {
+    free(buf);
+    return 0;
+  }
+
+  // FNV-1a
+  uint64_t h = 14695981039346656037u;
+  for (ptrdiff_t i = 0; i < n; ++i) {
+    h ^= buf[i];
+    h *= 1099511628211u;
+  }
+  free(buf);
+  return h;
+}
+
+int clPlanInit(clPlan *plan, const clColumn *writer, const clColumn *reader) {
+  memset(plan, 0, sizeof(*plan));
+  if (writer->tp != cl_OBJECT || reader->tp != cl_OBJECT) {
+    return cl_ERR_TYPE;
+  }
+
+  plan->writer = clSchemaFingerprint(writer);
+  plan->reader = clSchemaFingerprint(reader);
+  if (!plan->writer || !plan->reader) {
+    return cl_ERR_MEMORY;
+  }
+
+  clCompiler c = {plan, 0, 0};
+  int err = compileObject(&c, writer, reader, 0, 0);
+  if (err) {
+    clPlanFree(plan);
+  }
+  return err;
+}
+
+void clPlanFree(clPlan *plan) {
+  free(plan->ops);
+  plan->ops = NULL;
+  plan->num = 0;
+  plan->registers = 0;
+}
+
+static int convertNumber(int convert, const clPlanOp *op, const uint8_t *src,
+                         uint8_t *dst, int64_t *reg) {
+  if (convert == OP_FLOAT) {
+    if (dst) {
+      double v;
+      if (op->src_size == 4) {
+        float f;
+        memcpy(&f, src, sizeof(f));
+        v = f;
+      } else {
+        memcpy(&v, src, sizeof(v));
+      }
+
+      if (op->dst_size == 4) {
+        float f = (float)v;
+        memcpy(dst, &f, sizeof(f));
+      } else {
+        memcpy(dst, &v, sizeof(v));
+      }
+    }
+    return 0;
+  }
+
+  int64_t v = clLoadInteger(src, op->src_tp, op->src_size);
+  if (reg) {
+    *reg = v;
+  }
+  if (dst) {
+    if (!clFitsInteger(v, op->dst_tp, op->dst_size)) {
+      return cl_ERR_VALUE;
+    }
+    clStoreInteger(dst, op->dst_size, v);
+  }
+  return 0;
+}
+
+static int runString(const clPlanOp *op, uint8_t *dst, clReader *r) {
+  int32_t element = op->src_size;
+  if (!element) {
+    return 0;
+  }
+
+  size_t avail = (r->size - r->pos) / element;
+  int32_t capacity = op->count;
+  if (avail < (size_t)capacity) {
+    capacity = (int32_t)avail;
+  }
+
+  const uint8_t *p = r->buf + r->pos;
+  int32_t len = clStringLength(p, element, capacity);
+  bool terminated = clIsTerminated(p, element, len);
+  if (capacity < op->count && !terminated) {
+    return cl_ERR_BUFFER;
+  }
+  r->pos += (size_t)element * len;
+
+  if (dst) {
+    // a truncated string keeps its terminator
+    int32_t chars = terminated ? len - 1 : len;
+    if (chars > op->capacity) {
+      chars = op->capacity > 0 ? op->capacity - 1 : 0;
+    }
+    memcpy(dst, p, (size_t)element * chars);
+    if (chars < op->capacity) {
+      memset(dst + (size_t)element * chars, 0, (size_t)element);
+    }
+  }
+  return 0;
+}
+
+static int run(const clPlan *plan, int32_t first, int32_t end, uint8_t *base,
+               clReader *r, int64_t *regs);
+
+static int runArray(const clPlan *plan, int32_t pc, uint8_t *base,
+                    clReader *r, int64_t *regs) {
+  const clPlanOp *op = &plan->ops[pc];
+  uint8_t *dst = base && op->dst >= 0 ? base + op->dst : NULL;
+
+  int64_t count = op->reg >= 0 ? regs[op->reg] : op->count;
+  if (op->reg >= 0 && (count < 0 || (dst && count > op->capacity))) {
+    return cl_ERR_CAPACITY;
+  }
+  int64_t live = dst ? (count < op->capacity ? count : op->capacity) : 0;
+
+  if (!op->sub && op->convert == OP_COPY) {
+    // elements of the same type, copied in one go
+    size_t n = (size_t)count * op->src_size;
+    if (r->size - r->pos < n) {
+      return cl_ERR_BUFFER;
+    }
+    if (live) {
+      memcpy(dst, r->buf + r->pos, (size_t)live * op->src_size);
+    }
+    r->pos += n;
+  } else {
+    for (int64_t i = 0; i < count; ++i) {
+      uint8_t *element = i < live ? dst + i * op->dst_size : NULL;
+      int err;
+      if (op->sub) {
+        err = run(plan, pc + 1, pc + 1 + op->sub, element, r, regs);
+      } else if (r->size - r->pos < (size_t)op->src_size) {
+        err = cl_ERR_BUFFER;
+      } else {
+        err = convertNumber(op->convert, op, r->buf + r->pos, element, NULL);
+        r->pos += (size_t)op->src_size;
+      }
+      if (err) {
+        return err;
+      }
+    }
+  }
+
+  if (dst && op->reg < 0 && live < op->capacity) {
+    // a longer fixed array
+    memset(dst + live * op->dst_size, 0,
+           (size_t)(op->capacity - live) * op->dst_size);
+  }
+  if (base && op->len >= 0) {
+    clStoreInteger(base + op->len, op->len_size, count);
+  }
+  return 0;
+}
+
+static int run(const clPlan *plan, int32_t first, int32_t end, uint8_t *base,
+               clReader *r, int64_t *regs) {
+  for (int32_t pc = first; pc < end; ++pc) {
+    const clPlanOp *op = &plan->ops[pc];
+    uint8_t *dst = base && op->dst >= 0 ? base + op->dst : NULL;
+    int err = 0;
+
+    switch (op->op) {
+    case OP_COPY:
+    case OP_SKIP:
+      if (r->size - r->pos < (size_t)op->src_size) {
+        return cl_ERR_BUFFER;
+      }
+      if (dst) {
+        memcpy(dst, r->buf + r->pos, (size_t)op->src_size);
+      }
+      r->pos += (size_t)op->src_size;
+      break;
+
+    case OP_ZERO:
+      if (dst) {
+        memset(dst, 0, (size_t)op->dst_size);
+      }
+      break;
+
+    case OP_INT:
+    case OP_FLOAT:
+      if (r->size - r->pos < (size_t)op->src_size) {
+        return cl_ERR_BUFFER;
+      }
+      err = convertNumber(op->op, op, r->buf + r->pos, dst,
+                          op->reg >= 0 ? &regs[op->reg] : NULL);
+      r->pos += (size_t)op->src_size;
+      break;
+
+    case OP_STRING:
+      err = runString(op, dst, r);
+      break;
+
+    case OP_ARRAY:
+      err = runArray(plan, pc, base, r, regs);
+      pc += op->sub;
+      break;
+    }
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+ptrdiff_t clPlanDecode(const clPlan *plan, void *dst, const void *buf,
+                       size_t size) {
+  int64_t regs[PLAN_REGISTERS];
+  clReader r = {(const uint8_t *)buf, 0, size, cl_WIRE_RAW};
+  int err = run(plan, 0, plan->num, (uint8_t *)dst, &r, regs);
+  return err ? err : (ptrdiff_t)r.pos;
+}
+
+typedef struct clCachedPlan {
+  clPlan plan;
+  struct clCachedPlan *next;
+} clCachedPlan;
+
+// Plans are keyed by the fingerprints of their descriptors, computed on a
+// miss of the index by the addresses of the pair, which is reset when the
+// descriptor at an address may have changed.
+typedef struct {
+  const clColumn *writer;
+  const clColumn *reader;
+  const clPlan *plan;
+} clRecentPlan;
+
+static _Thread_local clCachedPlan *cache[PLAN_BUCKETS];
+static _Thread_local clRecentPlan recent[PLAN_BUCKETS];
+static _Thread_local uint64_t seen;
+
+static void dropCache(void) {
+  memset(recent, 0, sizeof(recent));
+  for (size_t i = 0; i < PLAN_BUCKETS; ++i) {
+    while (cache[i]) {
+      clCachedPlan *p = cache[i];
+      cache[i] = p->next;
+      clPlanFree(&p->plan);
+      free(p);
+    }
+  }
+}
+
+// The key only drops the cache of a thread when it exits.
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static pthread_key_t key;
+static _Thread_local bool registered;
+
+static void release(void *p) {
+  (void)p;
+  dropCache();
+}
+
+static void makeKey(void) { pthread_key_create(&key, release); }
+
+int clPlanFind(const clPlan **out, const clColumn *writer,
+               const clColumn *reader) {
+  uint64_t e = clProgramEpoch();
+  if (e != seen) {
+    memset(recent, 0, sizeof(recent));
+    seen = e;
+  }
+  clRecentPlan *slot =
+      &recent[(size_t)((((uintptr_t)writer >> 3) ^ (uintptr_t)reader) *
+                           0x9e3779b97f4a7c15u >>
+                       32) &
+              (PLAN_BUCKETS - 1)];
+  if (slot->plan && slot->writer == writer && slot->reader == reader) {
+    *out = slot->plan;
+    return 0;
+  }
+
+  uint64_t w = clSchemaFingerprint(writer);
+  uint64_t r = clSchemaFingerprint(reader);
+  if (!w || !r) {
+    return cl_ERR_MEMORY;
+  }
+
+  size_t bucket = (size_t)((w ^ (r * 0x9e3779b97f4a7c15u)) >> 32) &
+                  (PLAN_BUCKETS - 1);
+  clCachedPlan *p = cache[bucket];
+  while (p && (p->plan.writer != w || p->plan.reader != r)) {
+    p = p->next;
+  }
+
+  if (!p) {
+    p = (clCachedPlan *)malloc(sizeof(clCachedPlan));
+    if (!p) {
+      return cl_ERR_MEMORY;
+    }
+    int err = clPlanInit(&p->plan, writer, reader);
+    if (err) {
+      free(p);
+      return err;
+    }
+    if (!registered) {
+      pthread_once(&once, makeKey);
+      registered = pthread_setspecific(key, &registered) == 0;
+    }
+    p->next = cache[bucket];
+    cache[bucket] = p;
+  }
+
+  slot->writer = writer;
+  slot->reader = reader;
+  *out = slot->plan = &p->plan;
+  return 0;
+}
+
+void clPlanCacheClear(void) { dropCache(); }
+
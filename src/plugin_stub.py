@@ -71,6 +71,30 @@ def check_is_flexable_array(cursor1: Cursor, cursor2: Cursor) -> bool:
     return check_is_len(cursor1.spelling, cursor2.spelling)
 
 
+TAG_RE = re.compile(r"@tag\(\s*(\w+)\s*\)")
+CASE_RE = re.compile(r"@case\(\s*(-?\d+)\s*\)")
+
+
+@_plugin_stub
+def get_union_tag(cursor: Cursor) -> str | None:
+    """the sibling field selecting the member of the union field CURSOR"""
+    comment = cursor.raw_comment
+    declaration = cursor.type.get_canonical().get_declaration()
+    if not comment and declaration.is_anonymous():
+        # the comment of an inline union goes to its declaration
+        comment = declaration.raw_comment
+
+    match = TAG_RE.search(comment or "")
+    return match.group(1) if match else None
+
+
+@_plugin_stub
+def get_union_case(cursor: Cursor, index: int) -> int:
+    """the tag value selecting the union member CURSOR, the INDEX-th one"""
+    match = CASE_RE.search(cursor.raw_comment or "")
+    return int(match.group(1)) if match else index
+
+
 @_plugin_stub
 def begin_object(cursor: Cursor):
     pass
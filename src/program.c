@@ -0,0 +1,567 @@
+#include "internal.h"
+#include "program.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+// A program is a flat list of ops in the order of the encoding, compiled
+// for one cl_WIRE_* format. Nested objects are inlined with their offsets
+// added up, so every op addresses the root object, or the array element it
+// belongs to, directly. Fields that travel as their bytes and continue each
+// other in memory are merged into one OP_COPY (OP_SWAP for cl_WIRE_SWAPPED),
+// arrays whose elements are one such run are transferred in one go, and a
+// fixed array of them is merged like any other run. The ops of an array
+// element follow its OP_ARRAY, those of a union member its OP_MEMBER.
+
+#define PROGRAM_BUCKETS 64 // power of two
+
+typedef struct {
+  clProgram *program;
+  int32_t capacity;
+  int32_t mark; // ops before MARK are not merged into
+  int32_t num_cases;
+} clCompiler;
+
+static int emit(clCompiler *c, int op, ptrdiff_t offset, int32_t *idx) {
+  clProgram *program = c->program;
+  if (offset > INT32_MAX) {
+    return cl_ERR_VALUE;
+  }
+  if (program->num == c->capacity) {
+    int32_t capacity = c->capacity ? c->capacity * 2 : 16;
+    clProgramOp *ops = (clProgramOp *)realloc(
+        program->ops, (size_t)capacity * sizeof(clProgramOp));
+    if (!ops) {
+      return cl_ERR_MEMORY;
+    }
+    program->ops = ops;
+    c->capacity = capacity;
+  }
+
+  clProgramOp *p = &program->ops[program->num];
+  memset(p, 0, sizeof(*p));
+  p->op = (int8_t)op;
+  p->offset = (int32_t)offset;
+  p->at = -1;
+  *idx = program->num++;
+  return 0;
+}
+
+// Emits N numbers of WIDTH bytes at OFFSET that travel as their bytes,
+// swapped or not, merged with the previous op where they continue it.
+static int emitRun(clCompiler *c, ptrdiff_t offset, int32_t n, int32_t width) {
+  int op = c->program->wire == cl_WIRE_SWAPPED && width > 1 ? OP_SWAP
+                                                             : OP_COPY;
+  if (op == OP_COPY) {
+    n *= width;
+    width = 1;
+  }
+
+  clProgram *program = c->program;
+  if (program->num > c->mark) {
+    clProgramOp *prev = &program->ops[program->num - 1];
+    if (prev->op == op && prev->width == width &&
+        prev->offset + (ptrdiff_t)prev->n * width == offset) {
+      prev->n += n;
+      return 0;
+    }
+  }
+
+  int32_t idx;
+  int err = emit(c, op, offset, &idx);
+  if (!err) {
+    program->ops[idx].n = n;
+    program->ops[idx].width = width;
+  }
+  return err;
+}
+
+static int compileNumber(clCompiler *c, int tp, int32_t size,
+                         ptrdiff_t offset) {
+  if (!clIsVarint(c->program->wire, tp, size)) {
+    return emitRun(c, offset, 1, size);
+  }
+
+  int32_t idx;
+  int err = emit(c, OP_VARINT, offset, &idx);
+  if (!err) {
+    c->program->ops[idx].tp = (int8_t)tp;
+    c->program->ops[idx].width = size;
+  }
+  return err;
+}
+
+static int compileColumn(clCompiler *c, const clColumn *column,
+                         ptrdiff_t base);
+
+static int compileObject(clCompiler *c, const clColumn *column,
+                         ptrdiff_t base) {
+  for (int32_t i = 0; i < column->via_object.num; ++i) {
+    int err = compileColumn(c, &column->via_object.columns[i], base);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+static int compileArray(clCompiler *c, const clColumn *column,
+                        ptrdiff_t base) {
+  const clFlexibleArray *array = &column->via_flexible_array;
+  bool fixed = column->tp == cl_FIXED_ARRAY;
+  int tp = fixed ? column->via_fixed_array.tp : array->tp;
+  int32_t capacity =
+      fixed ? column->via_fixed_array.capacity : array->capacity;
+  const clColumn *columns =
+      fixed ? column->via_fixed_array.columns : array->columns;
+  int32_t stride = clElementSize(column, capacity);
+  ptrdiff_t offset = base + column->offset;
+
+  // a fixed array of numbers that travel as their bytes is one run
+  if (fixed && !columns && !clIsVarint(c->program->wire, tp, stride)) {
+    return emitRun(c, offset, capacity, stride);
+  }
+
+  int32_t mark = c->mark;
+  int32_t idx;
+  int err = emit(c, OP_ARRAY, offset, &idx);
+  if (err) {
+    return err;
+  }
+  clProgram *program = c->program;
+  clProgramOp *op = &program->ops[idx];
+  op->n = capacity;
+  op->width = stride;
+  if (!fixed) {
+    op->tp = (int8_t)array->len.tp;
+    op->size = (int8_t)array->len.size;
+    op->at = (int32_t)(base + array->len.offset);
+  }
+
+  c->mark = program->num;
+  err = columns ? compileObject(c, columns, columns->offset)
+                : compileNumber(c, tp, stride, 0);
+  if (err) {
+    return err;
+  }
+  op = &program->ops[idx];
+  op->sub = program->num - idx - 1;
+  c->mark = program->num;
+
+  // elements that are one run are transferred in one go
+  const clProgramOp *run = &program->ops[idx + 1];
+  op->bulk = op->sub == 1 && (run->op == OP_COPY || run->op == OP_SWAP) &&
+             run->offset == 0 && run->n * run->width == stride;
+  if (!op->bulk || !fixed) {
+    return 0;
+  }
+
+  // and a fixed array of them is a run like any other
+  int32_t width = run->width;
+  program->num = idx;
+  c->mark = mark;
+  return emitRun(c, offset, capacity * (stride / width), width);
+}
+
+static int compileUnion(clCompiler *c, const clColumn *column,
+                        ptrdiff_t base) {
+  ptrdiff_t offset = base + column->offset;
+  const clUnion *u = &column->via_union;
+  if (!clIsTagged(column)) {
+    return emitRun(c, offset, column->size, 1);
+  }
+
+  int32_t idx;
+  int err = emit(c, OP_UNION, offset, &idx);
+  if (err) {
+    return err;
+  }
+  clProgram *program = c->program;
+  clProgramOp *op = &program->ops[idx];
+  op->tp = u->tag.tp;
+  op->size = (int8_t)u->tag.size;
+  op->at = (int32_t)(base + u->tag.offset);
+  op->n = u->num_cases;
+  op->width = c->num_cases;
+
+  int32_t *cases = (int32_t *)realloc(
+      program->cases, (size_t)(c->num_cases + u->num_cases) * sizeof(int32_t));
+  if (!cases) {
+    return cl_ERR_MEMORY;
+  }
+  program->cases = cases;
+  int32_t first = c->num_cases;
+  c->num_cases += u->num_cases;
+  for (int32_t v = 0; v < u->num_cases; ++v) {
+    program->cases[first + v] = -1;
+  }
+
+  for (int32_t i = 0; i < u->num; ++i) {
+    int32_t member;
+    err = emit(c, OP_MEMBER, offset, &member);
+    if (err) {
+      return err;
+    }
+    for (int32_t v = 0; v < u->num_cases; ++v) {
+      if (u->cases[v] == i) {
+        program->cases[first + v] = member;
+      }
+    }
+
+    c->mark = program->num;
+    err = compileColumn(c, &u->columns[i], offset);
+    if (err) {
+      return err;
+    }
+    program->ops[member].sub = program->num - member - 1;
+    c->mark = program->num;
+  }
+  program->ops[idx].sub = program->num - idx - 1;
+  return 0;
+}
+
+static int compileColumn(clCompiler *c, const clColumn *column,
+                         ptrdiff_t base) {
+  switch (column->tp) {
+  case cl_OBJECT:
+    return compileObject(c, column, base + column->offset);
+
+  case cl_UNION:
+    return compileUnion(c, column, base);
+
+  case cl_FIXED_ARRAY:
+  case cl_FLEXIBLE_ARRAY:
+    return compileArray(c, column, base);
+
+  case cl_STRING: {
+    const clString *string = &column->via_string;
+    int32_t idx;
+    int err = emit(c, OP_STRING, base + column->offset, &idx);
+    if (!err) {
+      c->program->ops[idx].n = string->capacity;
+      c->program->ops[idx].width = clElementSize(column, string->capacity);
+    }
+    return err;
+  }
+
+  default:
+    if (!clIsNumber(column->tp)) {
+      return cl_ERR_TYPE;
+    }
+    return compileNumber(c, column->tp, column->size, base + column->offset);
+  }
+}
+
+int clProgramInit(clProgram *program, const clColumn *column, int wire) {
+  memset(program, 0, sizeof(*program));
+  if (wire != cl_WIRE_RAW && wire != cl_WIRE_COMPACT &&
+      wire != cl_WIRE_SWAPPED) {
+    return cl_ERR_VALUE;
+  }
+  if (column->tp != cl_OBJECT) {
+    return cl_ERR_TYPE;
+  }
+  program->column = column;
+  program->wire = wire;
+
+  // the root sits at offset 0 of a message whatever its own offset says
+  clCompiler c = {program, 0, 0, 0};
+  int err = compileObject(&c, column, 0);
+  if (err) {
+    clProgramFree(program);
+  }
+  return err;
+}
+
+void clProgramFree(clProgram *program) {
+  free(program->ops);
+  free(program->cases);
+  memset(program, 0, sizeof(*program));
+}
+
+static int encodeOps(const clProgram *program, int32_t begin, int32_t end,
+                     const uint8_t *base, clWriter *w) {
+  const clProgramOp *ops = program->ops;
+  for (int32_t i = begin; i < end; ++i) {
+    const clProgramOp *op = &ops[i];
+    const uint8_t *src = base + op->offset;
+    int err = 0;
+
+    switch (op->op) {
+    case OP_COPY:
+      err = clWriteBytes(w, src, (size_t)op->n);
+      break;
+
+    case OP_SWAP:
+      err = clWriteSwapped(w, src, (size_t)op->n, op->width);
+      break;
+
+    case OP_VARINT: {
+      int64_t v = clLoadInteger(src, op->tp, op->width);
+      err = clWriteVarint(w, clIsSigned(op->tp) ? clZigzag(v) : (uint64_t)v);
+      break;
+    }
+
+    case OP_STRING:
+      err = clEncodeString(src, op->width, op->n, w);
+      break;
+
+    case OP_ARRAY: {
+      int64_t n = clProgramCount(op, base);
+      if (n < 0) {
+        return (int)n;
+      }
+      if (op->bulk) {
+        const clProgramOp *run = &ops[i + 1];
+        size_t numbers = (size_t)n * (size_t)(op->width / run->width);
+        err = run->op == OP_SWAP ? clWriteSwapped(w, src, numbers, run->width)
+                                 : clWriteBytes(w, src, numbers);
+      } else {
+        for (int64_t k = 0; !err && k < n; ++k) {
+          err = encodeOps(program, i + 1, i + 1 + op->sub,
+                          src + k * op->width, w);
+        }
+      }
+      i += op->sub;
+      break;
+    }
+
+    case OP_UNION: {
+      int32_t m = clProgramMember(program, op, base);
+      if (m >= 0) {
+        err = encodeOps(program, m + 1, m + 1 + ops[m].sub, base, w);
+      }
+      i += op->sub;
+      break;
+    }
+    }
+
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+static int decodeOps(const clProgram *program, int32_t begin, int32_t end,
+                     uint8_t *base, clReader *r) {
+  const clProgramOp *ops = program->ops;
+  for (int32_t i = begin; i < end; ++i) {
+    const clProgramOp *op = &ops[i];
+    uint8_t *dst = base + op->offset;
+    int err = 0;
+
+    switch (op->op) {
+    case OP_COPY:
+      err = clReadBytes(r, dst, (size_t)op->n);
+      break;
+
+    case OP_SWAP:
+      err = clReadSwapped(r, dst, (size_t)op->n, op->width);
+      break;
+
+    case OP_VARINT: {
+      uint64_t u;
+      err = clReadVarint(r, &u);
+      if (err) {
+        return err;
+      }
+      int64_t v = clIsSigned(op->tp) ? clUnzigzag(u) : (int64_t)u;
+      if (!clFitsInteger(v, op->tp, op->width)) {
+        return cl_ERR_VALUE;
+      }
+      clStoreInteger(dst, op->width, v);
+      break;
+    }
+
+    case OP_STRING:
+      err = clDecodeString(dst, op->width, op->n, r);
+      break;
+
+    case OP_ARRAY: {
+      // the count field precedes the array and has already been decoded
+      int64_t n = clProgramCount(op, base);
+      if (n < 0) {
+        return (int)n;
+      }
+      if (op->bulk) {
+        const clProgramOp *run = &ops[i + 1];
+        size_t numbers = (size_t)n * (size_t)(op->width / run->width);
+        err = run->op == OP_SWAP ? clReadSwapped(r, dst, numbers, run->width)
+                                 : clReadBytes(r, dst, numbers);
+      } else {
+        for (int64_t k = 0; !err && k < n; ++k) {
+          err = decodeOps(program, i + 1, i + 1 + op->sub,
+                          dst + k * op->width, r);
+        }
+      }
+      i += op->sub;
+      break;
+    }
+
+    case OP_UNION: {
+      // and so does the tag
+      int32_t m = clProgramMember(program, op, base);
+      if (m >= 0) {
+        err = decodeOps(program, m + 1, m + 1 + ops[m].sub, base, r);
+      }
+      i += op->sub;
+      break;
+    }
+    }
+
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+int clProgramWrite(const clProgram *program, const uint8_t *src,
+                   clWriter *w) {
+  return encodeOps(program, 0, program->num, src, w);
+}
+
+int clProgramRead(const clProgram *program, uint8_t *dst, clReader *r) {
+  return decodeOps(program, 0, program->num, dst, r);
+}
+
+ptrdiff_t clProgramEncode(const clProgram *program, const void *src,
+                          void *buf, size_t size) {
+  clWriter w = {(uint8_t *)buf, 0, size, program->wire, NULL, NULL, 0};
+  int err = encodeOps(program, 0, program->num, (const uint8_t *)src, &w);
+  return err ? err : (ptrdiff_t)w.pos;
+}
+
+ptrdiff_t clProgramDecode(const clProgram *program, void *dst,
+                          const void *buf, size_t size) {
+  clReader r = {(const uint8_t *)buf, 0, size, program->wire};
+  int err = decodeOps(program, 0, program->num, (uint8_t *)dst, &r);
+  return err ? err : (ptrdiff_t)r.pos;
+}
+
+typedef struct clCachedProgram {
+  clProgram program;
+  uint64_t shape; // see shapeOf()
+  struct clCachedProgram *next;
+} clCachedProgram;
+
+static uint64_t epoch; // bumped to drop the programs of every thread
+static _Thread_local uint64_t seen;
+static _Thread_local clCachedProgram *cache[PROGRAM_BUCKETS];
+static _Thread_local clCachedProgram *last; // found the previous time
+
+static void dropCache(void) {
+  last = NULL;
+  for (size_t i = 0; i < PROGRAM_BUCKETS; ++i) {
+    while (cache[i]) {
+      clCachedProgram *p = cache[i];
+      cache[i] = p->next;
+      clProgramFree(&p->program);
+      free(p);
+    }
+  }
+}
+
+// The key only drops the cache of a thread when it exits.
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static pthread_key_t key;
+static _Thread_local bool registered;
+
+static void release(void *p) {
+  (void)p;
+  dropCache();
+}
+
+static void makeKey(void) { pthread_key_create(&key, release); }
+
+// Returns a hash of the layout of the object COLUMN and of its fields, which
+// tells a descriptor rebuilt at the address of a released one from the one
+// a program was compiled for. Nested objects are not looked into.
+static uint64_t shapeOf(const clColumn *column) {
+  uint64_t h = (uint64_t)column->size << 32 ^
+               (uint32_t)column->via_object.num ^
+               (uint64_t)(uintptr_t)column->via_object.columns;
+  for (int32_t i = 0; i < column->via_object.num; ++i) {
+    const clColumn *field = &column->via_object.columns[i];
+    h = (h << 7 | h >> 57) ^ (uint64_t)(uint8_t)field->tp ^
+        (uint64_t)field->size << 8 ^ (uint64_t)field->offset << 40;
+  }
+  return h;
+}
+
+int clProgramFind(const clProgram **out, const clColumn *column, int wire) {
+  uint64_t e = __atomic_load_n(&epoch, __ATOMIC_RELAXED);
+  if (e != seen) {
+    dropCache();
+    seen = e;
+  }
+  if (column->tp != cl_OBJECT) {
+    return cl_ERR_TYPE;
+  }
+  uint64_t shape = shapeOf(column);
+  if (last && last->program.column == column && last->program.wire == wire &&
+      last->shape == shape) {
+    *out = &last->program;
+    return 0;
+  }
+
+  size_t bucket = (size_t)((((uintptr_t)column >> 3) + (uintptr_t)wire) *
+                               0x9e3779b97f4a7c15u >>
+                           32) &
+                  (PROGRAM_BUCKETS - 1);
+  clCachedProgram **link = &cache[bucket];
+  while (*link && ((*link)->program.column != column ||
+                   (*link)->program.wire != wire)) {
+    link = &(*link)->next;
+  }
+
+  clCachedProgram *p = *link;
+  if (p && p->shape == shape) {
+    *out = &(last = p)->program;
+    return 0;
+  }
+  if (p) {
+    // compiled for another descriptor at this address
+    *link = p->next;
+    if (last == p) {
+      last = NULL;
+    }
+    clProgramFree(&p->program);
+  } else {
+    p = (clCachedProgram *)malloc(sizeof(clCachedProgram));
+    if (!p) {
+      return cl_ERR_MEMORY;
+    }
+  }
+
+  int err = clProgramInit(&p->program, column, wire);
+  if (err) {
+    free(p);
+    return err;
+  }
+
+  if (!registered) {
+    pthread_once(&once, makeKey);
+    registered = pthread_setspecific(key, &registered) == 0;
+  }
+  p->shape = shape;
+  p->next = cache[bucket];
+  cache[bucket] = p;
+  *out = &(last = p)->program;
+  return 0;
+}
+
+void clProgramInvalidate(void) {
+  __atomic_add_fetch(&epoch, 1, __ATOMIC_RELAXED);
+}
+
+uint64_t clProgramEpoch(void) {
+  return __atomic_load_n(&epoch, __ATOMIC_RELAXED);
+}
+
+void clProgramCacheClear(void) {
+  clProgramInvalidate();
+  dropCache();
+  seen = __atomic_load_n(&epoch, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "internal.h"
+
+// The ops of a clProgram, see program.c.
+
+enum {
+  OP_COPY,   // N bytes
+  OP_SWAP,   // N numbers of WIDTH bytes, reversed
+  OP_VARINT, // an integer of TP and WIDTH bytes, as a (zigzag) varint
+  OP_STRING, // up to N elements of WIDTH bytes
+  OP_ARRAY,  // elements of WIDTH bytes, the next SUB ops for each
+  OP_UNION,  // the next SUB ops are an OP_MEMBER per member
+  OP_MEMBER, // the next SUB ops
+};
+
+struct clProgramOp {
+  int8_t op;
+  int8_t tp;      // of a number, or of the count or tag field
+  int8_t size;    // of the count or tag field
+  bool bulk;      // OP_ARRAY: the elements are the single op that follows
+  int32_t offset; // from the root object or the current element
+  int32_t n;      // bytes, numbers, capacity or cases
+  int32_t width;  // of a number, string element or array element; for
+                  // OP_UNION the first of its cases in PROGRAM->cases
+  int32_t at;     // offset of the count or tag field, -1 for a fixed array
+  int32_t sub;
+};
+
+// Returns the elements of the array OP of the object at BASE, or
+// cl_ERR_CAPACITY.
+static inline int64_t clProgramCount(const clProgramOp *op,
+                                     const uint8_t *base) {
+  if (op->at < 0) {
+    return op->n;
+  }
+  int64_t n = clLoadInteger(base + op->at, op->tp, op->size);
+  return n < 0 || n > op->n ? cl_ERR_CAPACITY : n;
+}
+
+// Returns the OP_MEMBER of the union OP selected by its tag, or -1.
+static inline int32_t clProgramMember(const clProgram *program,
+                                      const clProgramOp *op,
+                                      const uint8_t *base) {
+  int64_t tag = clLoadInteger(base + op->at, op->tp, op->size);
+  if ((uint64_t)tag >= (uint64_t)op->n) {
+    return -1;
+  }
+  return program->cases[op->width + tag];
+}
@@ -0,0 +1,813 @@
+#include "internal.h"
+
+#include <stdlib.h>
+
+// A projection is a flat list of ops in the order of the encoding, compiled
+// for one cl_WIRE_* format. Fields that are not selected are skipped:
+// adjacent runs of fixed size are merged into one skip, arrays of elements
+// of fixed size are skipped in one go, and the ops past the last selected
+// field are dropped. Lengths of flexible arrays and tags of tagged unions
+// are loaded into registers whether selected or not, the encoding of what
+// follows them depends on their value. The ops of an array element follow
+// its OP_ARRAY, those of a union member its OP_MEMBER.
+
+#define MAX_DEPTH 64
+#define PROJECTION_REGISTERS 32
+
+enum {
+  OP_COPY,    // SIZE bytes to DST
+  OP_SKIP,    // SIZE bytes
+  OP_VARINTS, // COUNT varints, skipped
+  OP_NUMBER,  // a varint or swapped number to DST and/or a register
+  OP_STRING,  // up to COUNT elements of SIZE bytes
+  OP_ARRAY,   // COUNT elements, the next SUB ops for elements of objects
+  OP_UNION,   // the next SUB ops are an OP_MEMBER per member of COLUMN
+  OP_MEMBER,  // the next SUB ops for the member of index COUNT
+};
+
+enum {
+  SEL_NONE,
+  SEL_PART, // some fields below
+  SEL_ALL,
+};
+
+struct clProjectionOp {
+  int8_t op;
+  int8_t tp;      // of a number, or of array elements
+  int32_t size;   // of a run, a number or an encoded element
+  int32_t stride; // of array elements in DST
+  int32_t count;  // capacity of a flexible array
+  int32_t reg;    // set by a length or tag field, read by an array or union
+  int32_t sub;
+  int32_t leaf;   // the clBatch leaf holding DST outside of arrays
+  ptrdiff_t dst;  // from the current object or element, -1 to skip
+  const clColumn *column; // OP_UNION
+};
+
+typedef struct {
+  clProjection *projection;
+  int32_t capacity;
+  int32_t mark;   // ops before MARK are not merged into
+  int32_t leaf;   // of the field being compiled
+  int32_t leaves; // numbered so far
+  int32_t nested; // below an array or a union, within one leaf
+
+  // the fields from the root down to the current one, and the paths
+  const clColumn *stack[MAX_DEPTH];
+  int32_t depth;
+  const clColumn *(*paths)[MAX_DEPTH];
+  int32_t *lens;
+  size_t num_paths;
+} clCompiler;
+
+// Resolves PATH below ROOT into the fields it goes through.
+static int parsePath(const clColumn *root, const char *path,
+                     const clColumn **chain, int32_t *len) {
+  const clColumn *container = root;
+  size_t n = strlen(path);
+  size_t pos = 0;
+  *len = 0;
+
+  for (;;) {
+    if (!container || *len == MAX_DEPTH) {
+      return cl_ERR_VALUE;
+    }
+
+    size_t end = pos;
+    while (end < n && path[end] != '.' && path[end] != '[') {
+      ++end;
+    }
+    const clColumn *column = clFindColumn(container, path + pos, end - pos);
+    if (!column) {
+      return cl_ERR_VALUE;
+    }
+    chain[(*len)++] = column;
+    pos = end;
+
+    container = NULL;
+    switch (column->tp) {
+    case cl_OBJECT:
+      container = column;
+      break;
+
+    case cl_UNION:
+      // carried as its bytes, selected as a whole
+      if (!clIsTagged(column)) {
+        return 0;
+      }
+      container = column;
+      break;
+
+    case cl_FIXED_ARRAY:
+    case cl_FLEXIBLE_ARRAY:
+      if (n - pos >= 3 && memcmp(path + pos, "[*]", 3) == 0) {
+        pos += 3;
+        container = column->tp == cl_FIXED_ARRAY
+                        ? column->via_fixed_array.columns
+                        : column->via_flexible_array.columns;
+      }
+      break;
+
+    default:
+      break;
+    }
+
+    if (pos == n) {
+      return 0;
+    }
+    if (path[pos] != '.' || pos + 1 == n) {
+      return cl_ERR_VALUE;
+    }
+    ++pos;
+  }
+}
+
+// How much of the field on top of the stack the paths select.
+static int selection(const clCompiler *c) {
+  int sel = SEL_NONE;
+  for (size_t i = 0; i < c->num_paths; ++i) {
+    int32_t len = c->lens[i];
+    int32_t n = len < c->depth ? len : c->depth;
+    if (memcmp(c->paths[i], c->stack, (size_t)n * sizeof(*c->stack)) != 0) {
+      continue;
+    }
+    if (len <= c->depth) {
+      return SEL_ALL;
+    }
+    sel = SEL_PART;
+  }
+  return sel;
+}
+
+static bool isWord(int32_t size) {
+  return size == 1 || size == 2 || size == 4 || size == 8;
+}
+
+static int emit(clCompiler *c, int op, ptrdiff_t dst, int32_t *idx) {
+  clProjection *projection = c->projection;
+  if (projection->num == c->capacity) {
+    int32_t capacity = c->capacity ? c->capacity * 2 : 16;
+    clProjectionOp *ops = (clProjectionOp *)realloc(
+        projection->ops, (size_t)capacity * sizeof(clProjectionOp));
+    if (!ops) {
+      return cl_ERR_MEMORY;
+    }
+    projection->ops = ops;
+    c->capacity = capacity;
+  }
+
+  clProjectionOp *p = &projection->ops[projection->num];
+  memset(p, 0, sizeof(*p));
+  p->op = (int8_t)op;
+  p->reg = -1;
+  p->leaf = c->leaf;
+  p->dst = dst;
+  *idx = projection->num++;
+  return 0;
+}
+
+// Emits a copy (DST >= 0) or a skip of N bytes, merged with the previous op
+// where the bytes continue it within the same leaf.
+static int emitBytes(clCompiler *c, ptrdiff_t dst, int32_t n) {
+  clProjection *projection = c->projection;
+  if (projection->num > c->mark) {
+    clProjectionOp *prev = &projection->ops[projection->num - 1];
+    if (dst < 0 && prev->op == OP_SKIP) {
+      prev->size += n;
+      return 0;
+    }
+    if (dst >= 0 && prev->op == OP_COPY && prev->leaf == c->leaf &&
+        prev->dst + prev->size == dst) {
+      prev->size += n;
+      return 0;
+    }
+  }
+
+  int32_t idx;
+  int err = emit(c, dst < 0 ? OP_SKIP : OP_COPY, dst, &idx);
+  if (!err) {
+    projection->ops[idx].size = n;
+  }
+  return err;
+}
+
+static int emitVarints(clCompiler *c, int32_t n) {
+  clProjection *projection = c->projection;
+  if (projection->num > c->mark &&
+      projection->ops[projection->num - 1].op == OP_VARINTS) {
+    projection->ops[projection->num - 1].count += n;
+    return 0;
+  }
+
+  int32_t idx;
+  int err = emit(c, OP_VARINTS, -1, &idx);
+  if (!err) {
+    projection->ops[idx].count = n;
+  }
+  return err;
+}
+
+static int compileNumber(clCompiler *c, const clColumn *column, ptrdiff_t dst,
+                         int32_t reg) {
+  int wire = c->projection->wire;
+  bool varint = clIsVarint(wire, column->tp, column->size);
+  if (reg < 0 && !varint &&
+      (dst < 0 || wire != cl_WIRE_SWAPPED || column->size == 1)) {
+    return emitBytes(c, dst, column->size);
+  }
+  if (reg < 0 && dst < 0) {
+    return emitVarints(c, 1);
+  }
+  if (reg >= 0 && (clIsFloat(column->tp) || !isWord(column->size))) {
+    return cl_ERR_TYPE;
+  }
+
+  int32_t idx;
+  int err = emit(c, OP_NUMBER, dst, &idx);
+  if (!err) {
+    clProjectionOp *op = &c->projection->ops[idx];
+    op->tp = column->tp;
+    op->size = column->size;
+    op->reg = reg;
+  }
+  return err;
+}
+
+static int compileObject(clCompiler *c, const clColumn *column,
+                         ptrdiff_t base, int sel, int depth);
+
+static int compileArray(clCompiler *c, const clColumn *column, ptrdiff_t dst,
+                        int32_t reg, int sel, int depth) {
+  const clFlexibleArray *array = &column->via_flexible_array;
+  bool fixed = column->tp == cl_FIXED_ARRAY;
+  int tp = fixed ? column->via_fixed_array.tp : array->tp;
+  int32_t capacity =
+      fixed ? column->via_fixed_array.capacity : array->capacity;
+  const clColumn *columns =
+      fixed ? column->via_fixed_array.columns : array->columns;
+  int32_t stride = clElementSize(column, capacity);
+  int wire = c->projection->wire;
+  if (!fixed && reg < 0) {
+    return cl_ERR_VALUE;
+  }
+
+  if (!columns && fixed) {
+    bool varint = clIsVarint(wire, tp, stride);
+    if (!varint && (dst < 0 || wire != cl_WIRE_SWAPPED || stride == 1)) {
+      return emitBytes(c, dst, column->size);
+    }
+    if (varint && dst < 0) {
+      return emitVarints(c, capacity);
+    }
+  }
+
+  int32_t mark = c->mark;
+  int32_t idx;
+  int err = emit(c, OP_ARRAY, dst, &idx);
+  if (err) {
+    return err;
+  }
+
+  clProjectionOp *op = &c->projection->ops[idx];
+  op->tp = columns ? cl_OBJECT : (int8_t)tp;
+  op->size = op->stride = stride;
+  op->count = capacity;
+  op->reg = fixed ? -1 : reg;
+  if (!columns) {
+    return 0;
+  }
+
+  ++c->nested;
+  c->mark = c->projection->num;
+  err = compileObject(c, columns, columns->offset, sel,
+                      depth + 1);
+  --c->nested;
+  if (err) {
+    return err;
+  }
+
+  clProjection *projection = c->projection;
+  op = &projection->ops[idx];
+  op->sub = projection->num - idx - 1;
+  c->mark = projection->num;
+
+  // elements encoded as one run of bytes are copied or skipped in one go
+  const clProjectionOp *run = &projection->ops[idx + 1];
+  if (op->sub == 1 &&
+      ((run->op == OP_SKIP && dst < 0) ||
+       (run->op == OP_COPY && run->dst == 0 && run->size == stride))) {
+    op->size = run->size;
+    op->sub = 0;
+    projection->num = idx + 1;
+  }
+  if (op->sub || !fixed) {
+    return 0;
+  }
+
+  // and a fixed array of them is one run
+  int32_t n = op->size * capacity;
+  projection->num = idx;
+  c->mark = mark;
+  return emitBytes(c, dst, n);
+}
+
+static int compileColumn(clCompiler *c, const clColumn *column,
+                         ptrdiff_t base, int32_t reg, int sel, int depth);
+
+static int compileUnion(clCompiler *c, const clColumn *column, ptrdiff_t base,
+                        int32_t reg, int sel, int depth) {
+  if (reg < 0) {
+    return cl_ERR_VALUE;
+  }
+
+  int32_t idx;
+  int err =
+      emit(c, OP_UNION, sel == SEL_NONE ? -1 : base + column->offset, &idx);
+  if (err) {
+    return err;
+  }
+  c->projection->ops[idx].reg = reg;
+  c->projection->ops[idx].column = column;
+
+  ++c->nested;
+  const clUnion *u = &column->via_union;
+  for (int32_t i = 0; !err && i < u->num; ++i) {
+    int32_t member;
+    err = emit(c, OP_MEMBER, -1, &member);
+    if (err) {
+      break;
+    }
+    c->projection->ops[member].count = i;
+
+    c->mark = c->projection->num;
+    c->stack[c->depth++] = &u->columns[i];
+    err = compileColumn(c, &u->columns[i], base + column->offset, -1,
+                        sel == SEL_PART ? selection(c) : sel, depth + 1);
+    --c->depth;
+    c->projection->ops[member].sub = c->projection->num - member - 1;
+    c->mark = c->projection->num;
+  }
+  --c->nested;
+
+  c->projection->ops[idx].sub = c->projection->num - idx - 1;
+  return err;
+}
+
+// Compiles COLUMN of the object at BASE, selected as SEL says.
+static int compileColumn(clCompiler *c, const clColumn *column,
+                         ptrdiff_t base, int32_t reg, int sel, int depth) {
+  ptrdiff_t dst = sel == SEL_NONE ? -1 : base + column->offset;
+  if (depth > MAX_DEPTH || c->depth == MAX_DEPTH) {
+    return cl_ERR_VALUE;
+  }
+
+  switch (column->tp) {
+  case cl_OBJECT:
+    return compileObject(c, column, base + column->offset, sel, depth + 1);
+
+  case cl_UNION:
+    if (!clIsTagged(column)) {
+      return emitBytes(c, dst, column->size);
+    }
+    return compileUnion(c, column, base, reg, sel, depth);
+
+  case cl_FIXED_ARRAY:
+  case cl_FLEXIBLE_ARRAY:
+    return compileArray(c, column, dst, reg, sel, depth);
+
+  case cl_STRING: {
+    int32_t idx;
+    int err = emit(c, OP_STRING, dst, &idx);
+    if (!err) {
+      clProjectionOp *op = &c->projection->ops[idx];
+      op->size = clElementSize(column, column->via_string.capacity);
+      op->count = column->via_string.capacity;
+    }
+    return err;
+  }
+
+  default:
+    if (!clIsNumber(column->tp)) {
+      return cl_ERR_TYPE;
+    }
+    return compileNumber(c, column, dst, reg);
+  }
+}
+
+// Returns the index of the number of OBJECT in front of COLUMN at OFFSET,
+// the length field of a flexible array or the tag of a tagged union, or -1.
+static int32_t controlField(const clObject *object, const clColumn *column,
+                            ptrdiff_t offset) {
+  for (int32_t i = 0; i < object->num; ++i) {
+    const clColumn *field = &object->columns[i];
+    if (field == column) {
+      break;
+    }
+    if (clIsNumber(field->tp) && field->offset == offset) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int compileObject(clCompiler *c, const clColumn *column,
+                         ptrdiff_t base, int sel, int depth) {
+  const clObject *object = &column->via_object;
+  if (depth > MAX_DEPTH || c->depth == MAX_DEPTH) {
+    return cl_ERR_VALUE;
+  }
+  if (object->num == 0) {
+    return 0;
+  }
+
+  // the register and the selection of every field
+  int32_t *regs = (int32_t *)malloc((size_t)object->num * 2 * sizeof(int32_t));
+  if (!regs) {
+    return cl_ERR_MEMORY;
+  }
+  int32_t *sels = regs + object->num;
+
+  int err = 0;
+  for (int32_t i = 0; i < object->num; ++i) {
+    regs[i] = -1;
+    sels[i] = sel;
+    if (sel == SEL_PART) {
+      c->stack[c->depth++] = &object->columns[i];
+      sels[i] = selection(c);
+      --c->depth;
+    }
+  }
+
+  for (int32_t i = 0; !err && i < object->num; ++i) {
+    const clColumn *field = &object->columns[i];
+    int32_t control = -1;
+    if (field->tp == cl_FLEXIBLE_ARRAY) {
+      control =
+          controlField(object, field, field->via_flexible_array.len.offset);
+    } else if (clIsTagged(field)) {
+      control = controlField(object, field, field->via_union.tag.offset);
+    } else {
+      continue;
+    }
+
+    if (control < 0) {
+      err = cl_ERR_VALUE;
+    } else if (regs[control] < 0) {
+      if (c->projection->registers == PROJECTION_REGISTERS) {
+        err = cl_ERR_CAPACITY;
+      } else {
+        regs[control] = c->projection->registers++;
+      }
+    }
+    if (!err) {
+      regs[i] = regs[control];
+      // decoded along with what it describes
+      if (sels[i] != SEL_NONE) {
+        sels[control] = SEL_ALL;
+      }
+    }
+  }
+
+  for (int32_t i = 0; !err && i < object->num; ++i) {
+    const clColumn *field = &object->columns[i];
+    if (!c->nested && field->tp != cl_OBJECT) {
+      c->leaf = c->leaves++;
+    }
+    c->stack[c->depth++] = field;
+    err = compileColumn(c, field, base, regs[i], sels[i], depth);
+    --c->depth;
+  }
+  free(regs);
+  return err;
+}
+
+int clProjectionInit(clProjection *projection, const clColumn *column,
+                     int wire, const char *const *paths, size_t n) {
+  memset(projection, 0, sizeof(*projection));
+  projection->column = column;
+  projection->wire = wire;
+  if (column->tp != cl_OBJECT) {
+    return cl_ERR_TYPE;
+  }
+  if (wire < cl_WIRE_RAW || wire > cl_WIRE_SWAPPED) {
+    return cl_ERR_VALUE;
+  }
+
+  clCompiler c;
+  memset(&c, 0, sizeof(c));
+  c.projection = projection;
+  c.num_paths = n;
+  if (n) {
+    c.paths = (const clColumn *(*)[MAX_DEPTH])malloc(n * sizeof(*c.paths));
+    c.lens = (int32_t *)malloc(n * sizeof(*c.lens));
+  }
+
+  int err = n && (!c.paths || !c.lens) ? cl_ERR_MEMORY : 0;
+  for (size_t i = 0; !err && i < n; ++i) {
+    err = parsePath(column, paths[i], c.paths[i], &c.lens[i]);
+  }
+  if (!err) {
+    err = compileObject(&c, column, 0, SEL_PART, 0);
+  }
+  free(c.paths);
+  free(c.lens);
+  if (err) {
+    clProjectionFree(projection);
+    return err;
+  }
+
+  // nothing past the last selected field is read
+  int32_t end = 0;
+  for (int32_t pc = 0; pc < projection->num;
+       pc += 1 + projection->ops[pc].sub) {
+    if (projection->ops[pc].dst >= 0) {
+      end = pc + 1 + projection->ops[pc].sub;
+    }
+  }
+  projection->num = end;
+  return 0;
+}
+
+void clProjectionFree(clProjection *projection) {
+  free(projection->ops);
+  projection->ops = NULL;
+  projection->num = 0;
+  projection->registers = 0;
+}
+
+// Where the ops of an object write: the struct at BASE, or row ROW of BATCH
+// for the root object of a clProjectionAppend().
+typedef struct {
+  uint8_t *base;
+  clBatch *batch;
+  size_t row;
+} clTarget;
+
+static uint8_t *address(const clProjectionOp *op, const clTarget *t) {
+  if (op->dst < 0) {
+    return NULL;
+  }
+  if (!t->batch) {
+    return t->base + op->dst;
+  }
+
+  const clBatch *batch = t->batch;
+  size_t size = (size_t)batch->leaves[op->leaf]->size;
+  return batch->data[op->leaf] + size * t->row +
+         (op->dst - batch->offsets[op->leaf]);
+}
+
+// Decodes a number to DST and/or REG.
+static int runNumber(int wire, int tp, int32_t size, uint8_t *dst,
+                     clReader *r, int64_t *reg) {
+  if (clIsVarint(wire, tp, size)) {
+    uint64_t u;
+    int err = clReadVarint(r, &u);
+    if (err) {
+      return err;
+    }
+
+    int64_t v = clIsSigned(tp) ? clUnzigzag(u) : (int64_t)u;
+    if (!clFitsInteger(v, tp, size)) {
+      return cl_ERR_VALUE;
+    }
+    if (dst) {
+      clStoreInteger(dst, size, v);
+    }
+    if (reg) {
+      *reg = v;
+    }
+    return 0;
+  }
+
+  if (r->size - r->pos < (size_t)size) {
+    return cl_ERR_BUFFER;
+  }
+  const uint8_t *src = r->buf + r->pos;
+  r->pos += (size_t)size;
+
+  // a register is only set by words
+  uint8_t word[8];
+  uint8_t *p = dst ? dst : word;
+  if (wire == cl_WIRE_SWAPPED) {
+    clSwapBytes(p, src, 1, size);
+  } else {
+    memcpy(p, src, (size_t)size);
+  }
+  if (reg) {
+    *reg = clLoadInteger(p, tp, size);
+  }
+  return 0;
+}
+
+static int runString(const clProjectionOp *op, int wire, uint8_t *dst,
+                     clReader *r) {
+  int32_t element = op->size;
+  if (!element) {
+    return 0;
+  }
+
+  if (wire == cl_WIRE_COMPACT) {
+    uint64_t len;
+    int err = clReadVarint(r, &len);
+    if (err) {
+      return err;
+    }
+    if (len > (uint64_t)op->count) {
+      return cl_ERR_VALUE;
+    }
+
+    size_t n = (size_t)element * len;
+    if (r->size - r->pos < n) {
+      return cl_ERR_BUFFER;
+    }
+    if (dst) {
+      memcpy(dst, r->buf + r->pos, n);
+      if (len < (uint64_t)op->count) {
+        memset(dst + n, 0, (size_t)element);
+      }
+    }
+    r->pos += n;
+    return 0;
+  }
+
+  // no division for the common strings of chars
+  size_t avail = r->size - r->pos;
+  if (element > 1) {
+    avail /= (size_t)element;
+  }
+  int32_t capacity = op->count;
+  if (avail < (size_t)capacity) {
+    capacity = (int32_t)avail;
+  }
+
+  const uint8_t *p = r->buf + r->pos;
+  int32_t len = clStringLength(p, element, capacity);
+  if (capacity < op->count && !clIsTerminated(p, element, len)) {
+    return cl_ERR_BUFFER;
+  }
+  if (dst && wire == cl_WIRE_SWAPPED) {
+    clSwapBytes(dst, p, (size_t)len, element);
+  } else if (dst) {
+    memcpy(dst, p, (size_t)element * len);
+  }
+  r->pos += (size_t)element * len;
+  return 0;
+}
+
+static int run(const clProjection *projection, int32_t first, int32_t end,
+               const clTarget *t, clReader *r, int64_t *regs);
+
+static int runArray(const clProjection *projection, int32_t pc, uint8_t *dst,
+                    clReader *r, int64_t *regs) {
+  const clProjectionOp *op = &projection->ops[pc];
+  int wire = projection->wire;
+
+  int64_t count = op->reg >= 0 ? regs[op->reg] : op->count;
+  if (count < 0 || count > op->count) {
+    return cl_ERR_CAPACITY;
+  }
+
+  if (op->sub) {
+    for (int64_t i = 0; i < count; ++i) {
+      clTarget element = {dst ? dst + i * op->stride : NULL, NULL, 0};
+      int err = run(projection, pc + 1, pc + 1 + op->sub, &element, r, regs);
+      if (err) {
+        return err;
+      }
+    }
+    return 0;
+  }
+
+  if (op->tp != cl_OBJECT && clIsVarint(wire, op->tp, op->size)) {
+    for (int64_t i = 0; i < count; ++i) {
+      int err = runNumber(wire, op->tp, op->size,
+                          dst ? dst + i * op->stride : NULL, r, NULL);
+      if (err) {
+        return err;
+      }
+    }
+    return 0;
+  }
+
+  // elements of one run of bytes each, in one go
+  size_t n = (size_t)count * op->size;
+  if (r->size - r->pos < n) {
+    return cl_ERR_BUFFER;
+  }
+  if (dst && wire == cl_WIRE_SWAPPED && op->tp != cl_OBJECT) {
+    clSwapBytes(dst, r->buf + r->pos, (size_t)count, op->size);
+  } else if (dst && n) {
+    memcpy(dst, r->buf + r->pos, n);
+  }
+  r->pos += n;
+  return 0;
+}
+
+static int runUnion(const clProjection *projection, int32_t pc,
+                    const clTarget *t, clReader *r, int64_t *regs) {
+  const clProjectionOp *op = &projection->ops[pc];
+  const clUnion *u = &op->column->via_union;
+  int64_t tag = regs[op->reg];
+  int32_t index =
+      (uint64_t)tag < (uint64_t)u->num_cases ? u->cases[tag] : -1;
+
+  int32_t end = pc + 1 + op->sub;
+  for (int32_t m = pc + 1; m < end; m += 1 + projection->ops[m].sub) {
+    const clProjectionOp *member = &projection->ops[m];
+    if (member->count == index) {
+      return run(projection, m + 1, m + 1 + member->sub, t, r, regs);
+    }
+  }
+  return 0;
+}
+
+static int run(const clProjection *projection, int32_t first, int32_t end,
+               const clTarget *t, clReader *r, int64_t *regs) {
+  for (int32_t pc = first; pc < end; ++pc) {
+    const clProjectionOp *op = &projection->ops[pc];
+    uint8_t *dst = address(op, t);
+    int err = 0;
+
+    switch (op->op) {
+    case OP_COPY:
+    case OP_SKIP:
+      if (r->size - r->pos < (size_t)op->size) {
+        return cl_ERR_BUFFER;
+      }
+      if (dst) {
+        memcpy(dst, r->buf + r->pos, (size_t)op->size);
+      }
+      r->pos += (size_t)op->size;
+      break;
+
+    case OP_VARINTS:
+      for (int32_t i = 0; !err && i < op->count; ++i) {
+        uint64_t v;
+        err = clReadVarint(r, &v);
+      }
+      break;
+
+    case OP_NUMBER:
+      err = runNumber(projection->wire, op->tp, op->size, dst, r,
+                      op->reg >= 0 ? &regs[op->reg] : NULL);
+      break;
+
+    case OP_STRING:
+      err = runString(op, projection->wire, dst, r);
+      break;
+
+    case OP_ARRAY:
+      err = runArray(projection, pc, dst, r, regs);
+      pc += op->sub;
+      break;
+
+    case OP_UNION:
+      err = runUnion(projection, pc, t, r, regs);
+      pc += op->sub;
+      break;
+    }
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+ptrdiff_t clProjectionDecode(const clProjection *projection, void *dst,
+                             const void *buf, size_t size) {
+  int64_t regs[PROJECTION_REGISTERS];
+  clReader r = {(const uint8_t *)buf, 0, size, projection->wire};
+  clTarget t = {(uint8_t *)dst, NULL, 0};
+  int err = run(projection, 0, projection->num, &t, &r, regs);
+  return err ? err : (ptrdiff_t)r.pos;
+}
+
+ptrdiff_t clProjectionAppend(const clProjection *projection, clBatch *batch,
+                             const void *buf, size_t size) {
+  if (batch->column != projection->column) {
+    return cl_ERR_TYPE;
+  }
+  if (batch->size == batch->capacity) {
+    int err =
+        clBatchReserve(batch, batch->capacity ? batch->capacity * 2 : 64);
+    if (err) {
+      return err;
+    }
+  }
+
+  for (int32_t i = 0; i < batch->num; ++i) {
+    size_t n = (size_t)batch->leaves[i]->size;
+    memset(batch->data[i] + n * batch->size, 0, n);
+  }
+
+  int64_t regs[PROJECTION_REGISTERS];
+  clReader r = {(const uint8_t *)buf, 0, size, projection->wire};
+  clTarget t = {NULL, batch, batch->size};
+  int err = run(projection, 0, projection->num, &t, &r, regs);
+  if (err) {
+    return err;
+  }
+  ++batch->size;
+  return (ptrdiff_t)r.pos;
+}
@@ -0,0 +1,233 @@
+#include "internal.h"
+
+#include <stdlib.h>
+#include <sys/uio.h>
+
+// Every message is a record: an 8-byte header and the slot, padded to 8
+// bytes. Producers claim records by moving HEAD with a compare-and-swap and
+// fill the header in; the consumer trusts a record once its STATE has the
+// commit bit. A record never wraps: when it does not fit before the end of
+// the buffer, the rest of the buffer is claimed along with it as an empty
+// record. Released records are zeroed before TAIL moves past them, so that
+// everything between HEAD and TAIL + SIZE reads as uncommitted.
+
+#define RING_ALIGN 64                 // one cache line
+#define RING_MAX ((size_t)1 << 31)    // spans and lengths fit in 31 bits
+#define RING_COMMIT ((uint32_t)1 << 31)
+#define RING_BATCH 32                 // slots of clRingEncodeAll() at once
+
+typedef struct clRecord {
+  uint32_t span;  // bytes up to the next record
+  uint32_t state; // RING_COMMIT | used bytes, 0 until committed
+} clRecord;
+
+static uint64_t span(size_t size) {
+  return sizeof(clRecord) + ((size + 7) & ~(size_t)7);
+}
+
+static clRecord *record(const clRing *ring, uint64_t pos) {
+  return (clRecord *)(ring->data + (pos & (ring->size - 1)));
+}
+
+int clRingInit(clRing *ring, size_t size) {
+  memset(ring, 0, sizeof(*ring));
+  if (!size || size > RING_MAX) {
+    return cl_ERR_VALUE;
+  }
+
+  size_t n = RING_ALIGN;
+  while (n < size) {
+    n <<= 1;
+  }
+  ring->data = (uint8_t *)aligned_alloc(RING_ALIGN, n);
+  if (!ring->data) {
+    return cl_ERR_MEMORY;
+  }
+  memset(ring->data, 0, n);
+  ring->size = n;
+  return 0;
+}
+
+void clRingFree(clRing *ring) {
+  free(ring->data);
+  memset(ring, 0, sizeof(*ring));
+}
+
+// Claims TOTAL contiguous bytes and returns their position in START.
+static int reserve(clRing *ring, uint64_t total, uint64_t *start) {
+  if (total > ring->size / 2) {
+    return cl_ERR_CAPACITY;
+  }
+
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  uint64_t need;
+  for (;;) {
+    // the acquire pairs with clRingRelease(), the bytes read as zeroes
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint64_t room = ring->size - (head & (ring->size - 1));
+    need = total <= room ? total : room + total;
+    if (head + need - tail > ring->size) {
+      return cl_ERR_BUFFER;
+    }
+    if (__atomic_compare_exchange_n(&ring->head, &head, head + need, true,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+
+  if (need > total) {
+    clRecord *skip = record(ring, head);
+    skip->span = (uint32_t)(need - total);
+    __atomic_store_n(&skip->state, RING_COMMIT, __ATOMIC_RELEASE);
+  }
+  *start = head + need - total;
+  return 0;
+}
+
+int clRingReserveAll(clRing *ring, const size_t *sizes, size_t n,
+                     void **slots) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (sizes[i] > ring->size / 2) {
+      return cl_ERR_CAPACITY;
+    }
+    total += span(sizes[i]);
+  }
+  if (!n) {
+    return 0;
+  }
+
+  uint64_t pos;
+  int err = reserve(ring, total, &pos);
+  if (err) {
+    return err;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    clRecord *r = record(ring, pos);
+    r->span = (uint32_t)span(sizes[i]);
+    slots[i] = r + 1;
+    pos += r->span;
+  }
+  return 0;
+}
+
+int clRingReserve(clRing *ring, size_t size, void **slot) {
+  return clRingReserveAll(ring, &size, 1, slot);
+}
+
+void clRingCommit(clRing *ring, void *slot, size_t used) {
+  (void)ring;
+  clRecord *r = (clRecord *)slot - 1;
+  __atomic_store_n(&r->state, RING_COMMIT | (uint32_t)used, __ATOMIC_RELEASE);
+}
+
+ptrdiff_t clRingEncode(clRing *ring, const clColumn *column, int wire,
+                       const void *src) {
+  ptrdiff_t size = clEncodeSizeEx(column, wire, src);
+  if (size < 0) {
+    return size;
+  }
+
+  void *slot;
+  int err = clRingReserve(ring, (size_t)size, &slot);
+  if (err) {
+    return err;
+  }
+  ptrdiff_t n = clEncodeEx(column, wire, src, slot, (size_t)size);
+  clRingCommit(ring, slot, n < 0 ? 0 : (size_t)n);
+  return n;
+}
+
+ptrdiff_t clRingEncodeAll(clRing *ring, const clColumn *const *columns,
+                          int wire, const void *const *msgs, size_t n) {
+  size_t sizes[RING_BATCH];
+  void *slots[RING_BATCH];
+
+  size_t done = 0;
+  while (done < n) {
+    size_t k = n - done < RING_BATCH ? n - done : RING_BATCH;
+    for (size_t i = 0; i < k; ++i) {
+      ptrdiff_t size = clEncodeSizeEx(columns[done + i], wire, msgs[done + i]);
+      if (size < 0) {
+        if (!i) {
+          return done ? (ptrdiff_t)done : size;
+        }
+        k = i;
+        break;
+      }
+      sizes[i] = (size_t)size;
+    }
+
+    // as many of them as fit
+    int err = clRingReserveAll(ring, sizes, k, slots);
+    while (err && k > 1) {
+      k /= 2;
+      err = clRingReserveAll(ring, sizes, k, slots);
+    }
+    if (err) {
+      return done ? (ptrdiff_t)done : err;
+    }
+
+    // after a failed encode the rest are dropped, every slot is committed
+    ptrdiff_t failed = 0;
+    for (size_t i = 0; i < k; ++i) {
+      ptrdiff_t m = 0;
+      if (!failed) {
+        m = clEncodeEx(columns[done + i], wire, msgs[done + i], slots[i],
+                       sizes[i]);
+        if (m < 0) {
+          failed = m;
+          done += i;
+          m = 0;
+        }
+      }
+      clRingCommit(ring, slots[i], (size_t)m);
+    }
+    if (failed) {
+      return done ? (ptrdiff_t)done : failed;
+    }
+    done += k;
+  }
+  return (ptrdiff_t)done;
+}
+
+int clRingPeek(const clRing *ring, struct iovec *iov, int n) {
+  uint64_t tail = ring->tail;
+  uint64_t pos = tail;
+  int num = 0;
+  while (num < n && pos - tail < ring->size) {
+    clRecord *r = record(ring, pos);
+    uint32_t state = __atomic_load_n(&r->state, __ATOMIC_ACQUIRE);
+    if (!(state & RING_COMMIT)) {
+      break;
+    }
+
+    uint32_t used = state & ~RING_COMMIT;
+    if (used) {
+      iov[num].iov_base = r + 1;
+      iov[num].iov_len = used;
+      ++num;
+    }
+    pos += r->span;
+  }
+  return num;
+}
+
+void clRingRelease(clRing *ring, int n) {
+  uint64_t pos = ring->tail;
+  while (n > 0 && pos - ring->tail < ring->size) {
+    clRecord *r = record(ring, pos);
+    uint32_t state = __atomic_load_n(&r->state, __ATOMIC_ACQUIRE);
+    uint32_t bytes = r->span;
+    if (!(state & RING_COMMIT) || !bytes) {
+      break;
+    }
+    if (state & ~RING_COMMIT) {
+      --n;
+    }
+    memset(r, 0, bytes);
+    pos += bytes;
+  }
+  __atomic_store_n(&ring->tail, pos, __ATOMIC_RELEASE);
+}
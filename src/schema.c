@@ -0,0 +1,443 @@
+#include "internal.h"
+
+#include <stdlib.h>
+
+// A serialized descriptor tree, every column in pre-order:
+//
+//   u8 tp, u8 name length, name, i32 size, i32 align, i64 offset
+//   cl_OBJECT, cl_UNION     i32 num, then the children
+//   cl_UNION                then i32 num cases, and when not 0 the cases as
+//                           i16, u8 tag tp, i32 tag size, i64 tag offset
+//   cl_FIXED_ARRAY          u8 tp, i32 capacity, u8 has element, element
+//   cl_FLEXIBLE_ARRAY       as above, then u8 len tp, i32 len size,
+//                           i64 len offset
+//   cl_STRING               u8 tp, i32 capacity
+//
+// in host byte order. Lookup tables are not kept, clFindColumn() falls back
+// to a linear scan on a tree read back with clSchemaRead().
+
+#define MAX_DEPTH 64
+
+static int putU8(clWriter *w, int v) {
+  uint8_t x = (uint8_t)v;
+  return clWriteBytes(w, &x, sizeof(x));
+}
+
+static int putI16(clWriter *w, int16_t v) {
+  return clWriteBytes(w, &v, sizeof(v));
+}
+
+static int putI32(clWriter *w, int32_t v) {
+  return clWriteBytes(w, &v, sizeof(v));
+}
+
+static int putI64(clWriter *w, int64_t v) {
+  return clWriteBytes(w, &v, sizeof(v));
+}
+
+static int writeColumn(const clColumn *column, clWriter *w) {
+  int err = putU8(w, column->tp);
+  if (!err) {
+    err = putU8(w, column->name.len);
+  }
+  if (!err) {
+    err = clWriteBytes(w, column->name.string, (size_t)column->name.len);
+  }
+  if (!err) {
+    err = putI32(w, column->size);
+  }
+  if (!err) {
+    err = putI32(w, column->align);
+  }
+  if (!err) {
+    err = putI64(w, column->offset);
+  }
+  if (err) {
+    return err;
+  }
+
+  switch (column->tp) {
+  case cl_OBJECT:
+  case cl_UNION: {
+    const clObject *object = &column->via_object;
+    err = putI32(w, object->num);
+    for (int32_t i = 0; !err && i < object->num; ++i) {
+      err = writeColumn(&object->columns[i], w);
+    }
+    if (err || column->tp != cl_UNION) {
+      return err;
+    }
+
+    const clUnion *u = &column->via_union;
+    err = putI32(w, u->num_cases);
+    for (int32_t i = 0; !err && i < u->num_cases; ++i) {
+      err = putI16(w, u->cases[i]);
+    }
+    if (!err && u->num_cases) {
+      err = putU8(w, u->tag.tp);
+    }
+    if (!err && u->num_cases) {
+      err = putI32(w, u->tag.size);
+    }
+    if (!err && u->num_cases) {
+      err = putI64(w, u->tag.offset);
+    }
+    return err;
+  }
+
+  case cl_FIXED_ARRAY: {
+    const clFixedArray *array = &column->via_fixed_array;
+    err = putU8(w, array->tp);
+    if (!err) {
+      err = putI32(w, array->capacity);
+    }
+    if (!err) {
+      err = putU8(w, array->columns != NULL);
+    }
+    if (!err && array->columns) {
+      err = writeColumn(array->columns, w);
+    }
+    return err;
+  }
+
+  case cl_FLEXIBLE_ARRAY: {
+    const clFlexibleArray *array = &column->via_flexible_array;
+    err = putU8(w, array->tp);
+    if (!err) {
+      err = putI32(w, array->capacity);
+    }
+    if (!err) {
+      err = putU8(w, array->columns != NULL);
+    }
+    if (!err && array->columns) {
+      err = writeColumn(array->columns, w);
+    }
+    if (!err) {
+      err = putU8(w, array->len.tp);
+    }
+    if (!err) {
+      err = putI32(w, array->len.size);
+    }
+    if (!err) {
+      err = putI64(w, array->len.offset);
+    }
+    return err;
+  }
+
+  case cl_STRING:
+    err = putU8(w, column->via_string.tp);
+    return err ? err : putI32(w, column->via_string.capacity);
+
+  default:
+    return 0;
+  }
+}
+
+ptrdiff_t clSchemaSize(const clColumn *column) {
+  clWriter w = {NULL, 0, 0, cl_WIRE_RAW, NULL, NULL, 0};
+  int err = writeColumn(column, &w);
+  return err ? err : (ptrdiff_t)w.pos;
+}
+
+ptrdiff_t clSchemaWrite(const clColumn *column, void *buf, size_t size) {
+  clWriter w = {(uint8_t *)buf, 0, size, cl_WIRE_RAW, NULL, NULL, 0};
+  int err = writeColumn(column, &w);
+  return err ? err : (ptrdiff_t)w.pos;
+}
+
+// Reading runs twice over the same bytes: first only counting the columns,
+// union cases and name bytes (NODES is NULL), then filling one allocation.
+typedef struct {
+  clReader r;
+  clColumn *nodes;
+  size_t num;
+  int16_t *cases;
+  size_t cases_len;
+  char *names;
+  size_t names_len;
+} clSchemaReader;
+
+static int getU8(clSchemaReader *s, uint8_t *v) {
+  return clReadBytes(&s->r, v, sizeof(*v));
+}
+
+static int getI16(clSchemaReader *s, int16_t *v) {
+  return clReadBytes(&s->r, v, sizeof(*v));
+}
+
+static int getI32(clSchemaReader *s, int32_t *v) {
+  return clReadBytes(&s->r, v, sizeof(*v));
+}
+
+static int getI64(clSchemaReader *s, int64_t *v) {
+  return clReadBytes(&s->r, v, sizeof(*v));
+}
+
+static int readColumn(clSchemaReader *s, clColumn *column, int depth);
+
+// Reads the children of an object or union into consecutive nodes.
+static int readChildren(clSchemaReader *s, int32_t num, int depth,
+                        const clColumn **out) {
+  clColumn *children = s->nodes ? s->nodes + s->num : NULL;
+  s->num += (size_t)num;
+  *out = children;
+
+  for (int32_t i = 0; i < num; ++i) {
+    int err = readColumn(s, children ? &children[i] : NULL, depth + 1);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+static int readElement(clSchemaReader *s, int depth, const clColumn **out) {
+  uint8_t has;
+  int err = getU8(s, &has);
+  if (err) {
+    return err;
+  }
+  if (has > 1) {
+    return cl_ERR_VALUE;
+  }
+
+  *out = NULL;
+  if (!has) {
+    return 0;
+  }
+
+  clColumn *element = s->nodes ? s->nodes + s->num : NULL;
+  s->num += 1;
+  *out = element;
+  return readColumn(s, element, depth + 1);
+}
+
+static int readCases(clSchemaReader *s, clColumn *column) {
+  clUnion *u = &column->via_union;
+  int err = getI32(s, &u->num_cases);
+  if (err) {
+    return err;
+  }
+  if (u->num_cases < 0 ||
+      (size_t)u->num_cases > (s->r.size - s->r.pos) / sizeof(int16_t)) {
+    return cl_ERR_VALUE;
+  }
+  if (!u->num_cases) {
+    return 0;
+  }
+
+  int16_t *cases = s->cases ? s->cases + s->cases_len : NULL;
+  s->cases_len += (size_t)u->num_cases;
+  u->cases = cases;
+  for (int32_t i = 0; i < u->num_cases; ++i) {
+    int16_t v;
+    err = getI16(s, &v);
+    if (err) {
+      return err;
+    }
+    if (v < -1 || v >= u->num) {
+      return cl_ERR_VALUE;
+    }
+    if (cases) {
+      cases[i] = v;
+    }
+  }
+
+  uint8_t tag_tp;
+  int64_t tag_offset;
+  err = getU8(s, &tag_tp);
+  if (!err) {
+    err = getI32(s, &u->tag.size);
+  }
+  if (!err) {
+    err = getI64(s, &tag_offset);
+  }
+  if (err) {
+    return err;
+  }
+  if (!clIsNumber(tag_tp) || clIsFloat(tag_tp) || tag_offset < 0) {
+    return cl_ERR_VALUE;
+  }
+  u->tag.tp = (int8_t)tag_tp;
+  u->tag.offset = (ptrdiff_t)tag_offset;
+  return 0;
+}
+
+static int readColumn(clSchemaReader *s, clColumn *column, int depth) {
+  clColumn tmp;
+  if (!column) {
+    column = &tmp;
+  }
+  memset(column, 0, sizeof(*column));
+
+  if (depth > MAX_DEPTH) {
+    return cl_ERR_VALUE;
+  }
+
+  uint8_t tp, len;
+  int err = getU8(s, &tp);
+  if (!err) {
+    err = getU8(s, &len);
+  }
+  if (err) {
+    return err;
+  }
+  if (tp == cl_NONE || tp >= cl_MAX || len > INT8_MAX) {
+    return cl_ERR_VALUE;
+  }
+  if (s->r.size - s->r.pos < len) {
+    return cl_ERR_BUFFER;
+  }
+
+  column->tp = (int8_t)tp;
+  column->name.len = (int8_t)len;
+  if (s->names) {
+    char *name = s->names + s->names_len;
+    memcpy(name, s->r.buf + s->r.pos, len);
+    name[len] = '\0';
+    column->name.string = name;
+  }
+  s->names_len += (size_t)len + 1;
+  s->r.pos += len;
+
+  int64_t offset;
+  err = getI32(s, &column->size);
+  if (!err) {
+    err = getI32(s, &column->align);
+  }
+  if (!err) {
+    err = getI64(s, &offset);
+  }
+  if (err) {
+    return err;
+  }
+  if (column->size < 0 || offset < 0) {
+    return cl_ERR_VALUE;
+  }
+  column->offset = (ptrdiff_t)offset;
+
+  switch (tp) {
+  case cl_OBJECT:
+  case cl_UNION: {
+    int32_t num;
+    err = getI32(s, &num);
+    if (err) {
+      return err;
+    }
+    // every child takes at least 18 bytes
+    if (num < 0 || (size_t)num > (s->r.size - s->r.pos) / 18) {
+      return cl_ERR_VALUE;
+    }
+    column->via_object.num = num;
+    err = readChildren(s, num, depth, &column->via_object.columns);
+    return err || tp != cl_UNION ? err : readCases(s, column);
+  }
+
+  case cl_FIXED_ARRAY:
+  case cl_FLEXIBLE_ARRAY: {
+    uint8_t element_tp;
+    int32_t capacity;
+    const clColumn *element;
+    err = getU8(s, &element_tp);
+    if (!err) {
+      err = getI32(s, &capacity);
+    }
+    if (!err) {
+      err = readElement(s, depth, &element);
+    }
+    if (err) {
+      return err;
+    }
+    if (capacity < 0) {
+      return cl_ERR_VALUE;
+    }
+
+    if (tp == cl_FIXED_ARRAY) {
+      column->via_fixed_array.tp = (int8_t)element_tp;
+      column->via_fixed_array.capacity = capacity;
+      column->via_fixed_array.columns = element;
+      return 0;
+    }
+
+    clFlexibleArray *array = &column->via_flexible_array;
+    array->tp = element_tp;
+    array->capacity = capacity;
+    array->columns = element;
+
+    uint8_t len_tp;
+    int64_t len_offset;
+    err = getU8(s, &len_tp);
+    if (!err) {
+      err = getI32(s, &array->len.size);
+    }
+    if (!err) {
+      err = getI64(s, &len_offset);
+    }
+    if (err) {
+      return err;
+    }
+    if (!clIsNumber(len_tp) || len_offset < 0) {
+      return cl_ERR_VALUE;
+    }
+    array->len.tp = (int8_t)len_tp;
+    array->len.offset = (ptrdiff_t)len_offset;
+    return 0;
+  }
+
+  case cl_STRING: {
+    uint8_t string_tp;
+    err = getU8(s, &string_tp);
+    if (!err) {
+      err = getI32(s, &column->via_string.capacity);
+    }
+    if (err) {
+      return err;
+    }
+    if (column->via_string.capacity < 0) {
+      return cl_ERR_VALUE;
+    }
+    column->via_string.tp = (int8_t)string_tp;
+    return 0;
+  }
+
+  default:
+    return 0;
+  }
+}
+
+ptrdiff_t clSchemaRead(const clColumn **out, const void *buf, size_t size) {
+  clSchemaReader s;
+  memset(&s, 0, sizeof(s));
+  s.r.buf = (const uint8_t *)buf;
+  s.r.size = size;
+  s.num = 1;
+
+  int err = readColumn(&s, NULL, 0);
+  if (err) {
+    return err;
+  }
+
+  size_t nodes = s.num;
+  size_t cases = s.cases_len;
+  size_t names = s.names_len;
+  clColumn *columns = (clColumn *)malloc(nodes * sizeof(clColumn) +
+                                         cases * sizeof(int16_t) + names);
+  if (!columns) {
+    return cl_ERR_MEMORY;
+  }
+
+  memset(&s, 0, sizeof(s));
+  s.r.buf = (const uint8_t *)buf;
+  s.r.size = size;
+  s.nodes = columns;
+  s.num = 1;
+  s.cases = (int16_t *)(columns + nodes);
+  s.names = (char *)(s.cases + cases);
+
+  readColumn(&s, columns, 0);
+
+  // a program cached for a tree freed at the same address is stale
+  clProgramInvalidate();
+  *out = columns;
+  return (ptrdiff_t)s.r.pos;
+}
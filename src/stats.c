@@ -0,0 +1,241 @@
+#define _POSIX_C_SOURCE 200112L // clock_gettime
+
+#include "internal.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Every thread counts into a shard of its own: an open addressing table of
+// clStats keyed by descriptor, each allocated on the first call for its
+// descriptor. The owner updates the counters with plain loads and stores,
+// relaxed atomics only so that clStatsSnapshot() may read them meanwhile.
+// Shards are never freed: the shard of a thread that exits goes on to the
+// next new thread, its counts included.
+
+#define STATS_SLOTS 256 // power of two, descriptors per thread
+
+typedef struct clStatsShard {
+  clStats *slots[STATS_SLOTS];
+  bool busy; // owned by a running thread
+  struct clStatsShard *next;
+} clStatsShard;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static clStatsShard *shards;
+
+static uint64_t load(const uint64_t *p) {
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static void store(uint64_t *p, uint64_t v) {
+  __atomic_store_n(p, v, __ATOMIC_RELAXED);
+}
+
+static void add(uint64_t *dst, const uint64_t *src) {
+  store(dst, load(dst) + load(src));
+}
+
+void clStatsMerge(clStats *dst, const clStats *src) {
+  add(&dst->invalid, &src->invalid);
+  for (int i = 0; i < cl_STATS_OPS; ++i) {
+    clStatsOp *d = &dst->ops[i];
+    const clStatsOp *s = &src->ops[i];
+    add(&d->calls, &s->calls);
+    add(&d->errors, &s->errors);
+    add(&d->bytes_in, &s->bytes_in);
+    add(&d->bytes_out, &s->bytes_out);
+    for (int j = 0; j < cl_STATS_BUCKETS; ++j) {
+      add(&d->latency[j], &s->latency[j]);
+    }
+  }
+}
+
+size_t clStatsSnapshot(clStats *out, size_t n) {
+  size_t num = 0;
+  pthread_mutex_lock(&lock);
+  for (clStatsShard *s = shards; s; s = s->next) {
+    for (size_t i = 0; i < STATS_SLOTS; ++i) {
+      clStats *stats = __atomic_load_n(&s->slots[i], __ATOMIC_ACQUIRE);
+      if (!stats) {
+        continue;
+      }
+
+      size_t j = 0;
+      while (j < num && out[j].column != stats->column) {
+        ++j;
+      }
+      if (j == num) {
+        if (num == n) {
+          continue;
+        }
+        memset(&out[num], 0, sizeof(out[num]));
+        out[num++].column = stats->column;
+      }
+      clStatsMerge(&out[j], stats);
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return num;
+}
+
+void clStatsReset(void) {
+  pthread_mutex_lock(&lock);
+  for (clStatsShard *s = shards; s; s = s->next) {
+    for (size_t i = 0; i < STATS_SLOTS; ++i) {
+      clStats *stats = __atomic_load_n(&s->slots[i], __ATOMIC_ACQUIRE);
+      if (!stats) {
+        continue;
+      }
+
+      // counter by counter, the owner may be storing meanwhile
+      uint64_t *p = &stats->invalid;
+      uint64_t *end = (uint64_t *)&stats->ops[cl_STATS_OPS];
+      for (; p < end; ++p) {
+        store(p, 0);
+      }
+    }
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+uint64_t clStatsQuantile(const clStatsOp *op, double q) {
+  uint64_t calls = 0;
+  for (int i = 0; i < cl_STATS_BUCKETS; ++i) {
+    calls += op->latency[i];
+  }
+  if (!calls) {
+    return 0;
+  }
+
+  // the rank of the quantile, 1-based
+  uint64_t rank = (uint64_t)(q * (double)calls);
+  if (rank < 1) {
+    rank = 1;
+  }
+  if (rank > calls) {
+    rank = calls;
+  }
+
+  uint64_t seen = 0;
+  int i = 0;
+  for (; i < cl_STATS_BUCKETS - 1; ++i) {
+    seen += op->latency[i];
+    if (seen >= rank) {
+      break;
+    }
+  }
+  return i == cl_STATS_BUCKETS - 1 ? UINT64_MAX : (uint64_t)2 << i;
+}
+
+#ifdef CL_STATS
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static pthread_key_t key;
+static _Thread_local clStatsShard *shard;
+
+static void release(void *p) {
+  pthread_mutex_lock(&lock);
+  ((clStatsShard *)p)->busy = false;
+  pthread_mutex_unlock(&lock);
+}
+
+static void makeKey(void) { pthread_key_create(&key, release); }
+
+// Hands a free shard, or a new one, to the calling thread.
+static clStatsShard *acquire(void) {
+  pthread_once(&once, makeKey);
+
+  pthread_mutex_lock(&lock);
+  clStatsShard *s = shards;
+  while (s && s->busy) {
+    s = s->next;
+  }
+  if (!s) {
+    s = (clStatsShard *)calloc(1, sizeof(clStatsShard));
+    if (s) {
+      s->next = shards;
+      shards = s;
+    }
+  }
+  if (s) {
+    s->busy = true;
+  }
+  pthread_mutex_unlock(&lock);
+
+  if (s) {
+    pthread_setspecific(key, s);
+  }
+  shard = s;
+  return s;
+}
+
+// Returns the counters of COLUMN in the shard of the calling thread, or
+// NULL when out of memory or slots.
+static clStats *find(const clColumn *column) {
+  clStatsShard *s = shard ? shard : acquire();
+  if (!s) {
+    return NULL;
+  }
+
+  size_t h = (size_t)(((uintptr_t)column >> 4) * 0x9e3779b97f4a7c15u >> 32);
+  for (size_t i = 0; i < STATS_SLOTS; ++i) {
+    clStats **slot = &s->slots[(h + i) & (STATS_SLOTS - 1)];
+    if (*slot && (*slot)->column == column) {
+      return *slot;
+    }
+    if (!*slot) {
+      clStats *stats = (clStats *)calloc(1, sizeof(clStats));
+      if (stats) {
+        stats->column = column;
+        __atomic_store_n(slot, stats, __ATOMIC_RELEASE);
+      }
+      return stats;
+    }
+  }
+  return NULL;
+}
+
+static void bump(uint64_t *p, uint64_t n) { store(p, load(p) + n); }
+
+uint64_t clStatsNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void clStatsRecord(const clColumn *column, int op, uint64_t start,
+                   ptrdiff_t result) {
+  uint64_t ns = clStatsNow() - start;
+  clStats *stats = find(column);
+  if (!stats) {
+    return;
+  }
+
+  clStatsOp *s = &stats->ops[op];
+  bump(&s->calls, 1);
+  if (result < 0) {
+    bump(&s->errors, 1);
+  } else if (op == cl_STATS_DECODE) {
+    bump(&s->bytes_in, (uint64_t)result);
+    bump(&s->bytes_out, (uint64_t)column->size);
+  } else {
+    bump(&s->bytes_in, (uint64_t)column->size);
+    bump(&s->bytes_out, (uint64_t)result);
+  }
+
+  int bucket = 63 - __builtin_clzll(ns | 1);
+  if (bucket >= cl_STATS_BUCKETS) {
+    bucket = cl_STATS_BUCKETS - 1;
+  }
+  bump(&s->latency[bucket], 1);
+}
+
+void clStatsInvalid(const clColumn *column, ptrdiff_t n) {
+  clStats *stats = n > 0 ? find(column) : NULL;
+  if (stats) {
+    bump(&stats->invalid, (uint64_t)n);
+  }
+}
+
+#endif
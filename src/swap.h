@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#ifdef __SSSE3__
+
+// PSHUFB masks reversing every element of 2, 4, 8 and 16 bytes of a vector.
+static inline __m128i clSwapMask(int32_t width) {
+  switch (width) {
+  case 2:
+    return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  case 4:
+    return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  case 8:
+    return _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  default:
+    return _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+  }
+}
+
+#endif
+
+// Copies N elements of WIDTH bytes from SRC to DST, which may be SRC, with
+// the bytes of each element reversed.
+static inline void clSwapBytes(uint8_t *dst, const uint8_t *src, size_t n,
+                               int32_t width) {
+  size_t i = 0;
+
+#ifdef __SSSE3__
+  // sixteen bytes hold a whole number of elements of these widths
+  if (width == 2 || width == 4 || width == 8 || width == 16) {
+    __m128i mask = clSwapMask(width);
+    size_t per = 16 / (size_t)width;
+    for (; i + per <= n; i += per) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i * width));
+      _mm_storeu_si128((__m128i *)(dst + i * width),
+                       _mm_shuffle_epi8(v, mask));
+    }
+  }
+#endif
+
+  switch (width) {
+  case 2:
+    for (; i < n; ++i) {
+      uint16_t v;
+      memcpy(&v, src + i * 2, 2);
+      v = __builtin_bswap16(v);
+      memcpy(dst + i * 2, &v, 2);
+    }
+    break;
+  case 4:
+    for (; i < n; ++i) {
+      uint32_t v;
+      memcpy(&v, src + i * 4, 4);
+      v = __builtin_bswap32(v);
+      memcpy(dst + i * 4, &v, 4);
+    }
+    break;
+  case 8:
+    for (; i < n; ++i) {
+      uint64_t v;
+      memcpy(&v, src + i * 8, 8);
+      v = __builtin_bswap64(v);
+      memcpy(dst + i * 8, &v, 8);
+    }
+    break;
+  default:
+    for (; i < n; ++i) {
+      const uint8_t *s = src + i * width;
+      uint8_t *d = dst + i * width;
+      for (int32_t lo = 0, hi = width - 1; lo <= hi; ++lo, --hi) {
+        uint8_t t = s[lo];
+        d[lo] = s[hi];
+        d[hi] = t;
+      }
+    }
+    break;
+  }
+}
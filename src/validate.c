@@ -0,0 +1,403 @@
+#include "internal.h"
+
+#include <stdlib.h>
+
+// A validator is a flat list of checks in the order of the fields: nested
+// objects are inlined with their offsets added up, and the checks of an
+// array element or of a tagged union member follow the CHECK_ARRAY or
+// CHECK_MEMBER running them. Fields that hold no invalid value, such as
+// floats and plain integers, have no check at all.
+
+#define MAX_DEPTH 64
+#define BLOCK 64 // messages per word of the mask
+
+enum {
+  CHECK_RANGE,  // COUNT integers at OFFSET, each in [MIN, MIN + SPAN]
+  CHECK_STRING, // a terminator within COUNT elements at OFFSET
+  CHECK_ARRAY,  // the next SUB checks on every element at OFFSET
+  CHECK_MEMBER, // the next SUB checks when COLUMN selects its member INDEX
+};
+
+struct clCheck {
+  int8_t check;
+  int8_t tp;
+  int32_t size; // of an integer or element
+  int32_t count;
+  int32_t sub;
+  ptrdiff_t offset; // from the current object or element
+  int64_t min;
+  uint64_t span;
+
+  // CHECK_ARRAY: the length field of a flexible array, or -1.
+  // CHECK_MEMBER: the object holding the union and its tag.
+  ptrdiff_t len;
+  int8_t len_tp;
+  int32_t len_size;
+
+  const clColumn *column; // CHECK_MEMBER
+  int32_t index;
+};
+
+typedef struct {
+  clValidator *validator;
+  int32_t capacity;
+} clCompiler;
+
+static int emit(clCompiler *c, int check, ptrdiff_t offset, int32_t *idx) {
+  clValidator *validator = c->validator;
+  if (validator->num == c->capacity) {
+    int32_t capacity = c->capacity ? c->capacity * 2 : 16;
+    clCheck *checks = (clCheck *)realloc(validator->checks,
+                                         (size_t)capacity * sizeof(clCheck));
+    if (!checks) {
+      return cl_ERR_MEMORY;
+    }
+    validator->checks = checks;
+    c->capacity = capacity;
+  }
+
+  clCheck *p = &validator->checks[validator->num];
+  memset(p, 0, sizeof(*p));
+  p->check = (int8_t)check;
+  p->offset = offset;
+  p->count = 1;
+  p->len = -1;
+  *idx = validator->num++;
+  return 0;
+}
+
+static bool isWord(int32_t size) {
+  return size == 1 || size == 2 || size == 4 || size == 8;
+}
+
+static int emitRange(clCompiler *c, ptrdiff_t offset, int tp, int32_t size,
+                     int32_t count, int64_t min, int64_t max) {
+  if (!isWord(size) || min > max) {
+    return cl_ERR_VALUE;
+  }
+
+  int32_t idx;
+  int err = emit(c, CHECK_RANGE, offset, &idx);
+  if (!err) {
+    clCheck *check = &c->validator->checks[idx];
+    check->tp = (int8_t)tp;
+    check->size = size;
+    check->count = count;
+    check->min = min;
+    check->span = (uint64_t)max - (uint64_t)min;
+  }
+  return err;
+}
+
+// Ends the checks of an element or member started at IDX, dropped along
+// with them when there are none.
+static void endSub(clCompiler *c, int32_t idx) {
+  clValidator *validator = c->validator;
+  validator->checks[idx].sub = validator->num - idx - 1;
+  if (!validator->checks[idx].sub) {
+    validator->num = idx;
+  }
+}
+
+static int compileColumn(clCompiler *c, const clColumn *column,
+                         ptrdiff_t base, int depth);
+
+static int compileObject(clCompiler *c, const clColumn *column,
+                         ptrdiff_t base, int depth) {
+  const clObject *object = &column->via_object;
+  for (int32_t i = 0; i < object->num; ++i) {
+    int err = compileColumn(c, &object->columns[i], base, depth);
+    if (err) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+static int compileArray(clCompiler *c, const clColumn *column,
+                        ptrdiff_t base, int depth) {
+  const clFlexibleArray *array = &column->via_flexible_array;
+  bool fixed = column->tp == cl_FIXED_ARRAY;
+  int tp = fixed ? column->via_fixed_array.tp : array->tp;
+  int32_t capacity =
+      fixed ? column->via_fixed_array.capacity : array->capacity;
+  const clColumn *columns =
+      fixed ? column->via_fixed_array.columns : array->columns;
+  ptrdiff_t offset = base + column->offset;
+  int32_t element = clElementSize(column, capacity);
+  int err;
+
+  if (!fixed) {
+    err = emitRange(c, base + array->len.offset, array->len.tp,
+                    array->len.size, 1, 0, capacity);
+    if (err) {
+      return err;
+    }
+  }
+
+  // the elements of a fixed array of bools are checked in one go
+  if (!columns && tp == cl_BOOL && fixed) {
+    return emitRange(c, offset, cl_BOOL, element, capacity, 0, 1);
+  }
+  if (!columns && tp != cl_BOOL) {
+    return 0;
+  }
+
+  int32_t idx;
+  err = emit(c, CHECK_ARRAY, offset, &idx);
+  if (err) {
+    return err;
+  }
+
+  clCheck *check = &c->validator->checks[idx];
+  check->size = element;
+  check->count = capacity;
+  if (!fixed) {
+    check->len = base + array->len.offset;
+    check->len_tp = array->len.tp;
+    check->len_size = array->len.size;
+  }
+
+  err = columns ? compileColumn(c, columns, 0, depth + 1)
+                : emitRange(c, 0, cl_BOOL, element, 1, 0, 1);
+  if (err) {
+    return err;
+  }
+  endSub(c, idx);
+  return 0;
+}
+
+static int compileUnion(clCompiler *c, const clColumn *column, ptrdiff_t base,
+                        int depth) {
+  const clUnion *u = &column->via_union;
+  if (!clIsTagged(column)) {
+    return 0;
+  }
+
+  for (int32_t i = 0; i < u->num; ++i) {
+    int32_t idx;
+    int err = emit(c, CHECK_MEMBER, base + column->offset, &idx);
+    if (err) {
+      return err;
+    }
+
+    clCheck *check = &c->validator->checks[idx];
+    check->len = base;
+    check->column = column;
+    check->index = i;
+
+    err = compileColumn(c, &u->columns[i], 0, depth + 1);
+    if (err) {
+      return err;
+    }
+    endSub(c, idx);
+  }
+  return 0;
+}
+
+// Compiles the checks of COLUMN, a field of the object at BASE.
+static int compileColumn(clCompiler *c, const clColumn *column,
+                         ptrdiff_t base, int depth) {
+  if (depth > MAX_DEPTH) {
+    return cl_ERR_VALUE;
+  }
+
+  switch (column->tp) {
+  case cl_OBJECT:
+    return compileObject(c, column, base + column->offset, depth + 1);
+
+  case cl_UNION:
+    return compileUnion(c, column, base, depth);
+
+  case cl_FIXED_ARRAY:
+  case cl_FLEXIBLE_ARRAY:
+    return compileArray(c, column, base, depth);
+
+  case cl_STRING: {
+    int32_t idx;
+    int err = emit(c, CHECK_STRING, base + column->offset, &idx);
+    if (!err) {
+      clCheck *check = &c->validator->checks[idx];
+      check->size = clElementSize(column, column->via_string.capacity);
+      check->count = column->via_string.capacity;
+    }
+    return err;
+  }
+
+  case cl_BOOL:
+    return emitRange(c, base + column->offset, cl_BOOL, column->size, 1, 0,
+                     1);
+
+  default:
+    break;
+  }
+
+  if (clIsNumber(column->tp) && !clIsFloat(column->tp) &&
+      column->via_number.ranged) {
+    return emitRange(c, base + column->offset, column->tp, column->size, 1,
+                     column->via_number.min, column->via_number.max);
+  }
+  return 0;
+}
+
+int clValidatorInit(clValidator *validator, const clColumn *column) {
+  memset(validator, 0, sizeof(*validator));
+  if (column->tp != cl_OBJECT) {
+    return cl_ERR_TYPE;
+  }
+
+  validator->column = column;
+  clCompiler c = {validator, 0};
+
+  // the root sits at offset 0 of a message whatever its own offset says
+  int err = compileObject(&c, column, 0, 0);
+  if (err) {
+    clValidatorFree(validator);
+  }
+  return err;
+}
+
+void clValidatorFree(clValidator *validator) {
+  free(validator->checks);
+  memset(validator, 0, sizeof(*validator));
+}
+
+static bool inRange(const clCheck *check, const uint8_t *p) {
+  uint64_t bad = 0;
+  for (int32_t k = 0; k < check->count; ++k) {
+    int64_t v = clLoadInteger(p + (size_t)k * check->size, check->tp,
+                              check->size);
+    bad |= (uint64_t)v - (uint64_t)check->min > check->span;
+  }
+  return !bad;
+}
+
+static bool isTerminated(const clCheck *check, const uint8_t *p) {
+  int32_t len = clStringLength(p, check->size, check->count);
+  return clIsTerminated(p, check->size, len);
+}
+
+// Runs the NUM checks at CHECKS on the object at BASE, the nested ones
+// included.
+static bool runChecks(const clCheck *checks, int32_t num,
+                      const uint8_t *base) {
+  for (int32_t i = 0; i < num; i += 1 + checks[i].sub) {
+    const clCheck *check = &checks[i];
+    const uint8_t *p = base + check->offset;
+
+    switch (check->check) {
+    case CHECK_RANGE:
+      if (!inRange(check, p)) {
+        return false;
+      }
+      break;
+
+    case CHECK_STRING:
+      if (!isTerminated(check, p)) {
+        return false;
+      }
+      break;
+
+    case CHECK_ARRAY: {
+      int64_t count = check->count;
+      if (check->len >= 0) {
+        count = clLoadInteger(base + check->len, check->len_tp,
+                              check->len_size);
+        if (count < 0 || count > check->count) {
+          return false;
+        }
+      }
+      for (int64_t k = 0; k < count; ++k) {
+        if (!runChecks(check + 1, check->sub,
+                       p + (size_t)k * check->size)) {
+          return false;
+        }
+      }
+      break;
+    }
+
+    case CHECK_MEMBER: {
+      const clColumn *column = check->column;
+      if (clUnionMember(column, base + check->len) ==
+              &column->via_union.columns[check->index] &&
+          !runChecks(check + 1, check->sub, p)) {
+        return false;
+      }
+      break;
+    }
+    }
+  }
+  return true;
+}
+
+// X(size, signed, C type) for the integers a range check loads
+#define CL_VALIDATE_TYPES(X)                                                   \
+  X(1, true, int8_t)                                                           \
+  X(2, true, int16_t)                                                          \
+  X(4, true, int32_t)                                                          \
+  X(8, true, int64_t)                                                          \
+  X(1, false, uint8_t)                                                         \
+  X(2, false, uint16_t)                                                        \
+  X(4, false, uint32_t)                                                        \
+  X(8, false, uint64_t)
+
+// One range check over the END messages of a block, in a loop with a fixed
+// type and no early exit that the compiler vectorizes.
+static uint64_t rangeBits(const clCheck *check, const uint8_t *msgs,
+                          size_t end, size_t stride) {
+  uint64_t bits = 0;
+  uint64_t min = (uint64_t)check->min;
+  uint64_t span = check->span;
+  bool sign = clIsSigned(check->tp);
+
+#define X(SIZE, SIGNED, T)                                                     \
+  if (check->size == SIZE && sign == SIGNED) {                                 \
+    for (size_t j = 0; j < end; ++j) {                                         \
+      const uint8_t *p = msgs + j * stride + check->offset;                    \
+      uint64_t bad = 0;                                                        \
+      for (int32_t k = 0; k < check->count; ++k) {                             \
+        T v;                                                                   \
+        memcpy(&v, p + (size_t)k * SIZE, SIZE);                                \
+        bad |= (uint64_t)(int64_t)v - min > span;                              \
+      }                                                                        \
+      bits |= bad << j;                                                        \
+    }                                                                          \
+    return bits;                                                               \
+  }
+  CL_VALIDATE_TYPES(X)
+#undef X
+
+  return bits;
+}
+
+ptrdiff_t clValidate(const clValidator *validator, const void *msgs, size_t n,
+                     size_t stride, uint64_t *mask) {
+  const uint8_t *p = (const uint8_t *)msgs;
+  const clCheck *checks = validator->checks;
+  ptrdiff_t count = 0;
+
+  for (size_t i = 0; i < n; i += BLOCK) {
+    const uint8_t *block = p + i * stride;
+    size_t end = n - i < BLOCK ? n - i : BLOCK;
+    uint64_t bits = 0;
+
+    for (int32_t c = 0; c < validator->num; c += 1 + checks[c].sub) {
+      const clCheck *check = &checks[c];
+      if (check->check == CHECK_RANGE) {
+        bits |= rangeBits(check, block, end, stride);
+        continue;
+      }
+
+      for (size_t j = 0; j < end; ++j) {
+        bits |= (uint64_t)!runChecks(check, 1, block + j * stride) << j;
+      }
+    }
+
+    if (mask) {
+      mask[i / BLOCK] = bits;
+    }
+    count += __builtin_popcountll(bits);
+  }
+  clStatsInvalid(validator->column, count);
+  return count;
+}
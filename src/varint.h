@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#define CL_VARINT_MAX 10
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CL_VARINT_WORDS 1
+#else
+#define CL_VARINT_WORDS 0
+#endif
+
+static inline uint64_t clZigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t clUnzigzag(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline size_t clVarintSize(uint64_t v) {
+  // 7 payload bits per byte, computed without a loop
+  size_t bits = 64 - (size_t)__builtin_clzll(v | 1);
+  return (bits * 9 + 64) / 64;
+}
+
+#if CL_VARINT_WORDS
+
+// Spreads the low 56 bits of V into 7-bit groups, one per byte.
+static inline uint64_t clVarintSpread(uint64_t v) {
+#ifdef __BMI2__
+  return _pdep_u64(v, 0x7f7f7f7f7f7f7f7fULL);
+#else
+  v = ((v & 0x00fffffff0000000ULL) << 4) | (v & 0x000000000fffffffULL);
+  v = ((v & 0x0fffc0000fffc000ULL) << 2) | (v & 0x00003fff00003fffULL);
+  v = ((v & 0x3f803f803f803f80ULL) << 1) | (v & 0x007f007f007f007fULL);
+  return v;
+#endif
+}
+
+// Inverse of clVarintSpread(): drops the continuation bits of up to 8 bytes.
+static inline uint64_t clVarintGather(uint64_t v) {
+#ifdef __BMI2__
+  return _pext_u64(v, 0x7f7f7f7f7f7f7f7fULL);
+#else
+  v &= 0x7f7f7f7f7f7f7f7fULL;
+  v = ((v & 0x7f007f007f007f00ULL) >> 1) | (v & 0x007f007f007f007fULL);
+  v = ((v & 0x3fff00003fff0000ULL) >> 2) | (v & 0x00003fff00003fffULL);
+  v = ((v & 0x0fffffff00000000ULL) >> 4) | (v & 0x000000000fffffffULL);
+  return v;
+#endif
+}
+
+#endif
+
+// Returns the number of bytes written, or 0 when AVAIL is too small.
+static inline size_t clPutVarint(uint8_t *p, size_t avail, uint64_t v) {
+  size_t n = clVarintSize(v);
+  if (avail < n) {
+    return 0;
+  }
+
+#if CL_VARINT_WORDS
+  if (n <= 8 && avail >= 8) {
+    uint64_t cont = 0x8080808080808080ULL & ((1ULL << (8 * (n - 1))) - 1);
+    uint64_t word = clVarintSpread(v) | cont;
+    memcpy(p, &word, sizeof(word));
+    return n;
+  }
+#endif
+
+  for (size_t i = 0; i + 1 < n; ++i) {
+    p[i] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  p[n - 1] = (uint8_t)v;
+  return n;
+}
+
+// Returns the number of bytes consumed, or 0 when the input is truncated or
+// the varint is longer than CL_VARINT_MAX bytes.
+static inline size_t clGetVarint(const uint8_t *p, size_t avail, uint64_t *v) {
+#if CL_VARINT_WORDS
+  if (avail >= 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+
+    uint64_t stops = ~word & 0x8080808080808080ULL;
+    if (stops) {
+      size_t n = (size_t)__builtin_ctzll(stops) / 8 + 1;
+      uint64_t mask = n == 8 ? ~0ULL : (1ULL << (8 * n)) - 1;
+      *v = clVarintGather(word & mask);
+      return n;
+    }
+  }
+#endif
+
+  uint64_t result = 0;
+  for (size_t i = 0; i < avail && i < CL_VARINT_MAX; ++i) {
+    result |= (uint64_t)(p[i] & 0x7f) << (7 * i);
+    if (!(p[i] & 0x80)) {
+      if (i == CL_VARINT_MAX - 1 && p[i] > 1) {
+        return 0;
+      }
+      *v = result;
+      return i + 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,381 @@
+#include "internal.h"
+
+// Views read the cl_WIRE_RAW format in place. Numbers sit at fixed sizes in
+// host layout, so a field is found by skipping the encoded sizes of the
+// fields before it. The whole buffer is bounds checked once by
+// clViewInit(), after which skipping needs no checks. The bytes of an
+// untagged union are a copy of its memory, so views below such a union use
+// the column offsets directly (IMAGE). A tagged union holds the encoding of
+// its selected member.
+
+static int64_t skipColumn(const clColumn *parent, const clColumn *column,
+                          const uint8_t *obj, const uint8_t *p, size_t avail);
+
+static int64_t stringSize(const clColumn *column, const uint8_t *p,
+                          size_t avail, int64_t *chars) {
+  const clString *string = &column->via_string;
+  int32_t element = clElementSize(column, string->capacity);
+  if (!element) {
+    *chars = 0;
+    return 0;
+  }
+
+  int32_t capacity = string->capacity;
+  if (avail / element < (size_t)capacity) {
+    capacity = (int32_t)(avail / element);
+  }
+
+  int32_t len = clStringLength(p, element, capacity);
+  bool terminated = clIsTerminated(p, element, len);
+  if (capacity < string->capacity && !terminated) {
+    return cl_ERR_BUFFER;
+  }
+
+  *chars = terminated ? len - 1 : len;
+  return (int64_t)element * len;
+}
+
+// Reads the number at OFFSET of the struct from the encoded object OBJ of
+// PARENT. It is a length or tag field, which precedes COLUMN, so its bytes
+// have already been checked.
+static int loadSibling(const clColumn *parent, const clColumn *column,
+                       ptrdiff_t offset, int tp, int32_t size,
+                       const uint8_t *obj, int64_t *v) {
+  const clColumn *columns = parent->via_object.columns;
+
+  const uint8_t *p = obj;
+  for (const clColumn *prev = columns; prev < column; ++prev) {
+    if (prev->offset == offset && clIsNumber(prev->tp)) {
+      *v = clLoadInteger(p, tp, size);
+      return 0;
+    }
+    p += skipColumn(parent, prev, obj, p, SIZE_MAX);
+  }
+  return cl_ERR_VALUE;
+}
+
+static int64_t loadCount(const clColumn *parent, const clColumn *array,
+                         const uint8_t *obj) {
+  const clFlexibleArray *flexible = &array->via_flexible_array;
+  int64_t count;
+  int err = loadSibling(parent, array, flexible->len.offset, flexible->len.tp,
+                        flexible->len.size, obj, &count);
+  if (err) {
+    return err;
+  }
+  if (count < 0 || count > flexible->capacity) {
+    return cl_ERR_CAPACITY;
+  }
+  return count;
+}
+
+// Sets MEMBER to the member of the tagged union COLUMN selected in the
+// encoded object OBJ of PARENT, or NULL.
+static int loadMember(const clColumn *parent, const clColumn *column,
+                      const uint8_t *obj, const clColumn **member) {
+  const clUnion *u = &column->via_union;
+  int64_t tag;
+  int err = loadSibling(parent, column, u->tag.offset, u->tag.tp, u->tag.size,
+                        obj, &tag);
+  if (err) {
+    return err;
+  }
+
+  *member = NULL;
+  if ((uint64_t)tag < (uint64_t)u->num_cases && u->cases[tag] >= 0) {
+    *member = &u->columns[u->cases[tag]];
+  }
+  return 0;
+}
+
+static int64_t skipObject(const clColumn *column, const uint8_t *p,
+                          size_t avail) {
+  const clObject *object = &column->via_object;
+  size_t pos = 0;
+  for (int32_t i = 0; i < object->num; ++i) {
+    int64_t n = skipColumn(column, &object->columns[i], p, p + pos,
+                           avail - pos);
+    if (n < 0) {
+      return n;
+    }
+    pos += (size_t)n;
+  }
+  return (int64_t)pos;
+}
+
+static int64_t skipElements(const clColumn *element, int32_t stride,
+                            int64_t count, const uint8_t *p, size_t avail) {
+  if (!element) {
+    if ((uint64_t)count * stride > avail) {
+      return cl_ERR_BUFFER;
+    }
+    return count * stride;
+  }
+
+  size_t pos = 0;
+  for (int64_t i = 0; i < count; ++i) {
+    int64_t n = skipObject(element, p + pos, avail - pos);
+    if (n < 0) {
+      return n;
+    }
+    pos += (size_t)n;
+  }
+  return (int64_t)pos;
+}
+
+// Returns the encoded size of COLUMN at P, a field of the encoded object OBJ
+// of PARENT, or a cl_ERR_* code when it does not fit AVAIL.
+static int64_t skipColumn(const clColumn *parent, const clColumn *column,
+                          const uint8_t *obj, const uint8_t *p, size_t avail) {
+  switch (column->tp) {
+  case cl_OBJECT:
+    return skipObject(column, p, avail);
+
+  case cl_FIXED_ARRAY: {
+    const clFixedArray *array = &column->via_fixed_array;
+    return skipElements(array->columns,
+                        clElementSize(column, array->capacity),
+                        array->capacity, p, avail);
+  }
+
+  case cl_FLEXIBLE_ARRAY: {
+    const clFlexibleArray *array = &column->via_flexible_array;
+    int64_t count = loadCount(parent, column, obj);
+    if (count < 0) {
+      return count;
+    }
+    return skipElements(array->columns,
+                        clElementSize(column, array->capacity), count, p,
+                        avail);
+  }
+
+  case cl_STRING: {
+    int64_t chars;
+    return stringSize(column, p, avail, &chars);
+  }
+
+  case cl_UNION: {
+    if (!clIsTagged(column)) {
+      return (size_t)column->size > avail ? cl_ERR_BUFFER : column->size;
+    }
+
+    const clColumn *member;
+    int err = loadMember(parent, column, obj, &member);
+    if (err) {
+      return err;
+    }
+    // the encoding of the member alone, the union is its object
+    return member ? skipColumn(column, member, p, p, avail) : 0;
+  }
+
+  default:
+    if (!clIsNumber(column->tp)) {
+      return cl_ERR_TYPE;
+    }
+    return (size_t)column->size > avail ? cl_ERR_BUFFER : column->size;
+  }
+}
+
+// Fills the count of an array or string view.
+static int setCount(clView *view, const clColumn *parent, const uint8_t *obj) {
+  const clColumn *column = view->column;
+  view->count = 0;
+
+  switch (column->tp) {
+  case cl_FIXED_ARRAY:
+    view->count = column->via_fixed_array.capacity;
+    return 0;
+
+  case cl_FLEXIBLE_ARRAY: {
+    int64_t count =
+        view->image
+            ? clLoadCount(&column->via_flexible_array, obj)
+            : loadCount(parent, column, obj);
+    if (count < 0) {
+      return (int)count;
+    }
+    view->count = count;
+    return 0;
+  }
+
+  case cl_STRING: {
+    int64_t n = stringSize(column, view->data, view->size, &view->count);
+    return n < 0 ? (int)n : 0;
+  }
+
+  case cl_UNION: {
+    if (!clIsTagged(column)) {
+      return 0;
+    }
+
+    const clColumn *member = NULL;
+    if (view->image) {
+      member = clUnionMember(column, obj);
+    } else {
+      int err = loadMember(parent, column, obj, &member);
+      if (err) {
+        return err;
+      }
+    }
+    view->count = member ? member - column->via_union.columns : -1;
+    return 0;
+  }
+
+  default:
+    return 0;
+  }
+}
+
+ptrdiff_t clViewInit(clView *view, const clColumn *column, const void *buf,
+                     size_t size) {
+  if (column->tp != cl_OBJECT) {
+    return cl_ERR_TYPE;
+  }
+
+  int64_t n = skipObject(column, (const uint8_t *)buf, size);
+  if (n < 0) {
+    return n;
+  }
+
+  view->column = column;
+  view->data = (const uint8_t *)buf;
+  view->size = (size_t)n;
+  view->count = 0;
+  view->image = false;
+  return (ptrdiff_t)n;
+}
+
+int clViewField(const clView *view, const char *name, size_t len,
+                clView *field) {
+  const clColumn *column = clFindColumn(view->column, name, len);
+  if (!column) {
+    return cl_ERR_VALUE;
+  }
+
+  field->column = column;
+  if (!view->image && clIsTagged(view->column)) {
+    // only the selected member is encoded
+    if (column - view->column->via_union.columns != view->count) {
+      return cl_ERR_VALUE;
+    }
+    field->data = view->data;
+    field->size = view->size;
+    field->image = false;
+    return setCount(field, view->column, view->data);
+  }
+
+  if (view->image || view->column->tp == cl_UNION) {
+    field->data = view->data + column->offset;
+    field->size = (size_t)column->size;
+    field->image = true;
+    return setCount(field, view->column, view->data);
+  }
+
+  const uint8_t *p = view->data;
+  const clColumn *columns = view->column->via_object.columns;
+  for (const clColumn *prev = columns; prev < column; ++prev) {
+    p += skipColumn(view->column, prev, view->data, p, SIZE_MAX);
+  }
+
+  field->data = p;
+  field->size = (size_t)skipColumn(view->column, column, view->data, p,
+                                   SIZE_MAX);
+  field->image = false;
+  return setCount(field, view->column, view->data);
+}
+
+int clViewElement(const clView *view, int64_t i, clView *element) {
+  const clColumn *column = view->column;
+  const clColumn *columns;
+  int32_t capacity;
+
+  if (column->tp == cl_FIXED_ARRAY) {
+    columns = column->via_fixed_array.columns;
+    capacity = column->via_fixed_array.capacity;
+  } else if (column->tp == cl_FLEXIBLE_ARRAY) {
+    columns = column->via_flexible_array.columns;
+    capacity = column->via_flexible_array.capacity;
+  } else {
+    return cl_ERR_TYPE;
+  }
+  if (!columns) {
+    return cl_ERR_TYPE;
+  }
+  if (i < 0 || i >= view->count) {
+    return cl_ERR_VALUE;
+  }
+
+  int32_t stride = clElementSize(column, capacity);
+  const uint8_t *p = view->data + (view->image ? i * stride : 0);
+  for (int64_t j = 0; !view->image && j < i; ++j) {
+    p += skipObject(columns, p, SIZE_MAX);
+  }
+
+  element->column = columns;
+  element->data = p;
+  element->size = view->image ? (size_t)stride
+                              : (size_t)skipObject(columns, p, SIZE_MAX);
+  element->count = 0;
+  element->image = view->image;
+  return 0;
+}
+
+static int loadNumber(int tp, int32_t size, const uint8_t *p, clScalar *out) {
+  if (tp == cl_FLOAT32 && size == 4) {
+    float f;
+    memcpy(&f, p, sizeof(f));
+    out->f64 = f;
+    return 0;
+  }
+  if (tp == cl_FLOAT64 && size == 8) {
+    memcpy(&out->f64, p, sizeof(out->f64));
+    return 0;
+  }
+  if (!clIsNumber(tp) || clIsFloat(tp) || size < 1 || size > 8 ||
+      (size & (size - 1))) {
+    return cl_ERR_TYPE;
+  }
+
+  int64_t v = clLoadInteger(p, tp, size);
+  if (clIsSigned(tp)) {
+    out->i64 = v;
+  } else {
+    out->u64 = (uint64_t)v;
+  }
+  return 0;
+}
+
+int clViewNumber(const clView *view, clScalar *out) {
+  return loadNumber(view->column->tp, view->column->size, view->data, out);
+}
+
+int clViewNumberAt(const clView *view, int64_t i, clScalar *out) {
+  const clColumn *column = view->column;
+  int tp;
+  int32_t capacity;
+
+  if (column->tp == cl_FIXED_ARRAY && !column->via_fixed_array.columns) {
+    tp = column->via_fixed_array.tp;
+    capacity = column->via_fixed_array.capacity;
+  } else if (column->tp == cl_FLEXIBLE_ARRAY &&
+             !column->via_flexible_array.columns) {
+    tp = column->via_flexible_array.tp;
+    capacity = column->via_flexible_array.capacity;
+  } else {
+    return cl_ERR_TYPE;
+  }
+  if (i < 0 || i >= view->count) {
+    return cl_ERR_VALUE;
+  }
+
+  int32_t stride = clElementSize(column, capacity);
+  return loadNumber(tp, stride, view->data + i * stride, out);
+}
+
+const void *clViewString(const clView *view, size_t *len) {
+  if (view->column->tp != cl_STRING) {
+    return NULL;
+  }
+  *len = (size_t)view->count;
+  return view->data;
+}
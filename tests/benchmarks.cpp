@@ -0,0 +1,419 @@
+#include <benchmark/benchmark.h>
+
+#define USE_COLUMN_MACROS
+#include <atomic>
+#include <columns.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+// Every benchmark runs over a stream of kMessages messages per iteration.
+// Bytes/s are counted in struct bytes, so that the codecs compare directly
+// with the memcpy baseline; "wire" is the average encoded size, "allocs" the
+// malloc() calls per iteration.
+
+static const size_t kMessages = 256;
+
+static std::atomic<size_t> allocations;
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t num, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+// A message of strings only, for the per-kind costs.
+struct benchString {
+  char text[256];
+};
+
+static const clColumn benchStringFields[] = {
+    DEFINE_FIELD_STRING(benchString, text),
+};
+static const clColumn benchStringObject[] = {
+    DEFINE_OBJECT(benchString, benchStringFields),
+};
+
+static void fillName(char *name, size_t capacity, size_t i) {
+  size_t len = 8 + (i * 7) % (capacity - 8);
+  for (size_t j = 0; j < len; ++j) {
+    name[j] = (char)('a' + (i + j) % 26);
+  }
+  name[len] = '\0';
+}
+
+static void fill(stTests *msg, size_t i) {
+  memset(msg, 0, sizeof(*msg));
+  msg->epoch = (uint32_t)i;
+  fillName(msg->name, sizeof(msg->name), i);
+  msg->fuzzNum = 20;
+  for (uint32_t j = 0; j < msg->fuzzNum; ++j) {
+    fillName(msg->fuzz[j].name, sizeof(msg->fuzz[j].name), i + j);
+    msg->fuzz[j].tag = (int)(i * 31 + j);
+    msg->fuzz[j].v.other[0] = i * j;
+  }
+  msg->inlineUnion.tag = 1;
+  msg->inlineUnion.abc.u32 = (uint32_t)i;
+}
+
+static void fill(stNumbers *msg, size_t i) {
+  memset(msg, 0, sizeof(*msg));
+  msg->i8 = (int8_t)i;
+  msg->i16 = (int16_t)(i * 3);
+  msg->i32 = -(int32_t)(i * 1000);
+  msg->i64 = (int64_t)i << 20;
+  msg->u8 = (uint8_t)i;
+  msg->u16 = (uint16_t)(i * 5);
+  msg->u32 = (uint32_t)(i * 100000);
+  msg->u64 = (uint64_t)i << 40;
+  msg->f32 = (float)i / 3;
+  msg->f64 = (double)i / 7;
+  msg->b = i & 1;
+}
+
+static void fill(stUseItemRsp *msg, size_t i) {
+  memset(msg, 0, sizeof(*msg));
+  msg->code = (uint32_t)i;
+  msg->num = 10;
+  for (uint32_t j = 0; j < msg->num; ++j) {
+    msg->drops[j].itemID = (uint32_t)(i + j);
+    msg->drops[j].itemNum = j + 1;
+  }
+}
+
+static void fill(stInlineUnion *msg, size_t i) {
+  memset(msg, 0, sizeof(*msg));
+  msg->tag = (int32_t)i;
+  msg->abc.other[0] = i;
+  msg->abc.other[1] = ~i;
+}
+
+static void fill(benchString *msg, size_t i) {
+  memset(msg, 0, sizeof(*msg));
+  fillName(msg->text, sizeof(msg->text), i * 13);
+}
+
+template <class T> static const std::vector<T> &messages() {
+  static std::vector<T> msgs;
+  if (msgs.empty()) {
+    msgs.resize(kMessages);
+    for (size_t i = 0; i < kMessages; ++i) {
+      fill(&msgs[i], i);
+    }
+  }
+  return msgs;
+}
+
+// The encodings of messages<T>() back to back.
+struct Stream {
+  std::vector<uint8_t> data;
+  std::vector<size_t> offsets;
+};
+
+template <class T>
+static Stream encodeStream(const clColumn *column, int wire) {
+  const std::vector<T> &msgs = messages<T>();
+  Stream s;
+  s.data.resize(msgs.size() * sizeof(T) * 2);
+
+  size_t pos = 0;
+  for (const T &msg : msgs) {
+    ptrdiff_t n = clEncodeEx(column, wire, &msg, s.data.data() + pos,
+                             s.data.size() - pos);
+    if (n < 0) {
+      fprintf(stderr, "clEncodeEx: %d\n", (int)n);
+      abort();
+    }
+    s.offsets.push_back(pos);
+    pos += (size_t)n;
+  }
+  s.offsets.push_back(pos);
+  return s;
+}
+
+template <class T>
+static void report(benchmark::State &state, size_t wire_bytes,
+                   size_t before) {
+  size_t n = messages<T>().size();
+  state.SetItemsProcessed((int64_t)(state.iterations() * n));
+  state.SetBytesProcessed((int64_t)(state.iterations() * n * sizeof(T)));
+  state.counters["per_msg"] = benchmark::Counter(
+      (double)n, benchmark::Counter::kIsIterationInvariantRate |
+                     benchmark::Counter::kInvert);
+  state.counters["wire"] = (double)wire_bytes / n;
+  state.counters["allocs"] = benchmark::Counter(
+      (double)(allocations.load() - before), benchmark::Counter::kAvgIterations);
+}
+
+template <class T> static void benchMemcpy(benchmark::State &state) {
+  const std::vector<T> &msgs = messages<T>();
+  T dst;
+  size_t before = allocations.load();
+  for (auto _ : state) {
+    for (const T &msg : msgs) {
+      memcpy(&dst, &msg, sizeof(T));
+      benchmark::DoNotOptimize(&dst);
+      benchmark::ClobberMemory();
+    }
+  }
+  report<T>(state, sizeof(T) * msgs.size(), before);
+}
+
+template <class T>
+static void benchSize(benchmark::State &state, const clColumn *column,
+                      int wire) {
+  const std::vector<T> &msgs = messages<T>();
+  size_t wire_bytes = encodeStream<T>(column, wire).offsets.back();
+  size_t before = allocations.load();
+  for (auto _ : state) {
+    for (const T &msg : msgs) {
+      benchmark::DoNotOptimize(clEncodeSizeEx(column, wire, &msg));
+    }
+  }
+  report<T>(state, wire_bytes, before);
+}
+
+template <class T>
+static void benchEncode(benchmark::State &state, const clColumn *column,
+                        int wire) {
+  const std::vector<T> &msgs = messages<T>();
+  std::vector<uint8_t> buf(sizeof(T) * 2);
+  size_t wire_bytes = encodeStream<T>(column, wire).offsets.back();
+  size_t before = allocations.load();
+  for (auto _ : state) {
+    for (const T &msg : msgs) {
+      benchmark::DoNotOptimize(
+          clEncodeEx(column, wire, &msg, buf.data(), buf.size()));
+      benchmark::ClobberMemory();
+    }
+  }
+  report<T>(state, wire_bytes, before);
+}
+
+template <class T>
+static void benchDecode(benchmark::State &state, const clColumn *column,
+                        int wire) {
+  Stream s = encodeStream<T>(column, wire);
+  T dst;
+  size_t before = allocations.load();
+  for (auto _ : state) {
+    for (size_t i = 0; i + 1 < s.offsets.size(); ++i) {
+      ptrdiff_t n = clDecodeEx(column, wire, &dst, s.data.data() + s.offsets[i],
+                               s.offsets[i + 1] - s.offsets[i]);
+      benchmark::DoNotOptimize(n);
+      benchmark::ClobberMemory();
+    }
+  }
+  report<T>(state, s.offsets.back(), before);
+}
+
+template <class T>
+static void benchJsonEncode(benchmark::State &state, const clColumn *column) {
+  const std::vector<T> &msgs = messages<T>();
+  clBuffer out = {nullptr, 0, 0};
+  size_t wire_bytes = 0;
+  for (const T &msg : msgs) {
+    wire_bytes += (size_t)clJsonEncode(column, &msg, &out);
+  }
+
+  size_t before = allocations.load();
+  for (auto _ : state) {
+    for (const T &msg : msgs) {
+      out.size = 0;
+      benchmark::DoNotOptimize(clJsonEncode(column, &msg, &out));
+      benchmark::ClobberMemory();
+    }
+  }
+  report<T>(state, wire_bytes, before);
+  free(out.data);
+}
+
+template <class T>
+static void benchJsonDecode(benchmark::State &state, const clColumn *column) {
+  const std::vector<T> &msgs = messages<T>();
+  std::vector<std::string> docs;
+  size_t wire_bytes = 0;
+  for (const T &msg : msgs) {
+    clBuffer out = {nullptr, 0, 0};
+    clJsonEncode(column, &msg, &out);
+    docs.emplace_back(out.data, out.size);
+    wire_bytes += out.size;
+    free(out.data);
+  }
+
+  T dst;
+  size_t before = allocations.load();
+  for (auto _ : state) {
+    for (const std::string &doc : docs) {
+      benchmark::DoNotOptimize(
+          clJsonDecode(column, &dst, doc.data(), doc.size()));
+      benchmark::ClobberMemory();
+    }
+  }
+  report<T>(state, wire_bytes, before);
+}
+
+// The straight-line functions generated with --codec.
+static void benchCodecEncode(benchmark::State &state) {
+  const std::vector<stTests> &msgs = messages<stTests>();
+  std::vector<uint8_t> buf(sizeof(stTests) * 2);
+  size_t wire_bytes = encodeStream<stTests>(stTestsObject, cl_WIRE_RAW)
+                          .offsets.back();
+  size_t before = allocations.load();
+  for (auto _ : state) {
+    for (const stTests &msg : msgs) {
+      benchmark::DoNotOptimize(stTests_encode(&msg, buf.data(), buf.size()));
+      benchmark::ClobberMemory();
+    }
+  }
+  report<stTests>(state, wire_bytes, before);
+}
+
+static void benchCodecDecode(benchmark::State &state) {
+  Stream s = encodeStream<stTests>(stTestsObject, cl_WIRE_RAW);
+  stTests dst;
+  size_t before = allocations.load();
+  for (auto _ : state) {
+    for (size_t i = 0; i + 1 < s.offsets.size(); ++i) {
+      benchmark::DoNotOptimize(stTests_decode(&dst,
+                                              s.data.data() + s.offsets[i],
+                                              s.offsets[i + 1] - s.offsets[i]));
+      benchmark::ClobberMemory();
+    }
+  }
+  report<stTests>(state, s.offsets.back(), before);
+}
+
+// Decodes only PATHS of each stTests, against decode/<wire>/stTests.
+static void benchProject(benchmark::State &state, int wire,
+                         std::vector<const char *> paths) {
+  Stream s = encodeStream<stTests>(stTestsObject, wire);
+  clProjection projection;
+  if (clProjectionInit(&projection, stTestsObject, wire, paths.data(),
+                       paths.size())) {
+    state.SkipWithError("clProjectionInit");
+    return;
+  }
+
+  stTests dst;
+  size_t before = allocations.load();
+  for (auto _ : state) {
+    for (size_t i = 0; i + 1 < s.offsets.size(); ++i) {
+      ptrdiff_t n = clProjectionDecode(&projection, &dst,
+                                       s.data.data() + s.offsets[i],
+                                       s.offsets[i + 1] - s.offsets[i]);
+      benchmark::DoNotOptimize(n);
+      benchmark::ClobberMemory();
+    }
+  }
+  report<stTests>(state, s.offsets.back(), before);
+  clProjectionFree(&projection);
+}
+
+// Hashes every message, against memcpy/<message>.
+template <class T>
+static void benchHash(benchmark::State &state, const clColumn *column) {
+  const std::vector<T> &msgs = messages<T>();
+  size_t before = allocations.load();
+  for (auto _ : state) {
+    for (const T &msg : msgs) {
+      uint64_t h;
+      benchmark::DoNotOptimize(clHash(&h, column, &msg));
+      benchmark::DoNotOptimize(h);
+    }
+  }
+  report<T>(state, sizeof(T) * msgs.size(), before);
+}
+
+// Compares every message with an equal copy, the whole of both is read.
+template <class T>
+static void benchEqual(benchmark::State &state, const clColumn *column) {
+  const std::vector<T> &msgs = messages<T>();
+  std::vector<T> copies(msgs);
+  size_t before = allocations.load();
+  for (auto _ : state) {
+    for (size_t i = 0; i < msgs.size(); ++i) {
+      benchmark::DoNotOptimize(clEqual(column, &msgs[i], &copies[i]));
+    }
+  }
+  report<T>(state, sizeof(T) * msgs.size(), before);
+}
+
+static const struct {
+  const char *name;
+  int wire;
+} kWires[] = {
+    {"raw", cl_WIRE_RAW},
+    {"compact", cl_WIRE_COMPACT},
+    {"swapped", cl_WIRE_SWAPPED},
+};
+
+template <class T>
+static void registerMessage(const std::string &name, const clColumn *column) {
+  benchmark::RegisterBenchmark(("memcpy/" + name).c_str(), benchMemcpy<T>);
+  for (const auto &wire : kWires) {
+    std::string suffix = std::string("/") + wire.name + "/" + name;
+    benchmark::RegisterBenchmark(("size" + suffix).c_str(), benchSize<T>,
+                                 column, wire.wire);
+    benchmark::RegisterBenchmark(("encode" + suffix).c_str(), benchEncode<T>,
+                                 column, wire.wire);
+    benchmark::RegisterBenchmark(("decode" + suffix).c_str(), benchDecode<T>,
+                                 column, wire.wire);
+  }
+  benchmark::RegisterBenchmark(("encode/json/" + name).c_str(),
+                               benchJsonEncode<T>, column);
+  benchmark::RegisterBenchmark(("decode/json/" + name).c_str(),
+                               benchJsonDecode<T>, column);
+  benchmark::RegisterBenchmark(("hash/" + name).c_str(), benchHash<T>,
+                               column);
+  benchmark::RegisterBenchmark(("equal/" + name).c_str(), benchEqual<T>,
+                               column);
+}
+
+static int registerAll() {
+  registerMessage<stTests>("stTests", stTestsObject);
+  benchmark::RegisterBenchmark("encode/codec/stTests", benchCodecEncode);
+  benchmark::RegisterBenchmark("decode/codec/stTests", benchCodecDecode);
+  for (const auto &wire : kWires) {
+    std::string suffix = std::string("/") + wire.name + "/stTests";
+    benchmark::RegisterBenchmark(("project" + suffix + "/epoch").c_str(),
+                                 benchProject, wire.wire,
+                                 std::vector<const char *>{"epoch"});
+    benchmark::RegisterBenchmark(
+        ("project" + suffix + "/tags").c_str(), benchProject, wire.wire,
+        std::vector<const char *>{"epoch", "fuzz[*].tag"});
+  }
+
+  // one field kind each
+  registerMessage<stNumbers>("numbers", stNumbersObject);
+  registerMessage<benchString>("string", benchStringObject);
+  registerMessage<stUseItemRsp>("flexible_array", stUseItemRspObject);
+  registerMessage<stInlineUnion>("union", stInlineUnionObject);
+  return 0;
+}
+
+static int registered = registerAll();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,26 @@
+// generated by the columns. DO NOT EDIT!
+
+#define USE_COLUMN_MACROS
+#define COLUMN_LOOKUP(FIELDS) (&FIELDS##Lookup)
+#include <columns.h>
+#include <string.h>
+
+#include "commands_def.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static const clColumn *const commandsColumns[] = {
+    stUseItemReqObject,
+    stDropObject,
+    stUseItemRspObject,
+};
+static clHandler commandsHandlers[3];
+clDispatch commandsDispatch = {
+    1, 3, commandsColumns, commandsHandlers,
+};
+
+#ifdef __cplusplus
+}
+#endif
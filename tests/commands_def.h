@@ -0,0 +1,30 @@
+#pragma once
+
+// generated by the columns. DO NOT EDIT!
+#include <columns.h>
+
+#include "messages.h"
+#include "messages_def.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct clColumn;
+
+enum {
+    stUseItemReqCmd = 1,
+    stDropCmd = 2,
+    stUseItemRspCmd = 3,
+};
+
+typedef union {
+    struct stUseItemReq stUseItemReq;
+    struct stDrop stDrop;
+    struct stUseItemRsp stUseItemRsp;
+} commandsMessage;
+
+extern clDispatch commandsDispatch;
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,4 +1,5 @@
-#include <stdint.h> // IWYU pragma: keep
+#include <stdbool.h> // IWYU pragma: keep
+#include <stdint.h>  // IWYU pragma: keep
 
 // cmd = 1
 struct stUseItemReq {
@@ -57,3 +58,61 @@ struct stTests {
   struct stFuzz fuzz[20];
   struct stInlineUnion inlineUnion;
 };
+
+struct stNumbers {
+  int8_t i8;
+  int16_t i16;
+  int32_t i32;
+  int64_t i64;
+  uint8_t u8;
+  uint16_t u16;
+  uint32_t u32;
+  uint64_t u64;
+  float f32;
+  double f64;
+  bool b;
+};
+
+struct stTagged {
+  uint8_t kind;
+  // @tag(kind)
+  union {
+    uint8_t u8;
+    uint32_t u32;
+    char text[24];
+    // @case(7)
+    struct stDrop drop;
+  } value;
+
+  int16_t vkind;
+  // @tag(vkind)
+  union stValue v;
+};
+
+enum stColor {
+  stRED = 1,
+  stGREEN = 2,
+  stBLUE = 5,
+};
+
+struct stStroke {
+  enum stColor color;
+  bool dashed;
+};
+
+struct stPaint {
+  enum stColor background;
+  bool visible;
+  bool layers[3];
+  char label[8];
+
+  uint8_t strokesNum;
+  struct stStroke strokes[4];
+
+  uint8_t kind;
+  // @tag(kind)
+  union {
+    bool flag;
+    char note[6];
+  } extra;
+};
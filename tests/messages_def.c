@@ -1,39 +1,176 @@
 // generated by the columns. DO NOT EDIT!
 
 #define USE_COLUMN_MACROS
+#define COLUMN_LOOKUP(FIELDS) (&FIELDS##Lookup)
 #include <columns.h>
+#include <string.h>
 
 #include "messages.h"
+#include "messages_def.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// messages.h:4:8
+// messages.h:5:8
 static const clColumn c__S_stUseItemReq[] = {
     DEFINE_FIELD_NUMBER(struct stUseItemReq, itemID),
 };
+static const int16_t c__S_stUseItemReqSlots[] = {0};
+static const clLookup c__S_stUseItemReqLookup = {
+    .seed = 0u,
+    .num = 1,
+    .slots = c__S_stUseItemReqSlots,
+};
 const clColumn stUseItemReqObject[] = {
     DEFINE_OBJECT(struct stUseItemReq, c__S_stUseItemReq),
 };
-// messages.h:9:8
+COLUMN_ASSERT_SIZE(struct stUseItemReq, 4);
+ptrdiff_t stUseItemReq_encode(const struct stUseItemReq *src, void *buf, size_t size) {
+  uint8_t *p = (uint8_t *)buf;
+  uint8_t *end = p + size;
+  if (end - p < 4) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src, 4);
+  p += 4;
+  return p - (uint8_t *)buf;
+}
+ptrdiff_t stUseItemReq_decode(struct stUseItemReq *dst, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  const uint8_t *end = p + size;
+  if (end - p < 4) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst, p, 4);
+  p += 4;
+  return p - (const uint8_t *)buf;
+}
+COLUMN_ASSERT_SIZE(struct stUseItemReq_packed, 4);
+void stUseItemReq_pack(struct stUseItemReq_packed *dst, const struct stUseItemReq *src) {
+  memcpy(&dst->itemID, &src->itemID, 4);
+}
+void stUseItemReq_unpack(struct stUseItemReq *dst, const struct stUseItemReq_packed *src) {
+  memcpy(&dst->itemID, &src->itemID, 4);
+}
+// messages.h:10:8
 static const clColumn c__S_stDrop[] = {
     DEFINE_FIELD_NUMBER(struct stDrop, itemID),
     DEFINE_FIELD_NUMBER(struct stDrop, itemNum),
 };
+static const int16_t c__S_stDropSlots[] = {0, 1};
+static const clLookup c__S_stDropLookup = {
+    .seed = 1u,
+    .num = 2,
+    .slots = c__S_stDropSlots,
+};
 const clColumn stDropObject[] = {
     DEFINE_OBJECT(struct stDrop, c__S_stDrop),
 };
-// messages.h:15:8
+COLUMN_ASSERT_SIZE(struct stDrop, 8);
+ptrdiff_t stDrop_encode(const struct stDrop *src, void *buf, size_t size) {
+  uint8_t *p = (uint8_t *)buf;
+  uint8_t *end = p + size;
+  if (end - p < 8) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src, 8);
+  p += 8;
+  return p - (uint8_t *)buf;
+}
+ptrdiff_t stDrop_decode(struct stDrop *dst, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  const uint8_t *end = p + size;
+  if (end - p < 8) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst, p, 8);
+  p += 8;
+  return p - (const uint8_t *)buf;
+}
+COLUMN_ASSERT_SIZE(struct stDrop_packed, 8);
+void stDrop_pack(struct stDrop_packed *dst, const struct stDrop *src) {
+  memcpy(&dst->itemID, &src->itemID, 4);
+  memcpy(&dst->itemNum, &src->itemNum, 4);
+}
+void stDrop_unpack(struct stDrop *dst, const struct stDrop_packed *src) {
+  memcpy(&dst->itemID, &src->itemID, 4);
+  memcpy(&dst->itemNum, &src->itemNum, 4);
+}
+// messages.h:16:8
 static const clColumn c__S_stUseItemRsp[] = {
     DEFINE_FIELD_NUMBER(struct stUseItemRsp, code),
     DEFINE_FIELD_NUMBER(struct stUseItemRsp, num),
-    DEFINE_FIELD_OBJECT_FLEXIBLE_ARRAY(struct stUseItemRsp, drops, stDropObject),
+    DEFINE_FIELD_OBJECT_FLEXIBLE_ARRAY(struct stUseItemRsp, drops, num, stDropObject),
+};
+static const int16_t c__S_stUseItemRspSlots[] = {0, 1, 2, -1};
+static const clLookup c__S_stUseItemRspLookup = {
+    .seed = 3u,
+    .num = 4,
+    .slots = c__S_stUseItemRspSlots,
 };
 const clColumn stUseItemRspObject[] = {
     DEFINE_OBJECT(struct stUseItemRsp, c__S_stUseItemRsp),
 };
-// messages.h:22:7
+COLUMN_ASSERT_SIZE(struct stUseItemRsp, 88);
+ptrdiff_t stUseItemRsp_encode(const struct stUseItemRsp *src, void *buf, size_t size) {
+  uint8_t *p = (uint8_t *)buf;
+  uint8_t *end = p + size;
+  if (end - p < 8) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src, 8);
+  p += 8;
+  if ((uint64_t)src->num > 10) {
+    return cl_ERR_CAPACITY;
+  }
+  {
+    size_t n = (size_t)src->num * 8;
+    if ((size_t)(end - p) < n) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 8, n);
+    p += n;
+  }
+  return p - (uint8_t *)buf;
+}
+ptrdiff_t stUseItemRsp_decode(struct stUseItemRsp *dst, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  const uint8_t *end = p + size;
+  if (end - p < 8) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst, p, 8);
+  p += 8;
+  if ((uint64_t)dst->num > 10) {
+    return cl_ERR_CAPACITY;
+  }
+  {
+    size_t n = (size_t)dst->num * 8;
+    if ((size_t)(end - p) < n) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 8, p, n);
+    p += n;
+  }
+  return p - (const uint8_t *)buf;
+}
+COLUMN_ASSERT_SIZE(struct stUseItemRsp_packed, 88);
+void stUseItemRsp_pack(struct stUseItemRsp_packed *dst, const struct stUseItemRsp *src) {
+  memcpy(&dst->code, &src->code, 4);
+  memcpy(&dst->num, &src->num, 4);
+  for (size_t i = 0; i < 10; ++i) {
+    stDrop_pack(&dst->drops[i], &src->drops[i]);
+  }
+}
+void stUseItemRsp_unpack(struct stUseItemRsp *dst, const struct stUseItemRsp_packed *src) {
+  memcpy(&dst->code, &src->code, 4);
+  memcpy(&dst->num, &src->num, 4);
+  for (size_t i = 0; i < 10; ++i) {
+    stDrop_unpack(&dst->drops[i], &src->drops[i]);
+  }
+}
+// messages.h:23:7
 static const clColumn c__U_stValue[] = {
     DEFINE_FIELD_NUMBER(union stValue, i32),
     DEFINE_FIELD_NUMBER(union stValue, u32),
@@ -41,7 +178,13 @@ static const clColumn c__U_stValue[] = {
     DEFINE_FIELD_NUMBER(union stValue, u8),
     DEFINE_FIELD_FIXED_ARRAY(union stValue, other),
 };
-union c__S_stInlineUnion_U_messages_h_406 {
+static const int16_t c__U_stValueSlots[] = {1, -1, -1, 0, 3, -1, 2, 4};
+static const clLookup c__U_stValueLookup = {
+    .seed = 5u,
+    .num = 8,
+    .slots = c__U_stValueSlots,
+};
+union c__S_stInlineUnion_U_messages_h_449 {
   int32_t i32;
   uint32_t u32;
 
@@ -50,42 +193,834 @@ union c__S_stInlineUnion_U_messages_h_406 {
 
   uint64_t other[2];
 };
-// messages.h:34:3
-static const clColumn c__S_stInlineUnion_U_messages_h_406[] = {
-    DEFINE_FIELD_NUMBER(union c__S_stInlineUnion_U_messages_h_406, i32),
-    DEFINE_FIELD_NUMBER(union c__S_stInlineUnion_U_messages_h_406, u32),
-    DEFINE_FIELD_NUMBER(union c__S_stInlineUnion_U_messages_h_406, c),
-    DEFINE_FIELD_NUMBER(union c__S_stInlineUnion_U_messages_h_406, u8),
-    DEFINE_FIELD_FIXED_ARRAY(union c__S_stInlineUnion_U_messages_h_406, other),
+// messages.h:35:3
+static const clColumn c__S_stInlineUnion_U_messages_h_449[] = {
+    DEFINE_FIELD_NUMBER(union c__S_stInlineUnion_U_messages_h_449, i32),
+    DEFINE_FIELD_NUMBER(union c__S_stInlineUnion_U_messages_h_449, u32),
+    DEFINE_FIELD_NUMBER(union c__S_stInlineUnion_U_messages_h_449, c),
+    DEFINE_FIELD_NUMBER(union c__S_stInlineUnion_U_messages_h_449, u8),
+    DEFINE_FIELD_FIXED_ARRAY(union c__S_stInlineUnion_U_messages_h_449, other),
+};
+static const int16_t c__S_stInlineUnion_U_messages_h_449Slots[] = {1, -1, -1, 0, 3, -1, 2, 4};
+static const clLookup c__S_stInlineUnion_U_messages_h_449Lookup = {
+    .seed = 5u,
+    .num = 8,
+    .slots = c__S_stInlineUnion_U_messages_h_449Slots,
 };
-// messages.h:32:8
+// messages.h:33:8
 static const clColumn c__S_stInlineUnion[] = {
     DEFINE_FIELD_NUMBER(struct stInlineUnion, tag),
-    DEFINE_FIELD_UNION(struct stInlineUnion, abc, c__S_stInlineUnion_U_messages_h_406),
+    DEFINE_FIELD_UNION(struct stInlineUnion, abc, c__S_stInlineUnion_U_messages_h_449),
+};
+static const int16_t c__S_stInlineUnionSlots[] = {0, 1};
+static const clLookup c__S_stInlineUnionLookup = {
+    .seed = 2u,
+    .num = 2,
+    .slots = c__S_stInlineUnionSlots,
 };
 const clColumn stInlineUnionObject[] = {
     DEFINE_OBJECT(struct stInlineUnion, c__S_stInlineUnion),
 };
-// messages.h:45:8
+COLUMN_ASSERT_SIZE(struct stInlineUnion, 24);
+ptrdiff_t stInlineUnion_encode(const struct stInlineUnion *src, void *buf, size_t size) {
+  uint8_t *p = (uint8_t *)buf;
+  uint8_t *end = p + size;
+  if (end - p < 20) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src, 4);
+  memcpy(p + 4, (const uint8_t *)src + 8, 16);
+  p += 20;
+  return p - (uint8_t *)buf;
+}
+ptrdiff_t stInlineUnion_decode(struct stInlineUnion *dst, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  const uint8_t *end = p + size;
+  if (end - p < 20) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst, p, 4);
+  memcpy((uint8_t *)dst + 8, p + 4, 16);
+  p += 20;
+  return p - (const uint8_t *)buf;
+}
+COLUMN_ASSERT_SIZE(struct stInlineUnion_packed, 20);
+void stInlineUnion_pack(struct stInlineUnion_packed *dst, const struct stInlineUnion *src) {
+  memcpy(&dst->abc, &src->abc, 16);
+  memcpy(&dst->tag, &src->tag, 4);
+}
+void stInlineUnion_unpack(struct stInlineUnion *dst, const struct stInlineUnion_packed *src) {
+  memset((uint8_t *)dst + 4, 0, 4);
+  memcpy(&dst->tag, &src->tag, 4);
+  memcpy(&dst->abc, &src->abc, 16);
+}
+// messages.h:46:8
 static const clColumn c__S_stFuzz[] = {
     DEFINE_FIELD_STRING(struct stFuzz, name),
     DEFINE_FIELD_NUMBER(struct stFuzz, tag),
     DEFINE_FIELD_UNION(struct stFuzz, v, c__U_stValue),
 };
+static const int16_t c__S_stFuzzSlots[] = {0, -1, 1, 2};
+static const clLookup c__S_stFuzzLookup = {
+    .seed = 6u,
+    .num = 4,
+    .slots = c__S_stFuzzSlots,
+};
 const clColumn stFuzzObject[] = {
     DEFINE_OBJECT(struct stFuzz, c__S_stFuzz),
 };
-// messages.h:51:8
+COLUMN_ASSERT_SIZE(struct stFuzz, 56);
+ptrdiff_t stFuzz_encode(const struct stFuzz *src, void *buf, size_t size) {
+  uint8_t *p = (uint8_t *)buf;
+  uint8_t *end = p + size;
+  {
+    const uint8_t *z = (const uint8_t *)memchr((const uint8_t *)src, 0, 32);
+    size_t n = z ? (size_t)(z - ((const uint8_t *)src)) + 1 : 32;
+    if ((size_t)(end - p) < n) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src, n);
+    p += n;
+  }
+  if (end - p < 20) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src + 32, 4);
+  memcpy(p + 4, (const uint8_t *)src + 40, 16);
+  p += 20;
+  return p - (uint8_t *)buf;
+}
+ptrdiff_t stFuzz_decode(struct stFuzz *dst, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  const uint8_t *end = p + size;
+  {
+    size_t avail = (size_t)(end - p);
+    size_t limit = avail < 32 ? avail : 32;
+    const uint8_t *z = (const uint8_t *)memchr(p, 0, limit);
+    size_t n = z ? (size_t)(z - p) + 1 : limit;
+    if (!z && limit < 32) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst, p, n);
+    p += n;
+  }
+  if (end - p < 20) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst + 32, p, 4);
+  memcpy((uint8_t *)dst + 40, p + 4, 16);
+  p += 20;
+  return p - (const uint8_t *)buf;
+}
+COLUMN_ASSERT_SIZE(struct stFuzz_packed, 52);
+void stFuzz_pack(struct stFuzz_packed *dst, const struct stFuzz *src) {
+  memcpy(&dst->v, &src->v, 16);
+  memcpy(&dst->tag, &src->tag, 4);
+  memcpy(&dst->name, &src->name, 32);
+}
+void stFuzz_unpack(struct stFuzz *dst, const struct stFuzz_packed *src) {
+  memset((uint8_t *)dst + 36, 0, 4);
+  memcpy(&dst->name, &src->name, 32);
+  memcpy(&dst->tag, &src->tag, 4);
+  memcpy(&dst->v, &src->v, 16);
+}
+// messages.h:52:8
 static const clColumn c__S_stTests[] = {
     DEFINE_FIELD_NUMBER(struct stTests, epoch),
     DEFINE_FIELD_STRING(struct stTests, name),
     DEFINE_FIELD_NUMBER(struct stTests, fuzzNum),
-    DEFINE_FIELD_OBJECT_FLEXIBLE_ARRAY(struct stTests, fuzz, stFuzzObject),
+    DEFINE_FIELD_OBJECT_FLEXIBLE_ARRAY(struct stTests, fuzz, fuzzNum, stFuzzObject),
     DEFINE_FIELD_OBJECT(struct stTests, inlineUnion, c__S_stInlineUnion),
 };
+static const int16_t c__S_stTestsSlots[] = {-1, 3, 0, 1, -1, 2, 4, -1};
+static const clLookup c__S_stTestsLookup = {
+    .seed = 11u,
+    .num = 8,
+    .slots = c__S_stTestsSlots,
+};
 const clColumn stTestsObject[] = {
     DEFINE_OBJECT(struct stTests, c__S_stTests),
 };
+COLUMN_ASSERT_SIZE(struct stTests, 1184);
+ptrdiff_t stTests_encode(const struct stTests *src, void *buf, size_t size) {
+  uint8_t *p = (uint8_t *)buf;
+  uint8_t *end = p + size;
+  if (end - p < 4) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src, 4);
+  p += 4;
+  {
+    const uint8_t *z = (const uint8_t *)memchr((const uint8_t *)src + 4, 0, 32);
+    size_t n = z ? (size_t)(z - ((const uint8_t *)src + 4)) + 1 : 32;
+    if ((size_t)(end - p) < n) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 4, n);
+    p += n;
+  }
+  if (end - p < 4) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src + 36, 4);
+  p += 4;
+  if ((uint64_t)src->fuzzNum > 20) {
+    return cl_ERR_CAPACITY;
+  }
+  for (size_t i0 = 0; i0 < (size_t)src->fuzzNum; ++i0) {
+    const struct stFuzz *e0 = &src->fuzz[i0];
+    {
+      const uint8_t *z = (const uint8_t *)memchr((const uint8_t *)e0, 0, 32);
+      size_t n = z ? (size_t)(z - ((const uint8_t *)e0)) + 1 : 32;
+      if ((size_t)(end - p) < n) {
+        return cl_ERR_BUFFER;
+      }
+      memcpy(p, (const uint8_t *)e0, n);
+      p += n;
+    }
+    if (end - p < 20) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)e0 + 32, 4);
+    memcpy(p + 4, (const uint8_t *)e0 + 40, 16);
+    p += 20;
+  }
+  if (end - p < 20) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src + 1160, 4);
+  memcpy(p + 4, (const uint8_t *)src + 1168, 16);
+  p += 20;
+  return p - (uint8_t *)buf;
+}
+ptrdiff_t stTests_decode(struct stTests *dst, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  const uint8_t *end = p + size;
+  if (end - p < 4) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst, p, 4);
+  p += 4;
+  {
+    size_t avail = (size_t)(end - p);
+    size_t limit = avail < 32 ? avail : 32;
+    const uint8_t *z = (const uint8_t *)memchr(p, 0, limit);
+    size_t n = z ? (size_t)(z - p) + 1 : limit;
+    if (!z && limit < 32) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 4, p, n);
+    p += n;
+  }
+  if (end - p < 4) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst + 36, p, 4);
+  p += 4;
+  if ((uint64_t)dst->fuzzNum > 20) {
+    return cl_ERR_CAPACITY;
+  }
+  for (size_t i0 = 0; i0 < (size_t)dst->fuzzNum; ++i0) {
+    struct stFuzz *e0 = &dst->fuzz[i0];
+    {
+      size_t avail = (size_t)(end - p);
+      size_t limit = avail < 32 ? avail : 32;
+      const uint8_t *z = (const uint8_t *)memchr(p, 0, limit);
+      size_t n = z ? (size_t)(z - p) + 1 : limit;
+      if (!z && limit < 32) {
+        return cl_ERR_BUFFER;
+      }
+      memcpy((uint8_t *)e0, p, n);
+      p += n;
+    }
+    if (end - p < 20) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)e0 + 32, p, 4);
+    memcpy((uint8_t *)e0 + 40, p + 4, 16);
+    p += 20;
+  }
+  if (end - p < 20) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst + 1160, p, 4);
+  memcpy((uint8_t *)dst + 1168, p + 4, 16);
+  p += 20;
+  return p - (const uint8_t *)buf;
+}
+COLUMN_ASSERT_SIZE(struct stTests_packed, 1100);
+void stTests_pack(struct stTests_packed *dst, const struct stTests *src) {
+  memcpy(&dst->epoch, &src->epoch, 4);
+  memcpy(&dst->fuzzNum, &src->fuzzNum, 4);
+  for (size_t i = 0; i < 20; ++i) {
+    stFuzz_pack(&dst->fuzz[i], &src->fuzz[i]);
+  }
+  stInlineUnion_pack(&dst->inlineUnion, &src->inlineUnion);
+  memcpy(&dst->name, &src->name, 32);
+}
+void stTests_unpack(struct stTests *dst, const struct stTests_packed *src) {
+  memcpy(&dst->epoch, &src->epoch, 4);
+  memcpy(&dst->name, &src->name, 32);
+  memcpy(&dst->fuzzNum, &src->fuzzNum, 4);
+  for (size_t i = 0; i < 20; ++i) {
+    stFuzz_unpack(&dst->fuzz[i], &src->fuzz[i]);
+  }
+  stInlineUnion_unpack(&dst->inlineUnion, &src->inlineUnion);
+}
+// messages.h:62:8
+static const clColumn c__S_stNumbers[] = {
+    DEFINE_FIELD_NUMBER(struct stNumbers, i8),
+    DEFINE_FIELD_NUMBER(struct stNumbers, i16),
+    DEFINE_FIELD_NUMBER(struct stNumbers, i32),
+    DEFINE_FIELD_NUMBER(struct stNumbers, i64),
+    DEFINE_FIELD_NUMBER(struct stNumbers, u8),
+    DEFINE_FIELD_NUMBER(struct stNumbers, u16),
+    DEFINE_FIELD_NUMBER(struct stNumbers, u32),
+    DEFINE_FIELD_NUMBER(struct stNumbers, u64),
+    DEFINE_FIELD_NUMBER(struct stNumbers, f32),
+    DEFINE_FIELD_NUMBER(struct stNumbers, f64),
+    DEFINE_FIELD_NUMBER(struct stNumbers, b),
+};
+static const int16_t c__S_stNumbersSlots[] = {7, -1, 0, 5, -1, 8, 10, -1, 9, 6, 2, -1, -1, 4, 3, 1};
+static const clLookup c__S_stNumbersLookup = {
+    .seed = 17u,
+    .num = 16,
+    .slots = c__S_stNumbersSlots,
+};
+const clColumn stNumbersObject[] = {
+    DEFINE_OBJECT(struct stNumbers, c__S_stNumbers),
+};
+COLUMN_ASSERT_SIZE(struct stNumbers, 56);
+ptrdiff_t stNumbers_encode(const struct stNumbers *src, void *buf, size_t size) {
+  uint8_t *p = (uint8_t *)buf;
+  uint8_t *end = p + size;
+  if (end - p < 43) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src, 1);
+  memcpy(p + 1, (const uint8_t *)src + 2, 15);
+  memcpy(p + 16, (const uint8_t *)src + 18, 18);
+  memcpy(p + 34, (const uint8_t *)src + 40, 9);
+  p += 43;
+  return p - (uint8_t *)buf;
+}
+ptrdiff_t stNumbers_decode(struct stNumbers *dst, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  const uint8_t *end = p + size;
+  if (end - p < 43) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst, p, 1);
+  memcpy((uint8_t *)dst + 2, p + 1, 15);
+  memcpy((uint8_t *)dst + 18, p + 16, 18);
+  memcpy((uint8_t *)dst + 40, p + 34, 9);
+  p += 43;
+  return p - (const uint8_t *)buf;
+}
+COLUMN_ASSERT_SIZE(struct stNumbers_packed, 43);
+void stNumbers_pack(struct stNumbers_packed *dst, const struct stNumbers *src) {
+  memcpy(&dst->i64, &src->i64, 8);
+  memcpy(&dst->u64, &src->u64, 8);
+  memcpy(&dst->f64, &src->f64, 8);
+  memcpy(&dst->i32, &src->i32, 4);
+  memcpy(&dst->u32, &src->u32, 4);
+  memcpy(&dst->f32, &src->f32, 4);
+  memcpy(&dst->i16, &src->i16, 2);
+  memcpy(&dst->u16, &src->u16, 2);
+  memcpy(&dst->i8, &src->i8, 1);
+  memcpy(&dst->u8, &src->u8, 1);
+  memcpy(&dst->b, &src->b, 1);
+}
+void stNumbers_unpack(struct stNumbers *dst, const struct stNumbers_packed *src) {
+  memset((uint8_t *)dst + 1, 0, 1);
+  memset((uint8_t *)dst + 17, 0, 1);
+  memset((uint8_t *)dst + 36, 0, 4);
+  memset((uint8_t *)dst + 49, 0, 7);
+  memcpy(&dst->i8, &src->i8, 1);
+  memcpy(&dst->i16, &src->i16, 2);
+  memcpy(&dst->i32, &src->i32, 4);
+  memcpy(&dst->i64, &src->i64, 8);
+  memcpy(&dst->u8, &src->u8, 1);
+  memcpy(&dst->u16, &src->u16, 2);
+  memcpy(&dst->u32, &src->u32, 4);
+  memcpy(&dst->u64, &src->u64, 8);
+  memcpy(&dst->f32, &src->f32, 4);
+  memcpy(&dst->f64, &src->f64, 8);
+  memcpy(&dst->b, &src->b, 1);
+}
+union c__S_stTagged_U_messages_h_997 {
+  uint8_t u8;
+  uint32_t u32;
+  char text[24];
+  // @case(7)
+  struct stDrop drop;
+};
+// messages.h:79:3
+static const clColumn c__S_stTagged_U_messages_h_997[] = {
+    DEFINE_FIELD_NUMBER(union c__S_stTagged_U_messages_h_997, u8),
+    DEFINE_FIELD_NUMBER(union c__S_stTagged_U_messages_h_997, u32),
+    DEFINE_FIELD_STRING(union c__S_stTagged_U_messages_h_997, text),
+    DEFINE_FIELD_OBJECT(union c__S_stTagged_U_messages_h_997, drop, c__S_stDrop),
+};
+static const int16_t c__S_stTagged_U_messages_h_997Slots[] = {3, 0, 1, 2};
+static const clLookup c__S_stTagged_U_messages_h_997Lookup = {
+    .seed = 8u,
+    .num = 4,
+    .slots = c__S_stTagged_U_messages_h_997Slots,
+};
+static const int16_t c__S_stTagged_U_messages_h_997Cases[] = {0, 1, 2, -1, -1, -1, -1, 3};
+static const int16_t c__U_stValueCases[] = {0, 1, 2, 3, 4};
+// messages.h:76:8
+static const clColumn c__S_stTagged[] = {
+    DEFINE_FIELD_NUMBER(struct stTagged, kind),
+    DEFINE_FIELD_TAGGED_UNION(struct stTagged, value, c__S_stTagged_U_messages_h_997, kind, c__S_stTagged_U_messages_h_997Cases),
+    DEFINE_FIELD_NUMBER(struct stTagged, vkind),
+    DEFINE_FIELD_TAGGED_UNION(struct stTagged, v, c__U_stValue, vkind, c__U_stValueCases),
+};
+static const int16_t c__S_stTaggedSlots[] = {0, 1, 3, 2};
+static const clLookup c__S_stTaggedLookup = {
+    .seed = 2u,
+    .num = 4,
+    .slots = c__S_stTaggedSlots,
+};
+const clColumn stTaggedObject[] = {
+    DEFINE_OBJECT(struct stTagged, c__S_stTagged),
+};
+COLUMN_ASSERT_SIZE(struct stTagged, 48);
+ptrdiff_t stTagged_encode(const struct stTagged *src, void *buf, size_t size) {
+  uint8_t *p = (uint8_t *)buf;
+  uint8_t *end = p + size;
+  if (end - p < 1) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src, 1);
+  p += 1;
+  switch (src->kind) {
+  case 0:
+    if (end - p < 1) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 4, 1);
+    p += 1;
+    break;
+  case 1:
+    if (end - p < 4) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 4, 4);
+    p += 4;
+    break;
+  case 2:
+    {
+      const uint8_t *z = (const uint8_t *)memchr((const uint8_t *)src + 4, 0, 24);
+      size_t n = z ? (size_t)(z - ((const uint8_t *)src + 4)) + 1 : 24;
+      if ((size_t)(end - p) < n) {
+        return cl_ERR_BUFFER;
+      }
+      memcpy(p, (const uint8_t *)src + 4, n);
+      p += n;
+    }
+    break;
+  case 7:
+    if (end - p < 8) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 4, 8);
+    p += 8;
+    break;
+  default:
+    break;
+  }
+  if (end - p < 2) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src + 28, 2);
+  p += 2;
+  switch (src->vkind) {
+  case 0:
+    if (end - p < 4) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 32, 4);
+    p += 4;
+    break;
+  case 1:
+    if (end - p < 4) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 32, 4);
+    p += 4;
+    break;
+  case 2:
+    if (end - p < 1) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 32, 1);
+    p += 1;
+    break;
+  case 3:
+    if (end - p < 1) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 32, 1);
+    p += 1;
+    break;
+  case 4:
+    if (end - p < 16) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 32, 16);
+    p += 16;
+    break;
+  default:
+    break;
+  }
+  return p - (uint8_t *)buf;
+}
+ptrdiff_t stTagged_decode(struct stTagged *dst, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  const uint8_t *end = p + size;
+  if (end - p < 1) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst, p, 1);
+  p += 1;
+  switch (dst->kind) {
+  case 0:
+    if (end - p < 1) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 4, p, 1);
+    p += 1;
+    break;
+  case 1:
+    if (end - p < 4) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 4, p, 4);
+    p += 4;
+    break;
+  case 2:
+    {
+      size_t avail = (size_t)(end - p);
+      size_t limit = avail < 24 ? avail : 24;
+      const uint8_t *z = (const uint8_t *)memchr(p, 0, limit);
+      size_t n = z ? (size_t)(z - p) + 1 : limit;
+      if (!z && limit < 24) {
+        return cl_ERR_BUFFER;
+      }
+      memcpy((uint8_t *)dst + 4, p, n);
+      p += n;
+    }
+    break;
+  case 7:
+    if (end - p < 8) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 4, p, 8);
+    p += 8;
+    break;
+  default:
+    break;
+  }
+  if (end - p < 2) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst + 28, p, 2);
+  p += 2;
+  switch (dst->vkind) {
+  case 0:
+    if (end - p < 4) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 32, p, 4);
+    p += 4;
+    break;
+  case 1:
+    if (end - p < 4) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 32, p, 4);
+    p += 4;
+    break;
+  case 2:
+    if (end - p < 1) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 32, p, 1);
+    p += 1;
+    break;
+  case 3:
+    if (end - p < 1) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 32, p, 1);
+    p += 1;
+    break;
+  case 4:
+    if (end - p < 16) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 32, p, 16);
+    p += 16;
+    break;
+  default:
+    break;
+  }
+  return p - (const uint8_t *)buf;
+}
+COLUMN_ASSERT_SIZE(struct stTagged_packed, 43);
+void stTagged_pack(struct stTagged_packed *dst, const struct stTagged *src) {
+  memcpy(&dst->v, &src->v, 16);
+  memcpy(&dst->value, &src->value, 24);
+  memcpy(&dst->vkind, &src->vkind, 2);
+  memcpy(&dst->kind, &src->kind, 1);
+}
+void stTagged_unpack(struct stTagged *dst, const struct stTagged_packed *src) {
+  memset((uint8_t *)dst + 1, 0, 3);
+  memset((uint8_t *)dst + 30, 0, 2);
+  memcpy(&dst->kind, &src->kind, 1);
+  memcpy(&dst->value, &src->value, 24);
+  memcpy(&dst->vkind, &src->vkind, 2);
+  memcpy(&dst->v, &src->v, 16);
+}
+// messages.h:98:8
+static const clColumn c__S_stStroke[] = {
+    DEFINE_FIELD_ENUM(struct stStroke, color, 1, 5),
+    DEFINE_FIELD_NUMBER(struct stStroke, dashed),
+};
+static const int16_t c__S_stStrokeSlots[] = {0, 1};
+static const clLookup c__S_stStrokeLookup = {
+    .seed = 0u,
+    .num = 2,
+    .slots = c__S_stStrokeSlots,
+};
+const clColumn stStrokeObject[] = {
+    DEFINE_OBJECT(struct stStroke, c__S_stStroke),
+};
+COLUMN_ASSERT_SIZE(struct stStroke, 8);
+ptrdiff_t stStroke_encode(const struct stStroke *src, void *buf, size_t size) {
+  uint8_t *p = (uint8_t *)buf;
+  uint8_t *end = p + size;
+  if (end - p < 5) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src, 5);
+  p += 5;
+  return p - (uint8_t *)buf;
+}
+ptrdiff_t stStroke_decode(struct stStroke *dst, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  const uint8_t *end = p + size;
+  if (end - p < 5) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst, p, 5);
+  p += 5;
+  return p - (const uint8_t *)buf;
+}
+COLUMN_ASSERT_SIZE(struct stStroke_packed, 5);
+void stStroke_pack(struct stStroke_packed *dst, const struct stStroke *src) {
+  memcpy(&dst->color, &src->color, 4);
+  memcpy(&dst->dashed, &src->dashed, 1);
+}
+void stStroke_unpack(struct stStroke *dst, const struct stStroke_packed *src) {
+  memset((uint8_t *)dst + 5, 0, 3);
+  memcpy(&dst->color, &src->color, 4);
+  memcpy(&dst->dashed, &src->dashed, 1);
+}
+union c__S_stPaint_U_messages_h_1470 {
+  bool flag;
+  char note[6];
+};
+// messages.h:114:3
+static const clColumn c__S_stPaint_U_messages_h_1470[] = {
+    DEFINE_FIELD_NUMBER(union c__S_stPaint_U_messages_h_1470, flag),
+    DEFINE_FIELD_STRING(union c__S_stPaint_U_messages_h_1470, note),
+};
+static const int16_t c__S_stPaint_U_messages_h_1470Slots[] = {0, 1};
+static const clLookup c__S_stPaint_U_messages_h_1470Lookup = {
+    .seed = 0u,
+    .num = 2,
+    .slots = c__S_stPaint_U_messages_h_1470Slots,
+};
+static const int16_t c__S_stPaint_U_messages_h_1470Cases[] = {0, 1};
+// messages.h:103:8
+static const clColumn c__S_stPaint[] = {
+    DEFINE_FIELD_ENUM(struct stPaint, background, 1, 5),
+    DEFINE_FIELD_NUMBER(struct stPaint, visible),
+    DEFINE_FIELD_FIXED_ARRAY(struct stPaint, layers),
+    DEFINE_FIELD_STRING(struct stPaint, label),
+    DEFINE_FIELD_NUMBER(struct stPaint, strokesNum),
+    DEFINE_FIELD_OBJECT_FLEXIBLE_ARRAY(struct stPaint, strokes, strokesNum, stStrokeObject),
+    DEFINE_FIELD_NUMBER(struct stPaint, kind),
+    DEFINE_FIELD_TAGGED_UNION(struct stPaint, extra, c__S_stPaint_U_messages_h_1470, kind, c__S_stPaint_U_messages_h_1470Cases),
+};
+static const int16_t c__S_stPaintSlots[] = {0, 5, 6, 2, 4, 1, 7, 3};
+static const clLookup c__S_stPaintLookup = {
+    .seed = 393u,
+    .num = 8,
+    .slots = c__S_stPaintSlots,
+};
+const clColumn stPaintObject[] = {
+    DEFINE_OBJECT(struct stPaint, c__S_stPaint),
+};
+COLUMN_ASSERT_SIZE(struct stPaint, 60);
+ptrdiff_t stPaint_encode(const struct stPaint *src, void *buf, size_t size) {
+  uint8_t *p = (uint8_t *)buf;
+  uint8_t *end = p + size;
+  if (end - p < 8) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src, 8);
+  p += 8;
+  {
+    const uint8_t *z = (const uint8_t *)memchr((const uint8_t *)src + 8, 0, 8);
+    size_t n = z ? (size_t)(z - ((const uint8_t *)src + 8)) + 1 : 8;
+    if ((size_t)(end - p) < n) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 8, n);
+    p += n;
+  }
+  if (end - p < 1) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src + 16, 1);
+  p += 1;
+  if ((uint64_t)src->strokesNum > 4) {
+    return cl_ERR_CAPACITY;
+  }
+  for (size_t i0 = 0; i0 < (size_t)src->strokesNum; ++i0) {
+    const struct stStroke *e0 = &src->strokes[i0];
+    if (end - p < 5) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)e0, 5);
+    p += 5;
+  }
+  if (end - p < 1) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy(p, (const uint8_t *)src + 52, 1);
+  p += 1;
+  switch (src->kind) {
+  case 0:
+    if (end - p < 1) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy(p, (const uint8_t *)src + 53, 1);
+    p += 1;
+    break;
+  case 1:
+    {
+      const uint8_t *z = (const uint8_t *)memchr((const uint8_t *)src + 53, 0, 6);
+      size_t n = z ? (size_t)(z - ((const uint8_t *)src + 53)) + 1 : 6;
+      if ((size_t)(end - p) < n) {
+        return cl_ERR_BUFFER;
+      }
+      memcpy(p, (const uint8_t *)src + 53, n);
+      p += n;
+    }
+    break;
+  default:
+    break;
+  }
+  return p - (uint8_t *)buf;
+}
+ptrdiff_t stPaint_decode(struct stPaint *dst, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  const uint8_t *end = p + size;
+  if (end - p < 8) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst, p, 8);
+  p += 8;
+  {
+    size_t avail = (size_t)(end - p);
+    size_t limit = avail < 8 ? avail : 8;
+    const uint8_t *z = (const uint8_t *)memchr(p, 0, limit);
+    size_t n = z ? (size_t)(z - p) + 1 : limit;
+    if (!z && limit < 8) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 8, p, n);
+    p += n;
+  }
+  if (end - p < 1) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst + 16, p, 1);
+  p += 1;
+  if ((uint64_t)dst->strokesNum > 4) {
+    return cl_ERR_CAPACITY;
+  }
+  for (size_t i0 = 0; i0 < (size_t)dst->strokesNum; ++i0) {
+    struct stStroke *e0 = &dst->strokes[i0];
+    if (end - p < 5) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)e0, p, 5);
+    p += 5;
+  }
+  if (end - p < 1) {
+    return cl_ERR_BUFFER;
+  }
+  memcpy((uint8_t *)dst + 52, p, 1);
+  p += 1;
+  switch (dst->kind) {
+  case 0:
+    if (end - p < 1) {
+      return cl_ERR_BUFFER;
+    }
+    memcpy((uint8_t *)dst + 53, p, 1);
+    p += 1;
+    break;
+  case 1:
+    {
+      size_t avail = (size_t)(end - p);
+      size_t limit = avail < 6 ? avail : 6;
+      const uint8_t *z = (const uint8_t *)memchr(p, 0, limit);
+      size_t n = z ? (size_t)(z - p) + 1 : limit;
+      if (!z && limit < 6) {
+        return cl_ERR_BUFFER;
+      }
+      memcpy((uint8_t *)dst + 53, p, n);
+      p += n;
+    }
+    break;
+  default:
+    break;
+  }
+  return p - (const uint8_t *)buf;
+}
+COLUMN_ASSERT_SIZE(struct stPaint_packed, 44);
+void stPaint_pack(struct stPaint_packed *dst, const struct stPaint *src) {
+  memcpy(&dst->background, &src->background, 4);
+  memcpy(&dst->visible, &src->visible, 1);
+  memcpy(&dst->layers, &src->layers, 3);
+  memcpy(&dst->label, &src->label, 8);
+  memcpy(&dst->strokesNum, &src->strokesNum, 1);
+  for (size_t i = 0; i < 4; ++i) {
+    stStroke_pack(&dst->strokes[i], &src->strokes[i]);
+  }
+  memcpy(&dst->kind, &src->kind, 1);
+  memcpy(&dst->extra, &src->extra, 6);
+}
+void stPaint_unpack(struct stPaint *dst, const struct stPaint_packed *src) {
+  memset((uint8_t *)dst + 17, 0, 3);
+  memset((uint8_t *)dst + 59, 0, 1);
+  memcpy(&dst->background, &src->background, 4);
+  memcpy(&dst->visible, &src->visible, 1);
+  memcpy(&dst->layers, &src->layers, 3);
+  memcpy(&dst->label, &src->label, 8);
+  memcpy(&dst->strokesNum, &src->strokesNum, 1);
+  for (size_t i = 0; i < 4; ++i) {
+    stStroke_unpack(&dst->strokes[i], &src->strokes[i]);
+  }
+  memcpy(&dst->kind, &src->kind, 1);
+  memcpy(&dst->extra, &src->extra, 6);
+}
 
 // extra_output 2
 #ifdef __cplusplus
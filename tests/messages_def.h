@@ -9,11 +9,146 @@ extern "C" {
 struct clColumn;
 
 extern const struct clColumn stUseItemReqObject[];
+struct stUseItemReq;
+ptrdiff_t stUseItemReq_encode(const struct stUseItemReq *src, void *buf, size_t size);
+ptrdiff_t stUseItemReq_decode(struct stUseItemReq *dst, const void *buf, size_t size);
+#pragma pack(push, 1)
+struct stUseItemReq_packed {
+  uint32_t itemID;
+};
+#pragma pack(pop)
+void stUseItemReq_pack(struct stUseItemReq_packed *dst, const struct stUseItemReq *src);
+void stUseItemReq_unpack(struct stUseItemReq *dst, const struct stUseItemReq_packed *src);
 extern const struct clColumn stDropObject[];
+struct stDrop;
+ptrdiff_t stDrop_encode(const struct stDrop *src, void *buf, size_t size);
+ptrdiff_t stDrop_decode(struct stDrop *dst, const void *buf, size_t size);
+#pragma pack(push, 1)
+struct stDrop_packed {
+  uint32_t itemID;
+  uint32_t itemNum;
+};
+#pragma pack(pop)
+void stDrop_pack(struct stDrop_packed *dst, const struct stDrop *src);
+void stDrop_unpack(struct stDrop *dst, const struct stDrop_packed *src);
 extern const struct clColumn stUseItemRspObject[];
+struct stUseItemRsp;
+ptrdiff_t stUseItemRsp_encode(const struct stUseItemRsp *src, void *buf, size_t size);
+ptrdiff_t stUseItemRsp_decode(struct stUseItemRsp *dst, const void *buf, size_t size);
+#pragma pack(push, 1)
+struct stUseItemRsp_packed {
+  uint32_t code;
+  uint32_t num;
+  struct stDrop_packed drops[10];
+};
+#pragma pack(pop)
+void stUseItemRsp_pack(struct stUseItemRsp_packed *dst, const struct stUseItemRsp *src);
+void stUseItemRsp_unpack(struct stUseItemRsp *dst, const struct stUseItemRsp_packed *src);
 extern const struct clColumn stInlineUnionObject[];
+struct stInlineUnion;
+ptrdiff_t stInlineUnion_encode(const struct stInlineUnion *src, void *buf, size_t size);
+ptrdiff_t stInlineUnion_decode(struct stInlineUnion *dst, const void *buf, size_t size);
+#pragma pack(push, 1)
+struct stInlineUnion_packed {
+  uint8_t abc[16];
+  int32_t tag;
+};
+#pragma pack(pop)
+void stInlineUnion_pack(struct stInlineUnion_packed *dst, const struct stInlineUnion *src);
+void stInlineUnion_unpack(struct stInlineUnion *dst, const struct stInlineUnion_packed *src);
 extern const struct clColumn stFuzzObject[];
+struct stFuzz;
+ptrdiff_t stFuzz_encode(const struct stFuzz *src, void *buf, size_t size);
+ptrdiff_t stFuzz_decode(struct stFuzz *dst, const void *buf, size_t size);
+#pragma pack(push, 1)
+struct stFuzz_packed {
+  uint8_t v[16];
+  int32_t tag;
+  char name[32];
+};
+#pragma pack(pop)
+void stFuzz_pack(struct stFuzz_packed *dst, const struct stFuzz *src);
+void stFuzz_unpack(struct stFuzz *dst, const struct stFuzz_packed *src);
 extern const struct clColumn stTestsObject[];
+struct stTests;
+ptrdiff_t stTests_encode(const struct stTests *src, void *buf, size_t size);
+ptrdiff_t stTests_decode(struct stTests *dst, const void *buf, size_t size);
+#pragma pack(push, 1)
+struct stTests_packed {
+  uint32_t epoch;
+  uint32_t fuzzNum;
+  struct stFuzz_packed fuzz[20];
+  struct stInlineUnion_packed inlineUnion;
+  char name[32];
+};
+#pragma pack(pop)
+void stTests_pack(struct stTests_packed *dst, const struct stTests *src);
+void stTests_unpack(struct stTests *dst, const struct stTests_packed *src);
+extern const struct clColumn stNumbersObject[];
+struct stNumbers;
+ptrdiff_t stNumbers_encode(const struct stNumbers *src, void *buf, size_t size);
+ptrdiff_t stNumbers_decode(struct stNumbers *dst, const void *buf, size_t size);
+#pragma pack(push, 1)
+struct stNumbers_packed {
+  int64_t i64;
+  uint64_t u64;
+  double f64;
+  int32_t i32;
+  uint32_t u32;
+  float f32;
+  int16_t i16;
+  uint16_t u16;
+  int8_t i8;
+  uint8_t u8;
+  bool b;
+};
+#pragma pack(pop)
+void stNumbers_pack(struct stNumbers_packed *dst, const struct stNumbers *src);
+void stNumbers_unpack(struct stNumbers *dst, const struct stNumbers_packed *src);
+extern const struct clColumn stTaggedObject[];
+struct stTagged;
+ptrdiff_t stTagged_encode(const struct stTagged *src, void *buf, size_t size);
+ptrdiff_t stTagged_decode(struct stTagged *dst, const void *buf, size_t size);
+#pragma pack(push, 1)
+struct stTagged_packed {
+  uint8_t v[16];
+  uint8_t value[24];
+  int16_t vkind;
+  uint8_t kind;
+};
+#pragma pack(pop)
+void stTagged_pack(struct stTagged_packed *dst, const struct stTagged *src);
+void stTagged_unpack(struct stTagged *dst, const struct stTagged_packed *src);
+extern const struct clColumn stStrokeObject[];
+struct stStroke;
+ptrdiff_t stStroke_encode(const struct stStroke *src, void *buf, size_t size);
+ptrdiff_t stStroke_decode(struct stStroke *dst, const void *buf, size_t size);
+#pragma pack(push, 1)
+struct stStroke_packed {
+  uint32_t color;
+  bool dashed;
+};
+#pragma pack(pop)
+void stStroke_pack(struct stStroke_packed *dst, const struct stStroke *src);
+void stStroke_unpack(struct stStroke *dst, const struct stStroke_packed *src);
+extern const struct clColumn stPaintObject[];
+struct stPaint;
+ptrdiff_t stPaint_encode(const struct stPaint *src, void *buf, size_t size);
+ptrdiff_t stPaint_decode(struct stPaint *dst, const void *buf, size_t size);
+#pragma pack(push, 1)
+struct stPaint_packed {
+  uint32_t background;
+  bool visible;
+  bool layers[3];
+  char label[8];
+  uint8_t strokesNum;
+  struct stStroke_packed strokes[4];
+  uint8_t kind;
+  uint8_t extra[6];
+};
+#pragma pack(pop)
+void stPaint_pack(struct stPaint_packed *dst, const struct stPaint *src);
+void stPaint_unpack(struct stPaint *dst, const struct stPaint_packed *src);
 
 // extra_output 1
 #ifdef __cplusplus
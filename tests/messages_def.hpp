@@ -0,0 +1,174 @@
+#pragma once
+
+// generated by the columns. DO NOT EDIT!
+#include <columns.hpp>
+
+#include "messages.h"
+
+namespace cl {
+
+// messages.h:5:8
+template <> struct Descriptor<struct stUseItemReq> {
+  static constexpr std::string_view names[] = {
+      "itemID",
+  };
+  using fields = Fields<
+      Number<&stUseItemReq::itemID>>;
+};
+static_assert(sizeof(struct stUseItemReq) == 4, "struct stUseItemReq");
+// messages.h:10:8
+template <> struct Descriptor<struct stDrop> {
+  static constexpr std::string_view names[] = {
+      "itemID",
+      "itemNum",
+  };
+  using fields = Fields<
+      Number<&stDrop::itemID>,
+      Number<&stDrop::itemNum>>;
+};
+static_assert(sizeof(struct stDrop) == 8, "struct stDrop");
+// messages.h:16:8
+template <> struct Descriptor<struct stUseItemRsp> {
+  static constexpr std::string_view names[] = {
+      "code",
+      "num",
+      "drops",
+  };
+  using fields = Fields<
+      Number<&stUseItemRsp::code>,
+      Number<&stUseItemRsp::num>,
+      FlexibleArray<&stUseItemRsp::drops, &stUseItemRsp::num>>;
+};
+static_assert(sizeof(struct stUseItemRsp) == 88, "struct stUseItemRsp");
+// messages.h:33:8
+template <> struct Descriptor<struct stInlineUnion> {
+  static constexpr std::string_view names[] = {
+      "tag",
+      "abc",
+  };
+  using fields = Fields<
+      Number<&stInlineUnion::tag>,
+      Union<&stInlineUnion::abc>>;
+};
+static_assert(sizeof(struct stInlineUnion) == 24, "struct stInlineUnion");
+// messages.h:46:8
+template <> struct Descriptor<struct stFuzz> {
+  static constexpr std::string_view names[] = {
+      "name",
+      "tag",
+      "v",
+  };
+  using fields = Fields<
+      String<&stFuzz::name>,
+      Number<&stFuzz::tag>,
+      Union<&stFuzz::v>>;
+};
+static_assert(sizeof(struct stFuzz) == 56, "struct stFuzz");
+// messages.h:52:8
+template <> struct Descriptor<struct stTests> {
+  static constexpr std::string_view names[] = {
+      "epoch",
+      "name",
+      "fuzzNum",
+      "fuzz",
+      "inlineUnion",
+  };
+  using fields = Fields<
+      Number<&stTests::epoch>,
+      String<&stTests::name>,
+      Number<&stTests::fuzzNum>,
+      FlexibleArray<&stTests::fuzz, &stTests::fuzzNum>,
+      Object<&stTests::inlineUnion>>;
+};
+static_assert(sizeof(struct stTests) == 1184, "struct stTests");
+// messages.h:62:8
+template <> struct Descriptor<struct stNumbers> {
+  static constexpr std::string_view names[] = {
+      "i8",
+      "i16",
+      "i32",
+      "i64",
+      "u8",
+      "u16",
+      "u32",
+      "u64",
+      "f32",
+      "f64",
+      "b",
+  };
+  using fields = Fields<
+      Number<&stNumbers::i8>,
+      Number<&stNumbers::i16>,
+      Number<&stNumbers::i32>,
+      Number<&stNumbers::i64>,
+      Number<&stNumbers::u8>,
+      Number<&stNumbers::u16>,
+      Number<&stNumbers::u32>,
+      Number<&stNumbers::u64>,
+      Number<&stNumbers::f32>,
+      Number<&stNumbers::f64>,
+      Number<&stNumbers::b>>;
+};
+static_assert(sizeof(struct stNumbers) == 56, "struct stNumbers");
+// messages.h:76:8
+template <> struct Descriptor<struct stTagged> {
+  static constexpr std::string_view names[] = {
+      "kind",
+      "value",
+      "vkind",
+      "v",
+  };
+  using fields = Fields<
+      Number<&stTagged::kind>,
+      TaggedUnion<&stTagged::value, &stTagged::kind,
+          Case<0, Number<&decltype(stTagged::value)::u8>>,
+          Case<1, Number<&decltype(stTagged::value)::u32>>,
+          Case<2, String<&decltype(stTagged::value)::text>>,
+          Case<7, Object<&decltype(stTagged::value)::drop>>>,
+      Number<&stTagged::vkind>,
+      TaggedUnion<&stTagged::v, &stTagged::vkind,
+          Case<0, Number<&stValue::i32>>,
+          Case<1, Number<&stValue::u32>>,
+          Case<2, Number<&stValue::c>>,
+          Case<3, Number<&stValue::u8>>,
+          Case<4, FixedArray<&stValue::other>>>>;
+};
+static_assert(sizeof(struct stTagged) == 48, "struct stTagged");
+// messages.h:98:8
+template <> struct Descriptor<struct stStroke> {
+  static constexpr std::string_view names[] = {
+      "color",
+      "dashed",
+  };
+  using fields = Fields<
+      Number<&stStroke::color>,
+      Number<&stStroke::dashed>>;
+};
+static_assert(sizeof(struct stStroke) == 8, "struct stStroke");
+// messages.h:103:8
+template <> struct Descriptor<struct stPaint> {
+  static constexpr std::string_view names[] = {
+      "background",
+      "visible",
+      "layers",
+      "label",
+      "strokesNum",
+      "strokes",
+      "kind",
+      "extra",
+  };
+  using fields = Fields<
+      Number<&stPaint::background>,
+      Number<&stPaint::visible>,
+      FixedArray<&stPaint::layers>,
+      String<&stPaint::label>,
+      Number<&stPaint::strokesNum>,
+      FlexibleArray<&stPaint::strokes, &stPaint::strokesNum>,
+      Number<&stPaint::kind>,
+      TaggedUnion<&stPaint::extra, &stPaint::kind,
+          Case<0, Number<&decltype(stPaint::extra)::flag>>,
+          Case<1, String<&decltype(stPaint::extra)::note>>>>;
+};
+static_assert(sizeof(struct stPaint) == 60, "struct stPaint");
+
+} // namespace cl
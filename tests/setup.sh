@@ -1 +1 @@
-sh ../columns.sh --std=c11 -p plugin.py ./messages.h
+sh ../columns.sh --std=c11 --codec --hpp --packed --dispatch=commands -p plugin.py ./messages.h
@@ -0,0 +1,248 @@
+#include <cfloat>
+#include <clocale>
+#include <cmath>
+#include <columns.h>
+#include <cstdlib>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "messages.h"
+#include "messages_def.h"
+
+static std::string encode(const clColumn *column, const void *src) {
+  clBuffer out = {nullptr, 0, 0};
+  ptrdiff_t n = clJsonEncode(column, src, &out);
+  EXPECT_GT(n, 0);
+  std::string json(out.data, out.size);
+  free(out.data);
+  return json;
+}
+
+template <class T>
+static ptrdiff_t decode(const clColumn *column, T *dst, const std::string &s) {
+  return clJsonDecode(column, dst, s.data(), s.size());
+}
+
+TEST(json, encode) {
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.code = 7;
+  rsp.num = 2;
+  rsp.drops[0].itemID = 1;
+  rsp.drops[0].itemNum = 2;
+  rsp.drops[1].itemID = 4294967295u;
+
+  EXPECT_EQ("{\"code\":7,\"num\":2,\"drops\":[{\"itemID\":1,\"itemNum\":2},"
+            "{\"itemID\":4294967295,\"itemNum\":0}]}",
+            encode(stUseItemRspObject, &rsp));
+
+  stNumbers numbers;
+  memset(&numbers, 0, sizeof(numbers));
+  numbers.i8 = -128;
+  numbers.i64 = INT64_MIN;
+  numbers.u64 = UINT64_MAX;
+  numbers.f32 = 0.1f;
+  numbers.f64 = 0.1;
+  numbers.b = true;
+  EXPECT_EQ("{\"i8\":-128,\"i16\":0,\"i32\":0,\"i64\":-9223372036854775808,"
+            "\"u8\":0,\"u16\":0,\"u32\":0,\"u64\":18446744073709551615,"
+            "\"f32\":0.1,\"f64\":0.1,\"b\":true}",
+            encode(stNumbersObject, &numbers));
+
+  numbers.f64 = NAN;
+  EXPECT_NE(std::string::npos, encode(stNumbersObject, &numbers).find(
+                                   "\"f64\":null"));
+
+  // the shortest digits that read back, laid out like %g
+  const struct {
+    float f32;
+    double f64;
+    const char *json;
+  } floats[] = {
+      {-0.0f, 1e21, "\"f32\":-0,\"f64\":1e+21"},
+      {1e-5f, 0.0001, "\"f32\":1e-05,\"f64\":0.0001"},
+      {123456.0f, 1e15, "\"f32\":123456,\"f64\":1e+15"},
+      {1234567.0f, 5e-324, "\"f32\":1234567,\"f64\":5e-324"},
+      {FLT_MAX, -DBL_MAX, "\"f32\":3.4028235e+38,"
+                          "\"f64\":-1.7976931348623157e+308"},
+      {-2.5f, 1.0 / 3, "\"f32\":-2.5,\"f64\":0.3333333333333333"},
+  };
+  for (const auto &f : floats) {
+    numbers.f32 = f.f32;
+    numbers.f64 = f.f64;
+    EXPECT_NE(std::string::npos,
+              encode(stNumbersObject, &numbers).find(f.json))
+        << f.json;
+  }
+
+  stFuzz fuzz;
+  memset(&fuzz, 0, sizeof(fuzz));
+  strcpy(fuzz.name, "a\"b\\c\n\x01\xc3\xa9 long enough for words");
+  fuzz.v.u8 = 0xab;
+  EXPECT_EQ("{\"name\":\"a\\\"b\\\\c\\n\\u0001\xc3\xa9 long enough for "
+            "words\",\"tag\":0,\"v\":\"ab000000000000000000000000000000\"}",
+            encode(stFuzzObject, &fuzz));
+}
+
+TEST(json, roundtrip) {
+  stTests tests;
+  memset(&tests, 0, sizeof(tests));
+  tests.epoch = 42;
+  strcpy(tests.name, "roundtrip \t\"quoted\"");
+  tests.fuzzNum = 3;
+  for (int i = 0; i < 3; ++i) {
+    snprintf(tests.fuzz[i].name, sizeof(tests.fuzz[i].name), "fuzz%d", i);
+    tests.fuzz[i].tag = -i;
+    tests.fuzz[i].v.other[1] = 0x0102030405060708ull * i;
+  }
+  tests.inlineUnion.tag = 9;
+  tests.inlineUnion.abc.i32 = -1;
+
+  std::string json = encode(stTestsObject, &tests);
+  stTests back;
+  memset(&back, 0, sizeof(back));
+  EXPECT_EQ((ptrdiff_t)json.size(), decode(stTestsObject, &back, json));
+  EXPECT_EQ(0, memcmp(&tests, &back, sizeof(tests)));
+
+  stNumbers numbers;
+  memset(&numbers, 0, sizeof(numbers));
+  numbers.f32 = FLT_MIN;
+  numbers.f64 = DBL_MAX;
+  numbers.i16 = -32768;
+  numbers.u64 = UINT64_MAX;
+  json = encode(stNumbersObject, &numbers);
+  stNumbers n2;
+  memset(&n2, 0, sizeof(n2));
+  ASSERT_GT(decode(stNumbersObject, &n2, json), 0);
+  EXPECT_EQ(0, memcmp(&numbers, &n2, sizeof(numbers)));
+}
+
+TEST(json, decode) {
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.code = 5;
+
+  // unknown keys are skipped, the array sets the length field
+  std::string json =
+      " { \"extra\" : {\"a\":[1,2,{\"b\":null}],\"c\":\"\\u00e9\"},"
+      "\"drops\" : [ {\"itemNum\":3} , {\"itemID\":8,\"itemNum\":9} ] } ";
+  EXPECT_EQ((ptrdiff_t)json.size(), decode(stUseItemRspObject, &rsp, json));
+  EXPECT_EQ(5u, rsp.code);
+  EXPECT_EQ(2u, rsp.num);
+  EXPECT_EQ(3u, rsp.drops[0].itemNum);
+  EXPECT_EQ(8u, rsp.drops[1].itemID);
+
+  stFuzz fuzz;
+  json = "{\"name\":\"\\ud83d\\ude00\\/x\"}";
+  ASSERT_GT(decode(stFuzzObject, &fuzz, json), 0);
+  EXPECT_STREQ("\xf0\x9f\x98\x80/x", fuzz.name);
+
+  // exactly the capacity leaves no terminator
+  json = "{\"name\":\"" + std::string(32, 'x') + "\"}";
+  ASSERT_GT(decode(stFuzzObject, &fuzz, json), 0);
+  EXPECT_EQ(0, memcmp(fuzz.name, std::string(32, 'x').data(), 32));
+}
+
+TEST(json, errors) {
+  stUseItemRsp rsp;
+  stFuzz fuzz;
+  stNumbers numbers;
+
+  const char *invalid[] = {
+      "{\"code\":-1}",
+      "{\"code\":4294967296}",
+      "{\"code\":1.5}",
+      "{\"code\":01}",
+      "{\"code\":\"1\"}",
+      "{\"code\":1,}",
+      "{\"code\" 1}",
+      "[1]",
+      "{\"extra\":[1,]}",
+      "{\"extra\":\"\\x\"}",
+      "{\"extra\":\"\\udc00\"}",
+      "{\"extra\":\"\x01\"}",
+      "{\"extra\":\"\xc0\xaf\"}",
+      "{\"extra\":\"\xed\xa0\x80\"}",
+      "{\"extra\":tru}",
+  };
+  for (const char *s : invalid) {
+    EXPECT_EQ(cl_ERR_VALUE,
+              clJsonDecode(stUseItemRspObject, &rsp, s, strlen(s)))
+        << s;
+  }
+
+  std::string json = "{\"num\":0,\"drops\":[";
+  for (int i = 0; i < 11; ++i) {
+    json += i ? ",{}" : "{}";
+  }
+  json += "]}";
+  EXPECT_EQ(cl_ERR_CAPACITY, decode(stUseItemRspObject, &rsp, json));
+
+  json = "{\"name\":\"" + std::string(33, 'x') + "\"}";
+  EXPECT_EQ(cl_ERR_CAPACITY, decode(stFuzzObject, &fuzz, json));
+
+  json = "{\"i8\":128}";
+  EXPECT_EQ(cl_ERR_VALUE, decode(stNumbersObject, &numbers, json));
+  json = "{\"v\":\"00\"}";
+  EXPECT_EQ(cl_ERR_BUFFER, decode(stFuzzObject, &fuzz, json));
+
+  std::string deep(100, '[');
+  json = "{\"extra\":" + deep;
+  EXPECT_EQ(cl_ERR_VALUE, decode(stFuzzObject, &fuzz, json));
+
+  // every prefix of a valid document is truncated
+  json = "{\"name\":\"\xc3\xa9\\u00e9\",\"tag\":-12,\"v\":"
+         "\"00000000000000000000000000000000\"}";
+  ASSERT_EQ((ptrdiff_t)json.size(), decode(stFuzzObject, &fuzz, json));
+  for (size_t i = 0; i < json.size() - 1; ++i) {
+    EXPECT_EQ(cl_ERR_BUFFER, clJsonDecode(stFuzzObject, &fuzz, json.data(), i))
+        << i;
+  }
+}
+
+TEST(json, longNumbers) {
+  stNumbers numbers;
+  memset(&numbers, 0, sizeof(numbers));
+
+  // a double written out in full is read
+  std::string json = "{\"f64\":0." + std::string(300, '0') + "15}";
+  EXPECT_EQ((ptrdiff_t)json.size(), decode(stNumbersObject, &numbers, json));
+  EXPECT_EQ(1.5e-301, numbers.f64);
+  json = "{\"extra\":1" + std::string(400, '0') + ",\"f32\":2}";
+  EXPECT_EQ((ptrdiff_t)json.size(), decode(stNumbersObject, &numbers, json));
+  EXPECT_EQ(2.0f, numbers.f32);
+
+  // longer is refused as such
+  json = "{\"f64\":1." + std::string(600, '0') + "}";
+  EXPECT_EQ(cl_ERR_CAPACITY, decode(stNumbersObject, &numbers, json));
+  json = "{\"extra\":1." + std::string(600, '0') + "}";
+  EXPECT_EQ(cl_ERR_CAPACITY, decode(stNumbersObject, &numbers, json));
+}
+
+TEST(json, locale) {
+  // '.' stays the decimal point under a locale that uses ','
+  const char *names[] = {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8",
+                         "fr_FR.utf8"};
+  bool found = false;
+  for (const char *name : names) {
+    if (setlocale(LC_NUMERIC, name) &&
+        strcmp(localeconv()->decimal_point, ",") == 0) {
+      found = true;
+      break;
+    }
+  }
+  if (!found) {
+    setlocale(LC_NUMERIC, "C");
+    GTEST_SKIP() << "no locale with a decimal comma";
+  }
+
+  stNumbers numbers;
+  memset(&numbers, 0, sizeof(numbers));
+  numbers.f64 = 1.5;
+  std::string json = encode(stNumbersObject, &numbers);
+  numbers.f64 = 0;
+  EXPECT_EQ((ptrdiff_t)json.size(), decode(stNumbersObject, &numbers, json));
+  EXPECT_EQ(1.5, numbers.f64);
+  setlocale(LC_NUMERIC, "C");
+}
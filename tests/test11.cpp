@@ -0,0 +1,111 @@
+#include <columns.h>
+#include <cstring>
+#include <gtest/gtest.h>
+
+#include "messages.h"
+#include "messages_def.h"
+
+static int field(const clView &view, const char *name, clView *out) {
+  return clViewField(&view, name, strlen(name), out);
+}
+
+TEST(view, leaf) {
+  stUseItemReq req = {12345};
+  char buf[sizeof(req)];
+  ptrdiff_t n = clEncode(stUseItemReqObject, &req, buf, sizeof(buf));
+
+  clView view, itemID;
+  ASSERT_EQ(n, clViewInit(&view, stUseItemReqObject, buf, n));
+  ASSERT_EQ(0, field(view, "itemID", &itemID));
+
+  clScalar v;
+  ASSERT_EQ(0, clViewNumber(&itemID, &v));
+  EXPECT_EQ(12345u, v.u64);
+  EXPECT_EQ((const uint8_t *)buf, itemID.data);
+
+  EXPECT_EQ(cl_ERR_BUFFER, clViewInit(&view, stUseItemReqObject, buf, n - 1));
+  EXPECT_EQ(cl_ERR_VALUE, field(view, "missing", &itemID));
+}
+
+TEST(view, nested) {
+  stTests tests;
+  memset(&tests, 0, sizeof(tests));
+  tests.epoch = 3;
+  strcpy(tests.name, "view");
+  tests.fuzzNum = 4;
+  for (int i = 0; i < 4; ++i) {
+    snprintf(tests.fuzz[i].name, sizeof(tests.fuzz[i].name), "%*d", i * 3, i);
+    tests.fuzz[i].tag = i * 10;
+    tests.fuzz[i].v.other[1] = 100 + i;
+  }
+  tests.inlineUnion.tag = -7;
+  tests.inlineUnion.abc.other[1] = 99;
+
+  char buf[sizeof(tests)];
+  ptrdiff_t n = clEncode(stTestsObject, &tests, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+
+  clView view, name, fuzz, element, tag, v, other, inlineUnion, abc;
+  ASSERT_EQ(n, clViewInit(&view, stTestsObject, buf, n));
+
+  ASSERT_EQ(0, field(view, "name", &name));
+  size_t len;
+  const char *s = (const char *)clViewString(&name, &len);
+  EXPECT_EQ(std::string("view"), std::string(s, len));
+  EXPECT_EQ(buf + 4, s);
+
+  ASSERT_EQ(0, field(view, "fuzz", &fuzz));
+  EXPECT_EQ(4, fuzz.count);
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_EQ(0, clViewElement(&fuzz, i, &element));
+    ASSERT_EQ(0, field(element, "tag", &tag));
+    clScalar x;
+    ASSERT_EQ(0, clViewNumber(&tag, &x));
+    EXPECT_EQ(i * 10, x.i64);
+
+    // below a union the memory layout applies
+    ASSERT_EQ(0, field(element, "v", &v));
+    ASSERT_EQ(0, field(v, "other", &other));
+    EXPECT_TRUE(other.image);
+    EXPECT_EQ(2, other.count);
+    ASSERT_EQ(0, clViewNumberAt(&other, 1, &x));
+    EXPECT_EQ(100u + i, x.u64);
+    EXPECT_EQ(cl_ERR_VALUE, clViewNumberAt(&other, 2, &x));
+  }
+  EXPECT_EQ(cl_ERR_VALUE, clViewElement(&fuzz, 4, &element));
+  EXPECT_EQ(cl_ERR_TYPE, clViewNumber(&fuzz, nullptr));
+
+  ASSERT_EQ(0, field(view, "inlineUnion", &inlineUnion));
+  ASSERT_EQ(0, field(inlineUnion, "tag", &tag));
+  clScalar x;
+  ASSERT_EQ(0, clViewNumber(&tag, &x));
+  EXPECT_EQ(-7, x.i64);
+  ASSERT_EQ(0, field(inlineUnion, "abc", &abc));
+  ASSERT_EQ(0, field(abc, "other", &other));
+  ASSERT_EQ(0, clViewNumberAt(&other, 1, &x));
+  EXPECT_EQ(99u, x.u64);
+
+  for (ptrdiff_t i = 0; i < n; ++i) {
+    EXPECT_EQ(cl_ERR_BUFFER, clViewInit(&view, stTestsObject, buf, i)) << i;
+  }
+}
+
+TEST(view, errors) {
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.num = 2;
+
+  char buf[sizeof(rsp)];
+  ptrdiff_t n = clEncode(stUseItemRspObject, &rsp, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+
+  // a length field past the capacity
+  uint32_t num = 11;
+  memcpy(buf + 4, &num, sizeof(num));
+  clView view;
+  EXPECT_EQ(cl_ERR_CAPACITY, clViewInit(&view, stUseItemRspObject, buf, n));
+
+  EXPECT_EQ(cl_ERR_TYPE,
+            clViewInit(&view, &stUseItemRspObject->via_object.columns[0], buf,
+                       n));
+}
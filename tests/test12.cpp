@@ -0,0 +1,282 @@
+#include <columns.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+
+#include "commands_def.h"
+
+class LogTest : public testing::Test {
+protected:
+  void SetUp() override {
+    char name[] = "/tmp/columns-log-XXXXXX";
+    int fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    path = name;
+  }
+
+  void TearDown() override { unlink(path.c_str()); }
+
+  std::string path;
+};
+
+static int32_t countRecords(const clLogReader *log, int32_t cmd,
+                            uint64_t from, uint64_t to) {
+  clLogCursor cursor;
+  clLogRecord record;
+  clLogBegin(&cursor, log, cmd, from, to);
+
+  int32_t n = 0;
+  int more;
+  while ((more = clLogNext(&cursor, &record)) > 0) {
+    ++n;
+  }
+  return more < 0 ? more : n;
+}
+
+TEST(schema, roundtrip) {
+  ptrdiff_t n = clSchemaSize(stTestsObject);
+  ASSERT_GT(n, 0);
+
+  std::string buf(n, '\0');
+  ASSERT_EQ(n, clSchemaWrite(stTestsObject, &buf[0], n));
+  EXPECT_EQ(cl_ERR_BUFFER, clSchemaWrite(stTestsObject, &buf[0], n - 1));
+
+  const clColumn *column;
+  ASSERT_EQ(n, clSchemaRead(&column, buf.data(), n));
+  const clColumn *truncated;
+  EXPECT_EQ(cl_ERR_BUFFER, clSchemaRead(&truncated, buf.data(), n - 1));
+
+  // the copy describes the same encoding
+  stTests tests;
+  memset(&tests, 0, sizeof(tests));
+  strcpy(tests.name, "schema");
+  tests.fuzzNum = 2;
+  tests.fuzz[1].tag = 77;
+
+  char encoded[sizeof(tests)];
+  ptrdiff_t size = clEncode(stTestsObject, &tests, encoded, sizeof(encoded));
+  ASSERT_GT(size, 0);
+
+  clView view, fuzz, element, tag;
+  ASSERT_EQ(size, clViewInit(&view, column, encoded, size));
+  ASSERT_EQ(0, clViewField(&view, "fuzz", 4, &fuzz));
+  ASSERT_EQ(2, fuzz.count);
+  ASSERT_EQ(0, clViewElement(&fuzz, 1, &element));
+  ASSERT_EQ(0, clViewField(&element, "tag", 3, &tag));
+
+  clScalar v;
+  ASSERT_EQ(0, clViewNumber(&tag, &v));
+  EXPECT_EQ(77, v.i64);
+
+  stTests decoded;
+  memset(&decoded, 0, sizeof(decoded));
+  EXPECT_EQ(size, clDecode(column, &decoded, encoded, size));
+  EXPECT_STREQ("schema", decoded.name);
+  EXPECT_EQ(77, decoded.fuzz[1].tag);
+  free((void *)column);
+}
+
+TEST_F(LogTest, blocks) {
+  clLogWriter writer;
+  ASSERT_EQ(0, clLogOpen(&writer, path.c_str(), &commandsDispatch, 4096,
+                         cl_LOG_DIRECT));
+
+  const int kRecords = 1000;
+  for (int i = 0; i < kRecords; ++i) {
+    stDrop drop = {(uint32_t)i, (uint32_t)i * 2};
+    stUseItemReq req = {(uint32_t)i};
+    ASSERT_EQ(0, i % 10 ? clLogAppend(&writer, stDropCmd, i, &drop)
+                        : clLogAppend(&writer, stUseItemReqCmd, i, &req));
+  }
+  EXPECT_EQ(cl_ERR_VALUE, clLogAppend(&writer, 9, 0, nullptr));
+  ASSERT_EQ(0, clLogClose(&writer));
+
+  clLogReader log;
+  ASSERT_EQ(0, clLogMap(&log, path.c_str()));
+  EXPECT_EQ(3, log.num);
+  EXPECT_EQ(nullptr, clLogSchema(&log, 9));
+
+  EXPECT_EQ(kRecords, countRecords(&log, -1, 0, UINT64_MAX));
+  EXPECT_EQ(kRecords / 10, countRecords(&log, stUseItemReqCmd, 0, UINT64_MAX));
+  EXPECT_EQ(0, countRecords(&log, stUseItemRspCmd, 0, UINT64_MAX));
+  EXPECT_EQ(11, countRecords(&log, -1, 500, 510));
+
+  clLogCursor cursor;
+  clLogRecord record;
+  clLogBegin(&cursor, &log, stDropCmd, 733, UINT64_MAX);
+  ASSERT_EQ(1, clLogNext(&cursor, &record));
+  EXPECT_EQ(stDropCmd, record.cmd);
+  EXPECT_EQ(733u, record.timestamp);
+  EXPECT_GT((const uint8_t *)record.data, log.data);
+  EXPECT_LT((const uint8_t *)record.data, log.data + log.size);
+
+  stDrop drop;
+  ASSERT_EQ((ptrdiff_t)record.size,
+            clDecode(clLogSchema(&log, stDropCmd), &drop, record.data,
+                     record.size));
+  EXPECT_EQ(733u, drop.itemID);
+  EXPECT_EQ(1466u, drop.itemNum);
+  clLogUnmap(&log);
+
+  // reopening appends
+  ASSERT_EQ(0, clLogOpen(&writer, path.c_str(), &commandsDispatch, 0, 0));
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.num = 1;
+  ASSERT_EQ(0, clLogAppend(&writer, stUseItemRspCmd, kRecords, &rsp));
+  ASSERT_EQ(0, clLogClose(&writer));
+
+  ASSERT_EQ(0, clLogMap(&log, path.c_str()));
+  EXPECT_EQ(kRecords + 1, countRecords(&log, -1, 0, UINT64_MAX));
+  EXPECT_EQ(1, countRecords(&log, stUseItemRspCmd, 0, UINT64_MAX));
+  clLogUnmap(&log);
+}
+
+TEST_F(LogTest, capacity) {
+  clLogWriter writer;
+  EXPECT_EQ(cl_ERR_VALUE,
+            clLogOpen(&writer, path.c_str(), &commandsDispatch, 1000, 0));
+  ASSERT_EQ(0, clLogOpen(&writer, path.c_str(), &commandsDispatch, 0, 0));
+  ASSERT_EQ(0, clLogClose(&writer));
+
+  // a file of other descriptors is not appended to
+  const clColumn *columns[] = {stTestsObject};
+  clHandler handlers[1] = {};
+  clDispatch other = {1, 1, columns, handlers};
+  EXPECT_EQ(cl_ERR_VALUE, clLogOpen(&writer, path.c_str(), &other, 0, 0));
+}
+
+TEST_F(LogTest, tornBlock) {
+  clLogWriter writer;
+  ASSERT_EQ(0,
+            clLogOpen(&writer, path.c_str(), &commandsDispatch, 8192, 0));
+  for (int i = 0; i < 300; ++i) {
+    stDrop drop = {(uint32_t)i, 1};
+    ASSERT_EQ(0, clLogAppend(&writer, stDropCmd, i, &drop));
+  }
+  ASSERT_EQ(0, clLogClose(&writer));
+
+  // the first page of a block of two, as left by a crash: the file still
+  // ends on a page
+  FILE *f = fopen(path.c_str(), "r+b");
+  ASSERT_NE(nullptr, f);
+  uint32_t header[4];
+  ASSERT_EQ(4u, fread(header, sizeof(header[0]), 4, f));
+  std::string page(4096, '\0');
+  ASSERT_EQ(0, fseek(f, header[3], SEEK_SET));
+  ASSERT_EQ(page.size(), fread(&page[0], 1, page.size(), f));
+  ASSERT_EQ(0, fseek(f, 0, SEEK_END));
+  long end = ftell(f);
+  ASSERT_EQ(8192, end - (long)header[3]);
+  ASSERT_EQ(page.size(), fwrite(page.data(), 1, page.size(), f));
+  fclose(f);
+
+  ASSERT_EQ(0, clLogOpen(&writer, path.c_str(), &commandsDispatch, 8192, 0));
+  stDrop drop = {300, 1};
+  ASSERT_EQ(0, clLogAppend(&writer, stDropCmd, 300, &drop));
+  ASSERT_EQ(0, clLogClose(&writer));
+
+  clLogReader log;
+  ASSERT_EQ(0, clLogMap(&log, path.c_str()));
+  EXPECT_EQ(301, countRecords(&log, -1, 0, UINT64_MAX));
+  clLogUnmap(&log);
+}
+
+TEST_F(LogTest, malformedHeader) {
+  // a header size short of the header itself, or not padded to a page
+  const uint32_t sizes[] = {0, 8, 4100};
+  for (uint32_t size : sizes) {
+    std::string file(8192, '\0');
+    uint32_t fields[] = {1, 1, size};
+    memcpy(&file[0], "CLOG", 4);
+    memcpy(&file[4], fields, sizeof(fields));
+
+    FILE *f = fopen(path.c_str(), "wb");
+    ASSERT_NE(nullptr, f);
+    ASSERT_EQ(file.size(), fwrite(file.data(), 1, file.size(), f));
+    fclose(f);
+
+    clLogReader log;
+    EXPECT_EQ(cl_ERR_VALUE, clLogMap(&log, path.c_str())) << size;
+  }
+}
+
+// Records keep their written layout: a reader built against other structs
+// finds the fields by name through the descriptors of the header.
+TEST_F(LogTest, schemaChange) {
+  struct oldDrop {
+    uint32_t itemNum;
+    uint16_t pad;
+    uint32_t itemID;
+  };
+
+  clColumn fields[3];
+  memset(fields, 0, sizeof(fields));
+  const char *names[] = {"itemNum", "pad", "itemID"};
+  const int8_t tps[] = {cl_UINT32, cl_UINT16, cl_UINT32};
+  const ptrdiff_t offsets[] = {offsetof(oldDrop, itemNum),
+                               offsetof(oldDrop, pad),
+                               offsetof(oldDrop, itemID)};
+  for (int i = 0; i < 3; ++i) {
+    fields[i].tp = tps[i];
+    fields[i].name.string = names[i];
+    fields[i].name.len = (int8_t)strlen(names[i]);
+    fields[i].size = tps[i] == cl_UINT16 ? 2 : 4;
+    fields[i].align = fields[i].size;
+    fields[i].offset = offsets[i];
+  }
+
+  clColumn object;
+  memset(&object, 0, sizeof(object));
+  object.tp = cl_OBJECT;
+  object.name.string = "oldDrop";
+  object.name.len = 7;
+  object.size = sizeof(oldDrop);
+  object.align = alignof(oldDrop);
+  object.via_object.num = 3;
+  object.via_object.columns = fields;
+
+  const clColumn *columns[] = {&object};
+  clHandler handlers[1] = {};
+  clDispatch old = {stDropCmd, 1, columns, handlers};
+
+  clLogWriter writer;
+  ASSERT_EQ(0, clLogOpen(&writer, path.c_str(), &old, 0, 0));
+  oldDrop drop = {5, 0, 42};
+  ASSERT_EQ(0, clLogAppend(&writer, stDropCmd, 1, &drop));
+  ASSERT_EQ(0, clLogClose(&writer));
+
+  clLogReader log;
+  ASSERT_EQ(0, clLogMap(&log, path.c_str()));
+
+  clLogCursor cursor;
+  clLogRecord record;
+  clLogBegin(&cursor, &log, stDropCmd, 0, UINT64_MAX);
+  ASSERT_EQ(1, clLogNext(&cursor, &record));
+
+  // read it into the current stDrop
+  const clColumn *schema = clLogSchema(&log, stDropCmd);
+  clView view;
+  ASSERT_EQ((ptrdiff_t)record.size,
+            clViewInit(&view, schema, record.data, record.size));
+
+  stDrop current;
+  const char *keys[] = {"itemID", "itemNum"};
+  uint32_t *dst[] = {&current.itemID, &current.itemNum};
+  for (int i = 0; i < 2; ++i) {
+    clView field;
+    clScalar v;
+    ASSERT_EQ(0, clViewField(&view, keys[i], strlen(keys[i]), &field));
+    ASSERT_EQ(0, clViewNumber(&field, &v));
+    *dst[i] = (uint32_t)v.u64;
+  }
+  EXPECT_EQ(42u, current.itemID);
+  EXPECT_EQ(5u, current.itemNum);
+
+  EXPECT_EQ(0, clLogNext(&cursor, &record));
+  clLogUnmap(&log);
+}
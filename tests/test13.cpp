@@ -0,0 +1,277 @@
+#include <gtest/gtest.h>
+
+#define USE_COLUMN_MACROS
+#include <columns.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "messages.h"
+#include "messages_def.h"
+
+// Two builds of the same message: fields reordered, resized, added and
+// removed, arrays and strings of other capacities.
+struct v1Drop {
+  uint16_t itemID;
+  uint16_t itemNum;
+};
+
+struct v1Bag {
+  int16_t owner;
+  char note[16];
+  uint8_t num;
+  v1Drop drops[8];
+  float weight;
+  uint32_t slots[4];
+  uint32_t removed;
+};
+
+struct v2Drop {
+  uint64_t itemNum;
+  uint32_t itemID;
+  uint32_t flags;
+};
+
+struct v2Bag {
+  double weight;
+  char note[8];
+  int64_t owner;
+  uint32_t added;
+  uint16_t num;
+  v2Drop drops[6];
+  uint32_t slots[6];
+};
+
+static const clColumn v1DropFields[] = {
+    DEFINE_FIELD_NUMBER(v1Drop, itemID),
+    DEFINE_FIELD_NUMBER(v1Drop, itemNum),
+};
+static const clColumn v1DropObject[] = {DEFINE_OBJECT(v1Drop, v1DropFields)};
+static const clColumn v1BagFields[] = {
+    DEFINE_FIELD_NUMBER(v1Bag, owner),
+    DEFINE_FIELD_STRING(v1Bag, note),
+    DEFINE_FIELD_NUMBER(v1Bag, num),
+    DEFINE_FIELD_OBJECT_FLEXIBLE_ARRAY(v1Bag, drops, num, v1DropObject),
+    DEFINE_FIELD_NUMBER(v1Bag, weight),
+    DEFINE_FIELD_FIXED_ARRAY(v1Bag, slots),
+    DEFINE_FIELD_NUMBER(v1Bag, removed),
+};
+static const clColumn v1BagObject[] = {DEFINE_OBJECT(v1Bag, v1BagFields)};
+
+static const clColumn v2DropFields[] = {
+    DEFINE_FIELD_NUMBER(v2Drop, itemNum),
+    DEFINE_FIELD_NUMBER(v2Drop, itemID),
+    DEFINE_FIELD_NUMBER(v2Drop, flags),
+};
+static const clColumn v2DropObject[] = {DEFINE_OBJECT(v2Drop, v2DropFields)};
+static const clColumn v2BagFields[] = {
+    DEFINE_FIELD_NUMBER(v2Bag, weight),
+    DEFINE_FIELD_STRING(v2Bag, note),
+    DEFINE_FIELD_NUMBER(v2Bag, owner),
+    DEFINE_FIELD_NUMBER(v2Bag, added),
+    DEFINE_FIELD_NUMBER(v2Bag, num),
+    DEFINE_FIELD_OBJECT_FLEXIBLE_ARRAY(v2Bag, drops, num, v2DropObject),
+    DEFINE_FIELD_FIXED_ARRAY(v2Bag, slots),
+};
+static const clColumn v2BagObject[] = {DEFINE_OBJECT(v2Bag, v2BagFields)};
+
+struct v3Bag {
+  char owner[8];
+};
+
+static const clColumn v3BagFields[] = {
+    DEFINE_FIELD_STRING(v3Bag, owner),
+};
+static const clColumn v3BagObject[] = {DEFINE_OBJECT(v3Bag, v3BagFields)};
+
+TEST(plan, fingerprint) {
+  uint64_t fp = clSchemaFingerprint(stTestsObject);
+  EXPECT_NE(0u, fp);
+  EXPECT_EQ(fp, clSchemaFingerprint(stTestsObject));
+  EXPECT_NE(fp, clSchemaFingerprint(stFuzzObject));
+  EXPECT_NE(clSchemaFingerprint(v1BagObject),
+            clSchemaFingerprint(v2BagObject));
+
+  // a descriptor read back from its blob has the same fingerprint
+  std::string blob(clSchemaSize(stTestsObject), '\0');
+  ASSERT_GT(clSchemaWrite(stTestsObject, &blob[0], blob.size()), 0);
+  const clColumn *column;
+  ASSERT_EQ((ptrdiff_t)blob.size(),
+            clSchemaRead(&column, blob.data(), blob.size()));
+  EXPECT_EQ(fp, clSchemaFingerprint(column));
+
+  const clPlan *a, *b;
+  ASSERT_EQ(0, clPlanFind(&a, stTestsObject, stTestsObject));
+  ASSERT_EQ(0, clPlanFind(&b, column, stTestsObject));
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(fp, a->writer);
+  EXPECT_EQ(fp, a->reader);
+
+  // found again by the addresses, and by the fingerprints once cleared
+  ASSERT_EQ(0, clPlanFind(&b, stTestsObject, stTestsObject));
+  EXPECT_EQ(a, b);
+  clProgramCacheClear();
+  ASSERT_EQ(0, clPlanFind(&b, column, stTestsObject));
+  EXPECT_EQ(a, b);
+  clPlanCacheClear();
+  free((void *)column);
+}
+
+TEST(plan, same) {
+  stTests tests;
+  memset(&tests, 0, sizeof(tests));
+  tests.epoch = 9;
+  strcpy(tests.name, "plan");
+  tests.fuzzNum = 3;
+  for (int i = 0; i < 3; ++i) {
+    snprintf(tests.fuzz[i].name, sizeof(tests.fuzz[i].name), "fuzz%d", i);
+    tests.fuzz[i].tag = i;
+    tests.fuzz[i].v.other[0] = 1000 + i;
+  }
+  tests.inlineUnion.tag = 5;
+  tests.inlineUnion.abc.u32 = 77;
+
+  char buf[sizeof(tests)];
+  ptrdiff_t n = clEncode(stTestsObject, &tests, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+
+  clPlan plan;
+  ASSERT_EQ(0, clPlanInit(&plan, stTestsObject, stTestsObject));
+
+  stTests expected, decoded;
+  memset(&expected, 0, sizeof(expected));
+  memset(&decoded, 0, sizeof(decoded));
+  ASSERT_EQ(n, clDecode(stTestsObject, &expected, buf, n));
+  ASSERT_EQ(n, clPlanDecode(&plan, &decoded, buf, n));
+  EXPECT_EQ(0, memcmp(&expected, &decoded, sizeof(decoded)));
+  EXPECT_EQ(cl_ERR_BUFFER, clPlanDecode(&plan, &decoded, buf, n - 1));
+  clPlanFree(&plan);
+}
+
+TEST(plan, translate) {
+  v1Bag bag;
+  memset(&bag, 0, sizeof(bag));
+  bag.owner = -12;
+  strcpy(bag.note, "a longer note");
+  bag.num = 3;
+  for (int i = 0; i < 3; ++i) {
+    bag.drops[i].itemID = (uint16_t)(100 + i);
+    bag.drops[i].itemNum = (uint16_t)(i + 1);
+  }
+  bag.weight = 2.5f;
+  for (int i = 0; i < 4; ++i) {
+    bag.slots[i] = 10 + i;
+  }
+  bag.removed = 0xdead;
+
+  char buf[sizeof(bag)];
+  ptrdiff_t n = clEncode(v1BagObject, &bag, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+
+  const clPlan *plan;
+  ASSERT_EQ(0, clPlanFind(&plan, v1BagObject, v2BagObject));
+
+  v2Bag current;
+  memset(&current, 0xff, sizeof(current));
+  ASSERT_EQ(n, clPlanDecode(plan, &current, buf, n));
+  EXPECT_EQ(2.5, current.weight);
+  EXPECT_STREQ("a longe", current.note);
+  EXPECT_EQ(-12, current.owner);
+  EXPECT_EQ(0u, current.added);
+  EXPECT_EQ(3u, current.num);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(100u + i, current.drops[i].itemID);
+    EXPECT_EQ(i + 1u, current.drops[i].itemNum);
+    EXPECT_EQ(0u, current.drops[i].flags);
+  }
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(i < 4 ? 10u + i : 0u, current.slots[i]);
+  }
+
+  // and back, narrowing
+  char out[sizeof(current)];
+  n = clEncode(v2BagObject, &current, out, sizeof(out));
+  ASSERT_GT(n, 0);
+
+  const clPlan *back;
+  ASSERT_EQ(0, clPlanFind(&back, v2BagObject, v1BagObject));
+  v1Bag old;
+  memset(&old, 0, sizeof(old));
+  ASSERT_EQ(n, clPlanDecode(back, &old, out, n));
+  EXPECT_EQ(-12, old.owner);
+  EXPECT_STREQ("a longe", old.note);
+  EXPECT_EQ(3, old.num);
+  EXPECT_EQ(102, old.drops[2].itemID);
+  EXPECT_EQ(13u, old.slots[3]);
+  EXPECT_EQ(0u, old.removed);
+
+  current.owner = 40000;
+  n = clEncode(v2BagObject, &current, out, sizeof(out));
+  EXPECT_EQ(cl_ERR_VALUE, clPlanDecode(back, &old, out, n));
+  clPlanCacheClear();
+}
+
+TEST(plan, capacity) {
+  v1Bag bag;
+  memset(&bag, 0, sizeof(bag));
+  bag.num = 8;
+
+  char buf[sizeof(bag)];
+  ptrdiff_t n = clEncode(v1BagObject, &bag, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+
+  clPlan plan;
+  ASSERT_EQ(0, clPlanInit(&plan, v1BagObject, v2BagObject));
+  v2Bag current;
+  EXPECT_EQ(cl_ERR_CAPACITY, clPlanDecode(&plan, &current, buf, n));
+  clPlanFree(&plan);
+
+  // owner became a string
+  EXPECT_EQ(cl_ERR_TYPE, clPlanInit(&plan, v1BagObject, v3BagObject));
+}
+
+// An object of one fixed array of 4 numbers of TP and SIZE bytes, with the
+// padding of the descriptors set to FILL.
+static void fixedNumbers(clColumn *object, clColumn *array, int8_t tp,
+                         int32_t size, uint8_t fill) {
+  memset(array, fill, sizeof(*array));
+  array->tp = cl_FIXED_ARRAY;
+  array->name.string = "a";
+  array->name.len = 1;
+  array->size = 4 * size;
+  array->align = size;
+  array->offset = 0;
+  array->via_fixed_array.tp = tp;
+  array->via_fixed_array.capacity = 4;
+  array->via_fixed_array.columns = nullptr;
+
+  memset(object, 0, sizeof(*object));
+  object->tp = cl_OBJECT;
+  object->name.string = "numbers";
+  object->name.len = 7;
+  object->size = 4 * size;
+  object->align = size;
+  object->via_object.num = 1;
+  object->via_object.columns = array;
+}
+
+TEST(plan, fixedNumbers) {
+  // the padding after the int8_t tp of a fixed array is not read as tp
+  clColumn writer, writerArray, reader, readerArray;
+  fixedNumbers(&writer, &writerArray, cl_UINT16, 2, 0xff);
+  fixedNumbers(&reader, &readerArray, cl_UINT32, 4, 0x00);
+
+  uint16_t a[4] = {1, 2, 300, 65535};
+  char buf[8];
+  ASSERT_EQ(8, clEncode(&writer, a, buf, sizeof(buf)));
+
+  clPlan plan;
+  ASSERT_EQ(0, clPlanInit(&plan, &writer, &reader));
+  uint32_t out[4] = {};
+  EXPECT_EQ(8, clPlanDecode(&plan, out, buf, sizeof(buf)));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(a[i], out[i]) << i;
+  }
+  clPlanFree(&plan);
+  clProgramCacheClear();
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include <columns.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "messages_def.h"
+#include "messages_def.hpp"
+
+static_assert(cl::fieldCount<stTests>() == 5);
+static_assert(cl::fieldIndex<stTests>("fuzz") == 3);
+static_assert(cl::fieldIndex<stTests>("missing") == -1);
+static_assert(cl::maxEncodedSize<stNumbers>() == 43);
+static_assert(cl::maxEncodedSize<stUseItemRsp>() ==
+              sizeof(uint32_t) * 2 + sizeof(stDrop) * 10);
+
+// The templates and the clColumn tables must agree on every byte.
+template <class T>
+static void expectSame(const clColumn *column, const T &msg) {
+  std::vector<uint8_t> expected(sizeof(T) * 2), encoded(sizeof(T) * 2);
+  ptrdiff_t n = clEncode(column, &msg, expected.data(), expected.size());
+  ASSERT_GT(n, 0);
+  EXPECT_EQ(n, cl::encodeSize(msg));
+  ASSERT_EQ(n, cl::encode(msg, encoded.data(), encoded.size()));
+  EXPECT_EQ(0, memcmp(expected.data(), encoded.data(), n));
+
+  T a, b;
+  memset(&a, 0, sizeof(a));
+  memset(&b, 0, sizeof(b));
+  ASSERT_EQ(n, clDecode(column, &a, expected.data(), n));
+  ASSERT_EQ(n, cl::decode(b, expected.data(), n));
+  EXPECT_EQ(0, memcmp(&a, &b, sizeof(T)));
+
+  EXPECT_EQ(cl_ERR_BUFFER, cl::encode(msg, encoded.data(), n - 1));
+  EXPECT_EQ(cl_ERR_BUFFER, cl::decode(b, expected.data(), n - 1));
+}
+
+TEST(hpp, tests) {
+  stTests tests;
+  memset(&tests, 0, sizeof(tests));
+  tests.epoch = 7;
+  strcpy(tests.name, "descriptor");
+  tests.fuzzNum = 4;
+  for (int i = 0; i < 4; ++i) {
+    snprintf(tests.fuzz[i].name, sizeof(tests.fuzz[i].name), "fuzz%d", i);
+    tests.fuzz[i].tag = -i;
+    tests.fuzz[i].v.other[1] = 1000 + i;
+  }
+  tests.inlineUnion.tag = 3;
+  tests.inlineUnion.abc.u32 = 99;
+  expectSame(stTestsObject, tests);
+
+  tests.fuzzNum = 1000;
+  char buf[sizeof(tests)];
+  EXPECT_EQ(cl_ERR_CAPACITY, cl::encode(tests, buf, sizeof(buf)));
+}
+
+TEST(hpp, rsp) {
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.code = 1;
+  rsp.num = 3;
+  for (uint32_t i = 0; i < rsp.num; ++i) {
+    rsp.drops[i].itemID = 100 + i;
+    rsp.drops[i].itemNum = i;
+  }
+  expectSame(stUseItemRspObject, rsp);
+}
+
+TEST(hpp, numbers) {
+  stNumbers numbers;
+  memset(&numbers, 0, sizeof(numbers));
+  numbers.i8 = -8;
+  numbers.i64 = -64;
+  numbers.u32 = 32;
+  numbers.f64 = 6.4;
+  numbers.b = true;
+  expectSame(stNumbersObject, numbers);
+}
+
+TEST(hpp, tagged) {
+  stTagged tagged;
+  memset(&tagged, 0, sizeof(tagged));
+  const uint8_t kinds[] = {0, 1, 2, 7, 9};
+  for (uint8_t kind : kinds) {
+    tagged.kind = kind;
+    tagged.vkind = kind % 5;
+    strcpy(tagged.value.text, "text");
+    tagged.v.other[1] = kind;
+    expectSame(stTaggedObject, tagged);
+  }
+  static_assert(cl::maxEncodedSize<stTagged>() == 1 + 24 + 2 + 16);
+}
+
+TEST(hpp, visit) {
+  stDrop drop = {5, 6};
+  std::string names;
+  uint32_t sum = 0;
+  cl::visit(drop, [&](std::string_view name, auto &field) {
+    names += std::string(name) + ",";
+    sum += field;
+    field = 0;
+  });
+  EXPECT_EQ("itemID,itemNum,", names);
+  EXPECT_EQ(11u, sum);
+  EXPECT_EQ(0u, drop.itemID);
+  EXPECT_EQ(0u, drop.itemNum);
+}
@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+
+#include <columns.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "messages.h"
+#include "messages_def.h"
+
+static stTagged tagged(uint8_t kind, int16_t vkind) {
+  stTagged msg;
+  memset(&msg, 0xcc, sizeof(msg));
+  msg.kind = kind;
+  switch (kind) {
+  case 0:
+    msg.value.u8 = 8;
+    break;
+  case 1:
+    msg.value.u32 = 32;
+    break;
+  case 2:
+    strcpy(msg.value.text, "tagged");
+    break;
+  case 7:
+    msg.value.drop.itemID = 70;
+    msg.value.drop.itemNum = 71;
+    break;
+  }
+  msg.vkind = vkind;
+  msg.v.other[0] = 1;
+  msg.v.other[1] = 2;
+  return msg;
+}
+
+TEST(tagged, encode) {
+  // kind, the selected member, vkind, the selected member
+  const struct {
+    uint8_t kind;
+    int16_t vkind;
+    ptrdiff_t size;
+  } cases[] = {
+      {0, 3, 1 + 1 + 2 + 1},  {1, 0, 1 + 4 + 2 + 4},
+      {2, 4, 1 + 7 + 2 + 16}, {7, 1, 1 + 8 + 2 + 4},
+      {3, -1, 1 + 0 + 2 + 0}, {255, 5, 1 + 0 + 2 + 0},
+  };
+
+  for (const auto &c : cases) {
+    stTagged msg = tagged(c.kind, c.vkind);
+    char buf[sizeof(msg)], codec[sizeof(msg)];
+    ASSERT_EQ(c.size, clEncodeSize(stTaggedObject, &msg));
+    ASSERT_EQ(c.size, clEncode(stTaggedObject, &msg, buf, sizeof(buf)));
+    ASSERT_EQ(c.size, stTagged_encode(&msg, codec, sizeof(codec)));
+    EXPECT_EQ(0, memcmp(buf, codec, c.size));
+    EXPECT_EQ(cl_ERR_BUFFER, clEncode(stTaggedObject, &msg, buf, c.size - 1));
+
+    stTagged out, generated;
+    memset(&out, 0, sizeof(out));
+    memset(&generated, 0, sizeof(generated));
+    ASSERT_EQ(c.size, clDecode(stTaggedObject, &out, buf, c.size));
+    ASSERT_EQ(c.size, stTagged_decode(&generated, buf, c.size));
+    EXPECT_EQ(0, memcmp(&out, &generated, sizeof(out)));
+    EXPECT_EQ(c.kind, out.kind);
+    EXPECT_EQ(c.vkind, out.vkind);
+    if (c.kind == 2) {
+      EXPECT_STREQ("tagged", out.value.text);
+    }
+    if (c.kind == 7) {
+      EXPECT_EQ(71u, out.value.drop.itemNum);
+    }
+    if (c.vkind == 4) {
+      EXPECT_EQ(2u, out.v.other[1]);
+    }
+
+    ptrdiff_t n = clEncodeEx(stTaggedObject, cl_WIRE_COMPACT, &msg, buf,
+                             sizeof(buf));
+    ASSERT_GT(n, 0);
+    EXPECT_LE(n, c.size);
+    memset(&out, 0, sizeof(out));
+    ASSERT_EQ(n, clDecodeEx(stTaggedObject, cl_WIRE_COMPACT, &out, buf, n));
+    EXPECT_EQ(0, memcmp(&out, &generated, sizeof(out)));
+  }
+}
+
+TEST(tagged, diff) {
+  stTagged base = tagged(1, 0);
+  stTagged cur = base;
+
+  // bytes outside the selected member do not count
+  cur.value.text[10] = 'x';
+  EXPECT_EQ(0, memcmp(&base.value.u32, &cur.value.u32, 4));
+  char patch[sizeof(cur)];
+  ptrdiff_t n = clDiff(stTaggedObject, &base, &cur, patch, sizeof(patch));
+  EXPECT_EQ(1, n);
+
+  cur = tagged(7, 3);
+  n = clDiff(stTaggedObject, &base, &cur, patch, sizeof(patch));
+  ASSERT_GT(n, 0);
+  EXPECT_EQ(n, clDiffSize(stTaggedObject, &base, &cur));
+
+  stTagged dst = base;
+  ASSERT_EQ(n, clPatch(stTaggedObject, &dst, patch, n));
+  EXPECT_EQ(7, dst.kind);
+  EXPECT_EQ(70u, dst.value.drop.itemID);
+  EXPECT_EQ(71u, dst.value.drop.itemNum);
+  EXPECT_EQ(3, dst.vkind);
+  EXPECT_EQ(cur.v.u8, dst.v.u8);
+}
+
+TEST(tagged, json) {
+  stTagged msg = tagged(2, 1);
+  msg.v.u32 = 5;
+
+  clBuffer out = {nullptr, 0, 0};
+  ASSERT_GT(clJsonEncode(stTaggedObject, &msg, &out), 0);
+  EXPECT_EQ("{\"kind\":2,\"value\":{\"text\":\"tagged\"},\"vkind\":1,"
+            "\"v\":{\"u32\":5}}",
+            std::string(out.data, out.size));
+
+  msg = tagged(4, 9);
+  out.size = 0;
+  ASSERT_GT(clJsonEncode(stTaggedObject, &msg, &out), 0);
+  EXPECT_EQ("{\"kind\":4,\"value\":null,\"vkind\":9,\"v\":null}",
+            std::string(out.data, out.size));
+  free(out.data);
+
+  // the member sets the tag
+  const char json[] = "{\"value\":{\"drop\":{\"itemID\":1,\"itemNum\":2}},"
+                      "\"v\":{\"other\":[3,4]}}";
+  stTagged in;
+  memset(&in, 0, sizeof(in));
+  ASSERT_EQ((ptrdiff_t)strlen(json),
+            clJsonDecode(stTaggedObject, &in, json, strlen(json)));
+  EXPECT_EQ(7, in.kind);
+  EXPECT_EQ(2u, in.value.drop.itemNum);
+  EXPECT_EQ(4, in.vkind);
+  EXPECT_EQ(4u, in.v.other[1]);
+
+  const char unknown[] = "{\"value\":{\"nope\":1}}";
+  EXPECT_EQ(cl_ERR_VALUE,
+            clJsonDecode(stTaggedObject, &in, unknown, strlen(unknown)));
+}
+
+TEST(tagged, view) {
+  stTagged msg = tagged(2, 4);
+  char buf[sizeof(msg)];
+  ptrdiff_t n = clEncode(stTaggedObject, &msg, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+
+  clView view, value, text, v, other;
+  ASSERT_EQ(n, clViewInit(&view, stTaggedObject, buf, n));
+  ASSERT_EQ(0, clViewField(&view, "value", 5, &value));
+  EXPECT_EQ(2, value.count);
+  EXPECT_EQ(7u, value.size);
+  EXPECT_EQ(cl_ERR_VALUE, clViewField(&value, "u32", 3, &text));
+  ASSERT_EQ(0, clViewField(&value, "text", 4, &text));
+  size_t len;
+  const char *s = (const char *)clViewString(&text, &len);
+  EXPECT_EQ("tagged", std::string(s, len));
+
+  ASSERT_EQ(0, clViewField(&view, "v", 1, &v));
+  ASSERT_EQ(0, clViewField(&v, "other", 5, &other));
+  clScalar x;
+  ASSERT_EQ(0, clViewNumberAt(&other, 1, &x));
+  EXPECT_EQ(2u, x.u64);
+
+  EXPECT_EQ(cl_ERR_BUFFER, clViewInit(&view, stTaggedObject, buf, n - 1));
+}
+
+TEST(tagged, schema) {
+  std::string blob(clSchemaSize(stTaggedObject), '\0');
+  ASSERT_GT(clSchemaWrite(stTaggedObject, &blob[0], blob.size()), 0);
+  const clColumn *column;
+  ASSERT_EQ((ptrdiff_t)blob.size(),
+            clSchemaRead(&column, blob.data(), blob.size()));
+  EXPECT_EQ(clSchemaFingerprint(stTaggedObject), clSchemaFingerprint(column));
+
+  stTagged msg = tagged(7, 2);
+  char a[sizeof(msg)], b[sizeof(msg)];
+  ptrdiff_t n = clEncode(stTaggedObject, &msg, a, sizeof(a));
+  ASSERT_EQ(1 + 8 + 2 + 1, n);
+  ASSERT_EQ(n, clEncode(column, &msg, b, sizeof(b)));
+  EXPECT_EQ(0, memcmp(a, b, n));
+
+  // plans are made of fixed sizes
+  clPlan plan;
+  EXPECT_EQ(cl_ERR_TYPE, clPlanInit(&plan, stTaggedObject, column));
+  free((void *)column);
+}
@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+
+#include <columns.h>
+#include <cstring>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+static stPaint paint() {
+  stPaint msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.background = stBLUE;
+  msg.visible = true;
+  msg.layers[2] = true;
+  strcpy(msg.label, "paint");
+  msg.strokesNum = 2;
+  msg.strokes[0].color = stRED;
+  msg.strokes[1].color = stGREEN;
+  msg.strokes[1].dashed = true;
+  msg.kind = 1;
+  strcpy(msg.extra.note, "note");
+  return msg;
+}
+
+static void setByte(void *field, uint8_t v) { memcpy(field, &v, 1); }
+
+static ptrdiff_t validate(const clColumn *column, const void *msg,
+                          size_t size) {
+  clValidator validator;
+  EXPECT_EQ(0, clValidatorInit(&validator, column));
+  ptrdiff_t n = clValidate(&validator, msg, 1, size, nullptr);
+  clValidatorFree(&validator);
+  return n;
+}
+
+TEST(validate, checks) {
+  stPaint msg = paint();
+  EXPECT_EQ(0, validate(stPaintObject, &msg, sizeof(msg)));
+
+  // the enum range, every value in it passes
+  msg.background = (stColor)0;
+  EXPECT_EQ(1, validate(stPaintObject, &msg, sizeof(msg)));
+  msg.background = (stColor)6;
+  EXPECT_EQ(1, validate(stPaintObject, &msg, sizeof(msg)));
+  msg.background = (stColor)3;
+  EXPECT_EQ(0, validate(stPaintObject, &msg, sizeof(msg)));
+
+  msg = paint();
+  setByte(&msg.visible, 2);
+  EXPECT_EQ(1, validate(stPaintObject, &msg, sizeof(msg)));
+
+  msg = paint();
+  setByte(&msg.layers[1], 0xff);
+  EXPECT_EQ(1, validate(stPaintObject, &msg, sizeof(msg)));
+
+  msg = paint();
+  memset(msg.label, 'x', sizeof(msg.label));
+  EXPECT_EQ(1, validate(stPaintObject, &msg, sizeof(msg)));
+
+  msg = paint();
+  msg.strokesNum = 5;
+  EXPECT_EQ(1, validate(stPaintObject, &msg, sizeof(msg)));
+
+  // only the live elements are checked
+  msg = paint();
+  msg.strokes[3].color = (stColor)9;
+  EXPECT_EQ(0, validate(stPaintObject, &msg, sizeof(msg)));
+  msg.strokes[1].color = (stColor)9;
+  EXPECT_EQ(1, validate(stPaintObject, &msg, sizeof(msg)));
+  msg.strokes[1].color = stBLUE;
+  setByte(&msg.strokes[0].dashed, 3);
+  EXPECT_EQ(1, validate(stPaintObject, &msg, sizeof(msg)));
+
+  // and only the selected member
+  msg = paint();
+  memset(msg.extra.note, 7, sizeof(msg.extra.note));
+  EXPECT_EQ(1, validate(stPaintObject, &msg, sizeof(msg)));
+  msg.kind = 0;
+  EXPECT_EQ(1, validate(stPaintObject, &msg, sizeof(msg)));
+  setByte(&msg.extra.flag, 1);
+  EXPECT_EQ(0, validate(stPaintObject, &msg, sizeof(msg)));
+  msg.kind = 2;
+  memset(msg.extra.note, 7, sizeof(msg.extra.note));
+  EXPECT_EQ(0, validate(stPaintObject, &msg, sizeof(msg)));
+}
+
+TEST(validate, decoded) {
+  stTests tests;
+  memset(&tests, 0, sizeof(tests));
+  strcpy(tests.name, "tests");
+  tests.fuzzNum = 3;
+  EXPECT_EQ(0, validate(stTestsObject, &tests, sizeof(tests)));
+
+  memset(tests.fuzz[2].name, 'f', sizeof(tests.fuzz[2].name));
+  EXPECT_EQ(1, validate(stTestsObject, &tests, sizeof(tests)));
+  tests.fuzzNum = 2;
+  EXPECT_EQ(0, validate(stTestsObject, &tests, sizeof(tests)));
+  tests.fuzzNum = 21;
+  EXPECT_EQ(1, validate(stTestsObject, &tests, sizeof(tests)));
+
+  // a client sending a count past the capacity
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.num = 11;
+  EXPECT_EQ(1, validate(stUseItemRspObject, &rsp, sizeof(rsp)));
+  rsp.num = 10;
+  EXPECT_EQ(0, validate(stUseItemRspObject, &rsp, sizeof(rsp)));
+
+  stNumbers numbers;
+  memset(&numbers, 0, sizeof(numbers));
+  setByte(&numbers.b, 2);
+  EXPECT_EQ(1, validate(stNumbersObject, &numbers, sizeof(numbers)));
+}
+
+TEST(validate, batch) {
+  // spaced further apart than the struct
+  struct Slot {
+    stPaint msg;
+    uint64_t pad;
+  };
+  std::vector<Slot> slots(200);
+  std::vector<bool> bad(slots.size());
+  for (size_t i = 0; i < slots.size(); ++i) {
+    stPaint &msg = slots[i].msg;
+    msg = paint();
+    switch (i % 7) {
+    case 1:
+      msg.background = (stColor)(6 + i);
+      bad[i] = true;
+      break;
+    case 3:
+      msg.strokes[2].color = msg.strokes[3].color = stRED;
+      msg.strokesNum = (uint8_t)(4 + i % 5);
+      bad[i] = msg.strokesNum > 4;
+      break;
+    case 5:
+      msg.kind = 0;
+      setByte(&msg.extra.flag, (uint8_t)(i % 3));
+      bad[i] = i % 3 > 1;
+      break;
+    }
+  }
+
+  clValidator validator;
+  ASSERT_EQ(0, clValidatorInit(&validator, stPaintObject));
+
+  std::vector<uint64_t> mask((slots.size() + 63) / 64, ~0ull);
+  ptrdiff_t expected = 0;
+  for (bool b : bad) {
+    expected += b;
+  }
+  EXPECT_EQ(expected, clValidate(&validator, slots.data(), slots.size(),
+                                 sizeof(Slot), mask.data()));
+  for (size_t i = 0; i < slots.size(); ++i) {
+    EXPECT_EQ(bad[i], (mask[i / 64] >> (i % 64)) & 1) << i;
+  }
+  EXPECT_EQ(0u, mask.back() >> (slots.size() % 64));
+
+  EXPECT_EQ(0, clValidate(&validator, slots.data(), 0, sizeof(Slot),
+                          mask.data()));
+  clValidatorFree(&validator);
+
+  EXPECT_EQ(cl_ERR_TYPE,
+            clValidatorInit(&validator, stPaintObject->via_object.columns));
+}
+
+TEST(validate, fixedBools) {
+  // the padding after the int8_t tp of a fixed array is not read as tp
+  struct flags {
+    bool on[4];
+  };
+  clColumn array;
+  memset(&array, 0xff, sizeof(array));
+  array.tp = cl_FIXED_ARRAY;
+  array.name.string = "on";
+  array.name.len = 2;
+  array.size = sizeof(bool[4]);
+  array.align = 1;
+  array.offset = 0;
+  array.via_fixed_array.tp = cl_BOOL;
+  array.via_fixed_array.capacity = 4;
+  array.via_fixed_array.columns = nullptr;
+
+  clColumn object;
+  memset(&object, 0, sizeof(object));
+  object.tp = cl_OBJECT;
+  object.name.string = "flags";
+  object.name.len = 5;
+  object.size = sizeof(flags);
+  object.align = 1;
+  object.via_object.num = 1;
+  object.via_object.columns = &array;
+
+  flags msg = {{true, false, true, false}};
+  EXPECT_EQ(0, validate(&object, &msg, sizeof(msg)));
+  setByte(&msg.on[3], 2);
+  EXPECT_EQ(1, validate(&object, &msg, sizeof(msg)));
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+
+#include <columns.h>
+#include <cstring>
+#include <string>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+static std::string joined(const clGather &gather) {
+  std::string s;
+  for (int i = 0; i < gather.num; ++i) {
+    s.append((const char *)gather.iov[i].iov_base, gather.iov[i].iov_len);
+  }
+  return s;
+}
+
+static std::string encoded(const clColumn *column, int wire, const void *src) {
+  std::string s(clEncodeSizeEx(column, wire, src), '\0');
+  EXPECT_EQ((ptrdiff_t)s.size(),
+            clEncodeEx(column, wire, src, &s[0], s.size()));
+  return s;
+}
+
+static stUseItemRsp rsp(uint32_t num) {
+  stUseItemRsp msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.code = 7;
+  msg.num = num;
+  for (uint32_t i = 0; i < num; ++i) {
+    msg.drops[i].itemID = 100 + i;
+    msg.drops[i].itemNum = i;
+  }
+  return msg;
+}
+
+TEST(gather, inPlace) {
+  struct iovec iov[8];
+  uint8_t arena[256];
+  clGather gather;
+  clGatherInit(&gather, iov, 8, arena, sizeof(arena));
+
+  // code, num and the live drops are one run of the struct
+  stUseItemRsp big = rsp(10);
+  ASSERT_EQ(88,
+            clGatherEncode(&gather, stUseItemRspObject, cl_WIRE_RAW, &big));
+  ASSERT_EQ(1, gather.num);
+  EXPECT_EQ((void *)&big, iov[0].iov_base);
+  EXPECT_EQ(0u, gather.used);
+
+  // short runs are copied, next to the frame header
+  uint32_t header = 24;
+  stUseItemRsp small = rsp(2);
+  ASSERT_EQ(0, clGatherBytes(&gather, &header, sizeof(header)));
+  ASSERT_EQ(24, clGatherEncode(&gather, stUseItemRspObject, cl_WIRE_RAW,
+                               &small));
+  ASSERT_EQ(2, gather.num);
+  EXPECT_EQ((void *)arena, iov[1].iov_base);
+  EXPECT_EQ(28u, gather.used);
+  EXPECT_EQ(88u + 28u, gather.bytes);
+
+  std::string expected = encoded(stUseItemRspObject, cl_WIRE_RAW, &big) +
+                         std::string((const char *)&header, sizeof(header)) +
+                         encoded(stUseItemRspObject, cl_WIRE_RAW, &small);
+  EXPECT_EQ(expected, joined(gather));
+
+  clGatherReset(&gather);
+  EXPECT_EQ(0, gather.num);
+  EXPECT_EQ(0u, gather.bytes);
+}
+
+TEST(gather, mixed) {
+  stTests tests;
+  memset(&tests, 0, sizeof(tests));
+  strcpy(tests.name, "a name long enough to be referenced");
+  tests.fuzzNum = 3;
+  for (int i = 0; i < 3; ++i) {
+    snprintf(tests.fuzz[i].name, sizeof(tests.fuzz[i].name), "fuzz%d", i);
+    tests.fuzz[i].tag = i;
+  }
+  stNumbers numbers;
+  memset(&numbers, 0, sizeof(numbers));
+  numbers.i64 = -1;
+  numbers.u16 = 300;
+  stUseItemRsp drops = rsp(9);
+
+  const clColumn *const columns[] = {stTestsObject, stNumbersObject,
+                                     stUseItemRspObject, stTestsObject};
+  const void *const msgs[] = {&tests, &numbers, &drops, &tests};
+
+  const int wires[] = {cl_WIRE_RAW, cl_WIRE_COMPACT};
+  for (int wire : wires) {
+    std::vector<struct iovec> iov(64);
+    std::vector<uint8_t> arena(4096);
+    clGather gather;
+    clGatherInit(&gather, iov.data(), (int)iov.size(), arena.data(),
+                 arena.size());
+    ASSERT_EQ(4, clGatherEncodeAll(&gather, columns, wire, msgs, 4));
+
+    std::string expected;
+    for (int i = 0; i < 4; ++i) {
+      expected += encoded(columns[i], wire, msgs[i]);
+    }
+    EXPECT_EQ(expected.size(), gather.bytes);
+    EXPECT_EQ(expected, joined(gather));
+
+    // only the drops, 80 bytes of cl_WIRE_RAW, are referenced
+    EXPECT_EQ(expected.size() - (wire == cl_WIRE_RAW ? 80 : 0), gather.used);
+
+    // straight to writev()
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ((ssize_t)gather.bytes, writev(fds[1], gather.iov, gather.num));
+    std::string read_back(gather.bytes, '\0');
+    ASSERT_EQ((ssize_t)gather.bytes,
+              read(fds[0], &read_back[0], read_back.size()));
+    close(fds[0]);
+    close(fds[1]);
+    EXPECT_EQ(expected, read_back);
+  }
+}
+
+TEST(gather, full) {
+  stTests tests;
+  memset(&tests, 0, sizeof(tests));
+  tests.fuzzNum = 20;
+  stUseItemRsp drops = rsp(10);
+
+  struct iovec iov[2];
+  uint8_t arena[64];
+  clGather gather;
+  clGatherInit(&gather, iov, 2, arena, sizeof(arena));
+  ASSERT_EQ(0, clGatherBytes(&gather, "hdr", 3));
+
+  // too large for the arena, nothing is kept
+  EXPECT_EQ(cl_ERR_BUFFER,
+            clGatherEncode(&gather, stTestsObject, cl_WIRE_RAW, &tests));
+  EXPECT_EQ(1, gather.num);
+  EXPECT_EQ(3u, gather.used);
+  EXPECT_EQ(3u, gather.bytes);
+  EXPECT_EQ(3u, iov[0].iov_len);
+
+  // fills both iovecs, the third message does not fit
+  const clColumn *const columns[] = {stUseItemRspObject, stUseItemRspObject,
+                                     stUseItemRspObject};
+  const void *const msgs[] = {&drops, &drops, &drops};
+  EXPECT_EQ(1, clGatherEncodeAll(&gather, columns, cl_WIRE_RAW, msgs, 3));
+  EXPECT_EQ(2, gather.num);
+  EXPECT_EQ(3u + 88u, gather.bytes);
+
+  tests.fuzzNum = 21;
+  clGatherReset(&gather);
+  EXPECT_EQ(cl_ERR_CAPACITY,
+            clGatherEncode(&gather, stTestsObject, cl_WIRE_RAW, &tests));
+  EXPECT_EQ(0, gather.num);
+}
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <columns.h>
+#include <cstring>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+static_assert(cl_WIRE_PORTABLE == cl_WIRE_RAW, "no swap on little-endian");
+#endif
+
+static std::string encoded(const clColumn *column, int wire, const void *src) {
+  std::string s(clEncodeSizeEx(column, wire, src), '\0');
+  EXPECT_EQ((ptrdiff_t)s.size(),
+            clEncodeEx(column, wire, src, &s[0], s.size()));
+  return s;
+}
+
+// The cl_WIRE_RAW bytes of numbers of WIDTHS back to back, each reversed.
+static std::string reversed(std::string raw, const std::vector<int> &widths) {
+  size_t pos = 0;
+  for (int width : widths) {
+    std::reverse(raw.begin() + pos, raw.begin() + pos + width);
+    pos += width;
+  }
+  EXPECT_EQ(raw.size(), pos);
+  return raw;
+}
+
+template <class T>
+static void expectRoundTrip(const clColumn *column, const T &msg) {
+  std::string buf = encoded(column, cl_WIRE_SWAPPED, &msg);
+  EXPECT_EQ(encoded(column, cl_WIRE_RAW, &msg).size(), buf.size());
+
+  T out;
+  memset(&out, 0, sizeof(out));
+  ASSERT_EQ((ptrdiff_t)buf.size(),
+            clDecodeEx(column, cl_WIRE_SWAPPED, &out, buf.data(), buf.size()));
+  EXPECT_EQ(0, memcmp(&msg, &out, sizeof(T)));
+  EXPECT_EQ(cl_ERR_BUFFER, clDecodeEx(column, cl_WIRE_SWAPPED, &out,
+                                      buf.data(), buf.size() - 1));
+}
+
+TEST(swapped, numbers) {
+  stNumbers numbers;
+  memset(&numbers, 0, sizeof(numbers));
+  numbers.i8 = -2;
+  numbers.i16 = 0x0102;
+  numbers.i32 = -0x01020304;
+  numbers.i64 = 0x0102030405060708;
+  numbers.u8 = 9;
+  numbers.u16 = 0xa0b0;
+  numbers.u32 = 0xa0b0c0d0;
+  numbers.u64 = 0xa0b0c0d0e0f00010;
+  numbers.f32 = 1.5f;
+  numbers.f64 = -3.25;
+  numbers.b = true;
+
+  std::string raw = encoded(stNumbersObject, cl_WIRE_RAW, &numbers);
+  EXPECT_EQ(reversed(raw, {1, 2, 4, 8, 1, 2, 4, 8, 4, 8, 1}),
+            encoded(stNumbersObject, cl_WIRE_SWAPPED, &numbers));
+  expectRoundTrip(stNumbersObject, numbers);
+}
+
+TEST(swapped, arrays) {
+  // the drops go through the kernel as one run of 4-byte numbers
+  for (uint32_t num = 0; num <= 10; ++num) {
+    stUseItemRsp rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.code = 0x11223344;
+    rsp.num = num;
+    for (uint32_t i = 0; i < num; ++i) {
+      rsp.drops[i].itemID = 0x01000000 + i;
+      rsp.drops[i].itemNum = i << 8;
+    }
+
+    std::string raw = encoded(stUseItemRspObject, cl_WIRE_RAW, &rsp);
+    EXPECT_EQ(reversed(raw, std::vector<int>(2 + 2 * num, 4)),
+              encoded(stUseItemRspObject, cl_WIRE_SWAPPED, &rsp));
+    expectRoundTrip(stUseItemRspObject, rsp);
+  }
+
+  // other[2] of the selected member
+  stTagged tagged;
+  memset(&tagged, 0, sizeof(tagged));
+  tagged.kind = 1;
+  tagged.value.u32 = 0x01020304;
+  tagged.vkind = 4;
+  tagged.v.other[0] = 0x0102030405060708;
+  tagged.v.other[1] = 0x1112131415161718;
+
+  std::string raw = encoded(stTaggedObject, cl_WIRE_RAW, &tagged);
+  EXPECT_EQ(reversed(raw, {1, 4, 2, 8, 8}),
+            encoded(stTaggedObject, cl_WIRE_SWAPPED, &tagged));
+  expectRoundTrip(stTaggedObject, tagged);
+}
+
+TEST(swapped, tests) {
+  stTests tests;
+  memset(&tests, 0, sizeof(tests));
+  tests.epoch = 0x01020304;
+  strcpy(tests.name, "swapped");
+  tests.fuzzNum = 4;
+  for (int i = 0; i < 4; ++i) {
+    snprintf(tests.fuzz[i].name, sizeof(tests.fuzz[i].name), "fuzz%d", i);
+    tests.fuzz[i].tag = -i;
+    tests.fuzz[i].v.other[0] = 0x0102030405060708 * i;
+  }
+  tests.inlineUnion.tag = 3;
+  tests.inlineUnion.abc.u32 = 99;
+  expectRoundTrip(stTestsObject, tests);
+
+  // strings and untagged unions are bytes
+  std::string raw = encoded(stTestsObject, cl_WIRE_RAW, &tests);
+  std::string swapped = encoded(stTestsObject, cl_WIRE_SWAPPED, &tests);
+  EXPECT_EQ(raw.substr(4, 8), swapped.substr(4, 8));
+  EXPECT_EQ(raw.substr(raw.size() - 16), swapped.substr(swapped.size() - 16));
+  EXPECT_NE(raw, swapped);
+
+  stPaint paint;
+  memset(&paint, 0, sizeof(paint));
+  paint.background = stBLUE;
+  paint.strokesNum = 3;
+  paint.strokes[2].color = stGREEN;
+  paint.kind = 1;
+  strcpy(paint.extra.note, "note");
+  expectRoundTrip(stPaintObject, paint);
+}
+
+TEST(swapped, gather) {
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.num = 10;
+  for (uint32_t i = 0; i < rsp.num; ++i) {
+    rsp.drops[i].itemID = i * 1000;
+  }
+
+  // swapped runs are copies, never the message itself
+  struct iovec iov[4];
+  uint8_t arena[256];
+  clGather gather;
+  clGatherInit(&gather, iov, 4, arena, sizeof(arena));
+  ASSERT_EQ(88, clGatherEncode(&gather, stUseItemRspObject, cl_WIRE_SWAPPED,
+                               &rsp));
+  ASSERT_EQ(1, gather.num);
+  EXPECT_EQ((void *)arena, iov[0].iov_base);
+  EXPECT_EQ(encoded(stUseItemRspObject, cl_WIRE_SWAPPED, &rsp),
+            std::string((const char *)arena, 88));
+}
@@ -0,0 +1,331 @@
+#include <gtest/gtest.h>
+
+#include <columns.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+static const int kWires[] = {cl_WIRE_RAW, cl_WIRE_COMPACT, cl_WIRE_SWAPPED};
+
+static std::string encoded(const clColumn *column, int wire, const void *src) {
+  std::string s(clEncodeSizeEx(column, wire, src), '\0');
+  EXPECT_EQ((ptrdiff_t)s.size(),
+            clEncodeEx(column, wire, src, &s[0], s.size()));
+  return s;
+}
+
+static stTests tests(uint32_t fuzzNum) {
+  stTests msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.epoch = 0x01020304;
+  strcpy(msg.name, "projection");
+  msg.fuzzNum = fuzzNum;
+  for (uint32_t i = 0; i < fuzzNum; ++i) {
+    snprintf(msg.fuzz[i].name, sizeof(msg.fuzz[i].name), "fuzz%u", i);
+    msg.fuzz[i].tag = -(int)i * 1000;
+    msg.fuzz[i].v.other[1] = i;
+  }
+  msg.inlineUnion.tag = 7;
+  msg.inlineUnion.abc.u32 = 99;
+  return msg;
+}
+
+TEST(projection, leaves) {
+  for (int wire : kWires) {
+    stTests msg = tests(5);
+    std::string buf = encoded(stTestsObject, wire, &msg);
+
+    const char *const paths[] = {"epoch", "fuzz[*].tag"};
+    clProjection projection;
+    ASSERT_EQ(0, clProjectionInit(&projection, stTestsObject, wire, paths, 2));
+
+    stTests out;
+    memset(&out, 0, sizeof(out));
+    ptrdiff_t n = clProjectionDecode(&projection, &out, buf.data(), buf.size());
+    ASSERT_GT(n, 0);
+    EXPECT_LT((size_t)n, buf.size());
+
+    // the length field comes along, names and values do not
+    EXPECT_EQ(msg.epoch, out.epoch);
+    EXPECT_EQ(5u, out.fuzzNum);
+    for (int i = 0; i < 5; ++i) {
+      EXPECT_EQ(msg.fuzz[i].tag, out.fuzz[i].tag);
+      EXPECT_EQ('\0', out.fuzz[i].name[0]);
+      EXPECT_EQ(0u, out.fuzz[i].v.other[1]);
+    }
+    EXPECT_EQ('\0', out.name[0]);
+    EXPECT_EQ(0, out.inlineUnion.tag);
+
+    // nothing past the last element is read
+    std::string tail = encoded(stInlineUnionObject, wire, &msg.inlineUnion);
+    EXPECT_EQ(buf.size() - tail.size(), (size_t)n);
+    EXPECT_EQ(n, clProjectionDecode(&projection, &out, buf.data(), (size_t)n));
+    EXPECT_EQ(cl_ERR_BUFFER,
+              clProjectionDecode(&projection, &out, buf.data(), n - 1));
+
+    clProjectionFree(&projection);
+  }
+}
+
+TEST(projection, subtrees) {
+  for (int wire : kWires) {
+    stTests msg = tests(3);
+    std::string buf = encoded(stTestsObject, wire, &msg);
+
+    const char *const paths[] = {"name", "fuzz[*]", "inlineUnion.abc"};
+    clProjection projection;
+    ASSERT_EQ(0, clProjectionInit(&projection, stTestsObject, wire, paths, 3));
+
+    stTests out;
+    memset(&out, 0, sizeof(out));
+    EXPECT_EQ((ptrdiff_t)buf.size(),
+              clProjectionDecode(&projection, &out, buf.data(), buf.size()));
+    EXPECT_EQ(0u, out.epoch);
+    EXPECT_STREQ(msg.name, out.name);
+    EXPECT_EQ(0, memcmp(msg.fuzz, out.fuzz, sizeof(msg.fuzz)));
+    EXPECT_EQ(0, out.inlineUnion.tag);
+    EXPECT_EQ(99u, out.inlineUnion.abc.u32);
+    clProjectionFree(&projection);
+  }
+
+  // the drops of cl_WIRE_RAW are one copy
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.code = 3;
+  rsp.num = 4;
+  for (uint32_t i = 0; i < rsp.num; ++i) {
+    rsp.drops[i].itemID = 10 + i;
+    rsp.drops[i].itemNum = i;
+  }
+  for (int wire : kWires) {
+    std::string buf = encoded(stUseItemRspObject, wire, &rsp);
+    const char *const paths[] = {"drops"};
+    clProjection projection;
+    ASSERT_EQ(0, clProjectionInit(&projection, stUseItemRspObject, wire,
+                                  paths, 1));
+    stUseItemRsp out;
+    memset(&out, 0, sizeof(out));
+    EXPECT_EQ((ptrdiff_t)buf.size(),
+              clProjectionDecode(&projection, &out, buf.data(), buf.size()));
+    EXPECT_EQ(0u, out.code);
+    EXPECT_EQ(4u, out.num);
+    EXPECT_EQ(0, memcmp(rsp.drops, out.drops, sizeof(rsp.drops)));
+    clProjectionFree(&projection);
+  }
+}
+
+TEST(projection, tagged) {
+  stTagged msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.kind = 1;
+  msg.value.u32 = 0xdeadbeef;
+  msg.vkind = 4;
+  msg.v.other[0] = 1;
+  msg.v.other[1] = 2;
+
+  const char *const paths[] = {"value.u32", "v"};
+  for (int wire : kWires) {
+    clProjection projection;
+    ASSERT_EQ(0,
+              clProjectionInit(&projection, stTaggedObject, wire, paths, 2));
+
+    msg.kind = 1;
+    msg.value.u32 = 0xdeadbeef;
+    std::string buf = encoded(stTaggedObject, wire, &msg);
+    stTagged out;
+    memset(&out, 0, sizeof(out));
+    EXPECT_EQ((ptrdiff_t)buf.size(),
+              clProjectionDecode(&projection, &out, buf.data(), buf.size()));
+    EXPECT_EQ(1, out.kind);
+    EXPECT_EQ(0xdeadbeef, out.value.u32);
+    EXPECT_EQ(4, out.vkind);
+    EXPECT_EQ(2u, out.v.other[1]);
+
+    // another member is skipped by its own length
+    msg.kind = 2;
+    strcpy(msg.value.text, "text");
+    buf = encoded(stTaggedObject, wire, &msg);
+    memset(&out, 0, sizeof(out));
+    EXPECT_EQ((ptrdiff_t)buf.size(),
+              clProjectionDecode(&projection, &out, buf.data(), buf.size()));
+    EXPECT_EQ(2, out.kind);
+    EXPECT_EQ('\0', out.value.text[0]);
+    EXPECT_EQ(2u, out.v.other[1]);
+    clProjectionFree(&projection);
+  }
+
+  // a flexible array of structs of enums
+  stPaint paint;
+  memset(&paint, 0, sizeof(paint));
+  paint.strokesNum = 3;
+  paint.strokes[1].color = stGREEN;
+  paint.strokes[2].dashed = true;
+  strcpy(paint.label, "label");
+  for (int wire : kWires) {
+    const char *const colors[] = {"strokes[*].color"};
+    clProjection projection;
+    ASSERT_EQ(0,
+              clProjectionInit(&projection, stPaintObject, wire, colors, 1));
+    std::string buf = encoded(stPaintObject, wire, &paint);
+    stPaint out;
+    memset(&out, 0, sizeof(out));
+    ASSERT_GT(clProjectionDecode(&projection, &out, buf.data(), buf.size()),
+              0);
+    EXPECT_EQ(3, out.strokesNum);
+    EXPECT_EQ(stGREEN, out.strokes[1].color);
+    EXPECT_FALSE(out.strokes[2].dashed);
+    EXPECT_EQ('\0', out.label[0]);
+    clProjectionFree(&projection);
+  }
+}
+
+TEST(projection, errors) {
+  clProjection projection;
+  const char *const bad[] = {"nope",          "fuzz.tag", "fuzz[3].tag",
+                             "epoch.",        "",         "fuzz[*].nope",
+                             "inlineUnion.x", "name[*]x"};
+  for (const char *path : bad) {
+    EXPECT_EQ(cl_ERR_VALUE, clProjectionInit(&projection, stTestsObject,
+                                             cl_WIRE_RAW, &path, 1))
+        << path;
+  }
+
+  const char *const epoch[] = {"epoch"};
+  EXPECT_EQ(cl_ERR_VALUE,
+            clProjectionInit(&projection, stTestsObject, 9, epoch, 1));
+  EXPECT_EQ(cl_ERR_TYPE,
+            clProjectionInit(&projection, &stTestsObject->via_object.columns[0],
+                             cl_WIRE_RAW, epoch, 1));
+
+  // nothing selected, nothing read
+  ASSERT_EQ(0, clProjectionInit(&projection, stTestsObject, cl_WIRE_RAW,
+                                nullptr, 0));
+  EXPECT_EQ(0, clProjectionDecode(&projection, nullptr, "", 0));
+  clProjectionFree(&projection);
+
+  // a count past the capacity, even for fields that are not selected
+  stTests msg = tests(20);
+  std::string buf = encoded(stTestsObject, cl_WIRE_RAW, &msg);
+  uint32_t fuzzNum = 21;
+  memcpy(&buf[4 + strlen(msg.name) + 1], &fuzzNum, sizeof(fuzzNum));
+  const char *const union_tag[] = {"inlineUnion.tag"};
+  ASSERT_EQ(0, clProjectionInit(&projection, stTestsObject, cl_WIRE_RAW,
+                                union_tag, 1));
+  stTests out;
+  EXPECT_EQ(cl_ERR_CAPACITY,
+            clProjectionDecode(&projection, &out, buf.data(), buf.size()));
+  clProjectionFree(&projection);
+}
+
+TEST(projection, batch) {
+  clBatch batch;
+  ASSERT_EQ(0, clBatchInit(&batch, stTestsObject));
+
+  const char *const paths[] = {"epoch", "fuzz[*].tag"};
+  for (int wire : kWires) {
+    clProjection projection;
+    ASSERT_EQ(0, clProjectionInit(&projection, stTestsObject, wire, paths, 2));
+
+    size_t first = batch.size;
+    for (uint32_t i = 0; i < 100; ++i) {
+      stTests msg = tests(i % 21);
+      msg.epoch = i;
+      std::string buf = encoded(stTestsObject, wire, &msg);
+      ASSERT_GT(clProjectionAppend(&projection, &batch, buf.data(), buf.size()),
+                0);
+    }
+    ASSERT_EQ(first + 100, batch.size);
+
+    std::vector<stTests> rows(100);
+    ASSERT_EQ(0, clBatchGather(&batch, first, 100, rows.data(),
+                               sizeof(stTests)));
+    for (uint32_t i = 0; i < 100; ++i) {
+      stTests msg = tests(i % 21);
+      stTests expected;
+      memset(&expected, 0, sizeof(expected));
+      expected.epoch = i;
+      expected.fuzzNum = msg.fuzzNum;
+      for (uint32_t j = 0; j < msg.fuzzNum; ++j) {
+        expected.fuzz[j].tag = msg.fuzz[j].tag;
+      }
+      EXPECT_EQ(0, memcmp(&expected, &rows[i], sizeof(stTests))) << i;
+    }
+
+    clScalar sum;
+    ASSERT_EQ(0, clBatchSum(&batch, clBatchLeaf(&batch, "epoch", 5), &sum));
+    EXPECT_EQ((uint64_t)(first / 100 + 1) * 4950, sum.u64);
+    clProjectionFree(&projection);
+  }
+
+  clBatch other;
+  ASSERT_EQ(0, clBatchInit(&other, stNumbersObject));
+  clProjection projection;
+  ASSERT_EQ(0, clProjectionInit(&projection, stTestsObject, cl_WIRE_RAW,
+                                paths, 2));
+  EXPECT_EQ(cl_ERR_TYPE, clProjectionAppend(&projection, &other, "", 0));
+  clProjectionFree(&projection);
+  clBatchFree(&other);
+  clBatchFree(&batch);
+}
+
+TEST(projection, fixedNumbers) {
+  // the padding after the int8_t tp of a fixed array is not read as tp
+  struct numbers {
+    uint32_t a[4];
+    uint32_t b;
+  };
+  clColumn fields[2];
+  memset(fields, 0xff, sizeof(fields));
+  fields[0].tp = cl_FIXED_ARRAY;
+  fields[0].name.string = "a";
+  fields[0].name.len = 1;
+  fields[0].size = sizeof(uint32_t[4]);
+  fields[0].align = alignof(uint32_t);
+  fields[0].offset = offsetof(numbers, a);
+  fields[0].via_fixed_array.tp = cl_UINT32;
+  fields[0].via_fixed_array.capacity = 4;
+  fields[0].via_fixed_array.columns = nullptr;
+  memset(&fields[1], 0, sizeof(fields[1]));
+  fields[1].tp = cl_UINT32;
+  fields[1].name.string = "b";
+  fields[1].name.len = 1;
+  fields[1].size = fields[1].align = sizeof(uint32_t);
+  fields[1].offset = offsetof(numbers, b);
+
+  clColumn object;
+  memset(&object, 0, sizeof(object));
+  object.tp = cl_OBJECT;
+  object.name.string = "numbers";
+  object.name.len = 7;
+  object.size = sizeof(numbers);
+  object.align = alignof(numbers);
+  object.via_object.num = 2;
+  object.via_object.columns = fields;
+
+  numbers msg = {{1, 300, 70000, 0x01020304}, 5};
+  for (int wire : kWires) {
+    std::string buf = encoded(&object, wire, &msg);
+    const char *const paths[] = {"b", "a"};
+    for (int i = 0; i < 2; ++i) {
+      clProjection projection;
+      ASSERT_EQ(0, clProjectionInit(&projection, &object, wire, paths + i, 1));
+      numbers out;
+      memset(&out, 0, sizeof(out));
+      // reading stops after the last selected field
+      size_t b = wire == cl_WIRE_COMPACT ? 1 : 4;
+      EXPECT_EQ((ptrdiff_t)(i == 0 ? buf.size() : buf.size() - b),
+                clProjectionDecode(&projection, &out, buf.data(), buf.size()))
+          << wire;
+      if (i == 0) {
+        EXPECT_EQ(5u, out.b) << wire;
+      } else {
+        EXPECT_EQ(0, memcmp(msg.a, out.a, sizeof(out.a))) << wire;
+      }
+      clProjectionFree(&projection);
+    }
+  }
+  clProgramCacheClear();
+}
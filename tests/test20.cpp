@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+
+#include <columns.h>
+#include <cstring>
+#include <sys/uio.h>
+#include <thread>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+// The summed counters of COLUMN, zeroes when it has none.
+static clStats snapshot(const clColumn *column) {
+  std::vector<clStats> all(64);
+  all.resize(clStatsSnapshot(all.data(), all.size()));
+
+  clStats stats;
+  memset(&stats, 0, sizeof(stats));
+  stats.column = column;
+  for (const clStats &s : all) {
+    if (s.column == column) {
+      stats = s;
+    }
+  }
+  return stats;
+}
+
+static stUseItemRsp rsp(uint32_t num) {
+  stUseItemRsp msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.code = 7;
+  msg.num = num;
+  for (uint32_t i = 0; i < num; ++i) {
+    msg.drops[i].itemID = i;
+  }
+  return msg;
+}
+
+TEST(stats, codec) {
+  clStatsReset();
+  stUseItemRsp msg = rsp(3);
+  char buf[256];
+  ptrdiff_t n = clEncode(stUseItemRspObject, &msg, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+  ASSERT_GT(clEncodeEx(stUseItemRspObject, cl_WIRE_COMPACT, &msg, buf,
+                       sizeof(buf)),
+            0);
+  EXPECT_EQ(cl_ERR_BUFFER, clEncode(stUseItemRspObject, &msg, buf, 1));
+
+  stUseItemRsp out;
+  ptrdiff_t m = clEncode(stUseItemRspObject, &msg, buf, sizeof(buf));
+  EXPECT_EQ(m, clDecode(stUseItemRspObject, &out, buf, m));
+  EXPECT_EQ(cl_ERR_BUFFER, clDecode(stUseItemRspObject, &out, buf, m - 1));
+
+  clStats stats = snapshot(stUseItemRspObject);
+  const clStatsOp &encode = stats.ops[cl_STATS_ENCODE];
+  EXPECT_EQ(4u, encode.calls);
+  EXPECT_EQ(1u, encode.errors);
+  EXPECT_EQ(3 * sizeof(stUseItemRsp), encode.bytes_in);
+
+  const clStatsOp &decode = stats.ops[cl_STATS_DECODE];
+  EXPECT_EQ(2u, decode.calls);
+  EXPECT_EQ(1u, decode.errors);
+  EXPECT_EQ((uint64_t)m, decode.bytes_in);
+  EXPECT_EQ(sizeof(stUseItemRsp), decode.bytes_out);
+
+  uint64_t timed = 0;
+  for (uint64_t count : encode.latency) {
+    timed += count;
+  }
+  EXPECT_EQ(encode.calls, timed);
+  EXPECT_EQ(0u, stats.ops[cl_STATS_DIFF].calls);
+}
+
+TEST(stats, encodedBytes) {
+  clStatsReset();
+  stUseItemRsp msg = rsp(5);
+  char buf[256];
+  ptrdiff_t raw = clEncode(stUseItemRspObject, &msg, buf, sizeof(buf));
+  ptrdiff_t compact = clEncodeEx(stUseItemRspObject, cl_WIRE_COMPACT, &msg,
+                                 buf, sizeof(buf));
+  ASSERT_GT(raw, 0);
+  ASSERT_GT(compact, 0);
+
+  clStats stats = snapshot(stUseItemRspObject);
+  EXPECT_EQ((uint64_t)(raw + compact), stats.ops[cl_STATS_ENCODE].bytes_out);
+}
+
+TEST(stats, diffAndGather) {
+  clStatsReset();
+  stUseItemRsp base = rsp(2);
+  stUseItemRsp cur = rsp(3);
+  char buf[256];
+  ptrdiff_t n = clDiff(stUseItemRspObject, &base, &cur, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+
+  struct iovec iov[4];
+  uint8_t arena[256];
+  clGather gather;
+  clGatherInit(&gather, iov, 4, arena, sizeof(arena));
+  ptrdiff_t m = clGatherEncode(&gather, stUseItemRspObject, cl_WIRE_RAW, &cur);
+  ASSERT_GT(m, 0);
+
+  clStats stats = snapshot(stUseItemRspObject);
+  EXPECT_EQ(1u, stats.ops[cl_STATS_DIFF].calls);
+  EXPECT_EQ((uint64_t)n, stats.ops[cl_STATS_DIFF].bytes_out);
+  EXPECT_EQ(1u, stats.ops[cl_STATS_ENCODE].calls);
+  EXPECT_EQ((uint64_t)m, stats.ops[cl_STATS_ENCODE].bytes_out);
+}
+
+TEST(stats, threads) {
+  clStatsReset();
+  const int kThreads = 8;
+  const int kCalls = 1000;
+
+  // every thread exits before the next starts, the later ones reuse shards
+  for (int round = 0; round < 2; ++round) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back([] {
+        stUseItemRsp msg = rsp(1);
+        char buf[256];
+        for (int i = 0; i < kCalls; ++i) {
+          clEncode(stUseItemRspObject, &msg, buf, sizeof(buf));
+        }
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+
+    clStats stats = snapshot(stUseItemRspObject);
+    EXPECT_EQ((uint64_t)(round + 1) * kThreads * kCalls,
+              stats.ops[cl_STATS_ENCODE].calls);
+  }
+}
+
+TEST(stats, mergeAndQuantile) {
+  clStatsOp op;
+  memset(&op, 0, sizeof(op));
+  EXPECT_EQ(0u, clStatsQuantile(&op, 0.5));
+
+  op.latency[3] = 90;
+  op.latency[10] = 9;
+  op.latency[cl_STATS_BUCKETS - 1] = 1;
+  EXPECT_EQ(16u, clStatsQuantile(&op, 0.0));
+  EXPECT_EQ(16u, clStatsQuantile(&op, 0.5));
+  EXPECT_EQ(2048u, clStatsQuantile(&op, 0.95));
+  EXPECT_EQ(UINT64_MAX, clStatsQuantile(&op, 1.0));
+
+  clStats a, b;
+  memset(&a, 0, sizeof(a));
+  memset(&b, 0, sizeof(b));
+  a.invalid = 1;
+  a.ops[cl_STATS_DECODE].calls = 2;
+  b.invalid = 3;
+  b.ops[cl_STATS_DECODE].calls = 4;
+  b.ops[cl_STATS_DECODE].latency[5] = 4;
+  clStatsMerge(&a, &b);
+  EXPECT_EQ(4u, a.invalid);
+  EXPECT_EQ(6u, a.ops[cl_STATS_DECODE].calls);
+  EXPECT_EQ(4u, a.ops[cl_STATS_DECODE].latency[5]);
+}
+
+TEST(stats, invalid) {
+  clStatsReset();
+  clValidator validator;
+  ASSERT_EQ(0, clValidatorInit(&validator, stUseItemRspObject));
+
+  std::vector<stUseItemRsp> msgs(10, rsp(2));
+  msgs[3].num = 100;
+  msgs[7].num = 100;
+  EXPECT_EQ(2, clValidate(&validator, msgs.data(), msgs.size(),
+                          sizeof(stUseItemRsp), nullptr));
+  EXPECT_EQ(2u, snapshot(stUseItemRspObject).invalid);
+  clValidatorFree(&validator);
+}
@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+
+#include <columns.h>
+#include <cstring>
+#include <string>
+#include <sys/uio.h>
+#include <thread>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+static std::string drain(clRing *ring) {
+  struct iovec iov[16];
+  std::string s;
+  int n;
+  while ((n = clRingPeek(ring, iov, 16)) > 0) {
+    for (int i = 0; i < n; ++i) {
+      s.append((const char *)iov[i].iov_base, iov[i].iov_len);
+      s += '|';
+    }
+    clRingRelease(ring, n);
+  }
+  return s;
+}
+
+static void put(clRing *ring, const std::string &msg) {
+  void *slot;
+  ASSERT_EQ(0, clRingReserve(ring, msg.size(), &slot));
+  memcpy(slot, msg.data(), msg.size());
+  clRingCommit(ring, slot, msg.size());
+}
+
+TEST(ring, order) {
+  clRing ring;
+  ASSERT_EQ(0, clRingInit(&ring, 100));
+  EXPECT_EQ(128u, ring.size);
+  EXPECT_EQ(0, (uintptr_t)ring.data % 64);
+
+  // nothing is visible before its commit, nor anything after it
+  void *a, *b;
+  ASSERT_EQ(0, clRingReserve(&ring, 3, &a));
+  ASSERT_EQ(0, clRingReserve(&ring, 5, &b));
+  memcpy(b, "bbbbb", 5);
+  clRingCommit(&ring, b, 5);
+  struct iovec iov[4];
+  EXPECT_EQ(0, clRingPeek(&ring, iov, 4));
+  memcpy(a, "aaa", 3);
+  clRingCommit(&ring, a, 2);
+  EXPECT_EQ(2, clRingPeek(&ring, iov, 4));
+  EXPECT_EQ(1, clRingPeek(&ring, iov, 1));
+  EXPECT_EQ("aa|bbbbb|", drain(&ring));
+  EXPECT_EQ(0, clRingPeek(&ring, iov, 4));
+
+  // dropped slots are skipped
+  ASSERT_EQ(0, clRingReserve(&ring, 8, &a));
+  clRingCommit(&ring, a, 0);
+  put(&ring, "c");
+  EXPECT_EQ("c|", drain(&ring));
+
+  // releasing more than was committed stops at the first uncommitted record
+  put(&ring, "d");
+  clRingRelease(&ring, 5);
+  EXPECT_EQ(0, clRingPeek(&ring, iov, 4));
+  put(&ring, "e");
+  ASSERT_EQ(0, clRingReserve(&ring, 2, &a));
+  put(&ring, "f");
+  clRingRelease(&ring, 3);
+  EXPECT_EQ(0, clRingPeek(&ring, iov, 4));
+  memcpy(a, "gg", 2);
+  clRingCommit(&ring, a, 2);
+  EXPECT_EQ("gg|f|", drain(&ring));
+  clRingFree(&ring);
+}
+
+TEST(ring, wrap) {
+  clRing ring;
+  ASSERT_EQ(0, clRingInit(&ring, 128));
+
+  // records of 24 bytes against 128: the buffer end moves around
+  for (int i = 0; i < 100; ++i) {
+    std::string msg(10, (char)('a' + i % 26));
+    put(&ring, msg);
+    put(&ring, msg + msg);
+    EXPECT_EQ(msg + "|" + msg + msg + "|", drain(&ring)) << i;
+  }
+  EXPECT_EQ(ring.head, ring.tail);
+  clRingFree(&ring);
+}
+
+TEST(ring, full) {
+  clRing ring;
+  ASSERT_EQ(0, clRingInit(&ring, 128));
+  void *slot;
+  EXPECT_EQ(cl_ERR_CAPACITY, clRingReserve(&ring, 65, &slot));
+
+  // 8 records of 16 bytes fill it up
+  for (int i = 0; i < 8; ++i) {
+    put(&ring, std::string(1, (char)('0' + i)));
+  }
+  EXPECT_EQ(cl_ERR_BUFFER, clRingReserve(&ring, 1, &slot));
+
+  struct iovec iov[8];
+  ASSERT_EQ(8, clRingPeek(&ring, iov, 8));
+  clRingRelease(&ring, 3);
+  EXPECT_EQ('3', *(const char *)iov[3].iov_base);
+  ASSERT_EQ(0, clRingReserve(&ring, 40, &slot));
+  clRingCommit(&ring, slot, 40);
+  EXPECT_EQ(cl_ERR_BUFFER, clRingReserve(&ring, 1, &slot));
+  EXPECT_EQ(6, clRingPeek(&ring, iov, 8));
+  clRingFree(&ring);
+
+  EXPECT_EQ(cl_ERR_VALUE, clRingInit(&ring, 0));
+}
+
+TEST(ring, encode) {
+  clRing ring;
+  ASSERT_EQ(0, clRingInit(&ring, 4096));
+
+  std::vector<stUseItemRsp> rsps(50);
+  std::vector<const clColumn *> columns(rsps.size(), stUseItemRspObject);
+  std::vector<const void *> msgs;
+  for (size_t i = 0; i < rsps.size(); ++i) {
+    memset(&rsps[i], 0, sizeof(rsps[i]));
+    rsps[i].code = (uint32_t)i;
+    rsps[i].num = (uint32_t)(i % 11);
+    msgs.push_back(&rsps[i]);
+  }
+
+  ASSERT_GT(clRingEncode(&ring, stUseItemRspObject, cl_WIRE_COMPACT, msgs[0]),
+            0);
+  EXPECT_EQ(49, clRingEncodeAll(&ring, columns.data(), cl_WIRE_COMPACT,
+                                msgs.data() + 1, 49));
+
+  struct iovec iov[64];
+  ASSERT_EQ(50, clRingPeek(&ring, iov, 64));
+  for (int i = 0; i < 50; ++i) {
+    stUseItemRsp out;
+    memset(&out, 0, sizeof(out));
+    EXPECT_EQ((ptrdiff_t)iov[i].iov_len,
+              clDecodeEx(stUseItemRspObject, cl_WIRE_COMPACT, &out,
+                         iov[i].iov_base, iov[i].iov_len));
+    EXPECT_EQ(0, memcmp(&rsps[i], &out, sizeof(out))) << i;
+  }
+  clRingRelease(&ring, 50);
+
+  // as many as fit, then the error of the first one
+  clRingFree(&ring);
+  ASSERT_EQ(0, clRingInit(&ring, 256));
+  ptrdiff_t n = clRingEncodeAll(&ring, columns.data(), cl_WIRE_RAW,
+                                msgs.data(), 50);
+  EXPECT_GT(n, 0);
+  EXPECT_LT(n, 50);
+  EXPECT_EQ(cl_ERR_BUFFER, clRingEncodeAll(&ring, columns.data(), cl_WIRE_RAW,
+                                           msgs.data() + n, 50 - n));
+  EXPECT_EQ(n, clRingPeek(&ring, iov, 64));
+  clRingFree(&ring);
+}
+
+TEST(ring, producers) {
+  clRing ring;
+  ASSERT_EQ(0, clRingInit(&ring, 1024));
+
+  const int kThreads = 4;
+  const uint32_t kMessages = 20000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&ring, t] {
+      for (uint32_t i = 0; i < kMessages;) {
+        // a header and a tail that spell the same message
+        uint32_t msg[2] = {(uint32_t)t << 24 | i, ~((uint32_t)t << 24 | i)};
+        size_t size = 8 + i % 3 * 4;
+        void *slot;
+        if (clRingReserve(&ring, size, &slot)) {
+          std::this_thread::yield();
+          continue;
+        }
+        memset(slot, 0, size);
+        memcpy(slot, msg, sizeof(msg));
+        clRingCommit(&ring, slot, size);
+        ++i;
+      }
+    });
+  }
+
+  // every producer in order
+  std::vector<uint32_t> next(kThreads, 0);
+  uint32_t total = 0;
+  bool ok = true;
+  while (total < kThreads * kMessages) {
+    struct iovec iov[32];
+    int n = clRingPeek(&ring, iov, 32);
+    if (!n) {
+      std::this_thread::yield();
+    }
+    for (int i = 0; i < n; ++i) {
+      uint32_t msg[2];
+      memcpy(msg, iov[i].iov_base, sizeof(msg));
+      uint32_t t = msg[0] >> 24;
+      uint32_t seq = msg[0] & 0xffffff;
+      if (t >= (uint32_t)kThreads) {
+        ok = false;
+        continue;
+      }
+      ok = ok && msg[1] == ~msg[0] && seq == next[t] &&
+           iov[i].iov_len == 8 + seq % 3 * 4;
+      next[t] = seq + 1;
+    }
+    clRingRelease(&ring, n);
+    total += (uint32_t)n;
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  EXPECT_TRUE(ok);
+  EXPECT_EQ(kThreads * kMessages, total);
+  EXPECT_EQ(ring.head, ring.tail);
+  clRingFree(&ring);
+}
@@ -0,0 +1,270 @@
+#include <gtest/gtest.h>
+
+#include <columns.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+static const int kWires[] = {cl_WIRE_RAW, cl_WIRE_COMPACT, cl_WIRE_SWAPPED};
+
+static stTests tests(uint32_t fuzzNum) {
+  stTests msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.epoch = 0x01020304;
+  strcpy(msg.name, "program");
+  msg.fuzzNum = fuzzNum;
+  for (uint32_t i = 0; i < fuzzNum; ++i) {
+    snprintf(msg.fuzz[i].name, sizeof(msg.fuzz[i].name), "fuzz%u", i);
+    msg.fuzz[i].tag = -(int)i * 1000;
+    msg.fuzz[i].v.other[0] = 0x0102030405060708 * i;
+  }
+  msg.inlineUnion.tag = 7;
+  msg.inlineUnion.abc.u32 = 99;
+  return msg;
+}
+
+template <class T>
+static void expectRoundTrip(const clProgram *program, const T &msg) {
+  std::string buf(clEncodeSizeEx(program->column, program->wire, &msg), '\0');
+  ASSERT_EQ((ptrdiff_t)buf.size(),
+            clProgramEncode(program, &msg, &buf[0], buf.size()));
+
+  T out;
+  memset(&out, 0, sizeof(out));
+  ASSERT_EQ((ptrdiff_t)buf.size(),
+            clProgramDecode(program, &out, buf.data(), buf.size()));
+  EXPECT_EQ(0, memcmp(&msg, &out, sizeof(T)));
+
+  // every truncation fails to encode, and never decodes past its end: a
+  // shorter prefix may still be a message of its own
+  for (size_t n = 0; n < buf.size(); ++n) {
+    EXPECT_EQ(cl_ERR_BUFFER, clProgramEncode(program, &msg, &buf[0], n));
+    EXPECT_GE((ptrdiff_t)n, clProgramDecode(program, &out, buf.data(), n))
+        << n;
+  }
+}
+
+TEST(program, ops) {
+  // the two counts are one copy, the drops one copy of NUM elements
+  clProgram program;
+  ASSERT_EQ(0, clProgramInit(&program, stUseItemRspObject, cl_WIRE_RAW));
+  EXPECT_EQ(3, program.num);
+  clProgramFree(&program);
+
+  // swapped as runs of 4-byte numbers
+  ASSERT_EQ(0, clProgramInit(&program, stUseItemRspObject, cl_WIRE_SWAPPED));
+  EXPECT_EQ(3, program.num);
+  clProgramFree(&program);
+
+  // every integer is a varint of its own
+  ASSERT_EQ(0, clProgramInit(&program, stUseItemRspObject, cl_WIRE_COMPACT));
+  EXPECT_EQ(5, program.num);
+  clProgramFree(&program);
+
+  ASSERT_EQ(0, clProgramInit(&program, stDropObject, cl_WIRE_RAW));
+  EXPECT_EQ(1, program.num);
+  clProgramFree(&program);
+
+  EXPECT_EQ(cl_ERR_TYPE,
+            clProgramInit(&program, &stTestsObject->via_object.columns[0],
+                          cl_WIRE_RAW));
+  EXPECT_EQ(cl_ERR_VALUE, clProgramInit(&program, stTestsObject, 9));
+}
+
+TEST(program, roundTrip) {
+  for (int wire : kWires) {
+    clProgram program;
+    ASSERT_EQ(0, clProgramInit(&program, stTestsObject, wire));
+    expectRoundTrip(&program, tests(0));
+    expectRoundTrip(&program, tests(3));
+    expectRoundTrip(&program, tests(20));
+    clProgramFree(&program);
+
+    ASSERT_EQ(0, clProgramInit(&program, stUseItemRspObject, wire));
+    stUseItemRsp rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.code = 0x11223344;
+    rsp.num = 10;
+    for (uint32_t i = 0; i < rsp.num; ++i) {
+      rsp.drops[i].itemID = 0x01000000 + i;
+      rsp.drops[i].itemNum = i << 8;
+    }
+    expectRoundTrip(&program, rsp);
+    rsp.num = 11;
+    char buf[256];
+    EXPECT_EQ(cl_ERR_CAPACITY,
+              clProgramEncode(&program, &rsp, buf, sizeof(buf)));
+    clProgramFree(&program);
+
+    ASSERT_EQ(0, clProgramInit(&program, stTaggedObject, wire));
+    stTagged tagged;
+    memset(&tagged, 0, sizeof(tagged));
+    tagged.vkind = 4;
+    tagged.v.other[1] = 2;
+    for (uint8_t kind : {0, 1, 2, 7, 9}) {
+      memset(&tagged.value, 0, sizeof(tagged.value));
+      tagged.kind = kind;
+      switch (kind) {
+      case 0:
+        tagged.value.u8 = 5;
+        break;
+      case 1:
+        tagged.value.u32 = 0x01020304;
+        break;
+      case 2:
+        strcpy(tagged.value.text, "text");
+        break;
+      case 7:
+        tagged.value.drop.itemNum = 6;
+        break;
+      }
+      expectRoundTrip(&program, tagged);
+    }
+    clProgramFree(&program);
+
+    ASSERT_EQ(0, clProgramInit(&program, stPaintObject, wire));
+    stPaint paint;
+    memset(&paint, 0, sizeof(paint));
+    paint.background = stBLUE;
+    paint.strokesNum = 3;
+    paint.strokes[2].color = stGREEN;
+    paint.kind = 1;
+    strcpy(paint.extra.note, "note");
+    expectRoundTrip(&program, paint);
+    clProgramFree(&program);
+  }
+}
+
+TEST(program, cache) {
+  const clProgram *a;
+  const clProgram *b;
+  ASSERT_EQ(0, clProgramFind(&a, stTestsObject, cl_WIRE_RAW));
+  ASSERT_EQ(0, clProgramFind(&b, stTestsObject, cl_WIRE_RAW));
+  EXPECT_EQ(a, b);
+  ASSERT_EQ(0, clProgramFind(&b, stTestsObject, cl_WIRE_COMPACT));
+  EXPECT_NE(a, b);
+  EXPECT_EQ(cl_WIRE_COMPACT, b->wire);
+  EXPECT_EQ(cl_ERR_TYPE,
+            clProgramFind(&b, &stTestsObject->via_object.columns[0],
+                          cl_WIRE_RAW));
+
+  clProgramCacheClear();
+  ASSERT_EQ(0, clProgramFind(&b, stTestsObject, cl_WIRE_RAW));
+  EXPECT_EQ(stTestsObject, b->column);
+}
+
+TEST(program, schemaRead) {
+  // a tree read at the address of a freed one gets a program of its own
+  std::vector<char> drop(clSchemaSize(stDropObject));
+  std::vector<char> rsp(clSchemaSize(stUseItemRspObject));
+  ASSERT_GT(clSchemaWrite(stDropObject, drop.data(), drop.size()), 0);
+  ASSERT_GT(clSchemaWrite(stUseItemRspObject, rsp.data(), rsp.size()), 0);
+
+  stUseItemRsp msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.code = 1;
+  msg.num = 2;
+  msg.drops[1].itemNum = 3;
+  char buf[128];
+  ptrdiff_t n = clEncode(stUseItemRspObject, &msg, buf, sizeof(buf));
+  ASSERT_EQ(24, n);
+
+  for (int i = 0; i < 10; ++i) {
+    const clColumn *column;
+    ASSERT_GT(clSchemaRead(&column, drop.data(), drop.size()), 0);
+    stDrop d;
+    EXPECT_EQ(8, clDecode(column, &d, buf, n));
+    free((void *)column);
+
+    ASSERT_GT(clSchemaRead(&column, rsp.data(), rsp.size()), 0);
+    stUseItemRsp out;
+    memset(&out, 0, sizeof(out));
+    EXPECT_EQ(n, clDecode(column, &out, buf, n));
+    EXPECT_EQ(0, memcmp(&msg, &out, sizeof(out)));
+    free((void *)column);
+  }
+}
+
+TEST(program, fixedNumbers) {
+  // the padding after the int8_t tp of a fixed array is not read as tp
+  struct numbers {
+    uint32_t a[4];
+  };
+  clColumn array;
+  memset(&array, 0xff, sizeof(array));
+  array.tp = cl_FIXED_ARRAY;
+  array.name.string = "a";
+  array.name.len = 1;
+  array.size = sizeof(uint32_t[4]);
+  array.align = alignof(uint32_t);
+  array.offset = 0;
+  array.via_fixed_array.tp = cl_UINT32;
+  array.via_fixed_array.capacity = 4;
+  array.via_fixed_array.columns = nullptr;
+
+  clColumn object;
+  memset(&object, 0, sizeof(object));
+  object.tp = cl_OBJECT;
+  object.name.string = "numbers";
+  object.name.len = 7;
+  object.size = sizeof(numbers);
+  object.align = alignof(numbers);
+  object.via_object.num = 1;
+  object.via_object.columns = &array;
+
+  numbers msg = {{1, 2, 3, 0x01020304}};
+  EXPECT_EQ(7, clEncodeSizeEx(&object, cl_WIRE_COMPACT, &msg));
+  EXPECT_EQ(16, clEncodeSizeEx(&object, cl_WIRE_SWAPPED, &msg));
+
+  for (int wire : kWires) {
+    const clProgram *program;
+    ASSERT_EQ(0, clProgramFind(&program, &object, wire));
+    expectRoundTrip(program, msg);
+  }
+
+  char buf[16];
+  ASSERT_EQ(16, clEncodeEx(&object, cl_WIRE_SWAPPED, &msg, buf, sizeof(buf)));
+  EXPECT_EQ(1, buf[3]);
+  EXPECT_EQ(4, buf[15]);
+  clProgramCacheClear();
+}
+
+TEST(program, rebuilt) {
+  // a descriptor rebuilt in place with another layout gets its own program
+  clColumn field;
+  memset(&field, 0, sizeof(field));
+  field.tp = cl_UINT8;
+  field.name.string = "v";
+  field.name.len = 1;
+  field.size = 1;
+  field.align = 1;
+
+  clColumn object;
+  memset(&object, 0, sizeof(object));
+  object.tp = cl_OBJECT;
+  object.name.string = "value";
+  object.name.len = 5;
+  object.size = 1;
+  object.align = 1;
+  object.via_object.num = 1;
+  object.via_object.columns = &field;
+
+  uint64_t v = 0x0102030405060708;
+  char buf[16];
+  EXPECT_EQ(1, clEncode(&object, &v, buf, sizeof(buf)));
+
+  field.tp = cl_UINT64;
+  field.size = object.size = object.align = field.align = 8;
+  ASSERT_EQ(8, clEncode(&object, &v, buf, sizeof(buf)));
+
+  field.tp = cl_UINT8;
+  field.size = object.size = object.align = field.align = 1;
+  uint64_t out = 0;
+  EXPECT_EQ(1, clDecode(&object, &out, buf, 8));
+  EXPECT_EQ(0, memcmp(&v, &out, 1));
+  clProgramCacheClear();
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <columns.h>
+#include <cstring>
+
+#include "messages.h"
+#include "messages_def.h"
+
+// Fills a message whose bytes outside its fields are FILL.
+static stPaint paint(uint8_t fill) {
+  stPaint msg;
+  memset(&msg, fill, sizeof(msg));
+  msg.background = stBLUE;
+  msg.visible = true;
+  msg.layers[0] = msg.layers[1] = msg.layers[2] = false;
+  strcpy(msg.label, "ab");
+  msg.strokesNum = 2;
+  for (int i = 0; i < 2; ++i) {
+    msg.strokes[i].color = stRED;
+    msg.strokes[i].dashed = i == 1;
+  }
+  msg.kind = 1;
+  strcpy(msg.extra.note, "n");
+  return msg;
+}
+
+template <class T>
+static void expectSame(const clColumn *column, const T &a, const T &b) {
+  uint64_t x, y;
+  ASSERT_EQ(0, clHash(&x, column, &a));
+  ASSERT_EQ(0, clHash(&y, column, &b));
+  EXPECT_EQ(x, y);
+  EXPECT_EQ(1, clEqual(column, &a, &b));
+}
+
+template <class T>
+static void expectDiffer(const clColumn *column, const T &a, const T &b) {
+  uint64_t x, y;
+  ASSERT_EQ(0, clHash(&x, column, &a));
+  ASSERT_EQ(0, clHash(&y, column, &b));
+  EXPECT_NE(x, y);
+  EXPECT_EQ(0, clEqual(column, &a, &b));
+}
+
+TEST(hash, padding) {
+  // padding, string tails, strokes past the count and the unselected bytes
+  // of the union all differ
+  stPaint a = paint(0x00);
+  stPaint b = paint(0xa5);
+  ASSERT_NE(0, memcmp(&a, &b, sizeof(a)));
+  expectSame(stPaintObject, a, b);
+
+  b.strokes[1].dashed = false;
+  expectDiffer(stPaintObject, a, b);
+  b = paint(0xa5);
+  b.label[1] = 'c';
+  expectDiffer(stPaintObject, a, b);
+  b = paint(0xa5);
+  b.strokesNum = 3;
+  expectDiffer(stPaintObject, a, b);
+  b = paint(0xa5);
+  b.kind = 0;
+  b.extra.flag = true;
+  expectDiffer(stPaintObject, a, b);
+}
+
+TEST(hash, arrays) {
+  stUseItemRsp a, b;
+  memset(&a, 0, sizeof(a));
+  memset(&b, 0xff, sizeof(b));
+  a.code = b.code = 7;
+  a.num = b.num = 4;
+  for (uint32_t i = 0; i < 4; ++i) {
+    a.drops[i].itemID = b.drops[i].itemID = i;
+    a.drops[i].itemNum = b.drops[i].itemNum = i * 3;
+  }
+  expectSame(stUseItemRspObject, a, b);
+  b.drops[3].itemNum = 0;
+  expectDiffer(stUseItemRspObject, a, b);
+
+  b.num = 11;
+  uint64_t h;
+  EXPECT_EQ(cl_ERR_CAPACITY, clHash(&h, stUseItemRspObject, &b));
+  EXPECT_EQ(cl_ERR_TYPE,
+            clHash(&h, &stUseItemRspObject->via_object.columns[0], &a));
+}
+
+TEST(hash, spans) {
+  // every length and position of a single differing byte
+  stTests a, b;
+  memset(&a, 0, sizeof(a));
+  a.fuzzNum = 20;
+  for (uint32_t i = 0; i < 20; ++i) {
+    memset(a.fuzz[i].name, 'x', i + 1);
+  }
+  memcpy(&b, &a, sizeof(a));
+  expectSame(stTestsObject, a, b);
+
+  for (uint32_t i = 0; i < 20; ++i) {
+    for (uint32_t k = 0; k <= i; ++k) {
+      b.fuzz[i].name[k] = 'y';
+      expectDiffer(stTestsObject, a, b);
+      b.fuzz[i].name[k] = 'x';
+    }
+  }
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <columns.h>
+#include <cstring>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+TEST(packed, sizes) {
+  // the fields without their padding, nested twins included
+  EXPECT_EQ(43u, sizeof(stNumbers_packed));
+  EXPECT_EQ(20u, sizeof(stInlineUnion_packed));
+  EXPECT_EQ(52u, sizeof(stFuzz_packed));
+  EXPECT_EQ(1100u, sizeof(stTests_packed));
+  EXPECT_EQ(5u, sizeof(stStroke_packed));
+  EXPECT_EQ(44u, sizeof(stPaint_packed));
+
+  // the widest fields first
+  EXPECT_EQ(0u, offsetof(stNumbers_packed, i64));
+  EXPECT_EQ(42u, offsetof(stNumbers_packed, b));
+}
+
+TEST(packed, numbers) {
+  stNumbers msg;
+  memset(&msg, 0xa5, sizeof(msg));
+  msg.i8 = -1;
+  msg.i16 = -300;
+  msg.i32 = 1 << 20;
+  msg.i64 = -(1LL << 40);
+  msg.u8 = 200;
+  msg.u16 = 60000;
+  msg.u32 = 4000000000u;
+  msg.u64 = 1ULL << 63;
+  msg.f32 = 1.5f;
+  msg.f64 = -2.25;
+  msg.b = true;
+
+  stNumbers_packed packed;
+  stNumbers_pack(&packed, &msg);
+  int64_t i64;
+  memcpy(&i64, &packed.i64, sizeof(i64));
+  EXPECT_EQ(msg.i64, i64);
+
+  // the padding comes back zeroed
+  stNumbers out;
+  memset(&out, 0xff, sizeof(out));
+  stNumbers_unpack(&out, &packed);
+  stNumbers expected;
+  memset(&expected, 0, sizeof(expected));
+  expected.i8 = msg.i8;
+  expected.i16 = msg.i16;
+  expected.i32 = msg.i32;
+  expected.i64 = msg.i64;
+  expected.u8 = msg.u8;
+  expected.u16 = msg.u16;
+  expected.u32 = msg.u32;
+  expected.u64 = msg.u64;
+  expected.f32 = msg.f32;
+  expected.f64 = msg.f64;
+  expected.b = msg.b;
+  EXPECT_EQ(0, memcmp(&expected, &out, sizeof(out)));
+}
+
+TEST(packed, nested) {
+  // a dense array of twins round trips every element
+  std::vector<stTests> msgs(3);
+  std::vector<stTests_packed> packed(msgs.size());
+  for (size_t i = 0; i < msgs.size(); ++i) {
+    stTests &msg = msgs[i];
+    memset(&msg, 0, sizeof(msg));
+    msg.epoch = (uint32_t)i;
+    snprintf(msg.name, sizeof(msg.name), "tests%zu", i);
+    msg.fuzzNum = 20;
+    for (uint32_t j = 0; j < msg.fuzzNum; ++j) {
+      snprintf(msg.fuzz[j].name, sizeof(msg.fuzz[j].name), "fuzz%u", j);
+      msg.fuzz[j].tag = (int)(i * 100 + j);
+      msg.fuzz[j].v.other[0] = 0x0102030405060708 * j;
+      msg.fuzz[j].v.other[1] = ~msg.fuzz[j].v.other[0];
+    }
+    msg.inlineUnion.tag = -7;
+    msg.inlineUnion.abc.other[1] = i;
+    stTests_pack(&packed[i], &msg);
+  }
+  EXPECT_EQ(3 * 1100u, packed.size() * sizeof(packed[0]));
+
+  for (size_t i = 0; i < msgs.size(); ++i) {
+    stTests out;
+    memset(&out, 0xff, sizeof(out));
+    stTests_unpack(&out, &packed[i]);
+    EXPECT_EQ(0, memcmp(&msgs[i], &out, sizeof(out))) << i;
+  }
+}
+
+TEST(packed, paint) {
+  stPaint msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.background = stBLUE;
+  msg.visible = true;
+  msg.layers[2] = true;
+  strcpy(msg.label, "label");
+  msg.strokesNum = 4;
+  for (int i = 0; i < 4; ++i) {
+    msg.strokes[i].color = i & 1 ? stRED : stGREEN;
+    msg.strokes[i].dashed = i == 3;
+  }
+  msg.kind = 1;
+  strcpy(msg.extra.note, "note");
+
+  stPaint_packed packed;
+  stPaint_pack(&packed, &msg);
+  stPaint out;
+  memset(&out, 0x5a, sizeof(out));
+  stPaint_unpack(&out, &packed);
+  EXPECT_EQ(0, memcmp(&msg, &out, sizeof(out)));
+  EXPECT_EQ(1, clEqual(stPaintObject, &msg, &out));
+}
@@ -0,0 +1,215 @@
+#include <columns.h>
+#include <cstring>
+#include <gtest/gtest.h>
+
+#include "messages.h"
+#include "messages_def.h"
+
+TEST(codec, flexible) {
+  stUseItemRsp rsp;
+  memset(&rsp, 0xcc, sizeof(rsp));
+  rsp.code = 7;
+  rsp.num = 2;
+  rsp.drops[0] = {100, 1};
+  rsp.drops[1] = {200, 2};
+
+  char buf[sizeof(rsp)];
+  ptrdiff_t n = clEncode(stUseItemRspObject, &rsp, buf, sizeof(buf));
+  EXPECT_EQ(8 + 2 * sizeof(stDrop), n);
+  EXPECT_EQ(n, clEncodeSize(stUseItemRspObject, &rsp));
+
+  stUseItemRsp out;
+  memset(&out, 0, sizeof(out));
+  EXPECT_EQ(n, clDecode(stUseItemRspObject, &out, buf, n));
+  EXPECT_EQ(7u, out.code);
+  EXPECT_EQ(2u, out.num);
+  EXPECT_EQ(200u, out.drops[1].itemID);
+  EXPECT_EQ(2u, out.drops[1].itemNum);
+  EXPECT_EQ(0u, out.drops[2].itemID);
+}
+
+TEST(codec, string) {
+  stTests tests;
+  memset(&tests, 0xcc, sizeof(tests));
+  tests.epoch = 1;
+  strcpy(tests.name, "abc");
+  tests.fuzzNum = 1;
+  strcpy(tests.fuzz[0].name, "");
+  tests.fuzz[0].tag = 3;
+  tests.fuzz[0].v.u32 = 42;
+  tests.inlineUnion.tag = 4;
+  tests.inlineUnion.abc.i32 = -1;
+
+  char buf[sizeof(tests)];
+  ptrdiff_t n = clEncode(stTestsObject, &tests, buf, sizeof(buf));
+  EXPECT_EQ(4 + 4 + 4 + (1 + 4 + 16) + (4 + 16), n);
+
+  stTests out;
+  memset(&out, 0, sizeof(out));
+  EXPECT_EQ(n, clDecode(stTestsObject, &out, buf, n));
+  EXPECT_STREQ("abc", out.name);
+  EXPECT_EQ(1u, out.fuzzNum);
+  EXPECT_STREQ("", out.fuzz[0].name);
+  EXPECT_EQ(42u, out.fuzz[0].v.u32);
+  EXPECT_EQ(-1, out.inlineUnion.abc.i32);
+
+  memset(tests.name, 'x', sizeof(tests.name));
+  n = clEncode(stTestsObject, &tests, buf, sizeof(buf));
+  EXPECT_EQ(4 + 32 + 4 + (1 + 4 + 16) + (4 + 16), n);
+  EXPECT_EQ(n, clDecode(stTestsObject, &out, buf, n));
+  EXPECT_EQ(0, memcmp(tests.name, out.name, sizeof(out.name)));
+}
+
+TEST(codec, errors) {
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.num = 11;
+
+  char buf[sizeof(rsp)];
+  EXPECT_EQ(cl_ERR_CAPACITY, clEncodeSize(stUseItemRspObject, &rsp));
+  EXPECT_EQ(cl_ERR_CAPACITY,
+            clEncode(stUseItemRspObject, &rsp, buf, sizeof(buf)));
+
+  rsp.num = 3;
+  EXPECT_EQ(cl_ERR_BUFFER, clEncode(stUseItemRspObject, &rsp, buf, 16));
+
+  ptrdiff_t n = clEncode(stUseItemRspObject, &rsp, buf, sizeof(buf));
+  for (ptrdiff_t i = 0; i < n; ++i) {
+    EXPECT_EQ(cl_ERR_BUFFER, clDecode(stUseItemRspObject, &rsp, buf, i));
+  }
+
+  stTests tests;
+  memset(&tests, 0, sizeof(tests));
+  strcpy(tests.name, "abc");
+  char tbuf[sizeof(tests)];
+  n = clEncode(stTestsObject, &tests, tbuf, sizeof(tbuf));
+  for (ptrdiff_t i = 0; i < n; ++i) {
+    EXPECT_EQ(cl_ERR_BUFFER, clDecode(stTestsObject, &tests, tbuf, i));
+  }
+}
+
+TEST(codec, generated) {
+  stTests tests;
+  memset(&tests, 0, sizeof(tests));
+  tests.epoch = 9;
+  strcpy(tests.name, "generated");
+  tests.fuzzNum = 3;
+  for (int i = 0; i < 3; ++i) {
+    tests.fuzz[i].name[0] = 'a' + i;
+    tests.fuzz[i].tag = i;
+    tests.fuzz[i].v.other[1] = i * 1000;
+  }
+  tests.inlineUnion.abc.u8 = 5;
+
+  char expected[sizeof(tests)];
+  char buf[sizeof(tests)];
+  ptrdiff_t n = clEncode(stTestsObject, &tests, expected, sizeof(expected));
+  EXPECT_EQ(n, stTests_encode(&tests, buf, sizeof(buf)));
+  EXPECT_EQ(0, memcmp(expected, buf, n));
+  EXPECT_EQ(cl_ERR_BUFFER, stTests_encode(&tests, buf, n - 1));
+
+  stTests out;
+  memset(&out, 0, sizeof(out));
+  EXPECT_EQ(n, stTests_decode(&out, buf, n));
+  EXPECT_EQ(0, memcmp(&tests, &out, sizeof(out)));
+  for (ptrdiff_t i = 0; i < n; ++i) {
+    EXPECT_EQ(cl_ERR_BUFFER, stTests_decode(&out, buf, i));
+  }
+
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.num = 11;
+  EXPECT_EQ(cl_ERR_CAPACITY, stUseItemRsp_encode(&rsp, buf, sizeof(buf)));
+
+  rsp.num = 4;
+  rsp.drops[3].itemNum = 3;
+  n = clEncode(stUseItemRspObject, &rsp, expected, sizeof(expected));
+  EXPECT_EQ(n, stUseItemRsp_encode(&rsp, buf, sizeof(buf)));
+  EXPECT_EQ(0, memcmp(expected, buf, n));
+}
+
+TEST(codec, compact) {
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.code = 1;
+  rsp.num = 2;
+  rsp.drops[0] = {100, 1};
+  rsp.drops[1] = {200, 2};
+
+  char buf[sizeof(rsp)];
+  ptrdiff_t n = clEncodeEx(stUseItemRspObject, cl_WIRE_COMPACT, &rsp, buf,
+                           sizeof(buf));
+  EXPECT_EQ(1 + 1 + (1 + 1) + (2 + 1), n);
+  EXPECT_EQ(n, clEncodeSizeEx(stUseItemRspObject, cl_WIRE_COMPACT, &rsp));
+
+  stUseItemRsp out;
+  memset(&out, 0, sizeof(out));
+  EXPECT_EQ(n, clDecodeEx(stUseItemRspObject, cl_WIRE_COMPACT, &out, buf, n));
+  EXPECT_EQ(0, memcmp(&rsp, &out, sizeof(out)));
+
+  stTests tests;
+  memset(&tests, 0xcc, sizeof(tests));
+  strcpy(tests.name, "compact");
+  tests.fuzzNum = 0;
+  tests.inlineUnion.tag = -2;
+
+  char tbuf[sizeof(tests)];
+  n = clEncodeEx(stTestsObject, cl_WIRE_COMPACT, &tests, tbuf, sizeof(tbuf));
+  ASSERT_GT(n, 0);
+
+  stTests tout;
+  memset(&tout, 0xcc, sizeof(tout));
+  EXPECT_EQ(n, clDecodeEx(stTestsObject, cl_WIRE_COMPACT, &tout, tbuf, n));
+  EXPECT_STREQ("compact", tout.name);
+  EXPECT_EQ(-2, tout.inlineUnion.tag);
+}
+
+TEST(codec, varint) {
+  stNumbers values[] = {
+      {0, 0, 0, 0, 0, 0, 0, 0, 0.0f, 0.0, false},
+      {-1, -1, -1, -1, 1, 1, 1, 1, 1.5f, -2.5, true},
+      {INT8_MIN, INT16_MIN, INT32_MIN, INT64_MIN, 127, 128, 16383, 16384,
+       0.0f, 0.0, false},
+      {INT8_MAX, INT16_MAX, INT32_MAX, INT64_MAX, UINT8_MAX, UINT16_MAX,
+       UINT32_MAX, UINT64_MAX, 0.0f, 0.0, true},
+      {0, 0, 0, (int64_t)1 << 55, 0, 0, 0, (uint64_t)1 << 56, 0.0f, 0.0,
+       false},
+  };
+
+  for (const stNumbers &in : values) {
+    char buf[64];
+    ptrdiff_t n =
+        clEncodeEx(stNumbersObject, cl_WIRE_COMPACT, &in, buf, sizeof(buf));
+    ASSERT_GT(n, 0);
+    EXPECT_EQ(n, clEncodeSizeEx(stNumbersObject, cl_WIRE_COMPACT, &in));
+
+    // exercise both the word-at-a-time and the bytewise paths
+    for (size_t slack = 0; slack < 10; ++slack) {
+      char exact[64 + 10];
+      memcpy(exact, buf, n);
+      stNumbers out;
+      memset(&out, 0, sizeof(out));
+      EXPECT_EQ(n, clDecodeEx(stNumbersObject, cl_WIRE_COMPACT, &out, exact,
+                              n + slack));
+      EXPECT_EQ(in.i16, out.i16);
+      EXPECT_EQ(in.i32, out.i32);
+      EXPECT_EQ(in.i64, out.i64);
+      EXPECT_EQ(in.u16, out.u16);
+      EXPECT_EQ(in.u32, out.u32);
+      EXPECT_EQ(in.u64, out.u64);
+      EXPECT_EQ(in.f64, out.f64);
+      EXPECT_EQ(in.b, out.b);
+    }
+
+    for (ptrdiff_t i = 0; i < n; ++i) {
+      EXPECT_EQ(cl_ERR_BUFFER,
+                clEncodeEx(stNumbersObject, cl_WIRE_COMPACT, &in, buf, i));
+    }
+  }
+
+  // u16 = 65536 does not fit
+  const unsigned char overflow[] = {0, 0, 0, 0, 0, 0x80, 0x80, 0x04};
+  stNumbers out;
+  EXPECT_EQ(cl_ERR_VALUE, clDecodeEx(stNumbersObject, cl_WIRE_COMPACT, &out,
+                                     overflow, sizeof(overflow)));
+}
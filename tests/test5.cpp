@@ -0,0 +1,100 @@
+#include <columns.h>
+#include <cstring>
+#include <gtest/gtest.h>
+
+#include "messages.h"
+#include "messages_def.h"
+
+static void fill(stTests &tests, uint32_t num) {
+  memset(&tests, 0, sizeof(tests));
+  tests.epoch = 1;
+  strcpy(tests.name, "delta");
+  tests.fuzzNum = num;
+  for (uint32_t i = 0; i < num; ++i) {
+    tests.fuzz[i].tag = i;
+    tests.fuzz[i].v.u32 = i * 10;
+  }
+}
+
+static void expectSame(const stTests &a, const stTests &b) {
+  char x[sizeof(a)], y[sizeof(b)];
+  ptrdiff_t n = clEncode(stTestsObject, &a, x, sizeof(x));
+  ASSERT_GT(n, 0);
+  ASSERT_EQ(n, clEncode(stTestsObject, &b, y, sizeof(y)));
+  EXPECT_EQ(0, memcmp(x, y, n));
+}
+
+TEST(delta, unchanged) {
+  stTests base, cur;
+  fill(base, 20);
+  fill(cur, 20);
+
+  char buf[sizeof(cur)];
+  // one bitmap byte for the five top-level fields
+  EXPECT_EQ(1, clDiff(stTestsObject, &base, &cur, buf, sizeof(buf)));
+  EXPECT_EQ(0, buf[0]);
+}
+
+TEST(delta, leaf) {
+  stTests base, cur;
+  fill(base, 20);
+  fill(cur, 20);
+  cur.fuzz[17].tag = 99;
+
+  char buf[sizeof(cur)];
+  ptrdiff_t n = clDiff(stTestsObject, &base, &cur, buf, sizeof(buf));
+  // top bitmap + fuzz bitmap + stFuzz bitmap + tag
+  EXPECT_EQ(1 + 3 + 1 + 4, n);
+  EXPECT_EQ(n, clDiffSize(stTestsObject, &base, &cur));
+
+  stTests dst = base;
+  EXPECT_EQ(n, clPatch(stTestsObject, &dst, buf, n));
+  expectSame(cur, dst);
+}
+
+TEST(delta, resize) {
+  stTests base, cur;
+  fill(base, 2);
+  fill(cur, 5);
+  strcpy(cur.name, "grown");
+  cur.fuzz[0].v.u32 = 7;
+  cur.inlineUnion.abc.other[1] = 3;
+
+  // the receiver never saw the elements past the baseline count
+  stTests dst = base;
+  memset(dst.fuzz + 2, 0xcc, sizeof(dst.fuzz) - 2 * sizeof(dst.fuzz[0]));
+
+  char buf[sizeof(cur)];
+  ptrdiff_t n = clDiff(stTestsObject, &base, &cur, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+  EXPECT_EQ(n, clPatch(stTestsObject, &dst, buf, n));
+  expectSame(cur, dst);
+
+  // and back down
+  n = clDiff(stTestsObject, &cur, &base, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+  EXPECT_EQ(n, clPatch(stTestsObject, &dst, buf, n));
+  expectSame(base, dst);
+}
+
+TEST(delta, errors) {
+  stUseItemRsp base, cur;
+  memset(&base, 0, sizeof(base));
+  memset(&cur, 0, sizeof(cur));
+  cur.num = 3;
+  cur.drops[2].itemNum = 1;
+
+  char buf[sizeof(cur)];
+  ptrdiff_t n = clDiff(stUseItemRspObject, &base, &cur, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+  for (ptrdiff_t i = 0; i < n; ++i) {
+    EXPECT_EQ(cl_ERR_BUFFER,
+              clDiff(stUseItemRspObject, &base, &cur, buf, i));
+    stUseItemRsp dst = base;
+    EXPECT_EQ(cl_ERR_BUFFER, clPatch(stUseItemRspObject, &dst, buf, i));
+  }
+
+  cur.num = 11;
+  EXPECT_EQ(cl_ERR_CAPACITY,
+            clDiff(stUseItemRspObject, &base, &cur, buf, sizeof(buf)));
+}
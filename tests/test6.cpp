@@ -0,0 +1,82 @@
+#include <columns.h>
+#include <cstddef>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+static const clColumn *find(const clColumn *column, const char *name) {
+  return clFindColumn(column, name, strlen(name));
+}
+
+TEST(lookup, find) {
+  const clColumn *tests = stTestsObject;
+  for (int32_t i = 0; i < tests->via_object.num; ++i) {
+    const clColumn *column = &tests->via_object.columns[i];
+    EXPECT_EQ(column, find(tests, column->name.string));
+  }
+
+  EXPECT_EQ(nullptr, find(tests, ""));
+  EXPECT_EQ(nullptr, find(tests, "fuzzNu"));
+  EXPECT_EQ(nullptr, find(tests, "fuzzNumx"));
+  EXPECT_EQ(nullptr, find(tests, "itemID"));
+  EXPECT_EQ(nullptr, find(&tests->via_object.columns[0], "epoch"));
+
+  const clColumn *inlineUnion = find(tests, "inlineUnion");
+  const clColumn *abc = find(inlineUnion, "abc");
+  ASSERT_NE(nullptr, abc);
+  EXPECT_EQ(cl_UNION, abc->tp);
+  EXPECT_EQ(cl_UINT8, find(abc, "u8")->tp);
+}
+
+TEST(lookup, path) {
+  clPath path;
+  const char *expr = "fuzz[3].v.u32";
+
+  // the second lookup is served from the cache
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_EQ(0, clResolvePath(stTestsObject, expr, strlen(expr), &path));
+    EXPECT_EQ(cl_UINT32, path.column->tp);
+    EXPECT_EQ((ptrdiff_t)offsetof(stTests, fuzz[3].v.u32), path.offset);
+  }
+
+  expr = "fuzz.tag";
+  ASSERT_EQ(0, clResolvePath(stTestsObject, expr, strlen(expr), &path));
+  EXPECT_EQ((ptrdiff_t)offsetof(stTests, fuzz[0].tag), path.offset);
+
+  expr = "inlineUnion.abc.other[1]";
+  ASSERT_EQ(0, clResolvePath(stTestsObject, expr, strlen(expr), &path));
+  EXPECT_EQ(cl_FIXED_ARRAY, path.column->tp);
+  EXPECT_EQ((ptrdiff_t)offsetof(stTests, inlineUnion.abc.other[1]),
+            path.offset);
+
+  const char *invalid[] = {
+      "",           "fuzz[20]",  "fuzz[",      "fuzz[]",   "fuzz.",
+      ".fuzz",      "epoch.x",   "fuzz[1]x",   "nothing",  "fuzz..tag",
+      "name[1]",    "fuzz[-1]",  "fuzz[1].v.u32.x",
+  };
+  for (const char *p : invalid) {
+    EXPECT_EQ(cl_ERR_VALUE, clResolvePath(stTestsObject, p, strlen(p), &path))
+        << p;
+  }
+}
+
+TEST(lookup, released) {
+  // a descriptor rebuilt at the address of a released one
+  std::vector<clColumn> fields(stNumbersObject->via_object.columns,
+                               stNumbersObject->via_object.columns +
+                                   stNumbersObject->via_object.num);
+  clColumn object = *stNumbersObject;
+  object.via_object.columns = fields.data();
+
+  clPath path;
+  ASSERT_EQ(0, clResolvePath(&object, "u32", 3, &path));
+  EXPECT_EQ((ptrdiff_t)offsetof(stNumbers, u32), path.offset);
+
+  const_cast<clColumn *>(path.column)->offset += 8;
+  clProgramCacheClear();
+  ASSERT_EQ(0, clResolvePath(&object, "u32", 3, &path));
+  EXPECT_EQ((ptrdiff_t)offsetof(stNumbers, u32) + 8, path.offset);
+}
@@ -0,0 +1,59 @@
+#include <columns.h>
+#include <cstring>
+#include <gtest/gtest.h>
+
+#include "commands_def.h"
+
+static int onUseItemRsp(const clColumn *column, void *msg, void *ctx) {
+  EXPECT_EQ(stUseItemRspObject, column);
+  const stUseItemRsp *rsp = static_cast<const stUseItemRsp *>(msg);
+  *static_cast<uint32_t *>(ctx) = rsp->drops[rsp->num - 1].itemID;
+  return rsp->code ? cl_ERR_VALUE : 0;
+}
+
+TEST(dispatch, table) {
+  EXPECT_EQ(1, commandsDispatch.first);
+  EXPECT_EQ(3, commandsDispatch.num);
+  EXPECT_EQ(stUseItemReqObject, clCommandColumn(&commandsDispatch, 1));
+  EXPECT_EQ(stDropObject, clCommandColumn(&commandsDispatch, stDropCmd));
+  EXPECT_EQ(stUseItemRspObject, clCommandColumn(&commandsDispatch, 3));
+  EXPECT_EQ(nullptr, clCommandColumn(&commandsDispatch, 0));
+  EXPECT_EQ(nullptr, clCommandColumn(&commandsDispatch, 4));
+  EXPECT_EQ(nullptr, clCommandColumn(&commandsDispatch, INT32_MIN));
+}
+
+TEST(dispatch, message) {
+  stUseItemRsp rsp;
+  memset(&rsp, 0, sizeof(rsp));
+  rsp.num = 2;
+  rsp.drops[1].itemID = 42;
+
+  char buf[sizeof(rsp)];
+  ptrdiff_t n = clEncode(stUseItemRspObject, &rsp, buf, sizeof(buf));
+  ASSERT_GT(n, 0);
+
+  commandsMessage msg;
+  uint32_t itemID = 0;
+  EXPECT_EQ(cl_ERR_VALUE, clDispatchMessage(&commandsDispatch, stUseItemRspCmd,
+                                            &msg, buf, n, &itemID));
+
+  EXPECT_EQ(0, clRegisterHandler(&commandsDispatch, stUseItemRspCmd,
+                                 onUseItemRsp));
+  EXPECT_EQ(cl_ERR_VALUE,
+            clRegisterHandler(&commandsDispatch, 7, onUseItemRsp));
+
+  EXPECT_EQ(n, clDispatchMessage(&commandsDispatch, stUseItemRspCmd, &msg, buf,
+                                 n, &itemID));
+  EXPECT_EQ(42u, itemID);
+
+  EXPECT_EQ(cl_ERR_BUFFER, clDispatchMessage(&commandsDispatch,
+                                             stUseItemRspCmd, &msg, buf, 4,
+                                             &itemID));
+
+  // errors of the handler are passed through
+  rsp.code = 1;
+  n = clEncode(stUseItemRspObject, &rsp, buf, sizeof(buf));
+  EXPECT_EQ(cl_ERR_VALUE, clDispatchMessage(&commandsDispatch,
+                                            stUseItemRspCmd, &msg, buf, n,
+                                            &itemID));
+}
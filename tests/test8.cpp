@@ -0,0 +1,121 @@
+#include <columns.h>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+static int32_t leaf(const clBatch &batch, const char *path) {
+  return clBatchLeaf(&batch, path, strlen(path));
+}
+
+TEST(batch, roundtrip) {
+  std::vector<stTests> rows(300);
+  memset(rows.data(), 0, rows.size() * sizeof(stTests));
+  for (size_t i = 0; i < rows.size(); ++i) {
+    rows[i].epoch = (uint32_t)i;
+    snprintf(rows[i].name, sizeof(rows[i].name), "row%zu", i);
+    rows[i].fuzzNum = 1;
+    rows[i].fuzz[0].v.u32 = (uint32_t)i * 3;
+    rows[i].inlineUnion.tag = -(int32_t)i;
+  }
+
+  clBatch batch;
+  ASSERT_EQ(0, clBatchInit(&batch, stTestsObject));
+  // epoch, name, fuzzNum, fuzz, inlineUnion.tag, inlineUnion.abc
+  EXPECT_EQ(6, batch.num);
+  EXPECT_EQ(4, leaf(batch, "inlineUnion.tag"));
+  EXPECT_EQ(cl_ERR_VALUE, leaf(batch, "inlineUnion"));
+  EXPECT_EQ(cl_ERR_VALUE, leaf(batch, "fuzz[1].tag"));
+
+  ASSERT_EQ(0, clBatchAppend(&batch, rows.data(), 100, sizeof(stTests)));
+  ASSERT_EQ(0, clBatchAppend(&batch, rows.data() + 100, 200, sizeof(stTests)));
+  EXPECT_EQ(300u, batch.size);
+  for (int32_t i = 0; i < batch.num; ++i) {
+    EXPECT_EQ(0u, (uintptr_t)batch.data[i] % 64);
+  }
+
+  std::vector<stTests> out(rows.size());
+  memset(out.data(), 0, out.size() * sizeof(stTests));
+  ASSERT_EQ(0, clBatchGather(&batch, 0, out.size(), out.data(),
+                             sizeof(stTests)));
+  EXPECT_EQ(0, memcmp(rows.data(), out.data(), rows.size() * sizeof(stTests)));
+
+  out[7].epoch = 1000;
+  ASSERT_EQ(0, clBatchScatter(&batch, 7, 1, &out[7], sizeof(stTests)));
+  clScalar max, min;
+  ASSERT_EQ(0, clBatchMinMax(&batch, leaf(batch, "epoch"), &min, &max));
+  EXPECT_EQ(0u, min.u64);
+  EXPECT_EQ(1000u, max.u64);
+
+  EXPECT_EQ(cl_ERR_VALUE,
+            clBatchGather(&batch, 299, 2, out.data(), sizeof(stTests)));
+  EXPECT_EQ(cl_ERR_VALUE,
+            clBatchScatter(&batch, 301, 0, out.data(), sizeof(stTests)));
+  EXPECT_EQ(cl_ERR_MEMORY, clBatchReserve(&batch, SIZE_MAX / 2));
+  EXPECT_EQ(300u, batch.size);
+  clBatchFree(&batch);
+}
+
+TEST(batch, kernels) {
+  std::vector<stNumbers> rows(1000);
+  memset(rows.data(), 0, rows.size() * sizeof(stNumbers));
+  for (size_t i = 0; i < rows.size(); ++i) {
+    rows[i].i8 = (int8_t)(i % 7 - 3);
+    rows[i].u64 = i;
+    rows[i].f64 = (double)i / 2;
+    rows[i].b = i % 3 == 0;
+  }
+
+  clBatch batch;
+  ASSERT_EQ(0, clBatchInit(&batch, stNumbersObject));
+  ASSERT_EQ(0, clBatchAppend(&batch, rows.data(), rows.size(),
+                             sizeof(stNumbers)));
+
+  clScalar sum, min, max;
+  ASSERT_EQ(0, clBatchSum(&batch, leaf(batch, "u64"), &sum));
+  EXPECT_EQ(999u * 1000 / 2, sum.u64);
+  ASSERT_EQ(0, clBatchSum(&batch, leaf(batch, "f64"), &sum));
+  EXPECT_DOUBLE_EQ(999.0 * 1000 / 4, sum.f64);
+  ASSERT_EQ(0, clBatchSum(&batch, leaf(batch, "b"), &sum));
+  EXPECT_EQ(334u, sum.u64);
+
+  ASSERT_EQ(0, clBatchMinMax(&batch, leaf(batch, "i8"), &min, &max));
+  EXPECT_EQ(-3, min.i64);
+  EXPECT_EQ(3, max.i64);
+
+  std::vector<uint64_t> mask((batch.size + 63) / 64);
+  clScalar value;
+  value.i64 = 0;
+  ptrdiff_t n =
+      clBatchFilter(&batch, leaf(batch, "i8"), cl_CMP_LT, value, mask.data());
+  ptrdiff_t expected = 0;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    bool hit = rows[i].i8 < 0;
+    expected += hit;
+    EXPECT_EQ(hit, (mask[i / 64] >> (i % 64)) & 1) << i;
+  }
+  EXPECT_EQ(expected, n);
+
+  // values outside the range of the column compare as numbers
+  value.i64 = 1000;
+  EXPECT_EQ(1000, clBatchFilter(&batch, leaf(batch, "i8"), cl_CMP_LT, value,
+                                mask.data()));
+  value.f64 = 100;
+  EXPECT_EQ(200, clBatchFilter(&batch, leaf(batch, "f64"), cl_CMP_LT, value,
+                               mask.data()));
+
+  EXPECT_EQ(cl_ERR_TYPE, clBatchSum(&batch, 42, &sum));
+  EXPECT_EQ(cl_ERR_VALUE, clBatchFilter(&batch, leaf(batch, "i8"), 99, value,
+                                        mask.data()));
+  clBatchFree(&batch);
+
+  ASSERT_EQ(0, clBatchInit(&batch, stNumbersObject));
+  EXPECT_EQ(cl_ERR_VALUE,
+            clBatchMinMax(&batch, leaf(batch, "u8"), &min, &max));
+  clBatchFree(&batch);
+
+  const clColumn *i8 = &stNumbersObject->via_object.columns[0];
+  EXPECT_EQ(cl_ERR_TYPE, clBatchInit(&batch, i8));
+}
@@ -0,0 +1,134 @@
+#include <columns.h>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "messages.h"
+#include "messages_def.h"
+
+template <class T>
+static void expectRoundtrip(const clColumn *column, const std::vector<T> &rows,
+                            ptrdiff_t *compressed = nullptr) {
+  clBatch batch;
+  ASSERT_EQ(0, clBatchInit(&batch, column));
+  ASSERT_EQ(0, clBatchAppend(&batch, rows.data(), rows.size(), sizeof(T)));
+
+  ptrdiff_t n = clBatchCompressSize(&batch);
+  ASSERT_GT(n, 0);
+  std::vector<uint8_t> buf(n);
+  EXPECT_EQ(cl_ERR_BUFFER, clBatchCompress(&batch, buf.data(), n - 1));
+  ASSERT_EQ(n, clBatchCompress(&batch, buf.data(), buf.size()));
+
+  clBatch out;
+  ASSERT_EQ(0, clBatchInit(&out, column));
+  if (!rows.empty()) {
+    EXPECT_EQ(cl_ERR_CAPACITY, clBatchDecompress(&out, buf.data(), buf.size(),
+                                                 rows.size() - 1));
+  }
+  ASSERT_EQ(n, clBatchDecompress(&out, buf.data(), buf.size(), rows.size()));
+  ASSERT_EQ(rows.size(), out.size);
+
+  std::vector<T> back(rows.size());
+  ASSERT_EQ(0, clBatchGather(&out, 0, back.size(), back.data(), sizeof(T)));
+  EXPECT_EQ(0, memcmp(rows.data(), back.data(), rows.size() * sizeof(T)));
+
+  // a truncated buffer never decodes
+  for (ptrdiff_t i = 0; i < n; ++i) {
+    clBatch tmp;
+    ASSERT_EQ(0, clBatchInit(&tmp, column));
+    EXPECT_LT(clBatchDecompress(&tmp, buf.data(), i, rows.size()), 0) << i;
+    clBatchFree(&tmp);
+  }
+
+  if (compressed) {
+    *compressed = n;
+  }
+  clBatchFree(&out);
+  clBatchFree(&batch);
+}
+
+static int32_t leaf(const clBatch &batch, const char *path) {
+  return clBatchLeaf(&batch, path, strlen(path));
+}
+
+TEST(compress, choice) {
+  std::vector<stNumbers> rows(1000);
+  memset(rows.data(), 0, rows.size() * sizeof(stNumbers));
+  static const uint64_t sparse[] = {7, 1000000, 5000000000ull};
+  for (size_t i = 0; i < rows.size(); ++i) {
+    rows[i].i8 = (int8_t)(i % 4 - 2);
+    rows[i].i16 = (int16_t)(i < 500 ? -300 : 300);
+    rows[i].i32 = (int32_t)(100000 - i * 3);
+    rows[i].u64 = sparse[i * 7 % 3];
+    rows[i].f64 = (double)i;
+  }
+
+  clBatch batch;
+  ASSERT_EQ(0, clBatchInit(&batch, stNumbersObject));
+  ASSERT_EQ(0, clBatchAppend(&batch, rows.data(), rows.size(),
+                             sizeof(stNumbers)));
+  EXPECT_EQ(cl_CODEC_FOR, clBatchCodec(&batch, leaf(batch, "i8")));
+  EXPECT_EQ(cl_CODEC_RLE, clBatchCodec(&batch, leaf(batch, "i16")));
+  EXPECT_EQ(cl_CODEC_DELTA, clBatchCodec(&batch, leaf(batch, "i32")));
+  EXPECT_EQ(cl_CODEC_DICT, clBatchCodec(&batch, leaf(batch, "u64")));
+  EXPECT_EQ(cl_CODEC_PLAIN, clBatchCodec(&batch, leaf(batch, "f64")));
+  EXPECT_EQ(cl_ERR_VALUE, clBatchCodec(&batch, -1));
+  clBatchFree(&batch);
+
+  expectRoundtrip(stNumbersObject, rows);
+}
+
+TEST(compress, extremes) {
+  std::vector<stNumbers> rows(300);
+  memset(rows.data(), 0, rows.size() * sizeof(stNumbers));
+  for (size_t i = 0; i < rows.size(); ++i) {
+    rows[i].i64 = i % 2 ? INT64_MIN : INT64_MAX;
+    rows[i].u64 = i % 3 ? 0 : UINT64_MAX;
+    rows[i].i32 = (int32_t)(i * 2654435761u);
+    rows[i].u16 = (uint16_t)(i * 40503u);
+    rows[i].b = i % 5 == 0;
+  }
+  expectRoundtrip(stNumbersObject, rows);
+
+  rows.resize(1);
+  expectRoundtrip(stNumbersObject, rows);
+}
+
+TEST(compress, drops) {
+  std::vector<stDrop> rows(10000);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    rows[i].itemID = 1000 + (uint32_t)(i / 16);
+    rows[i].itemNum = 1 + (uint32_t)(i % 3);
+  }
+
+  ptrdiff_t n = 0;
+  expectRoundtrip(stDropObject, rows, &n);
+  EXPECT_LT(n * 10, (ptrdiff_t)(rows.size() * sizeof(stDrop)));
+}
+
+TEST(compress, objects) {
+  std::vector<stTests> rows(50);
+  memset(rows.data(), 0, rows.size() * sizeof(stTests));
+  for (size_t i = 0; i < rows.size(); ++i) {
+    rows[i].epoch = (uint32_t)(i / 10);
+    strcpy(rows[i].name, i < 25 ? "first" : "second");
+    rows[i].fuzzNum = 2;
+    rows[i].fuzz[1].v.u32 = (uint32_t)i;
+  }
+  expectRoundtrip(stTestsObject, rows);
+}
+
+TEST(compress, rowCount) {
+  // a forged count is refused before any row is reserved
+  const uint8_t buf[] = {0xff, 0xff, 0xff, 0xff, 0x0f, cl_CODEC_RLE, 1, 0xff,
+                         0xff, 0xff, 0xff, 0x0f, 0, 0, 0, 0};
+  clBatch batch;
+  ASSERT_EQ(0, clBatchInit(&batch, stDropObject));
+  EXPECT_EQ(cl_ERR_CAPACITY,
+            clBatchDecompress(&batch, buf, sizeof(buf), 1 << 20));
+  EXPECT_EQ(0u, batch.size);
+  EXPECT_EQ(0u, batch.capacity);
+  EXPECT_EQ(cl_ERR_BUFFER, clBatchDecompress(&batch, buf, 5, SIZE_MAX));
+  EXPECT_EQ(0u, batch.capacity);
+  clBatchFree(&batch);
+}